@@ -0,0 +1,43 @@
+// File: components/aggregation/aggregation.c
+
+#include "aggregation.h"
+
+void aggregation_init(aggregate_t *agg, uint32_t window_s) {
+    agg->window_s = window_s;
+    agg->window_start_s = 0;
+    agg->count = 0;
+    running_stats_reset(&agg->distance);
+    running_stats_reset(&agg->weight);
+}
+
+bool aggregation_poll(aggregate_t *agg, uint32_t now_s, aggregate_t *closed) {
+    // Nada que cerrar si la ventana está vacía o todavía no ha vencido
+    if (agg->window_s == 0 || agg->count == 0 || now_s < agg->window_start_s + agg->window_s) {
+        return false;
+    }
+
+    *closed = *agg;
+    agg->count = 0;
+    running_stats_reset(&agg->distance);
+    running_stats_reset(&agg->weight);
+    return true;
+}
+
+bool aggregation_push(aggregate_t *agg, uint32_t now_s, float distance_cm, bool distance_valid,
+                      float weight_kg, bool weight_valid, aggregate_t *closed) {
+    if (agg->window_s == 0) {
+        return false;
+    }
+
+    bool window_closed = aggregation_poll(agg, now_s, closed);
+
+    // Primera muestra de la ventana: alinear su inicio a un múltiplo de la duración
+    if (agg->count == 0) {
+        agg->window_start_s = now_s - (now_s % agg->window_s);
+    }
+
+    agg->count++;
+    if (distance_valid) running_stats_add(&agg->distance, distance_cm);
+    if (weight_valid) running_stats_add(&agg->weight, weight_kg);
+    return window_closed;
+}
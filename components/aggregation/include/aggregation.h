@@ -0,0 +1,27 @@
+// File: components/aggregation/include/aggregation.h
+
+#pragma once                 // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "running_stats.h"
+
+// Ventana de agregación alineada al reloj (p.ej. 12:00:00-12:01:00 para 60 s)
+typedef struct {
+    uint32_t window_s;           // Duración de la ventana en segundos (0 = sin inicializar)
+    uint32_t window_start_s;     // Inicio de la ventana en curso (epoch UTC)
+    uint32_t count;              // Muestras de la ventana (cada canal cuenta solo sus lecturas válidas)
+    running_stats_t distance;    // Estadísticos de distancia (cm)
+    running_stats_t weight;      // Estadísticos de peso (kg)
+} aggregate_t;
+
+void aggregation_init(aggregate_t *agg, uint32_t window_s);     // Prepara una ventana vacía de window_s segundos
+
+// Añade una muestra; un canal con lectura fallida (valid a false) no entra en sus estadísticos.
+// Si la muestra cae fuera de la ventana en curso, copia la ventana cerrada en closed, abre la
+// nueva y devuelve true (closed solo es válido en ese caso)
+bool aggregation_push(aggregate_t *agg, uint32_t now_s, float distance_cm, bool distance_valid,
+                      float weight_kg, bool weight_valid, aggregate_t *closed);
+
+// Cierra la ventana en curso si ya ha vencido aunque no lleguen muestras nuevas
+bool aggregation_poll(aggregate_t *agg, uint32_t now_s, aggregate_t *closed);
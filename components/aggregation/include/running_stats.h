@@ -0,0 +1,46 @@
+// File: components/aggregation/include/running_stats.h
+
+#pragma once                 // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <math.h>
+
+// Estadísticos incrementales (algoritmo de Welford): memoria O(1) y una pasada
+typedef struct {
+    uint32_t count;          // Número de muestras acumuladas
+    float mean;              // Media actual
+    float m2;                // Suma de cuadrados de las desviaciones respecto a la media
+    float min;               // Mínimo observado
+    float max;               // Máximo observado
+} running_stats_t;
+
+static inline void running_stats_reset(running_stats_t *s) {
+    s->count = 0;
+    s->mean = 0.0f;
+    s->m2 = 0.0f;
+    s->min = 0.0f;
+    s->max = 0.0f;
+}
+
+static inline void running_stats_add(running_stats_t *s, float x) {
+    s->count++;
+    if (s->count == 1) {
+        s->min = x;
+        s->max = x;
+    } else {
+        if (x < s->min) s->min = x;
+        if (x > s->max) s->max = x;
+    }
+    float delta = x - s->mean;
+    s->mean += delta / (float)s->count;
+    s->m2 += delta * (x - s->mean);
+}
+
+// Varianza muestral (0 si hay menos de 2 muestras)
+static inline float running_stats_variance(const running_stats_t *s) {
+    return (s->count > 1) ? s->m2 / (float)(s->count - 1) : 0.0f;
+}
+
+static inline float running_stats_stddev(const running_stats_t *s) {
+    return sqrtf(running_stats_variance(s));
+}
@@ -0,0 +1,421 @@
+//File: components/commands/commands.c
+
+#include "commands.h"
+#include "communication.h"
+#include "config.h"
+#include "diagnostics.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "commands";                   // Etiqueta que usará esp_logx para clasificar mensajes de este módulo
+
+#define COMMANDS_TASK_STACK         4096
+#define COMMANDS_TASK_PRI           (tskIDLE_PRIORITY + 1)
+#define COMMANDS_POLL_MS            20                  // Sondeo de commands_wait_idle()
+#define COMMANDS_RESTART_DELAY_MS   1000                // Margen para que salga la respuesta antes de reiniciar
+
+// Mensaje copiado desde el manejador MQTT
+typedef struct {
+    uint16_t len;
+    char payload[COMMANDS_PAYLOAD_MAX];
+} command_msg_t;
+
+typedef struct {
+    char name[COMMANDS_NAME_MAX];
+    command_handler_t handler;
+    void *ctx;
+} command_entry_t;
+
+// Ids ya ejecutados y su resultado. En memoria RTC sin inicializar: sobreviven al deep sleep y a
+// esp_restart() (comando reboot o un fallo a mitad de comando), que es cuando el broker vuelve a
+// entregar lo que no llegó a confirmarse. Tras un corte de alimentación el número mágico lo descarta
+#define COMMANDS_SEEN_MAGIC  0x434d4431u                // "CMD1"
+typedef struct {
+    uint32_t hash;                                      // FNV-1a del id
+    int32_t result;                                     // esp_err_t de la primera ejecución
+} command_seen_t;
+RTC_NOINIT_ATTR static uint32_t seen_magic;
+RTC_NOINIT_ATTR static uint32_t seen_count;
+RTC_NOINIT_ATTR static uint32_t seen_next;
+RTC_NOINIT_ATTR static command_seen_t seen[CONFIG_COMMANDS_DEDUP_SLOTS];
+
+static QueueHandle_t command_queue;
+static command_entry_t handlers[COMMANDS_MAX_HANDLERS];
+static int handler_count;
+static uint32_t pending;                                // Encolados + en ejecución
+static portMUX_TYPE pending_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool restart_requested;
+
+// === UTILIDADES ===
+
+static uint32_t id_hash(const char *id) {
+    uint32_t h = 2166136261u;
+    for (; *id; id++) {
+        h ^= (uint8_t)*id;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Ids y nombres: letras, cifras y - _ . : (van sin escapar en la respuesta)
+static bool valid_token(const char *s) {
+    if (*s == '\0') return false;
+    for (; *s; s++) {
+        char c = *s;
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '-' || c == '_' || c == '.' || c == ':';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static bool seen_lookup(uint32_t hash, esp_err_t *result) {
+    for (uint32_t i = 0; i < seen_count; i++) {
+        if (seen[i].hash == hash) {
+            *result = seen[i].result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void seen_store(uint32_t hash, esp_err_t result) {
+    seen[seen_next] = (command_seen_t){ hash, result };
+    seen_next = (seen_next + 1) % CONFIG_COMMANDS_DEDUP_SLOTS;
+    if (seen_count < CONFIG_COMMANDS_DEDUP_SLOTS) seen_count++;
+}
+
+// Busca "key": en el objeto y devuelve el inicio del valor, o NULL
+static const char *json_find_value(const char *json, const char *key) {
+    size_t key_len = strlen(key);
+    for (const char *p = strchr(json, '"'); p; p = strchr(p + 1, '"')) {
+        if (strncmp(p + 1, key, key_len) != 0 || p[1 + key_len] != '"') continue;
+        const char *v = p + 2 + key_len;
+        while (*v == ' ' || *v == '\t' || *v == '\r' || *v == '\n') v++;
+        if (*v != ':') continue;                        // Era un valor que coincide con la clave
+        v++;
+        while (*v == ' ' || *v == '\t' || *v == '\r' || *v == '\n') v++;
+        return v;
+    }
+    return NULL;
+}
+
+// Copia texto escapando lo que no puede ir tal cual dentro de una cadena JSON
+static void json_escape(const char *in, char *out, size_t out_len) {
+    size_t n = 0;
+    for (; *in && n + 2 < out_len; in++) {
+        char c = *in;
+        if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = c;
+        } else if ((unsigned char)c >= 0x20) {
+            out[n++] = c;
+        }
+    }
+    out[n] = '\0';
+}
+
+static void publish_ack(const char *id, const char *name, const char *status, const char *detail) {
+    char escaped[COMMANDS_DETAIL_MAX * 2];
+    char msg[COMMANDS_ID_MAX + COMMANDS_NAME_MAX + sizeof(escaped) + 64];
+    json_escape(detail, escaped, sizeof(escaped));
+    snprintf(msg, sizeof(msg), "{\"id\":\"%s\",\"cmd\":\"%s\",\"status\":\"%s\",\"detail\":\"%s\"}",
+             id, name, status, escaped);
+    if (!communication_publish_ack(msg)) {
+        ESP_LOGW(TAG, "No se pudo enviar la respuesta del comando %s", id);
+    }
+}
+
+bool commands_get_arg(const command_t *cmd, const char *key, char *out, size_t out_len) {
+    if (!cmd || !cmd->json || !out || out_len == 0) return false;
+    const char *v = json_find_value(cmd->json, key);
+    if (!v) return false;
+
+    size_t n = 0;
+    if (*v == '"') {
+        for (v++; *v && *v != '"'; v++) {
+            if (*v == '\\' && v[1]) v++;                // \" y \\ se copian sin la barra
+            if (n + 1 < out_len) out[n++] = *v;
+        }
+        if (*v != '"') return false;                    // Cadena sin cerrar
+    } else {
+        for (; *v && *v != ',' && *v != '}' && *v != ' ' && *v != '\r' && *v != '\n'; v++) {
+            if (n + 1 < out_len) out[n++] = *v;
+        }
+        if (n == 0) return false;
+    }
+    out[n] = '\0';
+    return true;
+}
+
+// === COMANDOS PROPIOS ===
+
+static void format_config_value(config_key_t key, char *out, size_t out_len) {
+    const config_desc_t *desc = config_describe(key);
+    switch (desc->type) {
+        case CFG_TYPE_U32:
+            snprintf(out, out_len, "%s=%lu", desc->name, (unsigned long)config_get_u32(key));
+            break;
+        case CFG_TYPE_BOOL:
+            snprintf(out, out_len, "%s=%s", desc->name, config_get_bool(key) ? "true" : "false");
+            break;
+        case CFG_TYPE_STR:
+            snprintf(out, out_len, "%s=%s", desc->name, config_get_str(key));
+            break;
+    }
+}
+
+// {"cmd":"set","key":"period_usb_ms","value":"10000"}
+static esp_err_t cmd_set(const command_t *cmd, char *detail, size_t detail_len, void *ctx) {
+    (void)ctx;
+    char name[CFG_STR_MAX], value[CFG_STR_MAX];
+    if (!commands_get_arg(cmd, "key", name, sizeof(name)) || !commands_get_arg(cmd, "value", value, sizeof(value))) {
+        snprintf(detail, detail_len, "faltan key o value");
+        return ESP_ERR_INVALID_ARG;
+    }
+    config_key_t key = config_find(name);
+    if (key == CFG_KEY_INVALID) {
+        snprintf(detail, detail_len, "clave desconocida: %s", name);
+        return ESP_ERR_NOT_FOUND;
+    }
+    // Pines y prefijo: un valor erróneo deja la estación sin sensores o sin comandos hasta visitarla
+    if (config_describe(key)->flags & CFG_FLAG_LOCAL) {
+        snprintf(detail, detail_len, "%s no se cambia a distancia", name);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    esp_err_t err = config_set_from_text(key, value);
+    if (err != ESP_OK) {
+        snprintf(detail, detail_len, "valor no válido para %s", name);
+        return err;
+    }
+    format_config_value(key, detail, detail_len);
+    if (config_describe(key)->flags & CFG_FLAG_REBOOT) {
+        size_t n = strlen(detail);
+        snprintf(detail + n, detail_len - n, " (se aplica al reiniciar)");
+    }
+    return ESP_OK;
+}
+
+// {"cmd":"get","key":"period_usb_ms"}
+static esp_err_t cmd_get(const command_t *cmd, char *detail, size_t detail_len, void *ctx) {
+    (void)ctx;
+    char name[CFG_STR_MAX];
+    if (!commands_get_arg(cmd, "key", name, sizeof(name))) {
+        snprintf(detail, detail_len, "falta key");
+        return ESP_ERR_INVALID_ARG;
+    }
+    config_key_t key = config_find(name);
+    if (key == CFG_KEY_INVALID) {
+        snprintf(detail, detail_len, "clave desconocida: %s", name);
+        return ESP_ERR_NOT_FOUND;
+    }
+    format_config_value(key, detail, detail_len);
+    return ESP_OK;
+}
+
+// {"cmd":"reset","key":"period_usb_ms"}; sin key, toda la configuración
+static esp_err_t cmd_reset(const command_t *cmd, char *detail, size_t detail_len, void *ctx) {
+    (void)ctx;
+    char name[CFG_STR_MAX];
+    config_key_t key = CFG_KEY_ANY;
+    if (commands_get_arg(cmd, "key", name, sizeof(name))) {
+        key = config_find(name);
+        if (key == CFG_KEY_INVALID) {
+            snprintf(detail, detail_len, "clave desconocida: %s", name);
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+    esp_err_t err = config_reset(key);
+    if (err == ESP_OK && key != CFG_KEY_ANY) {
+        format_config_value(key, detail, detail_len);
+    }
+    return err;
+}
+
+static esp_err_t cmd_dump_events(const command_t *cmd, char *detail, size_t detail_len, void *ctx) {
+    (void)cmd;
+    (void)detail;
+    (void)detail_len;
+    (void)ctx;
+    communication_publish_events();
+    return ESP_OK;
+}
+
+// El reinicio se hace después de enviar la respuesta y guardar el id (ver command_task)
+static esp_err_t cmd_reboot(const command_t *cmd, char *detail, size_t detail_len, void *ctx) {
+    (void)cmd;
+    (void)ctx;
+    restart_requested = true;
+    snprintf(detail, detail_len, "reinicio en %d ms", COMMANDS_RESTART_DELAY_MS);
+    return ESP_OK;
+}
+
+// === DESPACHO ===
+
+static const command_entry_t *find_handler(const char *name) {
+    for (int i = 0; i < handler_count; i++) {
+        if (strcmp(handlers[i].name, name) == 0) return &handlers[i];
+    }
+    return NULL;
+}
+
+static void process_command(const command_msg_t *msg) {
+    command_t cmd = { .json = msg->payload };
+    char detail[COMMANDS_DETAIL_MAX] = "";
+
+    if (!commands_get_arg(&cmd, "id", cmd.id, sizeof(cmd.id)) || !valid_token(cmd.id)) {
+        ESP_LOGW(TAG, "Comando sin id válido descartado: %.*s", msg->len, msg->payload);
+        publish_ack("", "", "error", "id ausente o no válido");
+        return;
+    }
+    if (!commands_get_arg(&cmd, "cmd", cmd.name, sizeof(cmd.name)) || !valid_token(cmd.name)) {
+        cmd.name[0] = '\0';
+    }
+
+    // Idempotencia: un id ya visto solo repite la respuesta
+    uint32_t hash = id_hash(cmd.id);
+    esp_err_t result;
+    if (seen_lookup(hash, &result)) {
+        ESP_LOGI(TAG, "Comando %s repetido, no se ejecuta otra vez", cmd.id);
+        publish_ack(cmd.id, cmd.name, "duplicate", result == ESP_OK ? "ok" : esp_err_to_name(result));
+        return;
+    }
+
+    const command_entry_t *entry = find_handler(cmd.name);
+    if (entry) {
+        ESP_LOGI(TAG, "Ejecutando comando %s (%s)", cmd.id, cmd.name);
+        result = entry->handler(&cmd, detail, sizeof(detail), entry->ctx);
+    } else {
+        snprintf(detail, sizeof(detail), "comando desconocido: %s", cmd.name);
+        result = ESP_ERR_NOT_SUPPORTED;
+    }
+    if (result != ESP_OK && detail[0] == '\0') {
+        strlcpy(detail, esp_err_to_name(result), sizeof(detail));
+    }
+
+    // El id se guarda antes de responder: si se corta aquí, la reentrega no vuelve a ejecutarlo
+    seen_store(hash, result);
+    diagnostics_event(DIAG_EVT_COMMAND, (int32_t)hash, result);
+    publish_ack(cmd.id, cmd.name, result == ESP_OK ? "ok" : "error", detail);
+}
+
+static void command_task(void* _) {
+    command_msg_t msg;
+
+    for (;;) {
+        if (xQueueReceive(command_queue, &msg, portMAX_DELAY) != pdTRUE) continue;
+        process_command(&msg);
+
+        portENTER_CRITICAL(&pending_lock);
+        pending--;
+        portEXIT_CRITICAL(&pending_lock);
+
+        if (restart_requested) {
+            vTaskDelay(pdMS_TO_TICKS(COMMANDS_RESTART_DELAY_MS));
+            ESP_LOGW(TAG, "Reinicio pedido por comando remoto");
+            esp_restart();
+        }
+    }
+}
+
+static void on_command_message(const char *payload, int len) {
+    commands_submit(payload, len);
+}
+
+// === API ===
+
+esp_err_t commands_register(const char *name, command_handler_t handler, void *ctx) {
+    if (!name || !handler || strlen(name) >= COMMANDS_NAME_MAX) return ESP_ERR_INVALID_ARG;
+
+    for (int i = 0; i < handler_count; i++) {
+        if (strcmp(handlers[i].name, name) == 0) {
+            handlers[i].handler = handler;
+            handlers[i].ctx = ctx;
+            return ESP_OK;
+        }
+    }
+    if (handler_count == COMMANDS_MAX_HANDLERS) return ESP_ERR_NO_MEM;
+    strlcpy(handlers[handler_count].name, name, sizeof(handlers[0].name));
+    handlers[handler_count].handler = handler;
+    handlers[handler_count].ctx = ctx;
+    handler_count++;
+    return ESP_OK;
+}
+
+esp_err_t commands_submit(const char *payload, int len) {
+    if (!command_queue || !payload) return ESP_ERR_INVALID_STATE;
+    if (len <= 0 || len >= COMMANDS_PAYLOAD_MAX) {
+        ESP_LOGW(TAG, "Comando de %d bytes descartado (máximo %d)", len, COMMANDS_PAYLOAD_MAX - 1);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    command_msg_t msg;
+    msg.len = (uint16_t)len;
+    memcpy(msg.payload, payload, (size_t)len);
+    msg.payload[len] = '\0';
+
+    portENTER_CRITICAL(&pending_lock);
+    pending++;
+    portEXIT_CRITICAL(&pending_lock);
+    if (xQueueSend(command_queue, &msg, 0) != pdTRUE) {
+        portENTER_CRITICAL(&pending_lock);
+        pending--;
+        portEXIT_CRITICAL(&pending_lock);
+        ESP_LOGW(TAG, "Cola de comandos llena, descartando");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool commands_wait_idle(uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    while (pending > 0) {
+        if ((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeout_ms)) {
+            ESP_LOGW(TAG, "Quedan %lu comandos sin terminar", (unsigned long)pending);
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(COMMANDS_POLL_MS));
+    }
+    return true;
+}
+
+void commands_init(void) {
+    // Primer arranque o anillo ilegible (otro tamaño tras actualizar): vacío, después se conserva en RTC
+    if (seen_magic != COMMANDS_SEEN_MAGIC || seen_count > CONFIG_COMMANDS_DEDUP_SLOTS ||
+        seen_next >= CONFIG_COMMANDS_DEDUP_SLOTS) {
+        memset(seen, 0, sizeof(seen));
+        seen_count = 0;
+        seen_next = 0;
+        seen_magic = COMMANDS_SEEN_MAGIC;
+    }
+
+    if (!command_queue) {
+        command_queue = xQueueCreate(CONFIG_COMMANDS_QUEUE_LENGTH, sizeof(command_msg_t));
+        if (!command_queue) {
+            ESP_LOGE(TAG, "Error: No se pudo crear la cola de comandos");
+            return;
+        }
+    }
+    pending = 0;
+    restart_requested = false;
+
+    commands_register("set", cmd_set, NULL);
+    commands_register("get", cmd_get, NULL);
+    commands_register("reset", cmd_reset, NULL);
+    commands_register("dump_events", cmd_dump_events, NULL);
+    commands_register("reboot", cmd_reboot, NULL);
+
+    if (xTaskCreate(command_task, "command_task", COMMANDS_TASK_STACK, NULL, COMMANDS_TASK_PRI, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Error creando tarea de comandos");
+        return;
+    }
+    communication_set_command_handler(on_command_message);
+    ESP_LOGI(TAG, "Comandos remotos activos (%lu ids recordados)", (unsigned long)seen_count);
+}
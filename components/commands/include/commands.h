@@ -0,0 +1,52 @@
+//File: components/commands/include/commands.h
+
+#pragma once                 // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Comandos remotos por MQTT. El servidor publica en <prefijo>/<estación>/cmd (QoS1 y sesión
+// persistente: lo enviado mientras la estación duerme se entrega al reconectar) un JSON plano
+//   {"id":"a1b2","cmd":"set","key":"period_usb_ms","value":"10000"}
+// y la estación responde en <prefijo>/<estación>/ack con
+//   {"id":"a1b2","cmd":"set","status":"ok","detail":"..."}
+// El id hace el comando idempotente: si llega otra vez (reentrega QoS1 o reintento del servidor)
+// no se vuelve a ejecutar y se responde "duplicate" con el resultado de la primera ejecución.
+//
+// Comandos propios: set, get, reset (configuración), dump_events y reboot. Los demás módulos
+// añaden los suyos con commands_register() (tasks: burst; main: tare).
+
+#define COMMANDS_PAYLOAD_MAX    256         // Mensaje más largo que se acepta
+#define COMMANDS_ID_MAX         24          // Id del comando, con el terminador
+#define COMMANDS_NAME_MAX       16
+#define COMMANDS_DETAIL_MAX     96          // Texto de la respuesta
+#define COMMANDS_MAX_HANDLERS   12
+
+// Comando recibido. json apunta al mensaje completo para leer los argumentos con commands_get_arg()
+typedef struct {
+    char id[COMMANDS_ID_MAX];
+    char name[COMMANDS_NAME_MAX];
+    const char *json;
+} command_t;
+
+// Ejecuta el comando en la tarea de comandos (puede bloquear, p. ej. una tara). ESP_OK se responde
+// como "ok" y cualquier otro código como "error"; detail (vacío al entrar) va en la respuesta
+typedef esp_err_t (*command_handler_t)(const command_t *cmd, char *detail, size_t detail_len, void *ctx);
+
+// Crea la cola y la tarea, registra los comandos propios y recibe los mensajes del topic cmd
+void commands_init(void);
+
+// Añade (o sustituye) un comando
+esp_err_t commands_register(const char *name, command_handler_t handler, void *ctx);
+
+// Copia un mensaje recibido y lo encola sin bloquear (se llama desde el manejador MQTT)
+esp_err_t commands_submit(const char *payload, int len);
+
+// Lee un argumento del JSON como texto (cadena o número); false si no está
+bool commands_get_arg(const command_t *cmd, const char *key, char *out, size_t out_len);
+
+// Espera a que no queden comandos en cola ni en ejecución; false si vence el plazo.
+// Antes del deep sleep, para no cortar un comando a medias ni dejar su respuesta sin enviar
+bool commands_wait_idle(uint32_t timeout_ms);
@@ -6,13 +6,28 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_mac.h"
 #include "mqtt_client.h"
 #include "nivometro_sensors.h"
 #include "esp_sntp.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "diagnostics.h"
+#include "config.h"
+#include "snow_metrics.h"
+#include "snow_filter.h"
+#define DLOG_LOCAL_LEVEL CONFIG_DLOG_LEVEL_COMM
+#include "dlog.h"
 #include <sys/time.h>
 #include <time.h>
 #include <string.h>
+#include <stdarg.h>
+#include <math.h>
 #include "freertos/event_groups.h"
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
 
 static const char* TAG = "communication";              // Etiqueta que usará esp_logx para clasificar mensajes de este módulo
 static esp_mqtt_client_handle_t mqtt_client = NULL;    // Puntero al cliente mqtt una vez inicializado
@@ -24,22 +39,63 @@ static EventGroupHandle_t comm_event_group;
 static const int WIFI_CONNECTED_BIT = BIT0;            // Bit que marca wifi listo
 static const int MQTT_CONNECTED_BIT = BIT1;            // Bit que marca mqtt listo
 
-// Topics mqtt donde se publicarán los datos
-static const char* MQTT_TOPIC_ULTRASONIC = "sensors/ultrasonic";
-static const char* MQTT_TOPIC_WEIGHT     = "sensors/weight";
+// Identificador de estación y topic mqtt propio del dispositivo: <prefijo>/<id>/data
+static char station_id[24];
+static char mqtt_topic_data[64];
+static char mqtt_topic_agg[64];
+static char mqtt_topic_status[64];
+static char mqtt_topic_metrics[64];
+static char mqtt_topic_profile[64];
+static char mqtt_topic_events[64];
+static char mqtt_topic_bench[64];
+static char mqtt_topic_cmd[64];                         // Comandos del servidor (suscripción QoS1)
+static char mqtt_topic_ack[64];                         // Respuestas a los comandos
+static char mqtt_client_id[40];                         // Fijo por estación: el broker guarda la sesión con este id
+
+// Receptor de los comandos (commands_init lo registra)
+static communication_command_cb_t command_cb = NULL;
+
+// Mensajes QoS1 en vuelo: instante de publicación por msg_id para medir la latencia hasta el ack
+#define INFLIGHT_SLOTS  16
+typedef struct {
+    int msg_id;
+    int64_t sent_us;
+} inflight_msg_t;
+static inflight_msg_t inflight[INFLIGHT_SLOTS];
+static portMUX_TYPE inflight_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Últimos msg_id confirmados por el broker. El lote de muestras del almacén se comprueba contra ellos
+// (y no al llegar el PUBACK) porque la confirmación puede adelantarse a que se anote el msg_id
+#define ACKED_RING      32
+#define BATCH_POLL_MS   20
+static int acked_ring[ACKED_RING];
+static uint32_t acked_next = 0;
+static int batch_ids[COMMUNICATION_ACK_BATCH];          // Lote del almacén en vuelo, en orden de publicación
+static uint32_t batch_count = 0;
 
 // Prototipos de funciones internas
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
 static void mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data);
 static void init_sntp_and_wait(void);                       // Arranca sntp y espera a sincronizar hora
 static void get_iso8601_utc(char *out, size_t out_size);    // Rellena out con timestamp utc en formato iso8601
+static void format_iso8601_utc(time_t t, char *out, size_t out_size);   // Formatea un instante epoch en iso8601 utc
+static void build_station_topics(void);                     // Calcula el id de estación y los topics por dispositivo
+static int publish_tracked(const char *topic, const char *msg);  // Publica con QoS1 y registra el instante para medir el ack
 
 void communication_init(void) {
+    // Solo se inicializa una vez (en batería puede arrancarse tarde, al llegar un evento)
+    if (comm_event_group != NULL) {
+        return;
+    }
+
     // Crea el grupo de eventos para coordinar wifi y mqtt
     comm_event_group = xEventGroupCreate();
 
     ESP_LOGI(TAG, "Inicializando módulo de comunicación...");
 
+    // 0) Topics por dispositivo a partir del id configurado o de la MAC de fábrica
+    build_station_topics();
+
     // 1) Inicializar capa de red y sistema de eventos
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -69,21 +125,39 @@ void communication_init(void) {
     // 5) Arrancar wifi en modo sta con esa configuración
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_cfg));
+    profiler_begin(PROFILE_WIFI_ASSOC);
     ESP_ERROR_CHECK(esp_wifi_start());
+    // Modem sleep: la radio se apaga entre beacons y la estación sigue asociada (compatible con light sleep)
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
 
     // 6) Bloquear aquí hasta que el handler marque WIFI_CONNECTED_BIT
+    int64_t wifi_start_us = esp_timer_get_time();
     xEventGroupWaitBits(comm_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    metrics_histogram_record(METRIC_WIFI_CONNECT_MS, (uint32_t)((esp_timer_get_time() - wifi_start_us) / 1000));
+    profiler_end(PROFILE_WIFI_ASSOC);
 
     // 7) Una vez con wifi, sincronizar hora con sntp
+    profiler_begin(PROFILE_SNTP);
     init_sntp_and_wait();
+    profiler_end(PROFILE_SNTP);
 
-    // 8) Configurar y arrancar cliente MQTT usando URI de sdkconfig
+    // 8) Configurar y arrancar cliente MQTT usando URI y credenciales de sdkconfig
+    //    Sesión persistente (clean session desactivado): el broker conserva la suscripción a cmd y los
+    //    comandos QoS1 que lleguen mientras la estación duerme, y los entrega al volver a conectar
     esp_mqtt_client_config_t mqtt_cfg = {
-          .broker.address.uri = "mqtt://broker.hivemq.com:1883"
+          .broker.address.uri = CONFIG_MQTT_BROKER_URI,
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+          .broker.verification.crt_bundle_attach = esp_crt_bundle_attach,  // Solo se usa con mqtts://
+#endif
+          .credentials.client_id = mqtt_client_id,
+          .credentials.username = strlen(CONFIG_MQTT_USERNAME) > 0 ? CONFIG_MQTT_USERNAME : NULL,
+          .credentials.authentication.password = strlen(CONFIG_MQTT_PASSWORD) > 0 ? CONFIG_MQTT_PASSWORD : NULL,
+          .session.disable_clean_session = true,
     };
 
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     ESP_ERROR_CHECK(esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL));
+    profiler_begin(PROFILE_MQTT_CONNECT);             // Termina en MQTT_EVENT_CONNECTED
     esp_mqtt_client_start(mqtt_client);
     mqtt_started = true;
 }
@@ -102,6 +176,9 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         // Si se desconecta: limpiar bits y reintentar
         xEventGroupClearBits(comm_event_group, WIFI_CONNECTED_BIT | MQTT_CONNECTED_BIT);
+        metrics_counter_inc(METRIC_WIFI_DISCONNECTS);
+        wifi_event_sta_disconnected_t* disc = (wifi_event_sta_disconnected_t*)event_data;
+        diagnostics_event(DIAG_EVT_WIFI_DISCONNECT, disc ? disc->reason : 0, 0);
         mqtt_started = false;
         mqtt_connected = false;
         esp_wifi_connect();
@@ -116,26 +193,97 @@ static void mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_
     // Lógica para eventos del cliente mqtt
     if (event_id == MQTT_EVENT_CONNECTED) {
         // Se conectó al broker -> marcar mqtt listo
+        esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
         mqtt_connected = true;
+        profiler_end(PROFILE_MQTT_CONNECT);
         xEventGroupSetBits(comm_event_group, MQTT_CONNECTED_BIT);
-        ESP_LOGI(TAG, "MQTT conectado al broker");
+        ESP_LOGI(TAG, "MQTT conectado al broker (sesión %s)", event->session_present ? "recuperada" : "nueva");
+        
+        // Con la sesión recuperada la suscripción sigue en el broker: no se repite el SUBSCRIBE
+        if (command_cb && !event->session_present) {
+            esp_mqtt_client_subscribe(mqtt_client, mqtt_topic_cmd, 1);
+        }
 
     } else if (event_id == MQTT_EVENT_DISCONNECTED) {
         // Desconexión del broker -> limpiar bit y marcar estado
         mqtt_connected = false;
         xEventGroupClearBits(comm_event_group, MQTT_CONNECTED_BIT);
         mqtt_started = false;
+        diagnostics_event(DIAG_EVT_MQTT_DISCONNECT, 0, 0);
         ESP_LOGW(TAG, "MQTT desconectado del broker");
         
     } else if (event_id == MQTT_EVENT_PUBLISHED) {
         esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
-        ESP_LOGD(TAG, "Mensaje MQTT enviado - msg_id: %d", event->msg_id);
+        DLOGD(TAG, "Mensaje MQTT enviado - msg_id: %d", event->msg_id);
+        
+        // Latencia publicación -> ack del broker
+        int64_t sent_us = -1;
+        portENTER_CRITICAL(&inflight_lock);
+        for (int i = 0; i < INFLIGHT_SLOTS; i++) {
+            if (inflight[i].msg_id == event->msg_id) {
+                sent_us = inflight[i].sent_us;
+                inflight[i].msg_id = 0;
+                break;
+            }
+        }
+        acked_ring[acked_next++ % ACKED_RING] = event->msg_id;
+        portEXIT_CRITICAL(&inflight_lock);
+        metrics_counter_inc(METRIC_MQTT_ACKS);
+        if (sent_us >= 0) {
+            metrics_histogram_record(METRIC_PUBLISH_ACK_MS, (uint32_t)((esp_timer_get_time() - sent_us) / 1000));
+        }
+        
+    } else if (event_id == MQTT_EVENT_DATA) {
+        // Comando del servidor. Los comandos caben de sobra en el búfer del cliente: un mensaje
+        // troceado no puede ser un comando válido y se descarta
+        esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+        size_t cmd_len = strlen(mqtt_topic_cmd);
+        bool is_cmd = event->topic_len == (int)cmd_len && strncmp(event->topic, mqtt_topic_cmd, cmd_len) == 0;
+        if (!is_cmd || !command_cb) {
+            // ESP_LOGD y no DLOGD: el topic está en el búfer del cliente, que ya no existe al formatear
+            ESP_LOGD(TAG, "Mensaje en topic no esperado (%.*s)", event->topic_len, event->topic);
+        } else if (event->current_data_offset != 0 || event->data_len != event->total_data_len) {
+            ESP_LOGW(TAG, "Comando troceado (%d bytes) descartado", event->total_data_len);
+        } else {
+            command_cb(event->data, event->data_len);
+        }
         
     } else if (event_id == MQTT_EVENT_ERROR) {
         ESP_LOGE(TAG, "Error en evento MQTT");
     }
 }
 
+static void build_station_topics(void) {
+    if (strlen(CONFIG_NIVOMETRO_STATION_ID) > 0) {
+        // Id fijado en menuconfig
+        strlcpy(station_id, CONFIG_NIVOMETRO_STATION_ID, sizeof(station_id));
+    } else {
+        // Sin id configurado: usar la MAC base grabada en efuse, única por chip
+        uint8_t mac[6] = {0};
+        esp_efuse_mac_get_default(mac);
+        snprintf(station_id, sizeof(station_id), "%02x%02x%02x%02x%02x%02x",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+
+    // Prefijo de la configuración (CONFIG_MQTT_TOPIC_PREFIX por defecto); un cambio se aplica al reiniciar
+    const char *prefix = config_get_str(CFG_MQTT_TOPIC_PREFIX);
+    snprintf(mqtt_topic_data, sizeof(mqtt_topic_data), "%s/%s/data", prefix, station_id);
+    snprintf(mqtt_topic_agg, sizeof(mqtt_topic_agg), "%s/%s/agg", prefix, station_id);
+    snprintf(mqtt_topic_status, sizeof(mqtt_topic_status), "%s/%s/status", prefix, station_id);
+    snprintf(mqtt_topic_metrics, sizeof(mqtt_topic_metrics), "%s/%s/metrics", prefix, station_id);
+    snprintf(mqtt_topic_profile, sizeof(mqtt_topic_profile), "%s/%s/profile", prefix, station_id);
+    snprintf(mqtt_topic_events, sizeof(mqtt_topic_events), "%s/%s/events", prefix, station_id);
+    snprintf(mqtt_topic_bench, sizeof(mqtt_topic_bench), "%s/%s/bench", prefix, station_id);
+    snprintf(mqtt_topic_cmd, sizeof(mqtt_topic_cmd), "%s/%s/cmd", prefix, station_id);
+    snprintf(mqtt_topic_ack, sizeof(mqtt_topic_ack), "%s/%s/ack", prefix, station_id);
+    snprintf(mqtt_client_id, sizeof(mqtt_client_id), "nivometro-%s", station_id);
+    ESP_LOGI(TAG, "Estación %s - topic de datos: %s", station_id, mqtt_topic_data);
+}
+
+const char* communication_get_station_id(void) {
+    return station_id;
+}
+
 static void init_sntp_and_wait(void) {
     // Configura sntp para obtener la hora
     esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
@@ -151,30 +299,299 @@ static void get_iso8601_utc(char *out, size_t out_size) {
     // Obtiene tiempo actual y lo formatea en iso8601 utc
     struct timeval tv;
     gettimeofday(&tv, NULL);
+    format_iso8601_utc(tv.tv_sec, out, out_size);
+}
+
+static void format_iso8601_utc(time_t t, char *out, size_t out_size) {
+    // Formatea un instante epoch en iso8601 utc
     struct tm tm_utc;
-    gmtime_r(&tv.tv_sec, &tm_utc);
+    gmtime_r(&t, &tm_utc);
     strftime(out, out_size, "%Y-%m-%dT%H:%M:%SZ", &tm_utc);
 }
 
+// Añade al mensaje solo si cabe entero, como append() de metrics.c: un campo que no cabe (un float
+// desbocado tras reiniciar el filtro) se omite y len nunca pasa del búfer
+static bool append(char *buf, size_t buf_size, size_t *len, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static bool append(char *buf, size_t buf_size, size_t *len, const char *fmt, ...) {
+    if (*len >= buf_size) return false;
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(buf + *len, buf_size - *len, fmt, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= buf_size - *len) {
+        buf[*len] = '\0';
+        return false;
+    }
+    *len += (size_t)written;
+    return true;
+}
+
+static int publish_tracked(const char *topic, const char *msg) {
+    int64_t sent_us = esp_timer_get_time();
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, msg, 0, 1, 0);
+    if (msg_id < 0) {
+        metrics_counter_inc(METRIC_PUBLISH_FAILED);
+        return msg_id;
+    }
+    metrics_counter_inc(METRIC_PUBLISH_OK);
+
+    // Guardar en un hueco libre (o en el más antiguo si el broker no ha confirmado los anteriores)
+    portENTER_CRITICAL(&inflight_lock);
+    int slot = 0;
+    for (int i = 0; i < INFLIGHT_SLOTS; i++) {
+        if (inflight[i].msg_id == 0) { slot = i; break; }
+        if (inflight[i].sent_us < inflight[slot].sent_us) slot = i;
+    }
+    inflight[slot].msg_id = msg_id;
+    inflight[slot].sent_us = sent_us;
+    portEXIT_CRITICAL(&inflight_lock);
+    return msg_id;
+}
+
 bool communication_is_mqtt_connected(void) {
     return mqtt_connected;
 }
 
-void communication_publish(const sensor_data_t* data) {
+bool communication_is_initialized(void) {
+    return comm_event_group != NULL;
+}
+
+static int publish_sample(const char *topic, const sensor_data_t* data) {
     // Protege contra llamadas inválidas
-    if (!mqtt_client || !data) return;
+    if (!mqtt_client || !data) return -1;
 
-    char ts[32], msg[128];
-    // Timestamp en utc
+    char ts[32], msg[448];
+    // Timestamp en utc: el de la muestra si lo tiene (lotes guardados), si no el actual
+    if (data->epoch_s != 0) {
+        format_iso8601_utc((time_t)data->epoch_s, ts, sizeof(ts));
+    } else {
+        get_iso8601_utc(ts, sizeof(ts));
+    }
+
+    // Un único mensaje por muestra con ambos sensores y lo que se deriva de ellos; la estación va en el topic
+    snow_metrics_params_t geometry;
+    snow_metrics_t m;
+    snow_metrics_load_params(&geometry);
+    snow_metrics_compute(&geometry, data->distance_cm, nivometro_is_sensor_working(data->sensor_status, NIVOMETRO_SENSOR_ULTRASONIC),
+                         data->weight_kg, nivometro_is_sensor_working(data->sensor_status, NIVOMETRO_SENSOR_SCALE), &m);
+
+    // El cierre con el timestamp se reserva al final: los campos que no quepan antes se omiten
+    char tail[64];
+    snprintf(tail, sizeof(tail), ", \"timestamp\": \"%s\"}", ts);
+    size_t room = sizeof(msg) - strlen(tail), len = 0;
+    bool ok = append(msg, room, &len, "{\"distance_cm\": %.2f, \"weight_kg\": %.3f, \"battery_v\": %.2f",
+                     data->distance_cm, data->weight_kg, data->battery_voltage);
+    if (m.depth_valid) {
+        ok &= append(msg, room, &len, ", \"depth_cm\": %.1f", m.depth_cm);
+    }
+    if (m.swe_valid) {
+        ok &= append(msg, room, &len, ", \"swe_mm\": %.2f", m.swe_mm);
+    }
+    if (m.density_valid) {
+        ok &= append(msg, room, &len, ", \"density_kg_m3\": %.1f", m.density_kg_m3);
+    }
+    // Estimación del filtro y estadística de la innovación (kf_flags: bits SNOW_FILTER_*)
+    if (data->filter_flags & SNOW_FILTER_DEPTH_VALID) {
+        ok &= append(msg, room, &len, ", \"depth_kf\": %.1f, \"depth_rate\": %.2f",
+                     data->depth_filt_cm, data->depth_rate_cm_h);
+        if (!isnan(data->depth_nis)) {
+            ok &= append(msg, room, &len, ", \"depth_nis\": %.2f", data->depth_nis);
+        }
+    }
+    if (data->filter_flags & SNOW_FILTER_SWE_VALID) {
+        ok &= append(msg, room, &len, ", \"swe_kf\": %.2f, \"swe_rate\": %.3f",
+                     data->swe_filt_mm, data->swe_rate_mm_h);
+        if (!isnan(data->swe_nis)) {
+            ok &= append(msg, room, &len, ", \"swe_nis\": %.2f", data->swe_nis);
+        }
+    }
+    if (data->filter_flags) {
+        ok &= append(msg, room, &len, ", \"kf_flags\": %u", (unsigned)data->filter_flags);
+    }
+    if (!ok) {
+        ESP_LOGW(TAG, "Muestra con valores desbocados: se omiten los campos que no caben");
+    }
+    append(msg, sizeof(msg), &len, "%s", tail);
+    int msg_id = publish_tracked(topic, msg);
+    DLOGI(TAG, "Muestra publicada: %.2f cm, %.3f kg (msg_id %d)", data->distance_cm, data->weight_kg, msg_id);
+    return msg_id;
+}
+
+bool communication_publish(const sensor_data_t* data) {
+    return publish_sample(mqtt_topic_data, data) >= 0;
+}
+
+bool communication_publish_bench(const sensor_data_t* data) {
+    return publish_sample(mqtt_topic_bench, data) >= 0;
+}
+
+bool communication_publish_pending(const sensor_data_t* data) {
+    if (batch_count >= COMMUNICATION_ACK_BATCH) return false;
+    int msg_id = publish_sample(mqtt_topic_data, data);
+    if (msg_id < 0) return false;
+    batch_ids[batch_count++] = msg_id;
+    return true;
+}
+
+// Muestras seguidas del lote, desde la primera, cuyo PUBACK ya ha llegado
+static uint32_t batch_acked_prefix(void) {
+    uint32_t acked = 0;
+    portENTER_CRITICAL(&inflight_lock);
+    for (; acked < batch_count; acked++) {
+        bool found = false;
+        for (int i = 0; i < ACKED_RING && !found; i++) {
+            found = acked_ring[i] == batch_ids[acked];
+        }
+        if (!found) break;
+    }
+    portEXIT_CRITICAL(&inflight_lock);
+    return acked;
+}
+
+uint32_t communication_wait_batch_acked(uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    uint32_t acked = batch_acked_prefix();
+    while (acked < batch_count && (xTaskGetTickCount() - start) < pdMS_TO_TICKS(timeout_ms)) {
+        vTaskDelay(pdMS_TO_TICKS(BATCH_POLL_MS));
+        acked = batch_acked_prefix();
+    }
+    if (acked < batch_count) {
+        ESP_LOGW(TAG, "Lote del almacén: %lu de %lu muestras sin confirmar", (unsigned long)(batch_count - acked),
+                 (unsigned long)batch_count);
+    }
+    batch_count = 0;
+    return acked;
+}
+
+void communication_publish_aggregate(const aggregate_t* agg) {
+    // Protege contra llamadas inválidas o ventanas vacías
+    if (!mqtt_client || !agg || agg->count == 0) return;
+
+    char ts[32], msg[512];
+    // El timestamp es el inicio de la ventana, así InfluxDB alinea los puntos de toda la flota
+    format_iso8601_utc((time_t)agg->window_start_s, ts, sizeof(ts));
+
+    // Espesor y SWE son lineales en distancia y peso: sus estadísticos salen de los de la ventana
+    // (el mínimo de espesor es la distancia máxima). La densidad es la de las medias. Un canal sin
+    // lecturas válidas en la ventana no tiene estadísticos de los que derivar nada
+    bool distance_ok = agg->distance.count > 0;
+    bool weight_ok = agg->weight.count > 0;
+    snow_metrics_params_t geometry;
+    snow_metrics_t mean, low, high;
+    snow_metrics_load_params(&geometry);
+    snow_metrics_compute(&geometry, agg->distance.mean, distance_ok, agg->weight.mean, weight_ok, &mean);
+    snow_metrics_compute(&geometry, agg->distance.max, distance_ok, agg->weight.min, weight_ok, &low);
+    snow_metrics_compute(&geometry, agg->distance.min, distance_ok, agg->weight.max, weight_ok, &high);
+
+    // Cada canal solo lleva sus estadísticos si tuvo alguna lectura válida en la ventana
+    char tail[64];
+    snprintf(tail, sizeof(tail), ", \"timestamp\": \"%s\"}", ts);
+    size_t room = sizeof(msg) - strlen(tail), len = 0;
+    bool ok = append(msg, room, &len, "{\"window_s\": %lu, \"count\": %lu, \"distance_count\": %lu, \"weight_count\": %lu",
+                     (unsigned long)agg->window_s, (unsigned long)agg->count,
+                     (unsigned long)agg->distance.count, (unsigned long)agg->weight.count);
+    if (agg->distance.count > 0) {
+        ok &= append(msg, room, &len,
+                     ", \"distance_mean\": %.2f, \"distance_std\": %.2f, \"distance_min\": %.2f, \"distance_max\": %.2f",
+                     agg->distance.mean, running_stats_stddev(&agg->distance), agg->distance.min, agg->distance.max);
+    }
+    if (agg->weight.count > 0) {
+        ok &= append(msg, room, &len,
+                     ", \"weight_mean\": %.3f, \"weight_std\": %.3f, \"weight_min\": %.3f, \"weight_max\": %.3f",
+                     agg->weight.mean, running_stats_stddev(&agg->weight), agg->weight.min, agg->weight.max);
+    }
+    if (mean.depth_valid && low.depth_valid && high.depth_valid) {
+        ok &= append(msg, room, &len, ", \"depth_mean\": %.1f, \"depth_min\": %.1f, \"depth_max\": %.1f",
+                     mean.depth_cm, low.depth_cm, high.depth_cm);
+    }
+    if (mean.swe_valid && low.swe_valid && high.swe_valid) {
+        ok &= append(msg, room, &len, ", \"swe_mean\": %.2f, \"swe_min\": %.2f, \"swe_max\": %.2f",
+                     mean.swe_mm, low.swe_mm, high.swe_mm);
+    }
+    if (mean.density_valid) {
+        ok &= append(msg, room, &len, ", \"density_mean\": %.1f", mean.density_kg_m3);
+    }
+    if (!ok) {
+        ESP_LOGW(TAG, "Agregado con valores desbocados: se omiten los campos que no caben");
+    }
+    append(msg, sizeof(msg), &len, "%s", tail);
+    publish_tracked(mqtt_topic_agg, msg);
+    DLOGI(TAG, "Publicado agregado %lus (%lu muestras)", (unsigned long)agg->window_s, (unsigned long)agg->count);
+}
+
+void communication_publish_status(const energy_plan_t* plan, uint32_t pending_samples) {
+    // Protege contra llamadas inválidas
+    if (!mqtt_client || !plan) return;
+
+    char ts[32], msg[320];
     get_iso8601_utc(ts, sizeof(ts));
 
-    // Publicar valor del sensor de ultrasonidos
-    snprintf(msg, sizeof(msg), "{\"value\": %.2f, \"timestamp\": \"%s\"}", data->distance_cm, ts); 
-    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_ULTRASONIC, msg, 0, 1, 0);
-    ESP_LOGI(TAG, "Publicado en %s: %s", MQTT_TOPIC_ULTRASONIC, msg);
+    // Estado de energía: carga, plan elegido y autonomía prevista para planificar visitas
+    snprintf(msg, sizeof(msg),
+             "{\"battery_v\": %.2f, \"soc_percent\": %.1f, \"runtime_h\": %.0f, \"avg_current_ma\": %.3f, "
+             "\"sample_period_s\": %lu, \"upload_every\": %lu, \"hx711_samples\": %d, \"pending\": %lu, "
+             "\"timestamp\": \"%s\"}",
+             plan->battery_voltage, plan->soc_percent, plan->runtime_h, plan->avg_current_ma,
+             (unsigned long)plan->sample_period_s, (unsigned long)plan->upload_every, plan->hx711_samples,
+             (unsigned long)pending_samples, ts);
+    publish_tracked(mqtt_topic_status, msg);
+    ESP_LOGI(TAG, "Publicado estado en %s: %s", mqtt_topic_status, msg);
+}
+
+void communication_publish_metrics(void) {
+    if (!mqtt_client) return;
+
+    char msg[1024];
+    if (metrics_format_json(msg, sizeof(msg)) < 0) return;
+    publish_tracked(mqtt_topic_metrics, msg);
+    ESP_LOGI(TAG, "Publicadas métricas en %s (%u bytes)", mqtt_topic_metrics, (unsigned)strlen(msg));
+}
+
+static void publish_events_chunk(const char *json, void *ctx) {
+    uint32_t *chunks = (uint32_t*)ctx;
+    if (publish_tracked(mqtt_topic_events, json) >= 0) {
+        (*chunks)++;
+    }
+}
+
+void communication_publish_events(void) {
+    if (!mqtt_client) return;
+
+    uint32_t chunks = 0;
+    diagnostics_dump_json(publish_events_chunk, &chunks);
+    ESP_LOGI(TAG, "Volcado de eventos en %s: %lu mensajes", mqtt_topic_events, (unsigned long)chunks);
+}
+
+// Los comandos solo se aceptan por un broker cifrado y autenticado: sin receptor no se suscribe a cmd
+// y lo que llegue por otro topic se ignora
+void communication_set_command_handler(communication_command_cb_t cb) {
+#ifdef CONFIG_MQTT_COMMANDS
+    bool secure = strncmp(CONFIG_MQTT_BROKER_URI, "mqtts://", 8) == 0 && strlen(CONFIG_MQTT_USERNAME) > 0;
+    if (!secure) {
+        ESP_LOGW(TAG, "Comandos remotos desactivados: el broker no usa TLS (mqtts://) o no hay usuario");
+        return;
+    }
+    command_cb = cb;
+#else
+    (void)cb;
+#endif
+}
+
+bool communication_publish_ack(const char *json) {
+    if (!mqtt_client || !json) return false;
+    if (publish_tracked(mqtt_topic_ack, json) < 0) return false;
+    ESP_LOGI(TAG, "Respuesta a comando en %s: %s", mqtt_topic_ack, json);
+    return true;
+}
+
+bool communication_publish_profile(void) {
+    if (!mqtt_client) return false;
 
-    // Publicar valor del sensor de peso
-    snprintf(msg, sizeof(msg), "{\"value\": %.2f, \"timestamp\": \"%s\"}", data->weight_kg, ts);
-    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_WEIGHT, msg, 0, 1, 0);
-    ESP_LOGI(TAG, "Publicado en %s: %s", MQTT_TOPIC_WEIGHT, msg);
+    char msg[512];
+    if (profiler_format_json(msg, sizeof(msg)) < 0) return false;
+    if (publish_tracked(mqtt_topic_profile, msg) < 0) return false;
+    ESP_LOGI(TAG, "Publicado perfil de ciclos en %s: %s", mqtt_topic_profile, msg);
+    return true;
 }
\ No newline at end of file
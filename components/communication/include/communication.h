@@ -4,6 +4,8 @@
 
 #include <esp_err.h>
 #include "nivometro_sensors.h"
+#include "aggregation.h"
+#include "energy_budget.h"
 #include "sdkconfig.h"
 
 // Arranca la interfaz Wi-Fi y el cliente MQTT
@@ -13,8 +15,53 @@ void communication_init(void);
 // Bloquea la ejecución hasta que tanto Wi-Fi como MQTT confirmen conexión exitosa
 void communication_wait_for_connection(void);
 
-// Publica los datos de los sensores en 2 topics diferentes: sensors/ultrasonic y sensors/weight
-void communication_publish(const sensor_data_t* data);
+// Publica los datos de los sensores en un único mensaje sobre el topic del dispositivo: <prefijo>/<id>/data
+// Devuelve false si el cliente mqtt no ha aceptado el mensaje
+bool communication_publish(const sensor_data_t* data);
+
+// Muestras del almacén: se publican por lotes de hasta COMMUNICATION_ACK_BATCH y solo se retiran
+// del almacén cuando el broker las ha confirmado, para no perder las que siguen en vuelo al dormir
+#define COMMUNICATION_ACK_BATCH  8
+
+// Igual que communication_publish, pero la muestra queda en el lote pendiente de confirmación.
+// Devuelve false si el cliente no la acepta o el lote está lleno
+bool communication_publish_pending(const sensor_data_t* data);
+
+// Espera como mucho timeout_ms a que el broker confirme el lote y lo cierra. Devuelve cuántas
+// muestras seguidas, desde la primera del lote, están confirmadas (las que se pueden retirar)
+uint32_t communication_wait_batch_acked(uint32_t timeout_ms);
+
+// Igual que communication_publish pero en <prefijo>/<id>/bench, que no se ingiere (benchmark del pipeline)
+bool communication_publish_bench(const sensor_data_t* data);
+
+// Publica el resumen de una ventana cerrada (n, media, desviación, mín, máx) en <prefijo>/<id>/agg
+void communication_publish_aggregate(const aggregate_t* agg);
+
+// Publica el estado de energía (carga, plan y autonomía prevista) en <prefijo>/<id>/status
+void communication_publish_status(const energy_plan_t* plan, uint32_t pending_samples);
+
+// Publica una instantánea del registro de métricas en <prefijo>/<id>/metrics
+void communication_publish_metrics(void);
+
+// Publica el resumen del perfilador de fases en <prefijo>/<id>/profile; false si no se pudo enviar
+bool communication_publish_profile(void);
+
+// Vuelca el registro de eventos de diagnóstico (flash + anillo) en <prefijo>/<id>/events
+void communication_publish_events(void);
+
+// Receptor de los mensajes de <prefijo>/<id>/cmd. Se llama desde la tarea del cliente MQTT:
+// debe copiar el mensaje y volver enseguida (ver commands_submit)
+typedef void (*communication_command_cb_t)(const char *payload, int len);
+void communication_set_command_handler(communication_command_cb_t cb);
+
+// Publica la respuesta a un comando en <prefijo>/<id>/ack; false si el cliente no la acepta
+bool communication_publish_ack(const char *json);
+
+// Indica si communication_init() ya se ha ejecutado (en batería solo se conecta en los ciclos de subida)
+bool communication_is_initialized(void);
+
+// Devuelve el identificador de estación (menuconfig o MAC de efuse) usado en los topics
+const char* communication_get_station_id(void);
 
 // Verifica si MQTT está conectado
 bool communication_is_mqtt_connected(void);
@@ -3,9 +3,139 @@
 #include "config.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
+#include <string.h>
 
 static const char* TAG = "config";                     // Etiqueta que usará esp_logx para clasificar mensajes de este módulo
 
+#define CONFIG_NVS_NAMESPACE "config"                  // Namespace NVS de los parámetros
+
+#ifdef CONFIG_AGGREGATION_PUBLISH_RAW
+#define CFG_DEFAULT_PUBLISH_RAW 1
+#else
+#define CFG_DEFAULT_PUBLISH_RAW 0
+#endif
+
+// Esquema: una entrada por clave, en el mismo orden que config_key_t
+static const config_desc_t schema[CFG_COUNT] = {
+    [CFG_SENSOR_PERIOD_USB_MS]     = { "period_usb_ms", CFG_TYPE_U32, 5000, NULL, 1000, 3600000, 0 },
+    [CFG_SENSOR_PERIOD_BATTERY_MS] = { "period_bat_ms", CFG_TYPE_U32, 60000, NULL, 5000, 86400000, 0 },
+    [CFG_SENSOR_PERIOD_DEFAULT_MS] = { "period_def_ms", CFG_TYPE_U32, 30000, NULL, 1000, 86400000, 0 },
+    [CFG_EVENT_BURST_PERIOD_MS]    = { "burst_ms", CFG_TYPE_U32, CONFIG_EVENT_BURST_PERIOD_MS, NULL, 1000, 600000, 0 },
+    [CFG_EVENT_CALM_PERIOD_MS]     = { "calm_ms", CFG_TYPE_U32, CONFIG_EVENT_CALM_PERIOD_MS, NULL, 60000, 86400000, 0 },
+    [CFG_PUBLISH_RAW]              = { "publish_raw", CFG_TYPE_BOOL, CFG_DEFAULT_PUBLISH_RAW, NULL, 0, 1, 0 },
+    [CFG_DATA_QUEUE_LENGTH]        = { "queue_len", CFG_TYPE_U32, 10, NULL, 2, 64, CFG_FLAG_REBOOT },
+    [CFG_HCSR04P_TRIGGER_PIN]      = { "pin_trigger", CFG_TYPE_U32, 12, NULL, 0, 39, CFG_FLAG_REBOOT | CFG_FLAG_PIN_OUT | CFG_FLAG_LOCAL },
+    [CFG_HCSR04P_ECHO_PIN]         = { "pin_echo", CFG_TYPE_U32, 13, NULL, 0, 39, CFG_FLAG_REBOOT | CFG_FLAG_PIN_IN | CFG_FLAG_LOCAL },
+    [CFG_HX711_DOUT_PIN]           = { "pin_hx_dout", CFG_TYPE_U32, 26, NULL, 0, 39, CFG_FLAG_REBOOT | CFG_FLAG_PIN_IN | CFG_FLAG_LOCAL },
+    [CFG_HX711_SCK_PIN]            = { "pin_hx_sck", CFG_TYPE_U32, 27, NULL, 0, 39, CFG_FLAG_REBOOT | CFG_FLAG_PIN_OUT | CFG_FLAG_LOCAL },
+    [CFG_MQTT_TOPIC_PREFIX]        = { "topic_prefix", CFG_TYPE_STR, 0, CONFIG_MQTT_TOPIC_PREFIX, 1, CFG_STR_MAX - 1,
+                                       CFG_FLAG_REBOOT | CFG_FLAG_TOPIC | CFG_FLAG_LOCAL },
+    [CFG_MOUNT_HEIGHT_MM]          = { "mount_h_mm", CFG_TYPE_U32, CONFIG_SNOW_MOUNT_HEIGHT_MM, NULL, 100, 10000, 0 },
+    [CFG_PILLOW_AREA_CM2]          = { "pillow_cm2", CFG_TYPE_U32, CONFIG_SNOW_PILLOW_AREA_CM2, NULL, 100, 100000, 0 },
+};
+
+typedef union {
+    uint32_t u32;
+    char str[CFG_STR_MAX];
+} config_value_t;
+
+typedef struct {
+    config_key_t key;
+    config_change_cb_t cb;
+    void *ctx;
+} config_listener_t;
+
+// Caché en RAM: hasta config_init() se sirven los valores por defecto del esquema
+static config_value_t cache[CFG_COUNT];
+static bool cache_loaded = false;
+static config_listener_t listeners[CFG_MAX_LISTENERS];
+static int listener_count = 0;
+static portMUX_TYPE config_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool key_valid(config_key_t key) {
+    return key >= 0 && key < CFG_COUNT;
+}
+
+static void load_default(config_key_t key, config_value_t *v) {
+    const config_desc_t *d = &schema[key];
+    if (d->type == CFG_TYPE_STR) {
+        strlcpy(v->str, d->def_str, sizeof(v->str));
+    } else {
+        v->u32 = d->def_u32;
+    }
+}
+
+// Pines que los sensores no pueden usar: 0 (botón BOOT), 1 y 3 (UART0 de la consola), 4 (detección de
+// USB), 6-11 (flash SPI) y 16 (LED de estado)
+#define CFG_RESERVED_PINS   ((1ULL << 0) | (1ULL << 1) | (1ULL << 3) | (1ULL << 4) | (0x3FULL << 6) | (1ULL << 16))
+
+static bool pin_usable(uint32_t pin, bool output) {
+    if (pin >= 64 || (CFG_RESERVED_PINS & (1ULL << pin))) return false;
+    gpio_num_t gpio = (gpio_num_t)pin;
+    return output ? GPIO_IS_VALID_OUTPUT_GPIO(gpio) : GPIO_IS_VALID_GPIO(gpio);
+}
+
+// Un comodín (# +) o un separador (/) en el prefijo invalidaría la suscripción a cmd
+static bool topic_level_valid(const char *s) {
+    for (; *s; s++) {
+        char c = *s;
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '-' || c == '_' || c == '.';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static bool value_in_range(const config_desc_t *d, const config_value_t *v) {
+    if (d->type == CFG_TYPE_STR) {
+        size_t len = strnlen(v->str, sizeof(v->str));
+        if (len < d->min || len > d->max) return false;
+        return !(d->flags & CFG_FLAG_TOPIC) || topic_level_valid(v->str);
+    }
+    if (v->u32 < d->min || v->u32 > d->max) return false;
+    if (d->flags & CFG_FLAG_PIN_OUT) return pin_usable(v->u32, true);
+    if (d->flags & CFG_FLAG_PIN_IN) return pin_usable(v->u32, false);
+    return true;
+}
+
+// Lee cada clave de NVS; las ausentes o fuera de rango (esquema cambiado) se quedan con el valor por defecto
+static void load_cache(void) {
+    nvs_handle_t handle;
+    bool nvs_ok = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK;
+    int stored = 0;
+
+    for (int k = 0; k < CFG_COUNT; k++) {
+        const config_desc_t *d = &schema[k];
+        config_value_t v;
+        load_default((config_key_t)k, &v);
+        if (nvs_ok) {
+            config_value_t saved = v;
+            esp_err_t err;
+            if (d->type == CFG_TYPE_STR) {
+                size_t len = sizeof(saved.str);
+                err = nvs_get_str(handle, d->name, saved.str, &len);
+            } else {
+                err = nvs_get_u32(handle, d->name, &saved.u32);
+            }
+            if (err == ESP_OK && value_in_range(d, &saved)) {
+                v = saved;
+                stored++;
+            } else if (err == ESP_OK) {
+                ESP_LOGW(TAG, "Valor guardado de %s fuera de rango, se usa el de por defecto", d->name);
+            }
+        }
+        cache[k] = v;
+    }
+    if (nvs_ok) nvs_close(handle);
+    cache_loaded = true;
+    ESP_LOGI(TAG, "Configuración cargada: %d de %d parámetros guardados en NVS", stored, CFG_COUNT);
+}
+
 void config_init(void) {
     // Inicializa la nvs (memoria no volátil) para que el resto del sistema pueda leer/escribir parámetros sin fallos.
     esp_err_t err = nvs_flash_init();
@@ -18,7 +148,159 @@ void config_init(void) {
         nvs_flash_init();
     }
     
-    ESP_LOGI(TAG, "llamada a config_init(): no hay valores CONFIG_* disponibles");
+    load_cache();
 }
 
+uint32_t config_get_u32(config_key_t key) {
+    if (!key_valid(key)) return 0;
+    return cache_loaded ? cache[key].u32 : schema[key].def_u32;
+}
+
+bool config_get_bool(config_key_t key) {
+    return config_get_u32(key) != 0;
+}
+
+const char *config_get_str(config_key_t key) {
+    if (!key_valid(key) || schema[key].type != CFG_TYPE_STR) return "";
+    return cache_loaded ? cache[key].str : schema[key].def_str;
+}
+
+static void notify_listeners(config_key_t key) {
+    for (int i = 0; i < listener_count; i++) {
+        if (listeners[i].key == key || listeners[i].key == CFG_KEY_ANY) {
+            listeners[i].cb(key, listeners[i].ctx);
+        }
+    }
+}
 
+// Valida, guarda en NVS, actualiza la caché y avisa a los suscriptores si el valor cambia
+static esp_err_t config_store(config_key_t key, const config_value_t *v) {
+    if (!key_valid(key)) return ESP_ERR_INVALID_ARG;
+    const config_desc_t *d = &schema[key];
+    if (!value_in_range(d, v)) {
+        ESP_LOGW(TAG, "Valor fuera de rango para %s", d->name);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!cache_loaded) load_cache();
+
+    bool changed = (d->type == CFG_TYPE_STR) ? strcmp(cache[key].str, v->str) != 0
+                                             : cache[key].u32 != v->u32;
+    if (!changed) return ESP_OK;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "No se pudo abrir NVS para %s: %s", d->name, esp_err_to_name(err));
+        return err;
+    }
+    err = (d->type == CFG_TYPE_STR) ? nvs_set_str(handle, d->name, v->str)
+                                    : nvs_set_u32(handle, d->name, v->u32);
+    if (err == ESP_OK) err = nvs_commit(handle);
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error guardando %s: %s", d->name, esp_err_to_name(err));
+        return err;
+    }
+
+    taskENTER_CRITICAL(&config_mux);
+    cache[key] = *v;
+    taskEXIT_CRITICAL(&config_mux);
+
+    if (d->type == CFG_TYPE_STR) {
+        ESP_LOGI(TAG, "%s = \"%s\"%s", d->name, v->str, (d->flags & CFG_FLAG_REBOOT) ? " (tras reiniciar)" : "");
+    } else {
+        ESP_LOGI(TAG, "%s = %lu%s", d->name, (unsigned long)v->u32, (d->flags & CFG_FLAG_REBOOT) ? " (tras reiniciar)" : "");
+    }
+    notify_listeners(key);
+    return ESP_OK;
+}
+
+esp_err_t config_set_u32(config_key_t key, uint32_t value) {
+    if (!key_valid(key) || schema[key].type != CFG_TYPE_U32) return ESP_ERR_INVALID_ARG;
+    config_value_t v = { .u32 = value };
+    return config_store(key, &v);
+}
+
+esp_err_t config_set_bool(config_key_t key, bool value) {
+    if (!key_valid(key) || schema[key].type != CFG_TYPE_BOOL) return ESP_ERR_INVALID_ARG;
+    config_value_t v = { .u32 = value ? 1 : 0 };
+    return config_store(key, &v);
+}
+
+esp_err_t config_set_str(config_key_t key, const char *value) {
+    if (!key_valid(key) || schema[key].type != CFG_TYPE_STR || !value) return ESP_ERR_INVALID_ARG;
+    if (strlen(value) >= CFG_STR_MAX) return ESP_ERR_INVALID_SIZE;
+    config_value_t v;
+    strlcpy(v.str, value, sizeof(v.str));
+    return config_store(key, &v);
+}
+
+esp_err_t config_set_from_text(config_key_t key, const char *text) {
+    if (!key_valid(key) || !text) return ESP_ERR_INVALID_ARG;
+    switch (schema[key].type) {
+    case CFG_TYPE_STR:
+        return config_set_str(key, text);
+    case CFG_TYPE_BOOL:
+        if (strcmp(text, "true") == 0 || strcmp(text, "1") == 0) return config_set_bool(key, true);
+        if (strcmp(text, "false") == 0 || strcmp(text, "0") == 0) return config_set_bool(key, false);
+        return ESP_ERR_INVALID_ARG;
+    case CFG_TYPE_U32: {
+        char *end;
+        unsigned long value = strtoul(text, &end, 10);
+        if (end == text || *end != '\0' || text[0] == '-') return ESP_ERR_INVALID_ARG;
+        return config_set_u32(key, (uint32_t)value);
+    }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t config_reset(config_key_t key) {
+    if (key == CFG_KEY_ANY) {
+        esp_err_t result = ESP_OK;
+        for (int k = 0; k < CFG_COUNT; k++) {
+            esp_err_t err = config_reset((config_key_t)k);
+            if (err != ESP_OK) result = err;
+        }
+        return result;
+    }
+    if (!key_valid(key)) return ESP_ERR_INVALID_ARG;
+    if (!cache_loaded) load_cache();
+
+    // Se borra la clave en lugar de guardar el valor por defecto, para seguir los cambios de firmware
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) return err;
+    err = nvs_erase_key(handle, schema[key].name);
+    if (err == ESP_OK) err = nvs_commit(handle);
+    nvs_close(handle);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) return err;
+
+    config_value_t v;
+    load_default(key, &v);
+    bool changed = (schema[key].type == CFG_TYPE_STR) ? strcmp(cache[key].str, v.str) != 0
+                                                      : cache[key].u32 != v.u32;
+    taskENTER_CRITICAL(&config_mux);
+    cache[key] = v;
+    taskEXIT_CRITICAL(&config_mux);
+    if (changed) notify_listeners(key);
+    return ESP_OK;
+}
+
+config_key_t config_find(const char *name) {
+    if (!name) return CFG_KEY_INVALID;
+    for (int k = 0; k < CFG_COUNT; k++) {
+        if (strcmp(schema[k].name, name) == 0) return (config_key_t)k;
+    }
+    return CFG_KEY_INVALID;
+}
+
+const config_desc_t *config_describe(config_key_t key) {
+    return key_valid(key) ? &schema[key] : NULL;
+}
+
+esp_err_t config_subscribe(config_key_t key, config_change_cb_t cb, void *ctx) {
+    if (!cb || (!key_valid(key) && key != CFG_KEY_ANY)) return ESP_ERR_INVALID_ARG;
+    if (listener_count >= CFG_MAX_LISTENERS) return ESP_ERR_NO_MEM;
+    listeners[listener_count++] = (config_listener_t){ key, cb, ctx };
+    return ESP_OK;
+}
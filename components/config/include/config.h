@@ -2,4 +2,73 @@
 
 #pragma once                 // Le indica al compilador que procese este fichero solo una vez por compilacion
 
-void config_init(void);
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Parámetros ajustables en tiempo de ejecución. Cada clave tiene tipo, valor por defecto (de menuconfig
+// o del código), rango y nombre corto, que es a la vez la clave en NVS y el nombre en los comandos remotos.
+// Los valores viven en una caché en RAM indexada por la clave: leerlos es un acceso a un array.
+typedef enum {
+    CFG_SENSOR_PERIOD_USB_MS = 0,   // Intervalo de muestreo con USB
+    CFG_SENSOR_PERIOD_BATTERY_MS,   // Intervalo en batería sin medida de tensión
+    CFG_SENSOR_PERIOD_DEFAULT_MS,   // Intervalo con fuente desconocida
+    CFG_EVENT_BURST_PERIOD_MS,      // Intervalo durante un evento de nieve
+    CFG_EVENT_CALM_PERIOD_MS,       // Intervalo en batería con la señal plana
+    CFG_PUBLISH_RAW,                // Publicar cada muestra en crudo además de los agregados
+    CFG_DATA_QUEUE_LENGTH,          // Muestras en vuelo entre la tarea de sensores y la de publicación
+    CFG_HCSR04P_TRIGGER_PIN,
+    CFG_HCSR04P_ECHO_PIN,
+    CFG_HX711_DOUT_PIN,
+    CFG_HX711_SCK_PIN,
+    CFG_MQTT_TOPIC_PREFIX,          // Prefijo de los topics <prefijo>/<estación>/...
+    CFG_MOUNT_HEIGHT_MM,            // Altura del ultrasonido sobre la placa vacía (espesor de nieve)
+    CFG_PILLOW_AREA_CM2,            // Área de la placa de carga (equivalente en agua)
+    CFG_COUNT,
+    CFG_KEY_ANY = CFG_COUNT,        // Para suscribirse a cualquier cambio
+    CFG_KEY_INVALID = -1,
+} config_key_t;
+
+typedef enum {
+    CFG_TYPE_U32,
+    CFG_TYPE_BOOL,
+    CFG_TYPE_STR,
+} config_type_t;
+
+#define CFG_FLAG_REBOOT     (1u << 0)   // Se guarda al momento pero se aplica en el siguiente arranque
+#define CFG_FLAG_PIN_IN     (1u << 1)   // GPIO de entrada válido y libre (ver config.c)
+#define CFG_FLAG_PIN_OUT    (1u << 2)   // GPIO de salida válido y libre
+#define CFG_FLAG_TOPIC      (1u << 3)   // Nivel de topic MQTT: sin comodines ni separadores
+#define CFG_FLAG_LOCAL      (1u << 4)   // Crítica para arrancar: los comandos remotos la leen o la restablecen, no la cambian
+#define CFG_STR_MAX         32          // Longitud máxima de los valores de texto (con el terminador)
+#define CFG_MAX_LISTENERS   8
+
+typedef struct {
+    const char *name;               // Clave NVS y nombre remoto (máximo 15 caracteres)
+    config_type_t type;
+    uint32_t def_u32;               // Por defecto de U32 y BOOL
+    const char *def_str;            // Por defecto de STR
+    uint32_t min;                   // Rango de U32 (en STR, longitud mínima)
+    uint32_t max;
+    uint32_t flags;
+} config_desc_t;
+
+// Se llama después de guardar el valor, fuera de la sección crítica y desde la tarea que lo cambió
+typedef void (*config_change_cb_t)(config_key_t key, void *ctx);
+
+void config_init(void);             // Inicializa NVS y carga la caché (valores guardados o por defecto)
+
+uint32_t config_get_u32(config_key_t key);
+bool config_get_bool(config_key_t key);
+const char *config_get_str(config_key_t key);
+
+esp_err_t config_set_u32(config_key_t key, uint32_t value);
+esp_err_t config_set_bool(config_key_t key, bool value);
+esp_err_t config_set_str(config_key_t key, const char *value);
+esp_err_t config_set_from_text(config_key_t key, const char *text);   // Convierte según el tipo de la clave
+esp_err_t config_reset(config_key_t key);                           // Vuelve al valor por defecto (CFG_KEY_ANY: todas)
+
+config_key_t config_find(const char *name);
+const config_desc_t *config_describe(config_key_t key);
+esp_err_t config_subscribe(config_key_t key, config_change_cb_t cb, void *ctx);
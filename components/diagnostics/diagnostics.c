@@ -4,11 +4,42 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <inttypes.h>
 
 static const char *TAG = "diagnostics";                             // Etiqueta de logs para este módulo
 static nvs_handle_t diag_nvs_handle;                                // Handle nvs para diagnósticos
 
+#define DIAG_RING_MAGIC     0x44494147                              // Marca de anillo válido en memoria RTC
+#define DIAG_FLASH_BATCH    16                                      // Eventos por bloque en flash (un blob por volcado)
+
+// Anillo de eventos en memoria RTC: sobrevive al deep sleep sin escribir en flash
+typedef struct {
+    uint32_t magic;
+    uint32_t head;                  // Total de eventos escritos (la posición es head % tamaño)
+    uint32_t flushed;               // Total de eventos ya volcados a flash
+    uint16_t seq;
+    diag_event_t events[CONFIG_DIAG_RING_SIZE];
+} diag_ring_t;
+
+RTC_DATA_ATTR static diag_ring_t ring;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Hash corto (djb2) para identificar textos sin guardarlos
+static int32_t diag_hash(const char *s)
+{
+    uint32_t h = 5381;
+    while (s && *s) {
+        h = ((h << 5) + h) + (uint8_t)*s++;
+    }
+    return (int32_t)h;
+}
+
 void diagnostics_init(void)
 {
     // Inicializa la partición nvs y abre el namespace diag
@@ -23,44 +54,171 @@ void diagnostics_init(void)
         return;
     }
 
+    if (ring.magic != DIAG_RING_MAGIC) {
+        // Arranque en frío: el anillo RTC no tiene datos válidos
+        memset(&ring, 0, sizeof(ring));
+        ring.magic = DIAG_RING_MAGIC;
+    }
+
      // Abre (o crea) el namespace diag en nvs para guardar errores/eventos
     err = nvs_open("diag", NVS_READWRITE, &diag_nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "nvs_open diag falló: %s", esp_err_to_name(err));
     } else {
-        ESP_LOGI(TAG, "Diagnostics inicializados");
+        // Formato anterior (una clave evt_<n> por evento): borrar una vez, crecía sin límite
+        uint32_t legacy_cnt = 0;
+        if (nvs_get_u32(diag_nvs_handle, "evt_cnt", &legacy_cnt) == ESP_OK) {
+            nvs_erase_all(diag_nvs_handle);
+            nvs_commit(diag_nvs_handle);
+            ESP_LOGI(TAG, "Eliminadas %" PRIu32 " claves de eventos del formato anterior", legacy_cnt);
+        }
+        ESP_LOGI(TAG, "Diagnostics inicializados (%" PRIu32 " eventos pendientes de volcar)", diagnostics_pending_flush());
+    }
+}
+
+void diagnostics_event(diag_code_t code, int32_t arg0, int32_t arg1)
+{
+    // Camino caliente: solo RAM, sin formateo ni flash
+    uint32_t now = (uint32_t)time(NULL);
+
+    portENTER_CRITICAL(&ring_lock);
+    diag_event_t *evt = &ring.events[ring.head % CONFIG_DIAG_RING_SIZE];
+    evt->timestamp = now;
+    evt->code = (uint16_t)code;
+    evt->seq = ring.seq++;
+    evt->arg0 = arg0;
+    evt->arg1 = arg1;
+    ring.head++;
+    if (ring.head - ring.flushed > CONFIG_DIAG_RING_SIZE) {
+        ring.flushed = ring.head - CONFIG_DIAG_RING_SIZE;       // Se sobrescribieron eventos sin volcar
     }
+    portEXIT_CRITICAL(&ring_lock);
 }
 
 void diagnostics_log_error(const char *subsystem, esp_err_t err, const char *msg)
 {
-    // Registra el error en consola y, si nvs está abierto, aumenta el contador y guarda el mensaje
+    // Registra el error en consola y en el anillo (el volcado a flash se hace por lotes)
     ESP_LOGE(subsystem, "Error %s: %s", msg, esp_err_to_name(err));
-    if (diag_nvs_handle) {
-        uint32_t cnt = 0;
-        nvs_get_u32(diag_nvs_handle, "err_cnt", &cnt);
-        cnt++;
-        nvs_set_u32(diag_nvs_handle, "err_cnt", cnt);
-        nvs_set_str(diag_nvs_handle, "last_err", msg);
-        nvs_commit(diag_nvs_handle);
-    }
+    diagnostics_event(DIAG_EVT_ERROR, err, diag_hash(msg));
 }
 
 void diagnostics_record_event(const char *event_name, const char *details)
 {
-    // Registra el evento en consola y, si nvs está abierto, lo guarda incrementando el límite
+    // Registra el evento en consola y en el anillo identificando los textos por su hash
     ESP_LOGI(TAG, "Evento %s: %s", event_name, details ? details : "");
+    diagnostics_event(DIAG_EVT_GENERIC, diag_hash(event_name), diag_hash(details));
+}
 
-    if (diag_nvs_handle) {
-        uint32_t idx = 0;
-        nvs_get_u32(diag_nvs_handle, "evt_cnt", &idx);
+uint32_t diagnostics_pending_flush(void)
+{
+    portENTER_CRITICAL(&ring_lock);
+    uint32_t pending = ring.head - ring.flushed;
+    portEXIT_CRITICAL(&ring_lock);
+    return pending;
+}
+
+esp_err_t diagnostics_flush(void)
+{
+    // Vuelca los pendientes en bloques de DIAG_FLASH_BATCH sobre un área circular de
+    // CONFIG_DIAG_FLASH_BLOCKS blobs ("blk_<n>"), con un único commit al final
+    if (!diag_nvs_handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t next_block = 0;
+    nvs_get_u32(diag_nvs_handle, "blk_next", &next_block);
+
+    esp_err_t err = ESP_OK;
+    diag_event_t batch[DIAG_FLASH_BATCH];
+    uint32_t written = 0;
+
+    while (diagnostics_pending_flush() > 0) {
+        // Copiar un lote bajo el spinlock; la escritura en flash va fuera
+        portENTER_CRITICAL(&ring_lock);
+        uint32_t start = ring.flushed;
+        uint32_t n = ring.head - start;
+        if (n > DIAG_FLASH_BATCH) n = DIAG_FLASH_BATCH;
+        for (uint32_t i = 0; i < n; i++) {
+            batch[i] = ring.events[(start + i) % CONFIG_DIAG_RING_SIZE];
+        }
+        portEXIT_CRITICAL(&ring_lock);
 
         char key[16];
-        snprintf(key, sizeof(key), "evt_%" PRIu32, idx);
+        snprintf(key, sizeof(key), "blk_%" PRIu32, next_block % CONFIG_DIAG_FLASH_BLOCKS);
+        err = nvs_set_blob(diag_nvs_handle, key, batch, n * sizeof(diag_event_t));
+        if (err != ESP_OK) {
+            break;
+        }
+
+        portENTER_CRITICAL(&ring_lock);
+        if (ring.flushed == start) {
+            ring.flushed = start + n;
+        }
+        portEXIT_CRITICAL(&ring_lock);
+        next_block++;
+        written += n;
+    }
+
+    if (written > 0) {
+        nvs_set_u32(diag_nvs_handle, "blk_next", next_block);
+        esp_err_t commit_err = nvs_commit(diag_nvs_handle);
+        if (err == ESP_OK) err = commit_err;
+        ESP_LOGD(TAG, "Volcados %" PRIu32 " eventos a flash", written);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error volcando eventos: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+// Formatea eventos como [[ts,code,seq,a0,a1],...] dentro de un objeto con su origen
+static void dump_events(const char *source, int32_t block, const diag_event_t *events, size_t n,
+                        diag_dump_cb_t cb, void *ctx)
+{
+    char json[768];
+    size_t i = 0;
+    while (i < n) {
+        int len = snprintf(json, sizeof(json), "{\"src\":\"%s\",\"blk\":%" PRId32 ",\"ev\":[", source, block);
+        bool first = true;
+        // Cada mensaje se llena hasta dejar sitio para el cierre
+        while (i < n && len < (int)sizeof(json) - 64) {
+            len += snprintf(json + len, sizeof(json) - len, "%s[%" PRIu32 ",%u,%u,%" PRId32 ",%" PRId32 "]",
+                            first ? "" : ",", events[i].timestamp, events[i].code, events[i].seq,
+                            events[i].arg0, events[i].arg1);
+            first = false;
+            i++;
+        }
+        snprintf(json + len, sizeof(json) - len, "]}");
+        cb(json, ctx);
+    }
+}
+
+void diagnostics_dump_json(diag_dump_cb_t cb, void *ctx)
+{
+    if (!cb) {
+        return;
+    }
+
+    // 1) Área circular en flash
+    if (diag_nvs_handle) {
+        diag_event_t batch[DIAG_FLASH_BATCH];
+        for (uint32_t b = 0; b < CONFIG_DIAG_FLASH_BLOCKS; b++) {
+            char key[16];
+            size_t size = sizeof(batch);
+            snprintf(key, sizeof(key), "blk_%" PRIu32, b);
+            if (nvs_get_blob(diag_nvs_handle, key, batch, &size) == ESP_OK) {
+                dump_events("flash", (int32_t)b, batch, size / sizeof(diag_event_t), cb, ctx);
+            }
+        }
+    }
 
-        nvs_set_str(diag_nvs_handle, key, event_name);
-        idx++;
-        nvs_set_u32(diag_nvs_handle, "evt_cnt", idx);
-        nvs_commit(diag_nvs_handle);
+    // 2) Eventos del anillo aún no volcados (copia para no retener el spinlock al formatear)
+    static diag_event_t pending[CONFIG_DIAG_RING_SIZE];
+    portENTER_CRITICAL(&ring_lock);
+    uint32_t n = ring.head - ring.flushed;
+    for (uint32_t i = 0; i < n; i++) {
+        pending[i] = ring.events[(ring.flushed + i) % CONFIG_DIAG_RING_SIZE];
     }
+    portEXIT_CRITICAL(&ring_lock);
+    dump_events("ram", -1, pending, n, cb, ctx);
 }
@@ -0,0 +1,244 @@
+// File: components/diagnostics/dlog.c
+
+#define DLOG_LOCAL_LEVEL DLOG_LEVEL_DEBUG          // El benchmark no depende del nivel configurado
+
+#include "dlog.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+static const char *TAG = "dlog";
+
+#define DLOG_TASK_STACK     3072
+#define DLOG_LINE_MAX       160
+
+// Entrada del anillo, sin formatear: 32 bytes en el ESP32 (64 en un host de 64 bits, con punteros
+// y argumentos de 8 bytes)
+typedef struct {
+    uint32_t ts_ms;             // Milisegundos desde el arranque
+    const char *tag;            // Tag del módulo (cadena constante)
+    const char *fmt;            // Formato = ID del mensaje (cadena constante en flash)
+    uint8_t level;
+    uint8_t nargs;
+    uint16_t reserved;
+    dlog_arg_t args[DLOG_MAX_ARGS];
+} dlog_entry_t;
+
+static dlog_entry_t ring[CONFIG_DLOG_RING_ENTRIES];
+static uint32_t ring_head = 0;                          // Índice absoluto de la entrada más antigua
+static uint32_t ring_tail = 0;                          // Índice absoluto de la próxima entrada
+static uint32_t dropped = 0;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t formatter_task = NULL;
+
+void dlog_write(uint8_t level, const char *tag, const char *fmt, uint8_t nargs, const dlog_arg_t *args)
+{
+    // Camino caliente: copiar una entrada (32 bytes) bajo el spinlock, sin tocar el formato
+    uint32_t ts_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool stored = false;
+
+    taskENTER_CRITICAL(&ring_lock);
+    if (ring_tail - ring_head < CONFIG_DLOG_RING_ENTRIES) {
+        dlog_entry_t *e = &ring[ring_tail % CONFIG_DLOG_RING_ENTRIES];
+        e->ts_ms = ts_ms;
+        e->tag = tag;
+        e->fmt = fmt;
+        e->level = level;
+        e->nargs = nargs;
+        for (int i = 0; i < DLOG_MAX_ARGS; i++) e->args[i] = (i < nargs) ? args[i] : 0;
+        ring_tail++;
+        stored = true;
+    } else {
+        dropped++;                                      // Anillo lleno: se pierde el mensaje nuevo
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+
+    if (stored && formatter_task) {
+        xTaskNotifyGive(formatter_task);
+    }
+}
+
+uint32_t dlog_dropped(void)
+{
+    return dropped;
+}
+
+static bool pop_entry(dlog_entry_t *out)
+{
+    bool found = false;
+    taskENTER_CRITICAL(&ring_lock);
+    if (ring_head != ring_tail) {
+        *out = ring[ring_head % CONFIG_DLOG_RING_ENTRIES];
+        ring_head++;
+        found = true;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    return found;
+}
+
+#if CONFIG_DLOG_OUTPUT_TEXT
+
+// Rehace el printf conversión a conversión, tomando el tipo de cada argumento del propio formato
+static void format_entry(const dlog_entry_t *e, char *out, size_t out_size)
+{
+    size_t pos = 0;
+    int arg = 0;
+    const char *p = e->fmt;
+
+    while (*p && pos + 1 < out_size) {
+        if (*p != '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[pos++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // Aislar la especificación completa: %[flags][ancho][.precisión][longitud]conversión
+        char spec[16];
+        size_t n = 0;
+        int longs = 0;
+        spec[n++] = *p++;
+        while (*p && !strchr("diuxXcsfFeEgGaAp", *p) && n < sizeof(spec) - 2) {
+            if (*p == 'l') longs++;
+            spec[n++] = *p++;
+        }
+        if (!*p) break;
+        char conv = *p++;
+        spec[n++] = conv;
+        spec[n] = '\0';
+
+        dlog_arg_t raw = (arg < e->nargs) ? e->args[arg] : 0;
+        arg++;
+        int written;
+        if (strchr("fFeEgGaA", conv)) {
+            uint32_t bits = (uint32_t)raw;
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            written = snprintf(out + pos, out_size - pos, spec, (double)f);
+        } else if (conv == 's') {
+            written = snprintf(out + pos, out_size - pos, spec, raw ? (const char *)(uintptr_t)raw : "(null)");
+        } else if (conv == 'p') {
+            written = snprintf(out + pos, out_size - pos, spec, (void *)(uintptr_t)raw);
+        } else if (longs >= 2) {
+            written = (conv == 'd' || conv == 'i')
+                ? snprintf(out + pos, out_size - pos, spec, (long long)(int32_t)raw)
+                : snprintf(out + pos, out_size - pos, spec, (unsigned long long)(uint32_t)raw);
+        } else if (longs == 1) {
+            written = (conv == 'd' || conv == 'i')
+                ? snprintf(out + pos, out_size - pos, spec, (long)(int32_t)raw)
+                : snprintf(out + pos, out_size - pos, spec, (unsigned long)(uint32_t)raw);
+        } else {
+            written = (conv == 'd' || conv == 'i' || conv == 'c')
+                ? snprintf(out + pos, out_size - pos, spec, (int)(int32_t)raw)
+                : snprintf(out + pos, out_size - pos, spec, (unsigned int)(uint32_t)raw);
+        }
+        if (written < 0) break;
+        pos += ((size_t)written < out_size - pos) ? (size_t)written : out_size - pos - 1;
+    }
+    out[pos] = '\0';
+}
+
+static void emit_entry(const dlog_entry_t *e)
+{
+    static const char letters[] = "NEWID";
+    static const esp_log_level_t levels[] = { ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG };
+    char line[DLOG_LINE_MAX];
+    uint8_t level = (e->level <= DLOG_LEVEL_DEBUG) ? e->level : DLOG_LEVEL_DEBUG;
+
+    format_entry(e, line, sizeof(line));
+    esp_log_write(levels[level], e->tag, "%c (%" PRIu32 ") %s: %s\n", letters[level], e->ts_ms, e->tag, line);
+}
+
+#else  // CONFIG_DLOG_OUTPUT_BINARY
+
+static void emit_entry(const dlog_entry_t *e)
+{
+    // Línea compacta en hexadecimal para tools/dlog_decode.py: DL <ts> <nivel> <tag> <fmt> <n> <args...>
+    // Las direcciones de tag y formato se resuelven en el host con el ELF del firmware
+    esp_rom_printf("DL %08x %x %08x %08x %x %08x %08x %08x %08x\n",
+                   (unsigned)e->ts_ms, (unsigned)e->level,
+                   (unsigned)(uintptr_t)e->tag, (unsigned)(uintptr_t)e->fmt, (unsigned)e->nargs,
+                   (unsigned)e->args[0], (unsigned)e->args[1], (unsigned)e->args[2], (unsigned)e->args[3]);
+}
+
+#endif
+
+void dlog_flush(void)
+{
+    dlog_entry_t e;
+    while (pop_entry(&e)) {
+        emit_entry(&e);
+    }
+}
+
+static void formatter_task_fn(void *arg)
+{
+    uint32_t last_dropped = 0;
+    for (;;) {
+        // Prioridad de la tarea idle: solo formatea cuando nadie más necesita la CPU
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        dlog_flush();
+        if (dropped != last_dropped) {
+            ESP_LOGW(TAG, "%" PRIu32 " mensajes perdidos por anillo lleno", dropped - last_dropped);
+            last_dropped = dropped;
+        }
+    }
+}
+
+void dlog_init(void)
+{
+    if (formatter_task) return;
+    if (xTaskCreate(formatter_task_fn, "dlog", DLOG_TASK_STACK, NULL, tskIDLE_PRIORITY, &formatter_task) != pdPASS) {
+        ESP_LOGE(TAG, "No se pudo crear la tarea de formateo; los mensajes se vuelcan con dlog_flush()");
+        formatter_task = NULL;
+    }
+}
+
+#if CONFIG_DLOG_BENCHMARK
+
+#define DLOG_BENCH_ITERATIONS   50
+
+void dlog_run_benchmark(void)
+{
+    // Mismo mensaje que el camino caliente de sensor_task, con ESP_LOGI y con DLOGI
+    const char *mode_str = "BENCH";
+    float distance_cm = 123.45f;
+    float weight_kg = 6.789f;
+
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < DLOG_BENCH_ITERATIONS; i++) {
+        ESP_LOGI(TAG, "[%s] Datos enviados: %.2f cm, %.3f kg", mode_str, distance_cm, weight_kg);
+    }
+    int64_t esp_log_us = esp_timer_get_time() - t0;
+
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < DLOG_BENCH_ITERATIONS; i++) {
+        DLOG_AT(DLOG_LEVEL_INFO, TAG, "[%s] Datos enviados: %.2f cm, %.3f kg", mode_str, distance_cm, weight_kg);
+    }
+    int64_t dlog_us = esp_timer_get_time() - t0;
+
+    // El formateo diferido se paga aparte, fuera del ciclo medido
+    t0 = esp_timer_get_time();
+    dlog_flush();
+    int64_t flush_us = esp_timer_get_time() - t0;
+
+    ESP_LOGI(TAG, "Benchmark (%d mensajes): ESP_LOGI %lld us/msg, DLOGI %lld us/msg (+%lld us/msg diferidos)",
+             DLOG_BENCH_ITERATIONS, esp_log_us / DLOG_BENCH_ITERATIONS,
+             dlog_us / DLOG_BENCH_ITERATIONS, flush_us / DLOG_BENCH_ITERATIONS);
+}
+
+#else
+
+void dlog_run_benchmark(void)
+{
+}
+
+#endif
@@ -2,11 +2,48 @@
 
 #pragma once                   // Le indica al compilador que procese este fichero solo una vez por compilacion
 
+#include <stdint.h>
+#include <stddef.h>
 #include "esp_err.h"
 
+// Códigos de evento del registro binario (no reordenar: los decodifica el servidor)
+typedef enum {
+    DIAG_EVT_BOOT = 1,          // a0 = causa de reset, a1 = causa de despertar
+    DIAG_EVT_ERROR,             // a0 = esp_err_t, a1 = hash del mensaje
+    DIAG_EVT_GENERIC,           // a0 = hash del nombre, a1 = hash de los detalles
+    DIAG_EVT_POWER_SOURCE,      // a0 = power_source_t nueva
+    DIAG_EVT_SNOW_EVENT,        // a0 = distancia (mm), a1 = peso (g)
+    DIAG_EVT_SENSOR_ERROR,      // a0 = esp_err_t
+    DIAG_EVT_PUBLISH_FAILED,    // a0 = muestras pendientes
+    DIAG_EVT_WIFI_DISCONNECT,   // a0 = motivo 802.11
+    DIAG_EVT_MQTT_DISCONNECT,
+    DIAG_EVT_STORAGE_DROP,      // a0 = muestras sobrescritas acumuladas
+    DIAG_EVT_COMMAND,           // a0 = hash FNV-1a del id, a1 = esp_err_t del resultado
+    DIAG_EVT_STORAGE_CORRUPT,   // a0 = esp_err_t de la lectura, a1 = índice del registro descartado
+} diag_code_t;
+
+// Entrada del anillo: 16 bytes, sin texto
+typedef struct {
+    uint32_t timestamp;         // Epoch (s); antes de sincronizar SNTP, segundos desde el primer arranque
+    uint16_t code;              // diag_code_t
+    uint16_t seq;               // Número de secuencia (detecta huecos al volcar)
+    int32_t  arg0;
+    int32_t  arg1;
+} diag_event_t;
+
+// Recibe cada trozo json del volcado
+typedef void (*diag_dump_cb_t)(const char *json, void *ctx);
+
 void diagnostics_init(void);                                                        // Inicializa el sistema de logging
 
 void diagnostics_log_error(const char *tag, esp_err_t err, const char *msg);        // Registra un error con su codigo y descripcion
 
 void diagnostics_record_event(const char *event_name, const char *details);         // Guarda un evento significativo con más detalles
 
+void diagnostics_event(diag_code_t code, int32_t arg0, int32_t arg1);               // Añade un evento binario al anillo (sin escribir en flash)
+
+esp_err_t diagnostics_flush(void);                                                  // Vuelca al área circular de flash los eventos pendientes
+
+uint32_t diagnostics_pending_flush(void);                                           // Eventos en el anillo aún no volcados
+
+void diagnostics_dump_json(diag_dump_cb_t cb, void *ctx);                           // Entrega flash + anillo como trozos json
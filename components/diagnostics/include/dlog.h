@@ -0,0 +1,74 @@
+// File: components/diagnostics/include/dlog.h
+
+#pragma once                   // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <string.h>
+#include "sdkconfig.h"
+
+// Registro diferido: en el camino caliente solo se guarda el puntero al formato (su "ID",
+// una cadena constante en flash), el tag y los argumentos en bruto (32 bits) en un anillo.
+// El texto se formatea después en una tarea de baja prioridad, o fuera del equipo con
+// tools/dlog_decode.py a partir del ELF. Solo admite hasta 4 argumentos de 32 bits:
+// enteros, float/double (se guardan como float) y cadenas constantes.
+//
+// Nivel por módulo: definir DLOG_LOCAL_LEVEL antes de incluir este fichero; los mensajes
+// de nivel superior desaparecen en compilación.
+
+#define DLOG_LEVEL_NONE     0
+#define DLOG_LEVEL_ERROR    1
+#define DLOG_LEVEL_WARN     2
+#define DLOG_LEVEL_INFO     3
+#define DLOG_LEVEL_DEBUG    4
+
+#ifndef DLOG_LOCAL_LEVEL
+#define DLOG_LOCAL_LEVEL    CONFIG_DLOG_DEFAULT_LEVEL
+#endif
+
+#define DLOG_MAX_ARGS       4
+
+typedef uintptr_t dlog_arg_t;                   // Una palabra por argumento: 32 bits en el ESP32, cabe un puntero en el host
+
+void dlog_init(void);                                                           // Crea el anillo y, si procede, la tarea de formateo
+void dlog_write(uint8_t level, const char *tag, const char *fmt, uint8_t nargs, const dlog_arg_t *args);  // No usar directamente
+void dlog_flush(void);                                                          // Formatea/emite lo pendiente (antes de dormir)
+uint32_t dlog_dropped(void);                                                    // Entradas perdidas por anillo lleno
+void dlog_run_benchmark(void);                                                  // Compara ESP_LOGI con el registro diferido
+
+// Conversión de cada argumento a una palabra según su tipo (float en sus 32 bits bajos)
+static inline dlog_arg_t dlog_u32_from_float(float v) { uint32_t u; memcpy(&u, &v, sizeof(u)); return u; }
+static inline dlog_arg_t dlog_u32_from_double(double v) { return dlog_u32_from_float((float)v); }
+static inline dlog_arg_t dlog_u32_from_int(long long v) { return (uint32_t)v; }
+static inline dlog_arg_t dlog_u32_from_ptr(const void *p) { return (uintptr_t)p; }
+
+#define DLOG_ARG(x) _Generic((x),                   \
+    float: dlog_u32_from_float,                     \
+    double: dlog_u32_from_double,                   \
+    char *: dlog_u32_from_ptr,                      \
+    const char *: dlog_u32_from_ptr,                \
+    default: dlog_u32_from_int)(x)
+
+// Número de argumentos (0..4) y expansión de cada uno; con más de 4 falla en DLOG_MAP_TOO_MANY_ARGS
+#define DLOG_COUNT(...) DLOG_COUNT_(0, ##__VA_ARGS__, TOO_MANY_ARGS, 4, 3, 2, 1, 0)
+#define DLOG_COUNT_(_0, _1, _2, _3, _4, _5, N, ...) N
+#define DLOG_MAP_0()
+#define DLOG_MAP_1(a)             DLOG_ARG(a)
+#define DLOG_MAP_2(a, b)          DLOG_ARG(a), DLOG_ARG(b)
+#define DLOG_MAP_3(a, b, c)       DLOG_ARG(a), DLOG_ARG(b), DLOG_ARG(c)
+#define DLOG_MAP_4(a, b, c, d)    DLOG_ARG(a), DLOG_ARG(b), DLOG_ARG(c), DLOG_ARG(d)
+#define DLOG_MAP_N_(n, ...)       DLOG_MAP_##n(__VA_ARGS__)
+#define DLOG_MAP_N(n, ...)        DLOG_MAP_N_(n, ##__VA_ARGS__)
+
+#define DLOG_AT(level, tag, fmt, ...) do {                                          \
+        if ((level) <= DLOG_LOCAL_LEVEL) {                                          \
+            static const char dlog_fmt_[] = fmt;                                    \
+            const dlog_arg_t dlog_args_[DLOG_MAX_ARGS + 1] = {                      \
+                DLOG_MAP_N(DLOG_COUNT(__VA_ARGS__), ##__VA_ARGS__) };               \
+            dlog_write((level), (tag), dlog_fmt_, DLOG_COUNT(__VA_ARGS__), dlog_args_); \
+        }                                                                           \
+    } while (0)
+
+#define DLOGE(tag, fmt, ...) DLOG_AT(DLOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG_AT(DLOG_LEVEL_WARN,  tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG_AT(DLOG_LEVEL_INFO,  tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) DLOG_AT(DLOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
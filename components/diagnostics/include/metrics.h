@@ -0,0 +1,54 @@
+// File: components/diagnostics/include/metrics.h
+
+#pragma once                   // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Registro de métricas estático: contadores, indicadores e histogramas de latencia con
+// cubetas fijas. Se actualizan sin bloqueos (operaciones atómicas) desde cualquier tarea
+// y viven en memoria RTC, así que acumulan entre despertares del deep sleep.
+
+// Contadores monótonos
+typedef enum {
+    METRIC_BOOTS = 0,               // Arranques (incluye despertares de deep sleep)
+    METRIC_SAMPLES_READ,            // Lecturas de sensores correctas
+    METRIC_READ_ERRORS,             // Lecturas de sensores fallidas
+    METRIC_SAMPLES_DROPPED,         // Muestras descartadas por cola llena
+    METRIC_PUBLISH_OK,              // Mensajes aceptados por el cliente MQTT
+    METRIC_PUBLISH_FAILED,          // Mensajes rechazados por el cliente MQTT
+    METRIC_MQTT_ACKS,               // Confirmaciones QoS1 recibidas del broker
+    METRIC_WIFI_DISCONNECTS,        // Desconexiones Wi-Fi
+    METRIC_FILTER_REJECTED,         // Muestras con alguna medida rechazada por el filtro de espesor y SWE
+    METRIC_STORAGE_DISCARDED,       // Registros ilegibles del almacén descartados sin subir
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+// Indicadores (último valor)
+typedef enum {
+    METRIC_QUEUE_DEPTH = 0,         // Muestras en la cola sensor -> publicación
+    METRIC_BACKLOG,                 // Muestras pendientes en el almacén local
+    METRIC_STORAGE_DROPPED,         // Muestras sobrescritas en el almacén por falta de espacio
+    METRIC_FREE_HEAP,               // Heap libre (bytes)
+    METRIC_GAUGE_COUNT
+} metric_gauge_t;
+
+// Histogramas de latencia (milisegundos)
+typedef enum {
+    METRIC_SENSOR_READ_MS = 0,      // Lectura completa de sensores
+    METRIC_HX711_WAIT_MS,           // Espera a que el HX711 tenga dato listo
+    METRIC_PUBLISH_ACK_MS,          // Desde publicar hasta la confirmación del broker
+    METRIC_WIFI_CONNECT_MS,         // Desde arrancar el Wi-Fi hasta obtener IP
+    METRIC_HISTOGRAM_COUNT
+} metric_histogram_t;
+
+#define METRIC_HISTOGRAM_BUCKETS  15   // Límites 1, 2, 5 ... 30000 ms y desbordamiento
+
+void metrics_init(void);                                            // Cuenta el arranque; borra el registro tras un corte de alimentación
+void metrics_counter_add(metric_counter_t id, uint32_t n);          // Suma n al contador
+void metrics_gauge_set(metric_gauge_t id, int32_t value);           // Fija el valor del indicador
+void metrics_histogram_record(metric_histogram_t id, uint32_t ms);  // Registra una latencia en su cubeta
+uint32_t metrics_counter_get(metric_counter_t id);                  // Valor actual del contador (0 si no existe)
+int metrics_format_json(char *buf, size_t buf_size);                // Instantánea compacta en json; devuelve la longitud o -1
+
+static inline void metrics_counter_inc(metric_counter_t id) { metrics_counter_add(id, 1); }
@@ -0,0 +1,32 @@
+// File: components/diagnostics/include/profiler.h
+
+#pragma once                   // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Perfilador de fases del ciclo de despertar. Cada fase se mide con esp_timer; al dormir,
+// las duraciones del ciclo se suman a acumuladores en memoria RTC, y cada
+// CONFIG_PROFILER_SUMMARY_CYCLES ciclos queda listo un resumen (media por fase y carga estimada).
+
+typedef enum {
+    PROFILE_BOOT = 0,           // Desde el reset hasta app_main
+    PROFILE_HX711_REINIT,       // Power cycle y recalibración del HX711 tras deep sleep
+    PROFILE_WIFI_ASSOC,         // Arranque del Wi-Fi hasta obtener IP
+    PROFILE_SNTP,               // Sincronización de hora
+    PROFILE_MQTT_CONNECT,       // Arranque del cliente hasta conectar con el broker
+    PROFILE_SENSOR_READ,        // Lectura de HC-SR04P + HX711
+    PROFILE_PUBLISH,            // Envío del lote, estado y métricas
+    PROFILE_ACK_WAIT,           // Espera de confirmaciones tras publicar (radio en modem sleep)
+    PROFILE_SLEEP_DELAY,        // Esperas de cortesía antes de dormir
+    PROFILE_PHASE_COUNT
+} profile_phase_t;
+
+void profiler_init(void);                           // Registra la fase de arranque (llamar al inicio de app_main)
+void profiler_begin(profile_phase_t phase);         // Marca el inicio de una fase
+void profiler_end(profile_phase_t phase);           // Suma al ciclo el tiempo desde el último profiler_begin()
+void profiler_cycle_end(void);                      // Cierra el ciclo y lo acumula en RTC (justo antes de dormir)
+bool profiler_summary_ready(void);                  // true si ya hay CONFIG_PROFILER_SUMMARY_CYCLES ciclos acumulados
+int profiler_format_json(char *buf, size_t buf_size);   // Resumen en json; devuelve la longitud o -1
+void profiler_reset_summary(void);                  // Empieza una nueva ventana de resumen tras publicarla
@@ -0,0 +1,167 @@
+// File: components/diagnostics/metrics.c
+
+#include "metrics.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include <stdatomic.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+static const char *TAG = "metrics";
+
+#define METRICS_MAGIC  0x4D455452          // Marca de registro válido en memoria RTC
+
+// Límite superior de cada cubeta (ms); la última recoge todo lo que lo supera
+static const uint32_t bucket_limits_ms[METRIC_HISTOGRAM_BUCKETS - 1] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000
+};
+
+// Nombres cortos para el json exportado (mismo orden que los enum)
+static const char *const counter_names[METRIC_COUNTER_COUNT] = {
+    "boots", "reads", "read_err", "dropped", "pub_ok", "pub_fail", "acks", "wifi_disc", "kf_reject", "store_bad"
+};
+static const char *const gauge_names[METRIC_GAUGE_COUNT] = {
+    "queue", "backlog", "store_drop", "heap"
+};
+static const char *const histogram_names[METRIC_HISTOGRAM_COUNT] = {
+    "read_ms", "hx711_ms", "ack_ms", "wifi_ms"
+};
+
+typedef struct {
+    atomic_uint_fast32_t count;
+    atomic_uint_fast32_t sum_ms;
+    atomic_uint_fast32_t max_ms;
+    atomic_uint_fast32_t buckets[METRIC_HISTOGRAM_BUCKETS];
+} histogram_t;
+
+typedef struct {
+    uint32_t magic;
+    atomic_uint_fast32_t counters[METRIC_COUNTER_COUNT];
+    atomic_int_fast32_t gauges[METRIC_GAUGE_COUNT];
+    histogram_t histograms[METRIC_HISTOGRAM_COUNT];
+} metrics_registry_t;
+
+RTC_DATA_ATTR static metrics_registry_t registry;
+
+void metrics_init(void)
+{
+    if (registry.magic != METRICS_MAGIC) {
+        // Arranque en frío: la memoria RTC no tiene un registro válido
+        for (int i = 0; i < METRIC_COUNTER_COUNT; i++) atomic_init(&registry.counters[i], 0);
+        for (int i = 0; i < METRIC_GAUGE_COUNT; i++) atomic_init(&registry.gauges[i], 0);
+        for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+            histogram_t *hist = &registry.histograms[h];
+            atomic_init(&hist->count, 0);
+            atomic_init(&hist->sum_ms, 0);
+            atomic_init(&hist->max_ms, 0);
+            for (int b = 0; b < METRIC_HISTOGRAM_BUCKETS; b++) atomic_init(&hist->buckets[b], 0);
+        }
+        registry.magic = METRICS_MAGIC;
+        ESP_LOGI(TAG, "Registro de métricas inicializado");
+    }
+    metrics_counter_inc(METRIC_BOOTS);
+}
+
+void metrics_counter_add(metric_counter_t id, uint32_t n)
+{
+    if (id < METRIC_COUNTER_COUNT) {
+        atomic_fetch_add_explicit(&registry.counters[id], n, memory_order_relaxed);
+    }
+}
+
+uint32_t metrics_counter_get(metric_counter_t id)
+{
+    if (id >= METRIC_COUNTER_COUNT) {
+        return 0;
+    }
+    return (uint32_t)atomic_load_explicit(&registry.counters[id], memory_order_relaxed);
+}
+
+void metrics_gauge_set(metric_gauge_t id, int32_t value)
+{
+    if (id < METRIC_GAUGE_COUNT) {
+        atomic_store_explicit(&registry.gauges[id], value, memory_order_relaxed);
+    }
+}
+
+void metrics_histogram_record(metric_histogram_t id, uint32_t ms)
+{
+    if (id >= METRIC_HISTOGRAM_COUNT) {
+        return;
+    }
+    histogram_t *hist = &registry.histograms[id];
+
+    int bucket = 0;
+    while (bucket < METRIC_HISTOGRAM_BUCKETS - 1 && ms > bucket_limits_ms[bucket]) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&hist->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->sum_ms, ms, memory_order_relaxed);
+
+    // Máximo sin bloqueo: reintentar mientras otra tarea no haya escrito ya un valor mayor
+    uint_fast32_t current = atomic_load_explicit(&hist->max_ms, memory_order_relaxed);
+    while (ms > current &&
+           !atomic_compare_exchange_weak_explicit(&hist->max_ms, &current, ms,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Añade texto al buffer controlando el espacio restante; devuelve false si no cabe
+static bool append(char *buf, size_t buf_size, size_t *len, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static bool append(char *buf, size_t buf_size, size_t *len, const char *fmt, ...)
+{
+    if (*len >= buf_size) {
+        return false;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(buf + *len, buf_size - *len, fmt, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= buf_size - *len) {
+        return false;
+    }
+    *len += (size_t)written;
+    return true;
+}
+
+int metrics_format_json(char *buf, size_t buf_size)
+{
+    // Formato compacto: contadores e indicadores planos y, por histograma, n/suma/máx y las cubetas
+    // como array (Telegraf lo aplana en <nombre>_b_0 ... <nombre>_b_14)
+    size_t len = 0;
+    bool ok = append(buf, buf_size, &len, "{");
+
+    for (int i = 0; ok && i < METRIC_COUNTER_COUNT; i++) {
+        ok = append(buf, buf_size, &len, "\"%s\":%" PRIuFAST32 ",", counter_names[i],
+                    atomic_load_explicit(&registry.counters[i], memory_order_relaxed));
+    }
+    for (int i = 0; ok && i < METRIC_GAUGE_COUNT; i++) {
+        ok = append(buf, buf_size, &len, "\"%s\":%" PRIdFAST32 ",", gauge_names[i],
+                    atomic_load_explicit(&registry.gauges[i], memory_order_relaxed));
+    }
+    for (int h = 0; ok && h < METRIC_HISTOGRAM_COUNT; h++) {
+        histogram_t *hist = &registry.histograms[h];
+        ok = append(buf, buf_size, &len, "\"%s_n\":%" PRIuFAST32 ",\"%s_sum\":%" PRIuFAST32 ",\"%s_max\":%" PRIuFAST32 ",\"%s_b\":[",
+                    histogram_names[h], atomic_load_explicit(&hist->count, memory_order_relaxed),
+                    histogram_names[h], atomic_load_explicit(&hist->sum_ms, memory_order_relaxed),
+                    histogram_names[h], atomic_load_explicit(&hist->max_ms, memory_order_relaxed),
+                    histogram_names[h]);
+        for (int b = 0; ok && b < METRIC_HISTOGRAM_BUCKETS; b++) {
+            ok = append(buf, buf_size, &len, "%" PRIuFAST32 "%s",
+                        atomic_load_explicit(&hist->buckets[b], memory_order_relaxed),
+                        b < METRIC_HISTOGRAM_BUCKETS - 1 ? "," : "]");
+        }
+        ok = ok && append(buf, buf_size, &len, h < METRIC_HISTOGRAM_COUNT - 1 ? "," : "");
+    }
+    ok = ok && append(buf, buf_size, &len, "}");
+
+    if (!ok) {
+        ESP_LOGW(TAG, "Buffer de %u bytes insuficiente para la instantánea", (unsigned)buf_size);
+        return -1;
+    }
+    return (int)len;
+}
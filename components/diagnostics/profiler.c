@@ -0,0 +1,129 @@
+// File: components/diagnostics/profiler.c
+
+#include "profiler.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+static const char *TAG = "profiler";
+
+#define PROFILER_MAGIC  0x50524F47          // Marca de acumuladores válidos en memoria RTC
+
+static const char *const phase_names[PROFILE_PHASE_COUNT] = {
+    "boot", "hx711", "wifi", "sntp", "mqtt", "read", "publish", "ack_wait", "sleep_delay"
+};
+
+// Corriente media estimada de cada fase (mA) para convertir tiempo en carga
+static const uint16_t phase_current_ma[PROFILE_PHASE_COUNT] = {
+    45,     // boot: CPU a plena frecuencia, flash
+    50,     // hx711: CPU + puente de galgas alimentado
+    130,    // wifi: radio en asociación y DHCP
+    110,    // sntp: radio activa
+    110,    // mqtt: radio activa, TLS/TCP
+    50,     // read: CPU + sensores
+    120,    // publish: radio transmitiendo
+    60,     // ack_wait: CPU + radio en modem sleep
+    40,     // sleep_delay: CPU ociosa, radio en modem sleep
+};
+
+// Acumuladores de la ventana de resumen, conservados entre despertares
+typedef struct {
+    uint32_t magic;
+    uint32_t cycles;
+    uint32_t uploads;                       // Ciclos con subida: las fases de radio solo ocurren en ellos
+    uint64_t total_us[PROFILE_PHASE_COUNT];
+    uint64_t awake_us;
+} profiler_accum_t;
+
+RTC_DATA_ATTR static profiler_accum_t accum;
+
+// Ciclo en curso (se pierde con el deep sleep, por eso se vuelca en profiler_cycle_end)
+static int64_t phase_start_us[PROFILE_PHASE_COUNT];
+static uint64_t cycle_us[PROFILE_PHASE_COUNT];
+
+void profiler_init(void)
+{
+    if (accum.magic != PROFILER_MAGIC) {
+        profiler_reset_summary();
+    }
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        phase_start_us[i] = -1;
+        cycle_us[i] = 0;
+    }
+    cycle_us[PROFILE_BOOT] = (uint64_t)esp_timer_get_time();
+}
+
+void profiler_begin(profile_phase_t phase)
+{
+    if (phase < PROFILE_PHASE_COUNT) {
+        phase_start_us[phase] = esp_timer_get_time();
+    }
+}
+
+void profiler_end(profile_phase_t phase)
+{
+    if (phase < PROFILE_PHASE_COUNT && phase_start_us[phase] >= 0) {
+        cycle_us[phase] += (uint64_t)(esp_timer_get_time() - phase_start_us[phase]);
+        phase_start_us[phase] = -1;
+    }
+}
+
+void profiler_cycle_end(void)
+{
+    if (cycle_us[PROFILE_PUBLISH] > 0) {
+        accum.uploads++;
+    }
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        accum.total_us[i] += cycle_us[i];
+        cycle_us[i] = 0;
+    }
+    accum.awake_us += (uint64_t)esp_timer_get_time();
+    accum.cycles++;
+    ESP_LOGD(TAG, "Ciclo %" PRIu32 " acumulado", accum.cycles);
+}
+
+bool profiler_summary_ready(void)
+{
+    return accum.cycles >= CONFIG_PROFILER_SUMMARY_CYCLES;
+}
+
+int profiler_format_json(char *buf, size_t buf_size)
+{
+    if (accum.cycles == 0) {
+        return -1;
+    }
+
+    // Por fase: media en ms por ciclo y carga media estimada en mA·s por ciclo
+    int len = snprintf(buf, buf_size, "{\"cycles\":%" PRIu32 ",\"uploads\":%" PRIu32 ",\"awake_ms\":%" PRIu64,
+                       accum.cycles, accum.uploads, accum.awake_us / accum.cycles / 1000ULL);
+    double total_mas = 0.0;
+    for (int i = 0; i < PROFILE_PHASE_COUNT && len > 0 && (size_t)len < buf_size; i++) {
+        uint64_t mean_us = accum.total_us[i] / accum.cycles;
+        double mas = (double)mean_us / 1e6 * phase_current_ma[i];
+        total_mas += mas;
+        len += snprintf(buf + len, buf_size - len, ",\"%s_ms\":%" PRIu64 ",\"%s_mas\":%.2f",
+                        phase_names[i], mean_us / 1000ULL, phase_names[i], mas);
+    }
+    if (len > 0 && (size_t)len < buf_size) {
+        len += snprintf(buf + len, buf_size - len, ",\"total_mas\":%.2f}", total_mas);
+    }
+    if (len < 0 || (size_t)len >= buf_size) {
+        ESP_LOGW(TAG, "Buffer de %u bytes insuficiente para el resumen", (unsigned)buf_size);
+        return -1;
+    }
+    return len;
+}
+
+void profiler_reset_summary(void)
+{
+    accum.magic = PROFILER_MAGIC;
+    accum.cycles = 0;
+    accum.uploads = 0;
+    accum.awake_us = 0;
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        accum.total_us[i] = 0;
+    }
+}
@@ -0,0 +1,107 @@
+// File: components/event_detector/event_detector.c
+
+#include "event_detector.h"
+#include "sdkconfig.h"
+#include <math.h>
+
+void event_detector_default_params(event_detector_params_t *params) {
+    params->distance_drift_cm     = CONFIG_EVENT_DISTANCE_DRIFT_MM / 10.0f;
+    params->distance_threshold_cm = CONFIG_EVENT_DISTANCE_THRESHOLD_MM / 10.0f;
+    params->distance_step_cm      = CONFIG_EVENT_DISTANCE_STEP_MM / 10.0f;
+    params->weight_drift_kg       = CONFIG_EVENT_WEIGHT_DRIFT_G / 1000.0f;
+    params->weight_threshold_kg   = CONFIG_EVENT_WEIGHT_THRESHOLD_G / 1000.0f;
+    params->weight_step_kg        = CONFIG_EVENT_WEIGHT_STEP_G / 1000.0f;
+    params->calm_samples          = CONFIG_EVENT_CALM_SAMPLES;
+    params->burst_samples         = CONFIG_EVENT_BURST_SAMPLES;
+}
+
+void event_detector_init(event_detector_t *det) {
+    det->distance = (cusum_channel_t){0};
+    det->weight = (cusum_channel_t){0};
+    det->flat_count = 0;
+    det->burst_left = 0;
+    det->activity = SNOW_ACTIVITY_NORMAL;
+}
+
+// Actualiza el CUSUM de un canal. Devuelve true si hay cambio significativo;
+// *flat indica si la muestra está dentro de la deriva respecto a la anterior
+static bool cusum_update(cusum_channel_t *ch, float x, float drift, float threshold, float step, bool *flat) {
+    if (isnan(x)) {
+        return false;                           // Lectura inválida: no altera el estado
+    }
+    if (!ch->has_last) {
+        ch->reference = x;
+        ch->last = x;
+        ch->has_last = true;
+        *flat = false;
+        return false;
+    }
+
+    float diff = x - ch->last;
+    ch->last = x;
+    *flat = fabsf(diff) <= drift;
+
+    // CUSUM bilateral respecto a la referencia con deriva k
+    ch->pos = fmaxf(0.0f, ch->pos + (x - ch->reference - drift));
+    ch->neg = fmaxf(0.0f, ch->neg + (ch->reference - x - drift));
+
+    if (ch->pos > threshold || ch->neg > threshold || fabsf(diff) > step) {
+        // Cambio detectado: nueva referencia y sumas a cero
+        ch->reference = x;
+        ch->pos = 0.0f;
+        ch->neg = 0.0f;
+        return true;
+    }
+    return false;
+}
+
+bool event_detector_update(event_detector_t *det, const event_detector_params_t *params,
+                           float distance_cm, float weight_kg) {
+    bool distance_flat = true, weight_flat = true;
+
+    bool distance_change = cusum_update(&det->distance, distance_cm, params->distance_drift_cm,
+                                        params->distance_threshold_cm, params->distance_step_cm, &distance_flat);
+    bool weight_change = cusum_update(&det->weight, weight_kg, params->weight_drift_kg,
+                                      params->weight_threshold_kg, params->weight_step_kg, &weight_flat);
+
+    bool triggered = distance_change || weight_change;
+
+    if (triggered) {
+        det->burst_left = params->burst_samples;
+        det->flat_count = 0;
+        det->activity = SNOW_ACTIVITY_EVENT;
+        return true;
+    }
+
+    det->flat_count = (distance_flat && weight_flat) ? det->flat_count + 1 : 0;
+
+    if (det->burst_left > 0) {
+        det->burst_left--;
+        det->activity = (det->burst_left > 0) ? SNOW_ACTIVITY_EVENT : SNOW_ACTIVITY_NORMAL;
+    } else if (det->flat_count >= params->calm_samples) {
+        det->activity = SNOW_ACTIVITY_CALM;
+    } else {
+        det->activity = SNOW_ACTIVITY_NORMAL;
+    }
+    return false;
+}
+
+void event_detector_force_burst(event_detector_t *det, uint32_t samples) {
+    if (samples == 0) return;
+    if (samples > det->burst_left) det->burst_left = samples;
+    det->flat_count = 0;
+    det->activity = SNOW_ACTIVITY_EVENT;
+}
+
+uint32_t event_detector_period_ms(const event_detector_t *det, uint32_t base_ms,
+                                  uint32_t burst_ms, uint32_t calm_ms) {
+    switch (det->activity) {
+        case SNOW_ACTIVITY_EVENT:
+            return (burst_ms < base_ms) ? burst_ms : base_ms;
+        case SNOW_ACTIVITY_CALM:
+            return (calm_ms > base_ms) ? calm_ms : base_ms;
+        case SNOW_ACTIVITY_NORMAL:
+        default:
+            return base_ms;
+    }
+}
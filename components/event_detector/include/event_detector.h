@@ -0,0 +1,60 @@
+// File: components/event_detector/include/event_detector.h
+
+#pragma once                 // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Nivel de actividad de la nieve según el detector
+typedef enum {
+    SNOW_ACTIVITY_NORMAL = 0,    // Sin información suficiente o cambios moderados: periodo nominal
+    SNOW_ACTIVITY_CALM,          // Señal plana: se puede alargar el periodo
+    SNOW_ACTIVITY_EVENT          // Acumulación o erosión en curso: muestreo en ráfaga
+} snow_activity_t;
+
+// Parámetros del detector (unidades: cm y kg)
+typedef struct {
+    float distance_drift_cm;     // k del CUSUM de distancia
+    float distance_threshold_cm; // h del CUSUM de distancia
+    float distance_step_cm;      // Salto instantáneo de distancia
+    float weight_drift_kg;       // k del CUSUM de peso
+    float weight_threshold_kg;   // h del CUSUM de peso
+    float weight_step_kg;        // Salto instantáneo de peso
+    uint32_t calm_samples;       // Muestras planas para pasar a calma
+    uint32_t burst_samples;      // Muestras en ráfaga tras la última detección
+} event_detector_params_t;
+
+// CUSUM bilateral de un canal
+typedef struct {
+    float reference;             // Nivel de referencia tras el último evento
+    float pos;                   // Suma acumulada de subidas
+    float neg;                   // Suma acumulada de bajadas
+    float last;                  // Última muestra válida
+    bool has_last;               // true si last es válida
+} cusum_channel_t;
+
+// Estado del detector: tamaño fijo, apto para memoria RTC
+typedef struct {
+    cusum_channel_t distance;
+    cusum_channel_t weight;
+    uint32_t flat_count;         // Muestras planas consecutivas
+    uint32_t burst_left;         // Muestras que quedan en ráfaga
+    snow_activity_t activity;    // Actividad actual
+} event_detector_t;
+
+// Rellena los parámetros con los valores de menuconfig
+void event_detector_default_params(event_detector_params_t *params);
+
+void event_detector_init(event_detector_t *det);       // Reinicia el detector
+
+// Procesa una muestra (NAN en un canal = lectura inválida, se ignora) y devuelve
+// true si esta muestra ha disparado un evento nuevo
+bool event_detector_update(event_detector_t *det, const event_detector_params_t *params,
+                           float distance_cm, float weight_kg);
+
+// Pasa a ráfaga durante las próximas samples muestras, como tras una detección (p. ej. por comando remoto)
+void event_detector_force_burst(event_detector_t *det, uint32_t samples);
+
+// Devuelve el periodo de muestreo recomendado a partir del periodo base
+uint32_t event_detector_period_ms(const event_detector_t *det, uint32_t base_ms,
+                                  uint32_t burst_ms, uint32_t calm_ms);
@@ -0,0 +1,50 @@
+// File: components/nivometro_sensors/include/convergence.h
+//
+// Parada anticipada de las calibraciones: media y varianza en línea (Welford) con el semiancho
+// del intervalo de confianza del 95 % (t de Student). Se deja de muestrear en cuanto el intervalo
+// entra en la tolerancia y se abandona pronto si con la dispersión observada no entraría ni con
+// el máximo de muestras.
+
+#ifndef CONVERGENCE_H
+#define CONVERGENCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CONVERGENCE_RUNNING = 0,        // Faltan muestras
+    CONVERGENCE_DONE,               // Intervalo dentro de la tolerancia
+    CONVERGENCE_EXHAUSTED,          // Máximo de muestras alcanzado sin converger
+    CONVERGENCE_DIVERGED,           // Dispersión demasiado alta: no convergería a tiempo
+} convergence_state_t;
+
+typedef struct {
+    int min_samples;                // Mínimo antes de evaluar el intervalo
+    int max_samples;                // Tope de muestras válidas
+    double center;                  // Referencia de la tolerancia relativa (offset de la tara, 0 en distancias)
+    float rel_tolerance;            // Semiancho admitido como fracción de |media - center|
+    double abs_tolerance;           // Semiancho admitido mínimo, en unidades de la medida
+} convergence_params_t;
+
+typedef struct {
+    uint32_t n;
+    double mean;
+    double m2;                      // Suma de cuadrados de las desviaciones
+    convergence_state_t state;
+} convergence_t;
+
+void convergence_init(convergence_t *c);
+convergence_state_t convergence_push(convergence_t *c, const convergence_params_t *p, double x);
+double convergence_stddev(const convergence_t *c);
+double convergence_half_width(const convergence_t *c);      // Semiancho del IC del 95 %
+const char *convergence_state_name(convergence_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
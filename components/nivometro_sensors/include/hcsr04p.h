@@ -11,6 +11,8 @@
 #include "esp_timer.h"
 #include "esp_system.h"
 
+#define HCSR04P_MIN_CYCLE_MS    60      // Separación mínima entre disparos para que no se solapen ecos
+
 typedef struct {
     int trigger_pin;
     int echo_pin;
@@ -11,6 +11,7 @@
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "convergence.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,6 +31,23 @@ typedef struct {
     hx711_gain_t gain;
 } hx711_config_t;
 
+// Modelo de la célula ajustado por mínimos cuadrados: peso(g) = c0 + c1·x + c2·x², con x = bruto - offset.
+// En tiempo de ejecución se evalúa con una tabla en coma fija de tramos lineales de anchura 2^shift:
+// una conversión es un desplazamiento, un acceso a la tabla y una multiplicación-suma.
+#define HX711_CURVE_MAX_ORDER   2
+#define HX711_CURVE_MAX_POINTS  8
+#define HX711_LUT_SEGMENTS      32
+#define HX711_RAW_MIN           (-8388608)      // Rango del conversor (24 bits con signo)
+#define HX711_RAW_MAX           8388607
+
+typedef struct {
+    bool valid;
+    uint8_t shift;                              // Anchura de tramo = 1 << shift cuentas
+    int32_t x0;                                 // Cuenta neta al inicio del primer tramo
+    int32_t base_mg[HX711_LUT_SEGMENTS];        // Peso al inicio de cada tramo (mg)
+    int32_t slope_q16[HX711_LUT_SEGMENTS];      // Pendiente del tramo (mg por cuenta, Q16.16)
+} hx711_lut_t;
+
 // Estructura del dispositivo HX711
 typedef struct {
     gpio_num_t dout_pin;
@@ -40,6 +58,7 @@ typedef struct {
     bool is_ready;
     int32_t last_readings[5];
     int reading_index;
+    hx711_lut_t lut;                            // Si no es válida se usa offset/scale
 } hx711_t;
 
 typedef hx711_t hx711_sensor_t;
@@ -63,7 +82,20 @@ esp_err_t hx711_tare(hx711_t *dev, int samples);
 esp_err_t hx711_calibrate(hx711_t *dev, float known_weight, int samples);
 esp_err_t hx711_read_units(hx711_t *dev, float *units);
 esp_err_t hx711_read_units_average(hx711_t *dev, float *units, int samples);
+// Variantes con parada anticipada: leen al ritmo del conversor hasta que el IC del 95 % de la media
+// entra en la tolerancia de p. ESP_ERR_INVALID_STATE si la dispersión no permite converger.
+esp_err_t hx711_read_converged(hx711_t *dev, const convergence_params_t *p, convergence_t *stats);
+esp_err_t hx711_tare_converged(hx711_t *dev, const convergence_params_t *p);
+esp_err_t hx711_calibrate_converged(hx711_t *dev, float known_weight, const convergence_params_t *p);
 void hx711_debug_info(hx711_t *dev);
+
+// Calibración multipunto: ajusta el polinomio de orden 1 o 2 a count puntos (cuentas netas, gramos)
+esp_err_t hx711_fit_curve(const int32_t *net_counts, const float *weights_g, int count, int order,
+                          float coef[HX711_CURVE_MAX_ORDER + 1], float *rms_g);
+// Construye la tabla de evaluación sobre [net_min, net_max]; fuera del rango se extrapola con el tramo extremo
+esp_err_t hx711_set_curve(hx711_t *dev, const float coef[HX711_CURVE_MAX_ORDER + 1], int32_t net_min, int32_t net_max);
+void hx711_clear_curve(hx711_t *dev);
+float hx711_net_to_units(const hx711_t *dev, int32_t net);
 static inline bool hx711_init_old_api(hx711_sensor_t *sensor, int dout_pin, int sck_pin, hx711_gain_t gain) {
     hx711_config_t config = {
         .dout_pin = (gpio_num_t)dout_pin,
@@ -3,6 +3,7 @@
 
 #include "hcsr04p.h"
 #include "hx711.h"
+#include "zero_tracker.h"
 #include "esp_err.h"
 #include "esp_log.h"
 
@@ -27,6 +28,16 @@ typedef struct {
     uint8_t sensor_status;    // Status de sensores (bits)
     float battery_voltage;    // Voltaje batería
     int temperature_c;        // Temperatura en Celsius
+    bool snow_event;          // true si la muestra pertenece a un evento de nieve (se publica de inmediato)
+    uint32_t epoch_s;         // Instante de la muestra en UTC (segundos), válido entre despertares
+    // Estimación del filtro de Kalman de espesor y SWE (snow_filter); filter_flags = 0 si no hay
+    float depth_filt_cm;
+    float depth_rate_cm_h;
+    float swe_filt_mm;
+    float swe_rate_mm_h;
+    float depth_nis;          // Innovación normalizada de cada sensor (NAN si no había medida)
+    float swe_nis;
+    uint8_t filter_flags;     // SNOW_FILTER_*: estimaciones válidas y medidas rechazadas
 } sensor_data_t;
 
 // Configuración del nivómetro 
@@ -43,12 +54,20 @@ typedef struct {
     float hx711_known_weight;
 } nivometro_config_t;
 
+// Fuente de temperatura para la compensación de la balanza: °C, o NAN si no hay medida
+typedef float (*nivometro_temp_fn_t)(void *ctx);
+
 // Estructura principal del nivómetro
 typedef struct {
     hcsr04p_sensor_t ultrasonic;
     hx711_sensor_t scale;
     nivometro_config_t config;
     bool initialized;
+    int hx711_samples;               // Lecturas HX711 promediadas por muestra (lo ajusta el plan de energía)
+    nivometro_temp_fn_t temp_fn;     // NULL: sin temperatura
+    void *temp_ctx;
+    zero_tracker_t *zero;            // Seguimiento del cero (estado en RTC); NULL: offset fijo de la tara
+    zero_tracker_params_t zero_params;
 } nivometro_t;
 
 // ==============================================================================
@@ -62,9 +81,17 @@ esp_err_t nivometro_calibrate_scale(nivometro_t *nivometro, float known_weight_g
 esp_err_t nivometro_tare_scale(nivometro_t *nivometro);
 void nivometro_power_down(nivometro_t *nivometro);
 void nivometro_power_up(nivometro_t *nivometro);
+void nivometro_set_hx711_samples(nivometro_t *nivometro, int samples);   // Profundidad de promediado del HX711
+void nivometro_set_temperature_source(nivometro_t *nivometro, nivometro_temp_fn_t fn, void *ctx);
+
+// Activa el seguimiento del cero con el estado indicado (en memoria RTC). Si el estado no corresponde
+// a la tara actual (primer arranque o nueva calibración) se reinicia desde su offset
+void nivometro_enable_zero_tracking(nivometro_t *nivometro, zero_tracker_t *state);
 
 // Funciones de utilidad
 const char* nivometro_get_sensor_status_string(uint8_t status);
+#define NIVOMETRO_SENSOR_ULTRASONIC  0      // Índices de sensor_status para nivometro_is_sensor_working
+#define NIVOMETRO_SENSOR_SCALE       1
 bool nivometro_is_sensor_working(uint8_t status, int sensor_index);
 
 // Función de conversión entre estructuras
@@ -78,7 +105,7 @@ void nivometro_data_to_sensor_data(const nivometro_data_t *src, sensor_data_t *d
  * Calibra el sensor HC-SR04P con distancia conocida configurable
  * @param nivometro Puntero al objeto nivómetro
  * @param known_distance_cm Distancia conocida en centímetros
- * @param samples Número de mediciones a promediar
+ * @param samples Máximo de mediciones; se para antes si la media converge
  * @param tolerance_percent Tolerancia máxima aceptable (%)
  * @return Factor de calibración calculado o 0.0f si falla
  */
@@ -87,6 +114,14 @@ float nivometro_calibrate_ultrasonic(nivometro_t *nivometro,
                                    int samples, 
                                    float tolerance_percent);
 
+/**
+ * Lee la balanza hasta que la media converge (calibración multipunto)
+ * @param nivometro Puntero al objeto nivómetro
+ * @param net_counts Media de las lecturas menos el offset de la tara
+ * @return ESP_OK si converge o agota el máximo de lecturas, ESP_ERR_INVALID_STATE si diverge
+ */
+esp_err_t nivometro_read_scale_converged(nivometro_t *nivometro, int32_t *net_counts);
+
 /**
  * Calibra el sensor HX711 con validación automática
  * @param nivometro Puntero al objeto nivómetro
@@ -0,0 +1,73 @@
+// File: components/nivometro_sensors/include/zero_tracker.h
+//
+// Seguimiento del cero de la balanza y compensación de su deriva térmica. El cero (bruto con la
+// placa vacía) se modela como una recta en la temperatura
+//   cero(T) = zero_mean + k·(T - temp_mean)
+// ajustada en el propio equipo por mínimos cuadrados con olvido exponencial sobre los pares
+// (temperatura, bruto) tomados con la placa vacía y quieta. Sin temperatura, o mientras no varíe lo
+// suficiente para estimar k, la recta es horizontal y queda un auto-cero que sigue despacio el bruto
+// en vacío. La corrección total respecto a la tara está acotada para que una carga lenta (nieve que
+// se asienta) no se confunda con deriva.
+//
+// El estado no depende del hardware y se guarda en memoria RTC para sobrevivir al deep sleep.
+
+#ifndef ZERO_TRACKER_H
+#define ZERO_TRACKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ZERO_TRACKER_MIN_POINTS   10          // Pares aprendidos antes de estimar la pendiente
+
+typedef struct {
+    float band_g;                   // |peso| máximo para considerar la placa vacía
+    float stable_g;                 // Diferencia máxima entre lecturas seguidas para considerarla quieta
+    uint32_t stable_samples;        // Lecturas quietas seguidas antes de aprender
+    uint32_t window;                // Memoria del ajuste en pares (olvido 1 - 1/window)
+    int32_t max_drift_counts;       // Corrección máxima respecto al offset de la tara
+    float min_temp_span_c;          // Desviación típica de T mínima para estimar la pendiente
+    float distance_band_cm;         // Si el ultrasonido se aleja más de la referencia hay nieve: no se aprende
+} zero_tracker_params_t;
+
+typedef struct {
+    bool valid;
+    int32_t tare_offset;            // Offset de la tara de la que parte el modelo
+    float ref_distance_cm;          // Distancia con la placa vacía (NAN hasta la primera lectura en vacío)
+    bool has_temp;                  // Hay pares con temperatura
+    double weight;                  // Suma de pesos con olvido
+    double temp_mean;
+    double zero_mean;
+    double var_t;                   // Momentos centrados con olvido
+    double cov_tz;
+    uint32_t updates;               // Pares aprendidos desde la tara
+    uint32_t stable_count;
+    float last_units;               // Lectura anterior (g) para medir la quietud
+    bool has_last;
+} zero_tracker_t;
+
+// Parámetros de menuconfig; max_drift_counts depende de la escala y lo fija quien lo usa
+void zero_tracker_default_params(zero_tracker_params_t *p, float counts_per_g);
+
+// Empieza de nuevo a partir del offset de una tara
+void zero_tracker_reset(zero_tracker_t *zt, int32_t tare_offset);
+
+// Cero estimado (cuentas) a la temperatura temp_c; NAN para no compensar la temperatura
+int32_t zero_tracker_offset(const zero_tracker_t *zt, const zero_tracker_params_t *p, float temp_c);
+
+// Pendiente térmica estimada (cuentas/°C); 0 mientras no hay datos suficientes
+double zero_tracker_temp_coeff(const zero_tracker_t *zt, const zero_tracker_params_t *p);
+
+// Procesa una lectura (bruto y su peso con el cero actual). distance_cm y temp_c a NAN si no hay.
+// Devuelve true si el par se ha usado para aprender
+bool zero_tracker_update(zero_tracker_t *zt, const zero_tracker_params_t *p, int32_t raw,
+                         float units_g, float temp_c, float distance_cm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
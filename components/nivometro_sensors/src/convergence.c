@@ -0,0 +1,75 @@
+// File: components/nivometro_sensors/src/convergence.c
+
+#include "convergence.h"
+#include <math.h>
+
+// Cuantiles t de Student al 97,5 % para 1..10 grados de libertad; por encima, 1,96 + 2,5/gl
+// (error < 1 % frente a la tabla)
+static const float t975[] = { 12.71f, 4.30f, 3.18f, 2.78f, 2.57f, 2.45f, 2.36f, 2.31f, 2.26f, 2.23f };
+
+static double t_quantile(uint32_t dof)
+{
+    if (dof == 0) return INFINITY;
+    if (dof <= sizeof(t975) / sizeof(t975[0])) return t975[dof - 1];
+    return 1.96 + 2.5 / dof;
+}
+
+void convergence_init(convergence_t *c)
+{
+    c->n = 0;
+    c->mean = 0.0;
+    c->m2 = 0.0;
+    c->state = CONVERGENCE_RUNNING;
+}
+
+double convergence_stddev(const convergence_t *c)
+{
+    return c->n > 1 ? sqrt(c->m2 / (c->n - 1)) : 0.0;
+}
+
+double convergence_half_width(const convergence_t *c)
+{
+    if (c->n < 2) return INFINITY;
+    return t_quantile(c->n - 1) * convergence_stddev(c) / sqrt((double)c->n);
+}
+
+convergence_state_t convergence_push(convergence_t *c, const convergence_params_t *p, double x)
+{
+    if (c->state != CONVERGENCE_RUNNING) {
+        return c->state;
+    }
+
+    c->n++;
+    double delta = x - c->mean;
+    c->mean += delta / c->n;
+    c->m2 += delta * (x - c->mean);
+
+    if ((int)c->n < p->min_samples || c->n < 2) {
+        return c->state;
+    }
+
+    double tolerance = fmax(p->abs_tolerance, p->rel_tolerance * fabs(c->mean - p->center));
+    if (convergence_half_width(c) <= tolerance) {
+        c->state = CONVERGENCE_DONE;
+    } else if ((int)c->n >= p->max_samples) {
+        c->state = CONVERGENCE_EXHAUSTED;
+    } else if (tolerance > 0.0) {
+        // Muestras que harían falta con la dispersión actual (t ~ 1,96 con muchas muestras)
+        double needed = pow(1.96 * convergence_stddev(c) / tolerance, 2.0);
+        if (needed > 4.0 * p->max_samples) {
+            c->state = CONVERGENCE_DIVERGED;
+        }
+    }
+    return c->state;
+}
+
+const char *convergence_state_name(convergence_state_t state)
+{
+    switch (state) {
+    case CONVERGENCE_RUNNING:   return "en curso";
+    case CONVERGENCE_DONE:      return "convergida";
+    case CONVERGENCE_EXHAUSTED: return "sin converger";
+    case CONVERGENCE_DIVERGED:  return "divergente";
+    }
+    return "?";
+}
@@ -1,9 +1,16 @@
 // File: components/nivometro_sensors/src/hcsr04p.c
 #include "hcsr04p.h"
+#include "esp_pm.h"
+#include "sdkconfig.h"
 
 #define HCSR04P_TIMEOUT_US 25000  // 25ms timeout
 #define SOUND_SPEED_CM_US 0.0343  // Velocidad del sonido en cm/us
 
+#ifdef CONFIG_PM_ENABLE
+// Sin light sleep ni cambio de frecuencia mientras se cronometra el eco
+static esp_pm_lock_handle_t hcsr04p_pm_lock = NULL;
+#endif
+
 bool hcsr04p_init(hcsr04p_sensor_t *sensor, int trigger_pin, int echo_pin) {
     if (sensor == NULL) {
         return false;
@@ -36,6 +43,12 @@ bool hcsr04p_init(hcsr04p_sensor_t *sensor, int trigger_pin, int echo_pin) {
     // Inicializar el trigger en nivel bajo
     gpio_set_level(trigger_pin, 0);
     
+#ifdef CONFIG_PM_ENABLE
+    if (hcsr04p_pm_lock == NULL) {
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "hcsr04p", &hcsr04p_pm_lock);
+    }
+#endif
+    
     return true;
 }
 
@@ -47,6 +60,10 @@ float hcsr04p_read_distance(hcsr04p_sensor_t *sensor) {
     int64_t echo_start, echo_end;
     float distance;
     
+#ifdef CONFIG_PM_ENABLE
+    if (hcsr04p_pm_lock) esp_pm_lock_acquire(hcsr04p_pm_lock);
+#endif
+    
     // Enviar pulso de trigger (10us)
     gpio_set_level(sensor->trigger_pin, 0);
     esp_rom_delay_us(2);
@@ -56,21 +73,31 @@ float hcsr04p_read_distance(hcsr04p_sensor_t *sensor) {
     
     // Esperar a que el pin echo se active (nivel alto)
     int64_t start_time = esp_timer_get_time();
+    bool timeout = false;
     while (gpio_get_level(sensor->echo_pin) == 0) {
         if (esp_timer_get_time() - start_time > HCSR04P_TIMEOUT_US) {
-            return -1; // Timeout - sensor posiblemente desconectado
+            timeout = true; // Timeout - sensor posiblemente desconectado
+            break;
         }
     }
     echo_start = esp_timer_get_time();
     
     // Esperar a que el pin echo se desactive (nivel bajo)
-    while (gpio_get_level(sensor->echo_pin) == 1) {
+    while (!timeout && gpio_get_level(sensor->echo_pin) == 1) {
         if (esp_timer_get_time() - echo_start > HCSR04P_TIMEOUT_US) {
-            return -1; // Timeout - objeto demasiado lejos o error de lectura
+            timeout = true; // Timeout - objeto demasiado lejos o error de lectura
         }
     }
     echo_end = esp_timer_get_time();
     
+#ifdef CONFIG_PM_ENABLE
+    if (hcsr04p_pm_lock) esp_pm_lock_release(hcsr04p_pm_lock);
+#endif
+    
+    if (timeout) {
+        return -1;
+    }
+    
     // Calcular la distancia
     float echo_duration = (echo_end - echo_start);
     distance = (echo_duration * SOUND_SPEED_CM_US) / 2.0;
@@ -2,9 +2,33 @@
 
 #include "hx711.h"
 #include "esp_rom_sys.h"  
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "sdkconfig.h"
+#include "metrics.h"
+#include <math.h>
 
 static const char *TAG = "HX711";
 
+#ifdef CONFIG_PM_ENABLE
+// Bloqueo de frecuencia máxima solo durante el bit-bang: fuera de él la CPU puede bajar de frecuencia y dormir
+static esp_pm_lock_handle_t hx711_pm_lock = NULL;
+#endif
+
+static void hx711_pm_acquire(void)
+{
+#ifdef CONFIG_PM_ENABLE
+    if (hx711_pm_lock) esp_pm_lock_acquire(hx711_pm_lock);
+#endif
+}
+
+static void hx711_pm_release(void)
+{
+#ifdef CONFIG_PM_ENABLE
+    if (hx711_pm_lock) esp_pm_lock_release(hx711_pm_lock);
+#endif
+}
+
 // Función privada para leer un bit
 static inline bool hx711_read_bit(hx711_t *dev)
 {
@@ -17,19 +41,21 @@ static inline bool hx711_read_bit(hx711_t *dev)
 }
 
 // Función privada para esperar a que el sensor esté listo
+// Cede la CPU entre comprobaciones (un tick) en lugar de esperar activamente, para permitir el light sleep
 static esp_err_t hx711_wait_ready(hx711_t *dev, int timeout_ms)
 {
-    int timeout_us = timeout_ms * 1000;
-    int elapsed_us = 0;
+    int64_t start_us = esp_timer_get_time();
+    int64_t deadline_us = start_us + (int64_t)timeout_ms * 1000;
     
     while (gpio_get_level(dev->dout_pin) == 1) {
-        if (elapsed_us >= timeout_us) {
+        if (esp_timer_get_time() >= deadline_us) {
+            metrics_histogram_record(METRIC_HX711_WAIT_MS, (uint32_t)timeout_ms);
             return ESP_ERR_TIMEOUT;
         }
-        esp_rom_delay_us(100);
-        elapsed_us += 100;
+        vTaskDelay(1);
     }
     
+    metrics_histogram_record(METRIC_HX711_WAIT_MS, (uint32_t)((esp_timer_get_time() - start_us) / 1000));
     return ESP_OK;
 }
 
@@ -47,6 +73,7 @@ esp_err_t hx711_init(hx711_t *dev, const hx711_config_t *config)
     dev->scale = 1.0f;
     dev->is_ready = false;
     dev->reading_index = 0;
+    dev->lut.valid = false;
     
     // Limpiar historial de lecturas
     memset(dev->last_readings, 0, sizeof(dev->last_readings));
@@ -84,6 +111,15 @@ esp_err_t hx711_init(hx711_t *dev, const hx711_config_t *config)
     // Inicializar SCK en LOW
     gpio_set_level(dev->sck_pin, 0);
     
+#ifdef CONFIG_PM_ENABLE
+    if (hx711_pm_lock == NULL) {
+        ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "hx711", &hx711_pm_lock);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "No se pudo crear el bloqueo de energía: %s", esp_err_to_name(ret));
+        }
+    }
+#endif
+    
     // Esperar estabilización
     vTaskDelay(pdMS_TO_TICKS(HX711_STABILIZE_TIME_MS));
     
@@ -204,6 +240,9 @@ esp_err_t hx711_read_raw(hx711_t *dev, int32_t *raw_value)
     // Leer 24 bits de datos
     uint32_t value = 0;
     
+    // Frecuencia fija durante el bit-bang (los delays en us dependen de ella)
+    hx711_pm_acquire();
+    
     // Deshabilitar interrupciones durante la lectura crítica
     portDISABLE_INTERRUPTS();
     
@@ -223,6 +262,7 @@ esp_err_t hx711_read_raw(hx711_t *dev, int32_t *raw_value)
     }
     
     portENABLE_INTERRUPTS();
+    hx711_pm_release();
 
     // Convertir a valor con signo (complemento a 2)
     if (value & 0x800000) {
@@ -310,6 +350,7 @@ esp_err_t hx711_calibrate(hx711_t *dev, float known_weight, int samples)
         float net_value = (float)(avg_value - dev->offset);
         if (net_value != 0) {
             dev->scale = net_value / known_weight;
+            dev->lut.valid = false;         // La tabla anterior ya no corresponde a esta escala
             ESP_LOGI(TAG, "Calibración completada. Escala: %.2f", dev->scale);
         } else {
             ESP_LOGE(TAG, "Error en calibración: valor neto es cero");
@@ -322,6 +363,77 @@ esp_err_t hx711_calibrate(hx711_t *dev, float known_weight, int samples)
     return ret;
 }
 
+esp_err_t hx711_read_converged(hx711_t *dev, const convergence_params_t *p, convergence_t *stats)
+{
+    if (!dev || !p || !stats || p->max_samples <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    convergence_init(stats);
+    int failures = 0;
+    // Sin pausa entre lecturas: hx711_read_raw ya espera a DOUT, que marca el ritmo del conversor
+    while (stats->state == CONVERGENCE_RUNNING) {
+        int32_t raw_value;
+        if (hx711_read_raw(dev, &raw_value) != ESP_OK || raw_value == INT32_MIN) {
+            if (++failures > p->max_samples / 2) {
+                ESP_LOGE(TAG, "Demasiadas lecturas fallidas (%d)", failures);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            continue;
+        }
+        convergence_push(stats, p, (double)raw_value);
+    }
+
+    ESP_LOGI(TAG, "Media %.1f ± %.1f cuentas (IC 95%%) con %lu lecturas: %s", stats->mean,
+             convergence_half_width(stats), (unsigned long)stats->n, convergence_state_name(stats->state));
+    if (stats->state == CONVERGENCE_DIVERGED) {
+        ESP_LOGE(TAG, "Lecturas demasiado dispersas (desviación %.1f cuentas): ¿la carga está quieta?",
+                 convergence_stddev(stats));
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (stats->state == CONVERGENCE_EXHAUSTED) {
+        ESP_LOGW(TAG, "Máximo de %d lecturas alcanzado sin llegar a la tolerancia", p->max_samples);
+    }
+    return ESP_OK;
+}
+
+esp_err_t hx711_tare_converged(hx711_t *dev, const convergence_params_t *p)
+{
+    convergence_t stats;
+    esp_err_t ret = hx711_read_converged(dev, p, &stats);
+    if (ret == ESP_OK) {
+        dev->offset = (int32_t)lround(stats.mean);
+        ESP_LOGI(TAG, "Tara completada. Offset: %ld", (long)dev->offset);
+    }
+    return ret;
+}
+
+esp_err_t hx711_calibrate_converged(hx711_t *dev, float known_weight, const convergence_params_t *p)
+{
+    if (!dev || known_weight <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGI(TAG, "Calibrando con peso conocido: %.2f g", known_weight);
+    convergence_params_t params = *p;
+    params.center = dev->offset;                // La tolerancia relativa es sobre el valor neto
+
+    convergence_t stats;
+    esp_err_t ret = hx711_read_converged(dev, &params, &stats);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    double net_value = stats.mean - dev->offset;
+    if (net_value == 0) {
+        ESP_LOGE(TAG, "Error en calibración: valor neto es cero");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    dev->scale = (float)(net_value / known_weight);
+    dev->lut.valid = false;
+    ESP_LOGI(TAG, "Calibración completada. Escala: %.2f", dev->scale);
+    return ESP_OK;
+}
+
 esp_err_t hx711_read_units(hx711_t *dev, float *units)
 {
     if (!dev || !units) {
@@ -332,7 +444,7 @@ esp_err_t hx711_read_units(hx711_t *dev, float *units)
     esp_err_t ret = hx711_read_raw(dev, &raw_value);
     
     if (ret == ESP_OK && raw_value != INT32_MIN) {
-        *units = (float)(raw_value - dev->offset) / dev->scale;
+        *units = hx711_net_to_units(dev, raw_value - dev->offset);
     } else {
         *units = 0.0f;
     }
@@ -350,7 +462,7 @@ esp_err_t hx711_read_units_average(hx711_t *dev, float *units, int samples)
     esp_err_t ret = hx711_read_average(dev, &avg_raw, samples);
     
     if (ret == ESP_OK) {
-        *units = (float)(avg_raw - dev->offset) / dev->scale;
+        *units = hx711_net_to_units(dev, avg_raw - dev->offset);
     } else {
         *units = 0.0f;
     }
@@ -370,6 +482,7 @@ void hx711_debug_info(hx711_t *dev)
     ESP_LOGI(TAG, "Offset: %ld", (long)dev->offset);
     ESP_LOGI(TAG, "Scale: %f", dev->scale);
     ESP_LOGI(TAG, "Gain: %d", dev->gain);
+    ESP_LOGI(TAG, "Tabla de conversión: %s", dev->lut.valid ? "activa" : "no (offset/scale)");
     ESP_LOGI(TAG, "Sensor Ready: %s", hx711_is_ready(dev) ? "YES" : "NO");
     ESP_LOGI(TAG, "Lecturas RAW recientes:");
     
@@ -380,4 +493,143 @@ void hx711_debug_info(hx711_t *dev)
             vTaskDelay(pdMS_TO_TICKS(100));
         }
     }
-}
\ No newline at end of file
+}
+
+// Mínimos cuadrados por ecuaciones normales. x se normaliza por el máximo |x| para que la matriz
+// quede bien condicionada con cuentas del orden de 10^6 elevadas al cuadrado.
+esp_err_t hx711_fit_curve(const int32_t *net_counts, const float *weights_g, int count, int order,
+                          float coef[HX711_CURVE_MAX_ORDER + 1], float *rms_g)
+{
+    if (!net_counts || !weights_g || !coef || order < 1 || order > HX711_CURVE_MAX_ORDER || count <= order) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    double norm = 0.0;
+    for (int i = 0; i < count; i++) {
+        double ax = fabs((double)net_counts[i]);
+        if (ax > norm) norm = ax;
+    }
+    if (norm == 0.0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Matriz aumentada [A^T·A | A^T·w]
+    const int n = order + 1;
+    double m[HX711_CURVE_MAX_ORDER + 1][HX711_CURVE_MAX_ORDER + 2] = {{0}};
+    for (int i = 0; i < count; i++) {
+        double u = net_counts[i] / norm;
+        double pw[HX711_CURVE_MAX_ORDER + 1] = { 1.0, u, u * u };
+        for (int r = 0; r < n; r++) {
+            for (int c = 0; c < n; c++) m[r][c] += pw[r] * pw[c];
+            m[r][n] += pw[r] * weights_g[i];
+        }
+    }
+
+    // Eliminación gaussiana con pivote parcial
+    for (int col = 0; col < n; col++) {
+        int piv = col;
+        for (int r = col + 1; r < n; r++) {
+            if (fabs(m[r][col]) > fabs(m[piv][col])) piv = r;
+        }
+        if (fabs(m[piv][col]) < 1e-12) {
+            ESP_LOGE(TAG, "Ajuste singular: puntos de referencia insuficientes o repetidos");
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (piv != col) {
+            for (int c = 0; c <= n; c++) {
+                double tmp = m[col][c];
+                m[col][c] = m[piv][c];
+                m[piv][c] = tmp;
+            }
+        }
+        for (int r = col + 1; r < n; r++) {
+            double f = m[r][col] / m[col][col];
+            for (int c = col; c <= n; c++) m[r][c] -= f * m[col][c];
+        }
+    }
+    double a[HX711_CURVE_MAX_ORDER + 1] = { 0 };
+    for (int r = n - 1; r >= 0; r--) {
+        double acc = m[r][n];
+        for (int c = r + 1; c < n; c++) acc -= m[r][c] * a[c];
+        a[r] = acc / m[r][r];
+    }
+
+    // Deshacer la normalización
+    coef[0] = (float)a[0];
+    coef[1] = (float)(a[1] / norm);
+    coef[2] = (float)(a[2] / (norm * norm));
+
+    double sq = 0.0;
+    for (int i = 0; i < count; i++) {
+        double x = net_counts[i];
+        double e = coef[0] + coef[1] * x + coef[2] * x * x - weights_g[i];
+        sq += e * e;
+    }
+    if (rms_g) *rms_g = (float)sqrt(sq / count);
+
+    ESP_LOGI(TAG, "Ajuste de orden %d con %d puntos: c0=%.4f c1=%.6e c2=%.6e", order, count,
+             coef[0], coef[1], coef[2]);
+    return ESP_OK;
+}
+
+esp_err_t hx711_set_curve(hx711_t *dev, const float coef[HX711_CURVE_MAX_ORDER + 1], int32_t net_min, int32_t net_max)
+{
+    if (!dev || !coef || net_max < net_min) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Anchura de tramo: la menor potencia de dos con la que HX711_LUT_SEGMENTS tramos cubren el rango
+    int64_t span = (int64_t)net_max - net_min;
+    uint8_t shift = 0;
+    while (shift < 31 && ((int64_t)HX711_LUT_SEGMENTS << shift) <= span) {
+        shift++;
+    }
+
+    hx711_lut_t *lut = &dev->lut;
+    lut->valid = false;
+    lut->shift = shift;
+    lut->x0 = net_min;
+    for (int i = 0; i < HX711_LUT_SEGMENTS; i++) {
+        double xa = (double)net_min + (double)((int64_t)i << shift);
+        double xb = xa + (double)((int64_t)1 << shift);
+        double ya = (coef[0] + coef[1] * xa + coef[2] * xa * xa) * 1000.0;    // mg
+        double yb = (coef[0] + coef[1] * xb + coef[2] * xb * xb) * 1000.0;
+        double slope = (yb - ya) / (double)((int64_t)1 << shift) * 65536.0;
+        if (fabs(ya) > INT32_MAX || fabs(slope) > INT32_MAX) {
+            ESP_LOGE(TAG, "Curva fuera del rango de la tabla en coma fija (tramo %d)", i);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        lut->base_mg[i] = (int32_t)lround(ya);
+        lut->slope_q16[i] = (int32_t)lround(slope);
+    }
+    lut->valid = true;
+
+    ESP_LOGI(TAG, "Tabla de conversión: %d tramos de %ld cuentas desde %ld", HX711_LUT_SEGMENTS,
+             (long)(1L << shift), (long)net_min);
+    return ESP_OK;
+}
+
+void hx711_clear_curve(hx711_t *dev)
+{
+    if (dev) {
+        dev->lut.valid = false;
+    }
+}
+
+float hx711_net_to_units(const hx711_t *dev, int32_t net)
+{
+    const hx711_lut_t *lut = &dev->lut;
+    if (!lut->valid) {
+        return (float)net / dev->scale;
+    }
+
+    int64_t dx = (int64_t)net - lut->x0;
+    int idx = 0;
+    if (dx > 0) {
+        idx = (int)(dx >> lut->shift);
+        if (idx >= HX711_LUT_SEGMENTS) idx = HX711_LUT_SEGMENTS - 1;
+        dx -= (int64_t)idx << lut->shift;
+    }
+    int64_t mg = lut->base_mg[idx] + ((dx * lut->slope_q16[idx]) >> 16);
+    return (float)mg * 0.001f;
+}
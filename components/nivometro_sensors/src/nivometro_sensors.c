@@ -3,6 +3,8 @@
 #include "nivometro_sensors.h"
 #include "sdkconfig.h"
 #include "esp_timer.h"
+#define DLOG_LOCAL_LEVEL CONFIG_DLOG_LEVEL_SENSORS
+#include "dlog.h"
 #include <string.h>
 #include <math.h>
 
@@ -19,6 +21,10 @@ esp_err_t nivometro_init(nivometro_t *nivometro, const nivometro_config_t *confi
     
     memcpy(&nivometro->config, config, sizeof(nivometro_config_t));
     nivometro->initialized = false;
+    nivometro->hx711_samples = 1;
+    nivometro->temp_fn = NULL;
+    nivometro->temp_ctx = NULL;
+    nivometro->zero = NULL;
     
     ESP_LOGI(TAG, "Inicializando sensores del nivómetro...");
     
@@ -60,6 +66,9 @@ esp_err_t nivometro_read_all_sensors(nivometro_t *nivometro, nivometro_data_t *d
     data->timestamp_us = esp_timer_get_time();
     data->sensor_status = 0;
     
+    // Temperatura para compensar la deriva de la balanza
+    float temp_c = nivometro->temp_fn ? nivometro->temp_fn(nivometro->temp_ctx) : NAN;
+    
     // Leer HC-SR04P
     data->ultrasonic_distance_cm = hcsr04p_read_distance(&nivometro->ultrasonic);
     if (data->ultrasonic_distance_cm >= 0) {
@@ -70,57 +79,82 @@ esp_err_t nivometro_read_all_sensors(nivometro_t *nivometro, nivometro_data_t *d
     bool hx711_ready = hx711_is_ready(&nivometro->scale);
     
     if (!hx711_ready) {
-        ESP_LOGD(TAG, "HX711 no listo, reactivando...");
+        DLOGD(TAG, "HX711 no listo, reactivando...");
         hx711_power_up(&nivometro->scale);
         vTaskDelay(pdMS_TO_TICKS(200));
         hx711_ready = hx711_is_ready(&nivometro->scale);
     }
     
     if (hx711_ready) {
-        float weight_units = 0;
+        int32_t raw = 0;
         esp_err_t read_result = ESP_FAIL;
         
         // Intentar hasta 3 veces
         for (int attempt = 0; attempt < 3 && read_result != ESP_OK; attempt++) {
-            read_result = hx711_read_units(&nivometro->scale, &weight_units);
+            if (nivometro->hx711_samples > 1) {
+                read_result = hx711_read_average(&nivometro->scale, &raw, nivometro->hx711_samples);
+            } else {
+                read_result = hx711_read_raw(&nivometro->scale, &raw);
+                if (read_result == ESP_OK && raw == INT32_MIN) {
+                    read_result = ESP_ERR_INVALID_RESPONSE;
+                }
+            }
             if (read_result != ESP_OK) {
                 vTaskDelay(pdMS_TO_TICKS(100));
             }
         }
         
         if (read_result == ESP_OK) {
-            data->weight_grams = weight_units;
+            // Offset de la tara o, con seguimiento, el cero estimado a la temperatura actual
+            zero_tracker_t *zero = nivometro->zero;
+            int32_t offset = zero ? zero_tracker_offset(zero, &nivometro->zero_params, temp_c)
+                                  : nivometro->scale.offset;
+            data->weight_grams = hx711_net_to_units(&nivometro->scale, raw - offset);
+            if (zero) {
+                float distance = data->ultrasonic_distance_cm >= 0 ? data->ultrasonic_distance_cm : NAN;
+                zero_tracker_update(zero, &nivometro->zero_params, raw, data->weight_grams, temp_c, distance);
+            }
             data->sensor_status |= 0x02; // Bit 1 = HX711 OK
         } else {
             data->weight_grams = 0.0f;
-            ESP_LOGW(TAG, "Error leyendo HX711 tras 3 intentos");
+            DLOGW(TAG, "Error leyendo HX711 tras 3 intentos");
         }
     } else {
         data->weight_grams = 0.0f;
-        ESP_LOGW(TAG, "HX711 no responde");
+        DLOGW(TAG, "HX711 no responde");
     }
    
-    // Datos adicionales (estimados por ahora)
-    data->battery_voltage = 3.7f; // TODO: Implementar lectura real
-    data->temperature_c = 20;     // TODO: Implementar sensor temperatura
+    // Datos adicionales
+    data->battery_voltage = 0.0f; // La rellena tasks con la medida del ADC de power_manager
+    data->temperature_c = isnan(temp_c) ? 20 : (int8_t)lroundf(temp_c);   // Sin sensor, el valor fijo de siempre
     
-    ESP_LOGD(TAG, "Sensores leídos - Ultrasonido: %.2f cm, Peso: %.2f g", 
+    DLOGD(TAG, "Sensores leídos - Ultrasonido: %.2f cm, Peso: %.2f g", 
              data->ultrasonic_distance_cm, data->weight_grams);
     
     return ESP_OK;
 }
 
+// Parada anticipada de las calibraciones con los parámetros de menuconfig
+static void calibration_convergence_params(convergence_params_t *p, int max_samples, double abs_tolerance) {
+    p->min_samples = CONFIG_CALIBRATION_MIN_SAMPLES;
+    p->max_samples = max_samples;
+    p->center = 0.0;
+    p->rel_tolerance = CONFIG_CALIBRATION_CONVERGENCE_PERMILLE / 1000.0f;
+    p->abs_tolerance = abs_tolerance;
+}
+
 esp_err_t nivometro_calibrate_scale(nivometro_t *nivometro, float known_weight_g) {
     if (!nivometro || !nivometro->initialized) {
         return ESP_ERR_INVALID_ARG;
     }
     
     ESP_LOGI(TAG, "Calibrando balanza con peso conocido: %.2f g", known_weight_g);
-    // Usar número de muestras configurado en menuconfig
-    esp_err_t result = hx711_calibrate(&nivometro->scale, known_weight_g, CONFIG_CALIBRATION_HX711_SAMPLES);
+    // Hasta CONFIG_CALIBRATION_HX711_SAMPLES lecturas, menos si la media converge antes
+    convergence_params_t params;
+    calibration_convergence_params(&params, CONFIG_CALIBRATION_HX711_SAMPLES, 0.0);
+    esp_err_t result = hx711_calibrate_converged(&nivometro->scale, known_weight_g, &params);
     if (result == ESP_OK) {
         ESP_LOGI(TAG, "Calibración de balanza completada. Factor: %.2f", nivometro->scale.scale);
-        ESP_LOGI(TAG, "Muestras utilizadas: %d", CONFIG_CALIBRATION_HX711_SAMPLES);
     } else {
         ESP_LOGE(TAG, "Error en calibración: %s", esp_err_to_name(result));
     }
@@ -134,11 +168,16 @@ esp_err_t nivometro_tare_scale(nivometro_t *nivometro) {
     }
     
     ESP_LOGI(TAG, "Realizando tara de la balanza...");
-    // Usar número de muestras configurado en menuconfig para tara también
-    esp_err_t result = hx711_tare(&nivometro->scale, CONFIG_CALIBRATION_HX711_SAMPLES);
+    // En vacío la tolerancia es absoluta: el valor neto es ~0 y una relativa no tendría sentido
+    convergence_params_t params;
+    calibration_convergence_params(&params, CONFIG_CALIBRATION_HX711_SAMPLES, CONFIG_CALIBRATION_HX711_TARE_CI_COUNTS);
+    params.rel_tolerance = 0.0f;
+    esp_err_t result = hx711_tare_converged(&nivometro->scale, &params);
     if (result == ESP_OK) {
         ESP_LOGI(TAG, "Tara completada. Offset: %ld", nivometro->scale.offset);
-        ESP_LOGI(TAG, "Muestras utilizadas: %d", CONFIG_CALIBRATION_HX711_SAMPLES);
+        if (nivometro->zero) {
+            zero_tracker_reset(nivometro->zero, nivometro->scale.offset);
+        }
     } else {
         ESP_LOGE(TAG, "Error en tara: %s", esp_err_to_name(result));
     }
@@ -146,6 +185,22 @@ esp_err_t nivometro_tare_scale(nivometro_t *nivometro) {
     return result;
 }
 
+esp_err_t nivometro_read_scale_converged(nivometro_t *nivometro, int32_t *net_counts) {
+    if (!nivometro || !nivometro->initialized || !net_counts) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    convergence_params_t params;
+    calibration_convergence_params(&params, CONFIG_CALIBRATION_HX711_SAMPLES, CONFIG_CALIBRATION_HX711_TARE_CI_COUNTS);
+    params.center = nivometro->scale.offset;
+    convergence_t stats;
+    esp_err_t result = hx711_read_converged(&nivometro->scale, &params, &stats);
+    if (result == ESP_OK) {
+        *net_counts = (int32_t)lround(stats.mean - nivometro->scale.offset);
+    }
+    return result;
+}
+
 void nivometro_power_down(nivometro_t *nivometro) {
     if (nivometro && nivometro->initialized) {
         hx711_power_down(&nivometro->scale);
@@ -160,6 +215,37 @@ void nivometro_power_up(nivometro_t *nivometro) {
     }
 }
 
+void nivometro_set_hx711_samples(nivometro_t *nivometro, int samples) {
+    if (nivometro && samples > 0) {
+        nivometro->hx711_samples = samples;
+    }
+}
+
+void nivometro_set_temperature_source(nivometro_t *nivometro, nivometro_temp_fn_t fn, void *ctx) {
+    if (nivometro) {
+        nivometro->temp_fn = fn;
+        nivometro->temp_ctx = ctx;
+    }
+}
+
+void nivometro_enable_zero_tracking(nivometro_t *nivometro, zero_tracker_t *state) {
+    if (!nivometro) {
+        return;
+    }
+    nivometro->zero = state;
+    if (!state) {
+        return;
+    }
+    zero_tracker_default_params(&nivometro->zero_params, nivometro->scale.scale);
+    if (!state->valid || state->tare_offset != nivometro->scale.offset) {
+        zero_tracker_reset(state, nivometro->scale.offset);
+        DLOGI(TAG, "Seguimiento del cero desde la tara (offset %ld)", (long)nivometro->scale.offset);
+    } else {
+        DLOGI(TAG, "Seguimiento del cero: %lu lecturas en vacío, pendiente %.1f cuentas/°C",
+              (unsigned long)state->updates, zero_tracker_temp_coeff(state, &nivometro->zero_params));
+    }
+}
+
 const char* nivometro_get_sensor_status_string(uint8_t status) {
     static char status_str[64];
     snprintf(status_str, sizeof(status_str), "HC-SR04P:%s HX711:%s",
@@ -181,6 +267,15 @@ void nivometro_data_to_sensor_data(const nivometro_data_t *src, sensor_data_t *d
     dst->sensor_status = src->sensor_status;
     dst->battery_voltage = src->battery_voltage;
     dst->temperature_c = (int)src->temperature_c;
+    dst->snow_event = false;
+    dst->epoch_s = 0;
+    dst->depth_filt_cm = 0.0f;
+    dst->depth_rate_cm_h = 0.0f;
+    dst->swe_filt_mm = 0.0f;
+    dst->swe_rate_mm_h = 0.0f;
+    dst->depth_nis = NAN;
+    dst->swe_nis = NAN;
+    dst->filter_flags = 0;
 }
 
 // ==============================================================================
@@ -196,27 +291,38 @@ float nivometro_calibrate_ultrasonic(nivometro_t *nivometro,
         return 0.0f;
     }
     
-    float total_distance = 0;
-    int valid_samples = 0;
+    int invalid_samples = 0;
+    convergence_params_t params;
+    convergence_t stats;
+    calibration_convergence_params(&params, samples, 0.0);
+    convergence_init(&stats);
     
     ESP_LOGI(TAG, "Calibrando HC-SR04P con distancia conocida: %.1f cm", known_distance_cm);
-    ESP_LOGI(TAG, "Tomando %d mediciones (tolerancia: ±%.1f%%)...", samples, tolerance_percent);
+    ESP_LOGI(TAG, "Hasta %d mediciones (tolerancia: ±%.1f%%)...", samples, tolerance_percent);
     
-    for (int i = 0; i < samples; i++) {
+    // Al ritmo máximo del sensor hasta que la media converja; se abandona si falla la mitad
+    while (stats.state == CONVERGENCE_RUNNING && invalid_samples <= samples / 2) {
         float distance = hcsr04p_read_distance(&nivometro->ultrasonic);
         if (distance > 0) {  // Medición válida
-            total_distance += distance;
-            valid_samples++;
-            ESP_LOGI(TAG, "Medición %d/%d: %.2f cm", i + 1, samples, distance);
+            convergence_push(&stats, &params, distance);
+            ESP_LOGD(TAG, "Medición %lu: %.2f cm", (unsigned long)stats.n, distance);
         } else {
-            ESP_LOGW(TAG, "Medición %d/%d: inválida", i + 1, samples);
+            invalid_samples++;
+            ESP_LOGW(TAG, "Medición inválida (%d)", invalid_samples);
         }
-        vTaskDelay(pdMS_TO_TICKS(500));
+        vTaskDelay(pdMS_TO_TICKS(HCSR04P_MIN_CYCLE_MS));
     }
     
-    if (valid_samples >= (samples / 2)) {  // Al menos 50% de mediciones válidas
-        float average_measured = total_distance / valid_samples;
-        ESP_LOGI(TAG, "Promedio de %d mediciones válidas: %.2f cm", valid_samples, average_measured);
+    if (stats.state == CONVERGENCE_DIVERGED) {
+        ESP_LOGE(TAG, "Mediciones demasiado dispersas (desviación %.2f cm): revisa el objeto de referencia",
+                 convergence_stddev(&stats));
+        return 0.0f;
+    }
+    
+    if (invalid_samples <= samples / 2 && stats.n > 0) {  // Al menos 50% de mediciones válidas
+        float average_measured = (float)stats.mean;
+        ESP_LOGI(TAG, "Promedio de %lu mediciones válidas: %.2f ± %.2f cm (%s)", (unsigned long)stats.n,
+                 average_measured, convergence_half_width(&stats), convergence_state_name(stats.state));
         
         // Calcular factor de calibración
         float current_factor = nivometro->ultrasonic.calibration_factor;
@@ -252,7 +358,7 @@ float nivometro_calibrate_ultrasonic(nivometro_t *nivometro,
             return current_factor;
         }
     } else {
-        ESP_LOGE(TAG, "Mediciones insuficientes: %d/%d válidas", valid_samples, samples);
+        ESP_LOGE(TAG, "Mediciones insuficientes: %d inválidas", invalid_samples);
         return 0.0f;
     }
 }
@@ -267,7 +373,7 @@ esp_err_t nivometro_calibrate_scale_with_validation(nivometro_t *nivometro,
     ESP_LOGI(TAG, "Calibrando HX711 con validación automática");
     ESP_LOGI(TAG, "Peso conocido: %.1f g", known_weight_g);
     ESP_LOGI(TAG, "Tolerancia: ±%.1f%%", tolerance_percent);
-    ESP_LOGI(TAG, "Muestras: %d", CONFIG_CALIBRATION_HX711_SAMPLES);
+    ESP_LOGI(TAG, "Muestras: hasta %d", CONFIG_CALIBRATION_HX711_SAMPLES);
     
     // Realizar calibración usando parámetros de menuconfig
     esp_err_t cal_result = nivometro_calibrate_scale(nivometro, known_weight_g);
@@ -378,9 +484,14 @@ esp_err_t nivometro_apply_calibration_factors(nivometro_t *nivometro,
     // Aplicar calibración HC-SR04P
     hcsr04p_set_calibration(&nivometro->ultrasonic, hcsr04p_factor);
     
-    // Aplicar calibración HX711
+    // Aplicar calibración HX711 (modelo lineal evaluado también con la tabla en coma fija)
     nivometro->scale.scale = hx711_scale;
     nivometro->scale.offset = hx711_offset;
+    hx711_clear_curve(&nivometro->scale);
+    if (hx711_scale != 0.0f) {
+        const float linear[HX711_CURVE_MAX_ORDER + 1] = { 0.0f, 1.0f / hx711_scale, 0.0f };
+        hx711_set_curve(&nivometro->scale, linear, HX711_RAW_MIN, HX711_RAW_MAX);
+    }
     
     ESP_LOGI(TAG, "Factores de calibración aplicados");
     return ESP_OK;
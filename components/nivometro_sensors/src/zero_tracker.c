@@ -0,0 +1,97 @@
+// File: components/nivometro_sensors/src/zero_tracker.c
+
+#include "zero_tracker.h"
+#include "sdkconfig.h"
+#include <math.h>
+
+void zero_tracker_default_params(zero_tracker_params_t *p, float counts_per_g)
+{
+    p->band_g           = (float)CONFIG_HX711_ZERO_BAND_G;
+    p->stable_g         = (float)CONFIG_HX711_ZERO_STABLE_G;
+    p->stable_samples   = CONFIG_HX711_ZERO_STABLE_SAMPLES;
+    p->window           = CONFIG_HX711_ZERO_WINDOW;
+    p->max_drift_counts = (int32_t)lroundf(CONFIG_HX711_ZERO_MAX_DRIFT_G * fabsf(counts_per_g));
+    p->min_temp_span_c  = CONFIG_HX711_TEMPCO_MIN_SPAN_DC / 10.0f;
+    p->distance_band_cm = CONFIG_HX711_ZERO_DISTANCE_BAND_MM / 10.0f;
+}
+
+void zero_tracker_reset(zero_tracker_t *zt, int32_t tare_offset)
+{
+    // La tara cuenta como el primer par: el cero empieza en su offset
+    *zt = (zero_tracker_t){
+        .valid = true,
+        .tare_offset = tare_offset,
+        .ref_distance_cm = NAN,
+        .weight = 1.0,
+        .zero_mean = tare_offset,
+    };
+}
+
+double zero_tracker_temp_coeff(const zero_tracker_t *zt, const zero_tracker_params_t *p)
+{
+    if (!zt->valid || !zt->has_temp || zt->updates < ZERO_TRACKER_MIN_POINTS) return 0.0;
+    // Con poca variación de temperatura la pendiente sería casi todo ruido
+    double span2 = (double)p->min_temp_span_c * p->min_temp_span_c;
+    if (zt->var_t <= 0.0 || zt->var_t / zt->weight < span2) return 0.0;
+    return zt->cov_tz / zt->var_t;
+}
+
+int32_t zero_tracker_offset(const zero_tracker_t *zt, const zero_tracker_params_t *p, float temp_c)
+{
+    if (!zt->valid) return 0;
+    double zero = zt->zero_mean;
+    if (!isnan(temp_c) && zt->has_temp) {
+        zero += zero_tracker_temp_coeff(zt, p) * (temp_c - zt->temp_mean);
+    }
+    double lo = (double)zt->tare_offset - p->max_drift_counts;
+    double hi = (double)zt->tare_offset + p->max_drift_counts;
+    if (zero < lo) zero = lo;
+    if (zero > hi) zero = hi;
+    return (int32_t)lround(zero);
+}
+
+bool zero_tracker_update(zero_tracker_t *zt, const zero_tracker_params_t *p, int32_t raw,
+                         float units_g, float temp_c, float distance_cm)
+{
+    if (!zt->valid) return false;
+
+    bool quiet = zt->has_last && fabsf(units_g - zt->last_units) <= p->stable_g;
+    zt->last_units = units_g;
+    zt->has_last = true;
+    zt->stable_count = quiet ? zt->stable_count + 1 : 0;
+
+    if (fabsf(units_g) > p->band_g || zt->stable_count < p->stable_samples) return false;
+
+    // Placa vacía según la balanza: la primera vez fija la distancia de referencia; después, si el
+    // ultrasonido ve nieve, el peso cerca de cero es deriva acumulada y no se aprende de él
+    if (!isnan(distance_cm)) {
+        if (isnan(zt->ref_distance_cm)) {
+            zt->ref_distance_cm = distance_cm;
+        } else if (fabsf(distance_cm - zt->ref_distance_cm) > p->distance_band_cm) {
+            return false;
+        }
+    }
+
+    // Mínimos cuadrados con olvido exponencial (Welford ponderado)
+    double lambda = p->window > 1 ? 1.0 - 1.0 / p->window : 0.0;
+    zt->weight = lambda * zt->weight + 1.0;
+    double dz = raw - zt->zero_mean;
+    if (!isnan(temp_c)) {
+        if (!zt->has_temp) {
+            // Primera temperatura: la recta parte de aquí
+            zt->has_temp = true;
+            zt->temp_mean = temp_c;
+            zt->var_t = 0.0;
+            zt->cov_tz = 0.0;
+        }
+        double dt = temp_c - zt->temp_mean;
+        zt->temp_mean += dt / zt->weight;
+        zt->zero_mean += dz / zt->weight;
+        zt->var_t = lambda * zt->var_t + dt * (temp_c - zt->temp_mean);
+        zt->cov_tz = lambda * zt->cov_tz + dt * (raw - zt->zero_mean);
+    } else {
+        zt->zero_mean += dz / zt->weight;
+    }
+    zt->updates++;
+    return true;
+}
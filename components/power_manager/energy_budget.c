@@ -0,0 +1,153 @@
+// File: components/power_manager/energy_budget.c
+
+#include "energy_budget.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include <time.h>
+#include <inttypes.h>
+
+static const char* TAG = "energy_budget";
+
+#define ENERGY_NVS_NAMESPACE   "energy"
+#define ENERGY_MIN_HORIZON_H   24.0f           // Horizonte mínimo aunque se haya superado el objetivo
+#define VALID_EPOCH_S          1577836800      // 2020-01-01: antes de esto la hora no está sincronizada
+
+// Curva de descarga Li-ion: fracción del rango [vacía, llena] -> % de carga
+static const float soc_curve[][2] = {
+    {0.000f,   0.0f},
+    {0.222f,   5.0f},
+    {0.333f,  12.0f},
+    {0.444f,  25.0f},
+    {0.556f,  45.0f},
+    {0.667f,  63.0f},
+    {0.778f,  78.0f},
+    {0.889f,  90.0f},
+    {1.000f, 100.0f},
+};
+#define SOC_CURVE_POINTS (sizeof(soc_curve) / sizeof(soc_curve[0]))
+
+// Estado conservado entre despertares
+RTC_DATA_ATTR static uint32_t cycles_since_upload = 0;
+RTC_DATA_ATTR static float last_soc_percent = 0.0f;
+
+static energy_plan_t current_plan = {
+    .sample_period_s = CONFIG_ENERGY_MIN_SAMPLE_PERIOD_S,
+    .upload_every = 1,
+    .hx711_samples = 1,
+    .upload_due = true,
+};
+
+float energy_budget_soc_percent(float battery_v) {
+    float span_mv = (float)(CONFIG_BATTERY_FULL_MV - CONFIG_BATTERY_EMPTY_MV);
+    float frac = (battery_v * 1000.0f - CONFIG_BATTERY_EMPTY_MV) / span_mv;
+
+    if (frac <= soc_curve[0][0]) return 0.0f;
+    if (frac >= soc_curve[SOC_CURVE_POINTS - 1][0]) return 100.0f;
+
+    // Interpolación lineal entre los dos puntos de la curva que rodean la medida
+    for (size_t i = 1; i < SOC_CURVE_POINTS; i++) {
+        if (frac <= soc_curve[i][0]) {
+            float t = (frac - soc_curve[i - 1][0]) / (soc_curve[i][0] - soc_curve[i - 1][0]);
+            return soc_curve[i - 1][1] + t * (soc_curve[i][1] - soc_curve[i - 1][1]);
+        }
+    }
+    return 100.0f;
+}
+
+// Horas que faltan hasta la autonomía objetivo, contando desde la instalación guardada en NVS
+static float remaining_target_hours(float soc_percent) {
+    float target_h = CONFIG_ENERGY_TARGET_RUNTIME_DAYS * 24.0f;
+    time_t now = time(NULL);
+    if (now < VALID_EPOCH_S) {
+        return target_h;                          // Sin hora válida todavía: objetivo completo
+    }
+
+    nvs_handle_t handle;
+    if (nvs_open(ENERGY_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return target_h;
+    }
+
+    uint32_t deploy_ts = 0;
+    esp_err_t err = nvs_get_u32(handle, "deploy_ts", &deploy_ts);
+
+    // Batería nueva (carga casi completa tras un nivel bajo o sin registro): reinicia el objetivo
+    bool battery_swapped = (soc_percent >= 95.0f && last_soc_percent < 50.0f);
+    if (err != ESP_OK || battery_swapped) {
+        deploy_ts = (uint32_t)now;
+        nvs_set_u32(handle, "deploy_ts", deploy_ts);
+        nvs_commit(handle);
+        ESP_LOGI(TAG, "Inicio de autonomía registrado: %" PRIu32, deploy_ts);
+    }
+    nvs_close(handle);
+
+    float elapsed_h = (float)((uint32_t)now - deploy_ts) / 3600.0f;
+    float remaining_h = target_h - elapsed_h;
+    return (remaining_h > ENERGY_MIN_HORIZON_H) ? remaining_h : ENERGY_MIN_HORIZON_H;
+}
+
+void energy_budget_begin_cycle(void) {
+    cycles_since_upload++;
+}
+
+void energy_budget_mark_uploaded(void) {
+    cycles_since_upload = 0;
+    current_plan.upload_due = false;
+}
+
+const energy_plan_t* energy_budget_get_plan(void) {
+    return &current_plan;
+}
+
+void energy_budget_update(float battery_v, energy_plan_t *plan) {
+    energy_plan_t p = {0};
+    p.battery_voltage = battery_v;
+    p.soc_percent = energy_budget_soc_percent(battery_v);
+    p.remaining_mah = CONFIG_BATTERY_CAPACITY_MAH * p.soc_percent / 100.0f;
+
+    // Corriente media que nos podemos permitir para llegar al objetivo
+    float budget_ma = p.remaining_mah / remaining_target_hours(p.soc_percent);
+    float sleep_ma = CONFIG_ENERGY_SLEEP_CURRENT_UA / 1000.0f;
+    float available_ma = budget_ma - sleep_ma;
+
+    const float min_period = CONFIG_ENERGY_MIN_SAMPLE_PERIOD_S;
+    const float max_period = CONFIG_ENERGY_MAX_SAMPLE_PERIOD_S;
+
+    // Elegir el menor intervalo de muestreo cuya latencia de subida (n * T) no supere el máximo
+    p.upload_every = 1;
+    p.sample_period_s = (uint32_t)max_period;
+    for (uint32_t n = 1; n <= CONFIG_ENERGY_MAX_UPLOAD_EVERY; n++) {
+        float charge_per_sample = CONFIG_ENERGY_SAMPLE_CHARGE_MAS + (float)CONFIG_ENERGY_UPLOAD_CHARGE_MAS / n;
+        float period = (available_ma > 0.0f) ? charge_per_sample / available_ma : max_period;
+        if (period < min_period) period = min_period;
+        if (period > max_period) period = max_period;
+        if (n * period <= max_period && (uint32_t)period < p.sample_period_s) {
+            p.sample_period_s = (uint32_t)period;
+            p.upload_every = n;
+        }
+    }
+
+    // Promediado del HX711 según la carga: más lecturas cuando sobra energía
+    if (p.soc_percent > 60.0f)      p.hx711_samples = 10;
+    else if (p.soc_percent > 30.0f) p.hx711_samples = 5;
+    else if (p.soc_percent > 15.0f) p.hx711_samples = 3;
+    else                            p.hx711_samples = 1;
+
+    // Consumo medio y autonomía previstos con el plan elegido
+    float charge_per_sample = CONFIG_ENERGY_SAMPLE_CHARGE_MAS + (float)CONFIG_ENERGY_UPLOAD_CHARGE_MAS / p.upload_every;
+    p.avg_current_ma = sleep_ma + charge_per_sample / p.sample_period_s;
+    p.runtime_h = p.remaining_mah / p.avg_current_ma;
+
+    // Subir si toca por lote o si todavía no hay hora válida para sellar las muestras
+    p.upload_due = (cycles_since_upload >= p.upload_every) || (time(NULL) < VALID_EPOCH_S);
+
+    last_soc_percent = p.soc_percent;
+    current_plan = p;
+    if (plan) {
+        *plan = p;
+    }
+
+    ESP_LOGD(TAG, "Batería %.2f V (%.0f%%) -> muestreo %" PRIu32 " s, subida cada %" PRIu32 ", HX711 x%d, autonomía %.0f h",
+             p.battery_voltage, p.soc_percent, p.sample_period_s, p.upload_every, p.hx711_samples, p.runtime_h);
+}
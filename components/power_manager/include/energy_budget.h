@@ -0,0 +1,25 @@
+// File: components/power_manager/include/energy_budget.h
+
+#pragma once        // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Plan de energía para el modo batería calculado a partir de la carga restante
+typedef struct {
+    float battery_voltage;       // Tensión medida (V)
+    float soc_percent;           // Estado de carga estimado (%)
+    float remaining_mah;         // Carga restante estimada (mAh)
+    uint32_t sample_period_s;    // Intervalo de muestreo en batería
+    uint32_t upload_every;       // Despertares acumulados por cada subida
+    int hx711_samples;           // Lecturas HX711 promediadas por muestra
+    float avg_current_ma;        // Consumo medio previsto con este plan (mA)
+    float runtime_h;             // Autonomía restante prevista (horas)
+    bool upload_due;             // true si este despertar debe conectar y publicar
+} energy_plan_t;
+
+void energy_budget_begin_cycle(void);                              // Cuenta un despertar (una vez por arranque)
+void energy_budget_update(float battery_v, energy_plan_t *plan);   // Recalcula el plan con la tensión actual
+void energy_budget_mark_uploaded(void);                            // Indica que el lote pendiente ya se subió
+const energy_plan_t* energy_budget_get_plan(void);                 // Último plan calculado
+float energy_budget_soc_percent(float battery_v);                  // Estado de carga (%) según la curva Li-ion
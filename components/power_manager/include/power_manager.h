@@ -1,6 +1,13 @@
 #pragma once        // Le indica al compilador que procese este fichero solo una vez por compilacion
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Bit de notificación que reciben las tareas suscritas cuando cambia la fuente de alimentación
+#define POWER_EVENT_NOTIFY_BIT  (1UL << 0)
 
 // Enumeración para tipos de fuente de alimentación
 typedef enum {
@@ -11,11 +18,17 @@ typedef enum {
 
 void power_manager_init(void);               // Inicializa la configuración y periféricos de gestión de energía
 bool power_manager_should_sleep(void);       // Comprueba si se cumplen las condiciones para entrar en bajo consumo  
+bool power_manager_uses_deep_sleep(void);    // false si el modo batería usa light sleep automático (sin reinicio)
 void power_manager_enter_deep_sleep(void);   // Configura y activa el deep sleep del microcontrolador
+void power_manager_set_sleep_period_ms(uint32_t period_ms);   // Fija la duración del próximo deep sleep
 
 // Funciones para detección de alimentación
 power_source_t power_manager_get_source(void);    // Obtiene la fuente de alimentación actual (USB o batería)
 bool power_manager_is_usb_connected(void);        // Devuelve true si USB está conectado
+esp_err_t power_manager_subscribe(TaskHandle_t task);   // Avisa a la tarea (POWER_EVENT_NOTIFY_BIT) en cada cambio confirmado
+
+// Medida de batería por ADC (oneshot + calibración, promediada)
+float power_manager_read_battery_voltage(void);   // Devuelve la tensión de batería en voltios (0 si no hay ADC)
 
 // Función de diagnóstico
 void power_manager_debug_gpio_state(void);        // Muestra el estado actual del GPIO de detección
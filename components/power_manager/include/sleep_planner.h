@@ -0,0 +1,12 @@
+// File: components/power_manager/include/sleep_planner.h
+
+#pragma once        // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+
+// Planificador de deep sleep: mantiene en memoria RTC el próximo instante programado
+// (alineado a múltiplos del periodo sobre el reloj del sistema) y duerme justo hasta él,
+// descontando el tiempo que el equipo ha estado despierto en este ciclo.
+
+uint64_t sleep_planner_next_sleep_us(uint32_t period_ms);   // Microsegundos hasta la próxima ranura y la fija como plazo
+void sleep_planner_reset(void);                             // Olvida el plazo (p. ej. al volver a USB)
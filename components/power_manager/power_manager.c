@@ -1,11 +1,21 @@
 // File: components/power_manager/power_manager.c
 
 #include "power_manager.h"
+#include "sleep_planner.h"
+#include "diagnostics.h"
+#include "dlog.h"
 #include "esp_sleep.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "esp_attr.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "sdkconfig.h"
 #include <inttypes.h>  // Para PRIu32
 
 static const char* TAG = "power_manager";
@@ -19,16 +29,178 @@ static bool simulation_enabled = false;  // CAMBIADO: false = modo real
 // Pin HW para detección de USB en modo real
 #define USB_DETECT_PIN  GPIO_NUM_4  // Ajusta este pin según tu hardware
 
-// Variables para logging de cambios de estado (opcional)
-static power_source_t last_detected_source = POWER_SOURCE_UNKNOWN;
-static uint32_t state_change_count = 0;
+// Estado de alimentación confirmado tras el antirrebote (lo actualiza el temporizador, no cada consulta)
+static volatile power_source_t last_detected_source = POWER_SOURCE_UNKNOWN;
+static volatile uint32_t state_change_count = 0;
+
+// Antirrebote: cada flanco rearma el temporizador; el cambio se confirma con dos lecturas
+// iguales separadas por CONFIG_POWER_DEBOUNCE_MS sin flancos entre medias
+static esp_timer_handle_t debounce_timer = NULL;
+static power_source_t candidate_source = POWER_SOURCE_UNKNOWN;
+
+// Tareas avisadas con POWER_EVENT_NOTIFY_BIT en cada cambio confirmado
+#define POWER_MAX_SUBSCRIBERS  4
+static TaskHandle_t subscribers[POWER_MAX_SUBSCRIBERS];
+static int subscriber_count = 0;
+
+// Periodo de muestreo en batería (lo ajusta tasks según el plan de energía y el detector de eventos)
+#define DEFAULT_SLEEP_PERIOD_MS  60000
+static uint32_t sleep_period_ms = DEFAULT_SLEEP_PERIOD_MS;
+
+// ADC de batería: unidad oneshot y esquema de calibración del chip
+#define BATTERY_ADC_UNIT    ADC_UNIT_1
+#define BATTERY_ADC_ATTEN   ADC_ATTEN_DB_11      // Rango completo (~0-3.1 V en el pin)
+static adc_oneshot_unit_handle_t battery_adc = NULL;
+static adc_cali_handle_t battery_cali = NULL;
+
+// Crea el esquema de calibración disponible en el chip (curve fitting o line fitting)
+static bool battery_adc_calibration_init(void) {
+    esp_err_t ret = ESP_FAIL;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cali_cfg = {
+        .unit_id  = BATTERY_ADC_UNIT,
+        .chan     = CONFIG_BATTERY_ADC_CHANNEL,
+        .atten    = BATTERY_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    ret = adc_cali_create_scheme_curve_fitting(&cali_cfg, &battery_cali);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t cali_cfg = {
+        .unit_id  = BATTERY_ADC_UNIT,
+        .atten    = BATTERY_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    ret = adc_cali_create_scheme_line_fitting(&cali_cfg, &battery_cali);
+#endif
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "ADC sin calibración de fábrica (%s), se usa conversión lineal", esp_err_to_name(ret));
+        battery_cali = NULL;
+        return false;
+    }
+    return true;
+}
+
+static void battery_adc_init(void) {
+    adc_oneshot_unit_init_cfg_t unit_cfg = {
+        .unit_id = BATTERY_ADC_UNIT,
+    };
+    esp_err_t result = adc_oneshot_new_unit(&unit_cfg, &battery_adc);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Error inicializando ADC de batería: %s", esp_err_to_name(result));
+        battery_adc = NULL;
+        return;
+    }
+
+    adc_oneshot_chan_cfg_t chan_cfg = {
+        .atten    = BATTERY_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    ESP_ERROR_CHECK(adc_oneshot_config_channel(battery_adc, CONFIG_BATTERY_ADC_CHANNEL, &chan_cfg));
+
+    bool calibrated = battery_adc_calibration_init();
+    ESP_LOGI(TAG, "ADC de batería: canal %d, divisor x%.2f, %s",
+             CONFIG_BATTERY_ADC_CHANNEL, CONFIG_BATTERY_DIVIDER_RATIO_X100 / 100.0f,
+             calibrated ? "calibrado" : "sin calibrar");
+}
 
 // Obtener tiempo en ms
 static uint32_t get_time_ms(void) {
     return xTaskGetTickCount() * portTICK_PERIOD_MS;
 }
 
+static power_source_t read_source_from_pin(void) {
+    return gpio_get_level(USB_DETECT_PIN) ? POWER_SOURCE_USB : POWER_SOURCE_BATTERY;
+}
+
+// Flanco en el pin de detección: solo rearma el temporizador de antirrebote
+static void IRAM_ATTR usb_detect_isr(void* arg) {
+    esp_timer_stop(debounce_timer);
+    esp_timer_start_once(debounce_timer, (uint64_t)CONFIG_POWER_DEBOUNCE_MS * 1000ULL);
+}
+
+// Se ejecuta en la tarea de esp_timer cuando el pin lleva CONFIG_POWER_DEBOUNCE_MS sin flancos
+static void debounce_timer_cb(void* arg) {
+    power_source_t level_source = read_source_from_pin();
+
+    if (level_source == last_detected_source) {
+        candidate_source = POWER_SOURCE_UNKNOWN;   // Rebote que volvió al estado anterior
+        return;
+    }
+    if (level_source != candidate_source) {
+        // Primera lectura distinta: pedir una segunda confirmación antes de cambiar de modo
+        candidate_source = level_source;
+        esp_timer_start_once(debounce_timer, (uint64_t)CONFIG_POWER_DEBOUNCE_MS * 1000ULL);
+        return;
+    }
+
+    power_source_t previous = last_detected_source;
+    last_detected_source = level_source;
+    candidate_source = POWER_SOURCE_UNKNOWN;
+    state_change_count++;
+    diagnostics_event(DIAG_EVT_POWER_SOURCE, level_source, (int32_t)state_change_count);
+    if (level_source == POWER_SOURCE_USB) {
+        sleep_planner_reset();                      // Al volver a batería se realinea con el nuevo periodo
+    }
+    ESP_LOGI(TAG, "CAMBIO DETECTADO #%lu: %s → %s (GPIO %d) en t=%lu ms",
+             state_change_count,
+             previous == POWER_SOURCE_USB ? "USB" : "Batería",
+             level_source == POWER_SOURCE_USB ? "USB" : "Batería",
+             USB_DETECT_PIN,
+             get_time_ms());
+
+    for (int i = 0; i < subscriber_count; i++) {
+        xTaskNotify(subscribers[i], POWER_EVENT_NOTIFY_BIT, eSetBits);
+    }
+}
+
+// Interrupción por ambos flancos + temporizador de antirrebote
+static esp_err_t usb_detect_interrupt_init(void) {
+    const esp_timer_create_args_t timer_args = {
+        .callback = debounce_timer_cb,
+        .name     = "usb_debounce",
+    };
+    esp_err_t result = esp_timer_create(&timer_args, &debounce_timer);
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    // El servicio puede estar ya instalado por otro componente
+    result = gpio_install_isr_service(0);
+    if (result != ESP_OK && result != ESP_ERR_INVALID_STATE) {
+        return result;
+    }
+    return gpio_isr_handler_add(USB_DETECT_PIN, usb_detect_isr, NULL);
+}
+
+// Escalado dinámico de frecuencia y, con tickless idle, light sleep automático en los periodos ociosos
+static void power_management_init(void) {
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_config_t pm_cfg = {
+        .max_freq_mhz = CONFIG_POWER_PM_MAX_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_POWER_PM_MIN_FREQ_MHZ,
+#ifdef CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#else
+        .light_sleep_enable = false,
+#endif
+    };
+    esp_err_t result = esp_pm_configure(&pm_cfg);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Error configurando gestión de energía: %s", esp_err_to_name(result));
+        return;
+    }
+    ESP_LOGI(TAG, "Gestión de energía: %d-%d MHz, light sleep automático %s",
+             pm_cfg.min_freq_mhz, pm_cfg.max_freq_mhz, pm_cfg.light_sleep_enable ? "activo" : "desactivado");
+#else
+    ESP_LOGI(TAG, "Gestión de energía de ESP-IDF desactivada (CONFIG_PM_ENABLE)");
+#endif
+}
+
 void power_manager_init(void) {
+    // Frecuencia dinámica / light sleep y medida de batería (independientes del modo de detección de USB)
+    power_management_init();
+    battery_adc_init();
+
     if (simulation_enabled) {
         // Código de simulación (mantenido para pruebas futuras)
         ESP_LOGI(TAG, "MODO SIMULACIÓN ACTIVADO (no se usa actualmente)");
@@ -45,7 +217,7 @@ void power_manager_init(void) {
             .mode         = GPIO_MODE_INPUT,
             .pull_up_en   = GPIO_PULLUP_ENABLE,      // Pull-up habilitado
             .pull_down_en = GPIO_PULLDOWN_DISABLE,
-            .intr_type    = GPIO_INTR_DISABLE
+            .intr_type    = GPIO_INTR_ANYEDGE           // Cambios notificados por interrupción
         };
         
         esp_err_t result = gpio_config(&cfg);
@@ -62,6 +234,13 @@ void power_manager_init(void) {
                  USB_DETECT_PIN, 
                  initial_level,
                  last_detected_source == POWER_SOURCE_USB ? "USB/Nominal" : "Batería/Ahorro");
+        
+        result = usb_detect_interrupt_init();
+        if (result != ESP_OK) {
+            ESP_LOGE(TAG, "Error configurando interrupción de GPIO %d: %s", USB_DETECT_PIN, esp_err_to_name(result));
+        } else {
+            ESP_LOGI(TAG, "Detección por interrupción activa (antirrebote %d ms)", CONFIG_POWER_DEBOUNCE_MS);
+        }
     }
 }
 
@@ -70,34 +249,37 @@ power_source_t power_manager_get_source(void) {
         // Código de simulación (no se ejecuta)
         return POWER_SOURCE_USB;
     } else {
-        // MODO REAL: leer GPIO directamente
-        int level = gpio_get_level(USB_DETECT_PIN);
-        power_source_t current_source = level ? POWER_SOURCE_USB : POWER_SOURCE_BATTERY;
-        
-        // Detectar y loggear cambios de estado
-        if (current_source != last_detected_source && last_detected_source != POWER_SOURCE_UNKNOWN) {
-            state_change_count++;
-            ESP_LOGI(TAG, "CAMBIO DETECTADO #%lu: %s → %s (GPIO %d: %d)", 
-                     state_change_count,
-                     last_detected_source == POWER_SOURCE_USB ? "USB" : "Batería",
-                     current_source == POWER_SOURCE_USB ? "USB" : "Batería",
-                     USB_DETECT_PIN,
-                     level);
-        }
-        
-        last_detected_source = current_source;
-        return current_source;
+        // MODO REAL: estado ya filtrado por la interrupción y el antirrebote
+        return last_detected_source;
+    }
+}
+
+esp_err_t power_manager_subscribe(TaskHandle_t task) {
+    if (task == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (subscriber_count >= POWER_MAX_SUBSCRIBERS) {
+        return ESP_ERR_NO_MEM;
     }
+    subscribers[subscriber_count++] = task;
+    return ESP_OK;
+}
+
+bool power_manager_uses_deep_sleep(void) {
+#ifdef CONFIG_POWER_BATTERY_LIGHT_SLEEP
+    return false;
+#else
+    return true;
+#endif
 }
 
 bool power_manager_should_sleep(void) {
     power_source_t source = power_manager_get_source();
-    bool should_sleep = (source != POWER_SOURCE_USB);
+    // En modo light sleep el sistema no se reinicia: la espera entre muestras la hace el tickless idle
+    bool should_sleep = (source != POWER_SOURCE_USB) && power_manager_uses_deep_sleep();
     
     // Log detallado para debugging
-    ESP_LOGD(TAG, "should_sleep(): GPIO %d = %d, fuente = %s, sleep = %s",
-             USB_DETECT_PIN,
-             gpio_get_level(USB_DETECT_PIN),
+    ESP_LOGD(TAG, "should_sleep(): fuente = %s, sleep = %s",
              source == POWER_SOURCE_USB ? "USB" : "Batería",
              should_sleep ? "SÍ" : "NO");
     
@@ -114,15 +296,65 @@ void power_manager_enter_deep_sleep(void) {
     }
     
     ESP_LOGI(TAG, "Entrando en deep sleep... (GPIO %d = 0, modo batería)", USB_DETECT_PIN);
-    ESP_LOGI(TAG, "Configurando despertar por timer en 30 segundos");
     
-    const uint64_t SLEEP_US = 30ULL * 1000000ULL;  // 30 segundos
+    // Dormir hasta la próxima ranura del periodo, descontando el tiempo despierto de este ciclo
+    const uint64_t SLEEP_US = sleep_planner_next_sleep_us(sleep_period_ms);
+    ESP_LOGI(TAG, "Configurando despertar por timer en %" PRIu64 " ms (periodo %" PRIu32 " ms)",
+             SLEEP_US / 1000ULL, sleep_period_ms);
     esp_sleep_enable_timer_wakeup(SLEEP_US);
     
+#ifdef CONFIG_POWER_USB_WAKEUP
+    // Despertar también al volver el USB (nivel alto en el pin de detección, dominio RTC)
+    esp_err_t wake_result = esp_sleep_enable_ext0_wakeup(USB_DETECT_PIN, 1);
+    if (wake_result == ESP_OK) {
+        ESP_LOGI(TAG, "Despertar por USB habilitado (ext0, GPIO %d = 1)", USB_DETECT_PIN);
+    } else {
+        ESP_LOGW(TAG, "No se pudo habilitar el despertar por USB: %s", esp_err_to_name(wake_result));
+    }
+#endif
+    
     ESP_LOGI(TAG, "Iniciando deep sleep ahora...");
+    dlog_flush();                                       // El anillo del registro diferido no sobrevive al deep sleep
     esp_deep_sleep_start();
 }
 
+float power_manager_read_battery_voltage(void) {
+    if (battery_adc == NULL) {
+        return 0.0f;
+    }
+
+    // Promedia varias lecturas para filtrar el ruido del ADC
+    int32_t sum_mv = 0;
+    int valid = 0;
+    for (int i = 0; i < CONFIG_BATTERY_ADC_SAMPLES; i++) {
+        int raw = 0;
+        if (adc_oneshot_read(battery_adc, CONFIG_BATTERY_ADC_CHANNEL, &raw) != ESP_OK) {
+            continue;
+        }
+        int mv = 0;
+        if (battery_cali != NULL) {
+            adc_cali_raw_to_voltage(battery_cali, raw, &mv);
+        } else {
+            mv = raw * 3100 / 4095;                     // Aproximación lineal sin calibración
+        }
+        sum_mv += mv;
+        valid++;
+    }
+
+    if (valid == 0) {
+        ESP_LOGW(TAG, "No se pudo leer el ADC de batería");
+        return 0.0f;
+    }
+
+    // Deshacer el divisor de tensión
+    float pin_mv = (float)sum_mv / valid;
+    return pin_mv * (CONFIG_BATTERY_DIVIDER_RATIO_X100 / 100.0f) / 1000.0f;
+}
+
+void power_manager_set_sleep_period_ms(uint32_t period_ms) {
+    sleep_period_ms = period_ms;
+}
+
 bool power_manager_is_usb_connected(void) {
     return (power_manager_get_source() == POWER_SOURCE_USB);
 }
@@ -0,0 +1,69 @@
+// File: components/power_manager/sleep_planner.c
+
+#include "sleep_planner.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include <sys/time.h>
+#include <inttypes.h>
+
+static const char* TAG = "sleep_planner";
+
+#define SLEEP_PLANNER_MIN_SLEEP_US   200000ULL     // Por debajo de esto no compensa dormir: se salta a la ranura siguiente
+
+// Plazo y periodo vigentes, conservados entre despertares. El reloj del sistema sigue
+// contando durante el deep sleep, así que sirve de base de tiempos común entre ciclos
+RTC_DATA_ATTR static uint64_t next_deadline_us = 0;
+RTC_DATA_ATTR static uint32_t planned_period_ms = 0;
+RTC_DATA_ATTR static uint32_t missed_slots = 0;
+
+static uint64_t now_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
+}
+
+// Primera ranura alineada al periodo que deja al menos el margen mínimo de sueño
+static uint64_t next_aligned_slot(uint64_t now, uint64_t period_us) {
+    uint64_t slot = (now / period_us + 1) * period_us;
+    if (slot - now < SLEEP_PLANNER_MIN_SLEEP_US) {
+        slot += period_us;
+    }
+    return slot;
+}
+
+uint64_t sleep_planner_next_sleep_us(uint32_t period_ms) {
+    uint64_t period_us = (uint64_t)period_ms * 1000ULL;
+    uint64_t now = now_us();
+
+    if (period_us == 0) {
+        return SLEEP_PLANNER_MIN_SLEEP_US;
+    }
+
+    uint64_t deadline;
+    bool clock_jumped = (now >= next_deadline_us + period_us * 4) || (next_deadline_us > now + period_us);
+    if (next_deadline_us == 0 || planned_period_ms != period_ms || clock_jumped) {
+        // Primer ciclo, cambio de periodo (ráfaga/calma/plan de energía) o reloj corregido por SNTP: realinear
+        deadline = next_aligned_slot(now, period_us);
+    } else {
+        deadline = next_deadline_us + period_us;
+        while (deadline < now + SLEEP_PLANNER_MIN_SLEEP_US) {
+            // El ciclo se alargó más que el periodo: saltar ranuras perdidas en vez de encadenar retrasos
+            deadline += period_us;
+            missed_slots++;
+        }
+    }
+
+    next_deadline_us = deadline;
+    planned_period_ms = period_ms;
+
+    uint64_t sleep_us = deadline - now;
+    ESP_LOGI(TAG, "Despierto %" PRIu64 " ms, periodo %" PRIu32 " ms -> dormir %" PRIu64 " ms (ranuras perdidas: %" PRIu32 ")",
+             (uint64_t)esp_timer_get_time() / 1000ULL, period_ms, sleep_us / 1000ULL, missed_slots);
+    return sleep_us;
+}
+
+void sleep_planner_reset(void) {
+    next_deadline_us = 0;
+    planned_period_ms = 0;
+}
@@ -0,0 +1,65 @@
+// File: components/snow_metrics/include/snow_filter.h
+
+#pragma once                 // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Filtro de Kalman de espesor y SWE. Estado x = [espesor (cm), ritmo de espesor (cm/h), SWE (mm),
+// ritmo de SWE (mm/h)] con modelo de velocidad casi constante en cada canal. Los dos canales se
+// acoplan en el ruido de proceso: una nevada acelera a la vez espesor y SWE en la proporción de la
+// densidad de la nieve nueva, así que si el ultrasonido queda fuera (ventisca en el haz) la balanza
+// sigue informando del espesor y al revés. Cada medida se aplica por separado (actualizaciones
+// escalares, sin invertir matrices) y se rechaza si su innovación normalizada (NIS) supera la
+// puerta; tras varios rechazos seguidos se acepta que el nivel ha cambiado de verdad (placa
+// limpiada, retirada de nieve) y el canal se reinicia en la medida. Tiempo y memoria constantes.
+
+#define SNOW_FILTER_STATES         4
+#define SNOW_FILTER_MAX_GAP_S      (6 * 3600)   // Más tiempo sin muestras: se reinicia
+
+// Bits de snow_filter_output_t.flags
+#define SNOW_FILTER_DEPTH_VALID    (1u << 0)    // Hay estimación de espesor
+#define SNOW_FILTER_SWE_VALID      (1u << 1)    // Hay estimación de SWE
+#define SNOW_FILTER_DEPTH_GATED    (1u << 2)    // La distancia de esta muestra se ha rechazado
+#define SNOW_FILTER_SWE_GATED      (1u << 3)    // El peso de esta muestra se ha rechazado
+#define SNOW_FILTER_DEPTH_RESET    (1u << 4)    // El canal de espesor se ha reiniciado en esta muestra
+#define SNOW_FILTER_SWE_RESET      (1u << 5)
+
+typedef struct {
+    float depth_sigma_cm;        // Ruido del ultrasonido
+    float swe_sigma_mm;          // Ruido de la balanza en mm de agua
+    float fall_accel;            // Aceleración de la nevada (cm/h²), común a ambos canales
+    float depth_accel;           // Aceleración propia del espesor: asentamiento, erosión (cm/h²)
+    float swe_accel;             // Aceleración propia del SWE: fusión, lluvia (mm/h²)
+    float new_snow_density;      // Densidad de la nieve nueva (kg/m³): mm de SWE por cm de espesor / 10
+    float gate_nis;              // Umbral de la innovación normalizada (σ²)
+    uint32_t max_rejections;     // Rechazos seguidos antes de reiniciar el canal
+} snow_filter_params_t;
+
+typedef struct {
+    bool depth_ready;            // Canal inicializado con una medida
+    bool swe_ready;
+    uint32_t last_epoch_s;       // Instante de la última predicción
+    float x[SNOW_FILTER_STATES];
+    float p[SNOW_FILTER_STATES][SNOW_FILTER_STATES];
+    uint32_t depth_rejections;   // Rechazos seguidos
+    uint32_t swe_rejections;
+} snow_filter_t;
+
+typedef struct {
+    float depth_cm;
+    float depth_rate_cm_h;
+    float swe_mm;
+    float swe_rate_mm_h;
+    float depth_nis;             // Innovación normalizada de la distancia (NAN si no había medida)
+    float swe_nis;
+    uint8_t flags;               // SNOW_FILTER_*
+} snow_filter_output_t;
+
+void snow_filter_default_params(snow_filter_params_t *params);     // Parámetros de menuconfig
+void snow_filter_init(snow_filter_t *filter);
+
+// Predice hasta epoch_s (0: sin hora, no predice) y aplica las medidas válidas
+void snow_filter_update(snow_filter_t *filter, const snow_filter_params_t *params, uint32_t epoch_s,
+                        float depth_cm, bool depth_valid, float swe_mm, bool swe_valid,
+                        snow_filter_output_t *out);
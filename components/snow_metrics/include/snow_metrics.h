@@ -0,0 +1,36 @@
+// File: components/snow_metrics/include/snow_metrics.h
+
+#pragma once                 // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Magnitudes de nieve derivadas de las medidas en crudo y de la geometría de la instalación:
+//   espesor (cm)       = altura del sensor sobre la placa vacía - distancia medida
+//   SWE (mm)           = peso (kg) / área de la placa (m²)   (1 kg/m² = 1 mm de agua)
+//   densidad (kg/m³)   = SWE / espesor
+// Cada muestra se calcula en tiempo constante al publicarla; los agregados se derivan de los
+// estadísticos de la ventana, así los paneles no recalculan sobre todo el histórico.
+
+// Geometría (unidades: cm, m² y cm)
+typedef struct {
+    float mount_height_cm;       // Altura del ultrasonido sobre la placa vacía
+    float pillow_area_m2;        // Área de la placa de la célula de carga
+    float min_depth_cm;          // Espesor mínimo para dar densidad (con menos es casi todo ruido)
+} snow_metrics_params_t;
+
+typedef struct {
+    bool depth_valid;            // Hay distancia válida
+    float depth_cm;
+    bool swe_valid;              // Hay peso válido
+    float swe_mm;
+    bool density_valid;          // Ambos válidos y espesor suficiente
+    float density_kg_m3;
+} snow_metrics_t;
+
+// Geometría de la configuración en tiempo de ejecución (CFG_MOUNT_HEIGHT_MM, CFG_PILLOW_AREA_CM2)
+void snow_metrics_load_params(snow_metrics_params_t *params);
+
+// Deriva las magnitudes de una muestra; distance_valid/weight_valid según el estado de los sensores
+void snow_metrics_compute(const snow_metrics_params_t *params, float distance_cm, bool distance_valid,
+                          float weight_kg, bool weight_valid, snow_metrics_t *out);
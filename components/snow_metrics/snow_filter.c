@@ -0,0 +1,175 @@
+// File: components/snow_metrics/snow_filter.c
+
+#include "snow_filter.h"
+#include "sdkconfig.h"
+#include <math.h>
+#include <string.h>
+
+// Índices del estado
+#define X_DEPTH      0
+#define X_DEPTH_RATE 1
+#define X_SWE        2
+#define X_SWE_RATE   3
+
+void snow_filter_default_params(snow_filter_params_t *params) {
+    params->depth_sigma_cm   = CONFIG_SNOW_FILTER_DEPTH_SIGMA_MM / 10.0f;
+    params->swe_sigma_mm     = CONFIG_SNOW_FILTER_SWE_SIGMA_DMM / 10.0f;
+    params->fall_accel       = CONFIG_SNOW_FILTER_FALL_ACCEL_MM_H2 / 10.0f;
+    params->depth_accel      = CONFIG_SNOW_FILTER_DEPTH_ACCEL_MM_H2 / 10.0f;
+    params->swe_accel        = CONFIG_SNOW_FILTER_SWE_ACCEL_DMM_H2 / 10.0f;
+    params->new_snow_density = CONFIG_SNOW_FILTER_NEW_SNOW_DENSITY;
+    params->gate_nis         = (float)CONFIG_SNOW_FILTER_GATE_SIGMA * CONFIG_SNOW_FILTER_GATE_SIGMA;
+    params->max_rejections   = CONFIG_SNOW_FILTER_MAX_REJECTIONS;
+}
+
+void snow_filter_init(snow_filter_t *filter) {
+    memset(filter, 0, sizeof(*filter));
+}
+
+// Covarianza entre canales de la aceleración: la nevada es común (1 cm de espesor son
+// densidad/100 mm de SWE) y cada canal tiene además la suya propia
+static void channel_accel_cov(const snow_filter_params_t *params, float c[2][2]) {
+    float ratio = params->new_snow_density / 100.0f;
+    float fall = params->fall_accel * params->fall_accel;
+    c[0][0] = fall + params->depth_accel * params->depth_accel;
+    c[0][1] = fall * ratio;
+    c[1][0] = fall * ratio;
+    c[1][1] = fall * ratio * ratio + params->swe_accel * params->swe_accel;
+}
+
+static void predict(snow_filter_t *f, const snow_filter_params_t *params, float dt_h) {
+    f->x[X_DEPTH] += dt_h * f->x[X_DEPTH_RATE];
+    f->x[X_SWE]   += dt_h * f->x[X_SWE_RATE];
+
+    // P = F·P·Fᵀ, con F la identidad más dt en (nivel, ritmo) de cada canal
+    float (*p)[SNOW_FILTER_STATES] = f->p;
+    for (int j = 0; j < SNOW_FILTER_STATES; j++) {
+        p[X_DEPTH][j] += dt_h * p[X_DEPTH_RATE][j];
+        p[X_SWE][j]   += dt_h * p[X_SWE_RATE][j];
+    }
+    for (int i = 0; i < SNOW_FILTER_STATES; i++) {
+        p[i][X_DEPTH] += dt_h * p[i][X_DEPTH_RATE];
+        p[i][X_SWE]   += dt_h * p[i][X_SWE_RATE];
+    }
+
+    // + Q: aceleración blanca integrada en el intervalo, acoplada entre canales
+    float c[2][2];
+    channel_accel_cov(params, c);
+    const float q[2][2] = {
+        { dt_h * dt_h * dt_h / 3.0f, dt_h * dt_h / 2.0f },
+        { dt_h * dt_h / 2.0f,        dt_h },
+    };
+    for (int i = 0; i < SNOW_FILTER_STATES; i++) {
+        for (int j = 0; j < SNOW_FILTER_STATES; j++) {
+            p[i][j] += c[i / 2][j / 2] * q[i % 2][j % 2];
+        }
+    }
+}
+
+// Arranca un canal (0: espesor, 1: SWE) en la medida, sin correlación con el otro
+static void reset_channel(snow_filter_t *f, const snow_filter_params_t *params, int channel, float z, float r) {
+    int k = channel * 2;
+    for (int i = 0; i < SNOW_FILTER_STATES; i++) {
+        f->p[k][i] = f->p[i][k] = 0.0f;
+        f->p[k + 1][i] = f->p[i][k + 1] = 0.0f;
+    }
+    float c[2][2];
+    channel_accel_cov(params, c);
+    f->x[k] = z;
+    f->x[k + 1] = 0.0f;
+    f->p[k][k] = r;
+    f->p[k + 1][k + 1] = c[channel][channel];     // Ritmo desconocido: la aceleración de una hora
+}
+
+// Actualización escalar con la medida z del estado k. Devuelve la innovación normalizada y si se aplicó
+static bool scalar_update(snow_filter_t *f, int k, float z, float r, float gate, float *nis) {
+    float s = f->p[k][k] + r;
+    float y = z - f->x[k];
+    *nis = y * y / s;
+    if (*nis > gate) {
+        return false;
+    }
+
+    float gain[SNOW_FILTER_STATES], row[SNOW_FILTER_STATES];
+    for (int i = 0; i < SNOW_FILTER_STATES; i++) {
+        gain[i] = f->p[i][k] / s;
+        row[i] = f->p[k][i];
+    }
+    for (int i = 0; i < SNOW_FILTER_STATES; i++) {
+        f->x[i] += gain[i] * y;
+        for (int j = 0; j < SNOW_FILTER_STATES; j++) {
+            f->p[i][j] -= gain[i] * row[j];
+        }
+    }
+    // Simetría frente al redondeo en coma flotante
+    for (int i = 0; i < SNOW_FILTER_STATES; i++) {
+        for (int j = i + 1; j < SNOW_FILTER_STATES; j++) {
+            float m = 0.5f * (f->p[i][j] + f->p[j][i]);
+            f->p[i][j] = f->p[j][i] = m;
+        }
+    }
+    return true;
+}
+
+// Medida de un canal: inicializa, aplica o rechaza (y reinicia tras demasiados rechazos seguidos)
+static void measure(snow_filter_t *f, const snow_filter_params_t *params, int channel, float z, float sigma,
+                    bool *ready, uint32_t *rejections, float *nis, uint8_t *flags) {
+    float r = sigma * sigma;
+    uint8_t gated = channel ? SNOW_FILTER_SWE_GATED : SNOW_FILTER_DEPTH_GATED;
+    uint8_t reset = channel ? SNOW_FILTER_SWE_RESET : SNOW_FILTER_DEPTH_RESET;
+    if (!*ready) {
+        reset_channel(f, params, channel, z, r);
+        *ready = true;
+        *rejections = 0;
+        *nis = 0.0f;
+        *flags |= reset;
+        return;
+    }
+    if (scalar_update(f, channel * 2, z, r, params->gate_nis, nis)) {
+        *rejections = 0;
+    } else if (++*rejections >= params->max_rejections) {
+        reset_channel(f, params, channel, z, r);
+        *rejections = 0;
+        *flags |= reset;
+    } else {
+        *flags |= gated;
+    }
+}
+
+void snow_filter_update(snow_filter_t *filter, const snow_filter_params_t *params, uint32_t epoch_s,
+                        float depth_cm, bool depth_valid, float swe_mm, bool swe_valid,
+                        snow_filter_output_t *out) {
+    out->flags = 0;
+    out->depth_nis = NAN;
+    out->swe_nis = NAN;
+
+    if (epoch_s != 0) {
+        if (filter->last_epoch_s != 0 && epoch_s > filter->last_epoch_s) {
+            uint32_t gap_s = epoch_s - filter->last_epoch_s;
+            if (gap_s > SNOW_FILTER_MAX_GAP_S) {
+                // Demasiado tiempo sin datos: el ritmo anterior ya no dice nada
+                filter->depth_ready = false;
+                filter->swe_ready = false;
+            } else {
+                predict(filter, params, gap_s / 3600.0f);
+            }
+        }
+        filter->last_epoch_s = epoch_s;
+    }
+
+    if (depth_valid) {
+        measure(filter, params, 0, depth_cm, params->depth_sigma_cm, &filter->depth_ready,
+                &filter->depth_rejections, &out->depth_nis, &out->flags);
+    }
+    if (swe_valid) {
+        measure(filter, params, 1, swe_mm, params->swe_sigma_mm, &filter->swe_ready,
+                &filter->swe_rejections, &out->swe_nis, &out->flags);
+    }
+
+    if (filter->depth_ready) out->flags |= SNOW_FILTER_DEPTH_VALID;
+    if (filter->swe_ready) out->flags |= SNOW_FILTER_SWE_VALID;
+    out->depth_cm        = filter->x[X_DEPTH];
+    out->depth_rate_cm_h = filter->x[X_DEPTH_RATE];
+    out->swe_mm          = filter->x[X_SWE];
+    out->swe_rate_mm_h   = filter->x[X_SWE_RATE];
+}
@@ -0,0 +1,24 @@
+// File: components/snow_metrics/snow_metrics.c
+
+#include "snow_metrics.h"
+#include "config.h"
+#include "sdkconfig.h"
+
+void snow_metrics_load_params(snow_metrics_params_t *params) {
+    params->mount_height_cm = config_get_u32(CFG_MOUNT_HEIGHT_MM) / 10.0f;
+    params->pillow_area_m2  = config_get_u32(CFG_PILLOW_AREA_CM2) / 10000.0f;
+    params->min_depth_cm    = CONFIG_SNOW_DENSITY_MIN_DEPTH_MM / 10.0f;
+}
+
+void snow_metrics_compute(const snow_metrics_params_t *params, float distance_cm, bool distance_valid,
+                          float weight_kg, bool weight_valid, snow_metrics_t *out) {
+    out->depth_valid = distance_valid && distance_cm >= 0.0f;
+    out->depth_cm = out->depth_valid ? params->mount_height_cm - distance_cm : 0.0f;
+
+    out->swe_valid = weight_valid && params->pillow_area_m2 > 0.0f;
+    out->swe_mm = out->swe_valid ? weight_kg / params->pillow_area_m2 : 0.0f;
+
+    // Densidad aparente: kg/m² entre el espesor en metros
+    out->density_valid = out->depth_valid && out->swe_valid && out->depth_cm >= params->min_depth_cm;
+    out->density_kg_m3 = out->density_valid ? out->swe_mm / (out->depth_cm / 100.0f) : 0.0f;
+}
@@ -6,7 +6,18 @@
 #include "esp_err.h"
 
 void storage_init(void);                                 // Inicializa el sistema de almacenamiento (nvs, etc)
+// Huecos del anillo en nvs (rec0..rec255). Las muestras pendientes son como mucho storage_capacity(),
+// que se calcula al arrancar con el espacio libre de la partición (la más antigua se descarta al llenarse)
+#define STORAGE_MAX_RECORDS   256
+
 void storage_buffer_data(const sensor_data_t* data);     // Guarda temporalmente los datos de sensores para su posterior envío
+uint32_t storage_pending_count(void);                    // Número de muestras pendientes de subir
+esp_err_t storage_peek_oldest(sensor_data_t* data);      // Lee la muestra pendiente más antigua sin retirarla
+esp_err_t storage_peek(uint32_t offset, sensor_data_t* data);  // Lee la pendiente número offset (0 = la más antigua); ESP_ERR_NOT_FOUND si no hay
+void storage_pop_oldest(void);                           // Retira la muestra más antigua tras subirla con éxito
+void storage_discard_oldest(esp_err_t reason);           // Retira la más antigua sin subirla porque no se puede leer (reason: error de lectura)
+uint32_t storage_dropped_count(void);                    // Muestras perdidas por almacén lleno en esta sesión
+uint32_t storage_capacity(void);                         // Muestras pendientes que caben en nvs
 
 
 
@@ -1,14 +1,78 @@
-// File: components/power_manager/power_manager.c
+// File: components/storage/storage.c
 
 #include "storage.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
 #include "nivometro_sensors.h"  
+#include "diagnostics.h"
+#include "metrics.h"
 
 static const char* TAG = "storage";                     // Etiqueta de logs para este módulo
 static nvs_handle_t nvs_handle_local;                   // Handle nvs
-static uint32_t record_index = 0;                       // Incrementar el índice para cada registro
+
+// Cola circular de muestras pendientes de subir: rec0..rec{N-1} más los contadores head/tail
+// (absolutos, persistentes en nvs) para que el lote sobreviva al deep sleep
+static uint32_t head_index = 0;                         // Índice absoluto de la muestra más antigua pendiente
+static uint32_t tail_index = 0;                         // Índice absoluto de la próxima muestra a escribir
+static uint32_t dropped_count = 0;                      // Muestras sobrescritas por falta de espacio en esta sesión
+static uint32_t capacity = STORAGE_MAX_RECORDS;         // Muestras pendientes que caben (storage_size_ring)
+
+// Entradas de 32 bytes de NVS que ocupa cada muestra: índice del blob, cabecera del fragmento y datos
+#define STORAGE_ENTRIES_PER_RECORD  (2 + (sizeof(sensor_data_t) + 31) / 32)
+// Entradas que el anillo deja libres: la página que NVS reserva para compactar y otra para la
+// configuración, las ranuras de calibración y el registro de diagnóstico, que comparten la partición
+#define STORAGE_NVS_RESERVE_ENTRIES (2 * 126)
+
+static void record_key(uint32_t index, char* key, size_t key_size) {
+    // Genera la clave del hueco que corresponde al índice absoluto
+    snprintf(key, key_size, "rec%lu", (unsigned long)(index % STORAGE_MAX_RECORDS));
+}
+
+static void erase_record(uint32_t index) {
+    char key[16];
+    record_key(index, key, sizeof(key));
+    nvs_erase_key(nvs_handle_local, key);
+}
+
+// Descarta la pendiente más antigua para hacer sitio (la confirma quien llame con nvs_commit)
+static void drop_oldest(void) {
+    erase_record(head_index);
+    head_index++;
+    dropped_count++;
+    diagnostics_event(DIAG_EVT_STORAGE_DROP, (int32_t)dropped_count, 0);
+    nvs_set_u32(nvs_handle_local, "head", head_index);
+}
+
+// Los huecos fuera de la ventana pendiente se borran al retirarlos; los que quedaran de versiones que
+// solo los sobrescribían ocuparían espacio para siempre
+static void purge_stale_records(void) {
+    uint32_t purged = 0;
+    for (uint32_t i = tail_index; i != head_index + STORAGE_MAX_RECORDS; i++) {
+        char key[16];
+        record_key(i, key, sizeof(key));
+        if (nvs_erase_key(nvs_handle_local, key) == ESP_OK) purged++;
+    }
+    if (purged > 0) {
+        nvs_commit(nvs_handle_local);
+        ESP_LOGI(TAG, "Borrados %lu registros antiguos fuera de la cola", (unsigned long)purged);
+    }
+}
+
+// Tamaño del anillo según lo que queda libre en la partición: lo que ya ocupa el almacén se puede reutilizar
+static void storage_size_ring(void) {
+    nvs_stats_t stats;
+    size_t own_entries = 0;
+    if (nvs_get_stats(NULL, &stats) != ESP_OK || nvs_get_used_entry_count(nvs_handle_local, &own_entries) != ESP_OK) {
+        return;
+    }
+    size_t available = stats.free_entries + own_entries;
+    available = (available > STORAGE_NVS_RESERVE_ENTRIES) ? available - STORAGE_NVS_RESERVE_ENTRIES : 0;
+    size_t records = available / STORAGE_ENTRIES_PER_RECORD;
+    if (records < 1) records = 1;
+    if (records > STORAGE_MAX_RECORDS) records = STORAGE_MAX_RECORDS;
+    capacity = (uint32_t)records;
+}
 
 void storage_init(void) {
     // Inicializa la partición nvs
@@ -18,19 +82,111 @@ void storage_init(void) {
         nvs_flash_init();                               // Reintenta inicializarla
     }
     nvs_open("storage", NVS_READWRITE, &nvs_handle_local);
+
+    // Recupera la cola pendiente de ciclos anteriores
+    nvs_get_u32(nvs_handle_local, "head", &head_index);
+    nvs_get_u32(nvs_handle_local, "tail", &tail_index);
+    if (tail_index - head_index > STORAGE_MAX_RECORDS) {
+        ESP_LOGW(TAG, "Índices de almacenamiento incoherentes, reiniciando cola");
+        head_index = tail_index;
+    }
+    purge_stale_records();
+    storage_size_ring();
+
+    // Partición más llena que al guardarlas: se conservan las más recientes
+    if (storage_pending_count() > capacity) {
+        while (storage_pending_count() > capacity) {
+            drop_oldest();
+        }
+        nvs_commit(nvs_handle_local);
+    }
+    ESP_LOGI(TAG, "Almacenamiento listo: %lu muestras pendientes (caben %lu)",
+             (unsigned long)storage_pending_count(), (unsigned long)capacity);
 }
 
 void storage_buffer_data(const sensor_data_t* d) {
     char key[16];
-    // Genera una clave única tipo rec0, rec1 para cada estructura
-    snprintf(key, sizeof(key), "rec%lu", (unsigned long)record_index++);
+    record_key(tail_index, key, sizeof(key));
+
+    // Cola llena: se pierde la muestra más antigua. Antes de escribir, porque con el anillo completo
+    // la nueva ocupa su mismo hueco
+    if (storage_pending_count() >= capacity) {
+        while (storage_pending_count() >= capacity) {
+            drop_oldest();
+        }
+        ESP_LOGW(TAG, "Almacén lleno, descartada la muestra más antigua");
+    }
 
     // Almacena el struct completo en nvs
     esp_err_t err = nvs_set_blob(nvs_handle_local, key, d, sizeof(sensor_data_t));
+    // La partición se ha llenado antes que el anillo (la comparte con otros datos): se hace sitio con
+    // la más antigua, que vale menos que la nueva, y el anillo se queda en lo que ha cabido
+    if (err == ESP_ERR_NVS_NOT_ENOUGH_SPACE && storage_pending_count() > 0) {
+        while (err == ESP_ERR_NVS_NOT_ENOUGH_SPACE && storage_pending_count() > 0) {
+            drop_oldest();
+            err = nvs_set_blob(nvs_handle_local, key, d, sizeof(sensor_data_t));
+        }
+        capacity = storage_pending_count() + 1;
+        ESP_LOGW(TAG, "NVS lleno, almacén reducido a %lu muestras", (unsigned long)capacity);
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error al escribir en NVS: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "Registro guardado en %s", key);
-        nvs_commit(nvs_handle_local);                  // Confirma la escritura en memoria
+        nvs_commit(nvs_handle_local);                  // Confirma los descartes hechos
+        return;
     }
+
+    tail_index++;
+    nvs_set_u32(nvs_handle_local, "tail", tail_index);
+    nvs_commit(nvs_handle_local);                      // Confirma la escritura en memoria
+    ESP_LOGI(TAG, "Registro guardado en %s (%lu pendientes)", key, (unsigned long)storage_pending_count());
+}
+
+uint32_t storage_pending_count(void) {
+    return tail_index - head_index;
+}
+
+esp_err_t storage_peek(uint32_t offset, sensor_data_t* d) {
+    if (!d) return ESP_ERR_INVALID_ARG;
+    if (offset >= storage_pending_count()) return ESP_ERR_NOT_FOUND;
+
+    char key[16];
+    record_key(head_index + offset, key, sizeof(key));
+    size_t size = sizeof(sensor_data_t);
+    esp_err_t err = nvs_get_blob(nvs_handle_local, key, d, &size);
+    // Un registro más corto es de una versión anterior de sensor_data_t: no se puede interpretar
+    if (err == ESP_OK && size != sizeof(sensor_data_t)) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    return err;
+}
+
+esp_err_t storage_peek_oldest(sensor_data_t* d) {
+    return storage_peek(0, d);
+}
+
+void storage_pop_oldest(void) {
+    if (storage_pending_count() == 0) return;
+
+    erase_record(head_index);                           // Libera su espacio para otras claves de la partición
+    head_index++;
+    nvs_set_u32(nvs_handle_local, "head", head_index);
+    nvs_commit(nvs_handle_local);
+}
+
+void storage_discard_oldest(esp_err_t reason) {
+    if (storage_pending_count() == 0) return;
+
+    ESP_LOGW(TAG, "Registro %lu ilegible (%s), descartado", (unsigned long)(head_index % STORAGE_MAX_RECORDS),
+             esp_err_to_name(reason));
+    metrics_counter_inc(METRIC_STORAGE_DISCARDED);
+    diagnostics_event(DIAG_EVT_STORAGE_CORRUPT, reason, (int32_t)(head_index % STORAGE_MAX_RECORDS));
+    storage_pop_oldest();
+}
+
+uint32_t storage_dropped_count(void) {
+    return dropped_count;
+}
+
+uint32_t storage_capacity(void) {
+    return capacity;
 }
@@ -0,0 +1,45 @@
+// File: components/tasks/include/pipeline_bench.h
+
+#pragma once                    // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Benchmark de la cadena sensor_task -> cola -> storage_buffer_data -> communication_publish con
+// muestras sintéticas a ritmos crecientes. Usa las mismas funciones que la tarea de publicación en
+// batería, pero publica en <prefijo>/<id>/bench. Requiere communication_init() y el almacén vacío.
+
+#define PIPELINE_BENCH_MAX_STEPS    16
+
+typedef struct {
+    uint32_t p50_us;
+    uint32_t p95_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} pipeline_latency_t;
+
+typedef struct {
+    float offered_rate;             // Muestras/s inyectadas
+    float sustained_rate;           // Muestras/s publicadas, hasta vaciar la cadena
+    uint32_t produced;
+    uint32_t published;
+    uint32_t dropped_queue;         // Cola llena (mismo criterio que sensor_task: sin espera)
+    uint32_t dropped_storage;       // Almacén lleno: se sobrescribe la más antigua
+    uint32_t publish_failed;        // El cliente MQTT no aceptó el mensaje
+    uint32_t pending_end;           // Sin publicar al acabar la espera de vaciado
+    uint32_t queue_max;
+    float queue_mean;               // Ocupación media de la cola vista por el productor
+    pipeline_latency_t queue;       // Envío a la cola -> recepción en la tarea de publicación
+    pipeline_latency_t store;       // Recepción -> guardada en el almacén
+    pipeline_latency_t publish;     // Guardada -> aceptada por el cliente MQTT
+    pipeline_latency_t total;       // Envío a la cola -> aceptada por el cliente MQTT
+} pipeline_bench_step_t;
+
+// Ejecuta un escalón por ritmo; devuelve los escalones completados o -1 si no puede empezar
+int pipeline_bench_run(const float *rates, int rate_count, uint32_t step_ms, pipeline_bench_step_t *results);
+
+// Resultado de un escalón en json de una línea; devuelve la longitud o -1
+int pipeline_bench_format_json(const pipeline_bench_step_t *step, char *buf, size_t buf_size);
+
+// Escalones de menuconfig con salida por el log (llamar tras communication_init y antes de las tareas)
+void pipeline_bench_run_default(void);
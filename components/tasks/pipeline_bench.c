@@ -0,0 +1,318 @@
+// File: components/tasks/pipeline_bench.c
+
+#include "pipeline_bench.h"
+#include "config.h"
+#include "storage.h"
+#include "communication.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "pipeline_bench";
+
+#define BENCH_RECORDS           1024            // Muestras con latencia registrada por escalón
+#define BENCH_EPOCH0            1577836800      // Sello sintético: 2020-01-01 + nº de secuencia
+#define BENCH_PRODUCER_STACK    3072
+#define BENCH_CONSUMER_STACK    4096
+#define BENCH_PRODUCER_PRI      (tskIDLE_PRIORITY + 2)     // Como sensor_task
+#define BENCH_CONSUMER_PRI      (tskIDLE_PRIORITY + 1)     // Como publish_task
+#define BENCH_SATURATION        0.95f                      // Ritmo sostenido mínimo frente al ofrecido
+#define BENCH_POLL_MS           10
+
+// Instantes de cada muestra (32 bits bajos de esp_timer), indexados por secuencia % BENCH_RECORDS
+typedef struct {
+    uint32_t sent_us[BENCH_RECORDS];
+    uint32_t received_us[BENCH_RECORDS];
+    uint32_t stored_us[BENCH_RECORDS];
+    uint32_t lat_queue[BENCH_RECORDS];
+    uint32_t lat_store[BENCH_RECORDS];
+    uint32_t lat_publish[BENCH_RECORDS];
+    uint32_t lat_total[BENCH_RECORDS];
+} bench_records_t;
+
+static bench_records_t *rec;
+static QueueHandle_t bench_queue;
+static TaskHandle_t owner_task;
+static volatile bool consumer_stop;
+static float step_rate;
+static uint32_t step_ms_cfg;
+static uint32_t seq_base;                       // Primera secuencia del escalón en curso
+static pipeline_bench_step_t *cur;
+static uint32_t lat_count;
+static uint64_t queue_sum;
+static int64_t last_publish_us;
+
+// === PRODUCTOR: mismo envío sin espera que sensor_task ===
+
+static void producer_task(void *arg)
+{
+    (void)arg;
+    const int64_t start_us = esp_timer_get_time();
+    const int64_t end_us = start_us + (int64_t)step_ms_cfg * 1000;
+    uint32_t sent = 0;
+
+    for (;;) {
+        int64_t now = esp_timer_get_time();
+        if (now >= end_us) break;
+
+        // Todas las muestras que tocaban desde el inicio: el ritmo no depende del tick
+        uint32_t due = (uint32_t)((double)(now - start_us) * step_rate / 1e6) + 1;
+        while (sent < due) {
+            uint32_t seq = seq_base + sent++;
+            sensor_data_t d = {
+                .distance_cm = 100.0f + (float)(seq % 100),
+                .weight_kg = 1.0f + (float)(seq % 10) * 0.1f,
+                .battery_voltage = 3.9f,
+                .epoch_s = BENCH_EPOCH0 + seq,
+            };
+            uint32_t waiting = (uint32_t)uxQueueMessagesWaiting(bench_queue);
+            queue_sum += waiting;
+            if (waiting > cur->queue_max) cur->queue_max = waiting;
+            rec->sent_us[seq % BENCH_RECORDS] = (uint32_t)esp_timer_get_time();
+            cur->produced++;
+            if (xQueueSend(bench_queue, &d, 0) != pdTRUE) {
+                cur->dropped_queue++;
+            }
+        }
+        vTaskDelay(1);
+    }
+    xTaskNotifyGive(owner_task);
+    vTaskDelete(NULL);
+}
+
+// === CONSUMIDOR: storage_buffer_data + vaciado, como publish_task en batería ===
+
+static void record_published(const sensor_data_t *d, uint32_t now)
+{
+    uint32_t seq = d->epoch_s - BENCH_EPOCH0;
+    uint32_t i = seq % BENCH_RECORDS;
+    if (seq < seq_base) return;                                 // Resto de un escalón anterior
+    if (lat_count < BENCH_RECORDS) {
+        rec->lat_queue[lat_count] = rec->received_us[i] - rec->sent_us[i];
+        rec->lat_store[lat_count] = rec->stored_us[i] - rec->received_us[i];
+        rec->lat_publish[lat_count] = now - rec->stored_us[i];
+        rec->lat_total[lat_count] = now - rec->sent_us[i];
+        lat_count++;
+    }
+    cur->published++;
+}
+
+static void consumer_task(void *arg)
+{
+    (void)arg;
+    sensor_data_t d, pending;
+
+    while (!consumer_stop) {
+        if (xQueueReceive(bench_queue, &d, pdMS_TO_TICKS(100)) != pdTRUE) continue;
+        uint32_t i = (d.epoch_s - BENCH_EPOCH0) % BENCH_RECORDS;
+        rec->received_us[i] = (uint32_t)esp_timer_get_time();
+        storage_buffer_data(&d);
+        rec->stored_us[i] = (uint32_t)esp_timer_get_time();
+
+        while (storage_peek_oldest(&pending) == ESP_OK) {
+            if (!communication_publish_bench(&pending)) {
+                cur->publish_failed++;
+                break;                                  // Como drain_backlog: se reintenta con la siguiente
+            }
+            storage_pop_oldest();
+            last_publish_us = esp_timer_get_time();
+            record_published(&pending, (uint32_t)last_publish_us);
+        }
+    }
+    xTaskNotifyGive(owner_task);
+    vTaskDelete(NULL);
+}
+
+// === RESULTADOS ===
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void percentiles(uint32_t *values, uint32_t n, pipeline_latency_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (n == 0) return;
+    qsort(values, n, sizeof(uint32_t), cmp_u32);
+    out->p50_us = values[(n - 1) * 50 / 100];
+    out->p95_us = values[(n - 1) * 95 / 100];
+    out->p99_us = values[(n - 1) * 99 / 100];
+    out->max_us = values[n - 1];
+}
+
+static bool step_saturated(const pipeline_bench_step_t *s)
+{
+    return s->dropped_queue > 0 || s->dropped_storage > 0 || s->pending_end > 0
+        || s->sustained_rate < s->offered_rate * BENCH_SATURATION;
+}
+
+int pipeline_bench_run(const float *rates, int rate_count, uint32_t step_ms, pipeline_bench_step_t *results)
+{
+    if (!rates || !results || rate_count <= 0 || step_ms == 0) {
+        return -1;
+    }
+    if (storage_pending_count() > 0) {
+        ESP_LOGW(TAG, "Hay %" PRIu32 " muestras reales pendientes: no se ejecuta el benchmark", storage_pending_count());
+        return -1;
+    }
+    if (!communication_is_mqtt_connected()) {
+        ESP_LOGW(TAG, "MQTT sin conectar: no se ejecuta el benchmark");
+        return -1;
+    }
+
+    rec = calloc(1, sizeof(bench_records_t));
+    bench_queue = xQueueCreate(config_get_u32(CFG_DATA_QUEUE_LENGTH), sizeof(sensor_data_t));
+    if (!rec || !bench_queue) {
+        ESP_LOGE(TAG, "Sin memoria para el benchmark");
+        free(rec);
+        if (bench_queue) vQueueDelete(bench_queue);
+        return -1;
+    }
+    owner_task = xTaskGetCurrentTaskHandle();
+    consumer_stop = false;
+    seq_base = 0;
+
+    pipeline_bench_step_t dummy;
+    cur = &dummy;
+    if (xTaskCreate(consumer_task, "bench_pub", BENCH_CONSUMER_STACK, NULL, BENCH_CONSUMER_PRI, NULL) != pdPASS) {
+        free(rec);
+        vQueueDelete(bench_queue);
+        return -1;
+    }
+
+    int done = 0;
+    bool saturated = false;
+    for (int r = 0; r < rate_count && r < PIPELINE_BENCH_MAX_STEPS; r++) {
+        pipeline_bench_step_t *s = &results[r];
+        memset(s, 0, sizeof(*s));
+        s->offered_rate = rates[r];
+        lat_count = 0;
+        queue_sum = 0;
+        step_rate = rates[r];
+        step_ms_cfg = step_ms;
+        uint32_t storage_dropped_start = storage_dropped_count();
+        cur = s;
+
+        int64_t start_us = esp_timer_get_time();
+        last_publish_us = start_us;
+        if (xTaskCreate(producer_task, "bench_src", BENCH_PRODUCER_STACK, NULL, BENCH_PRODUCER_PRI, NULL) != pdPASS) {
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Esperar a que se vacíen la cola y el almacén, como mucho otro escalón
+        int64_t drain_deadline = esp_timer_get_time() + (int64_t)step_ms * 1000;
+        while ((uxQueueMessagesWaiting(bench_queue) > 0 || storage_pending_count() > 0)
+               && esp_timer_get_time() < drain_deadline) {
+            vTaskDelay(pdMS_TO_TICKS(BENCH_POLL_MS));
+        }
+
+        s->dropped_storage = storage_dropped_count() - storage_dropped_start;
+        s->pending_end = (uint32_t)uxQueueMessagesWaiting(bench_queue) + storage_pending_count();
+        s->queue_mean = s->produced ? (float)queue_sum / (float)s->produced : 0.0f;
+        double active_s = (double)(last_publish_us - start_us) / 1e6;
+        double step_s = step_ms / 1000.0;
+        s->sustained_rate = (float)(s->published / (active_s > step_s ? active_s : step_s));
+        percentiles(rec->lat_queue, lat_count, &s->queue);
+        percentiles(rec->lat_store, lat_count, &s->store);
+        percentiles(rec->lat_publish, lat_count, &s->publish);
+        percentiles(rec->lat_total, lat_count, &s->total);
+
+        // Descartar lo que quede para que no contamine el siguiente escalón ni el almacén real
+        sensor_data_t leftover;
+        while (xQueueReceive(bench_queue, &leftover, 0) == pdTRUE) {
+        }
+        while (storage_peek_oldest(&leftover) == ESP_OK) {
+            storage_pop_oldest();
+        }
+        seq_base += s->produced;
+        done++;
+
+        if (saturated) break;                           // Escalón de confirmación tras la saturación
+        saturated = step_saturated(s);
+    }
+
+    cur = &dummy;
+    consumer_stop = true;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vQueueDelete(bench_queue);
+    bench_queue = NULL;
+    free(rec);
+    rec = NULL;
+    return done;
+}
+
+int pipeline_bench_format_json(const pipeline_bench_step_t *s, char *buf, size_t buf_size)
+{
+    const pipeline_latency_t *lat[4] = { &s->queue, &s->store, &s->publish, &s->total };
+    static const char *const names[4] = { "queue", "store", "publish", "total" };
+
+    int len = snprintf(buf, buf_size,
+                       "{\"offered\":%.1f,\"sustained\":%.2f,\"produced\":%" PRIu32 ",\"published\":%" PRIu32
+                       ",\"drop_queue\":%" PRIu32 ",\"drop_storage\":%" PRIu32 ",\"publish_failed\":%" PRIu32
+                       ",\"pending\":%" PRIu32 ",\"queue_max\":%" PRIu32 ",\"queue_mean\":%.2f",
+                       s->offered_rate, s->sustained_rate, s->produced, s->published, s->dropped_queue,
+                       s->dropped_storage, s->publish_failed, s->pending_end, s->queue_max, s->queue_mean);
+    for (int i = 0; i < 4 && len > 0 && (size_t)len < buf_size; i++) {
+        len += snprintf(buf + len, buf_size - len,
+                        ",\"%s_us\":{\"p50\":%" PRIu32 ",\"p95\":%" PRIu32 ",\"p99\":%" PRIu32 ",\"max\":%" PRIu32 "}",
+                        names[i], lat[i]->p50_us, lat[i]->p95_us, lat[i]->p99_us, lat[i]->max_us);
+    }
+    if (len > 0 && (size_t)len < buf_size) {
+        len += snprintf(buf + len, buf_size - len, "}");
+    }
+    if (len < 0 || (size_t)len >= buf_size) {
+        return -1;
+    }
+    return len;
+}
+
+#if CONFIG_PIPELINE_BENCHMARK
+
+void pipeline_bench_run_default(void)
+{
+    float rates[PIPELINE_BENCH_MAX_STEPS];
+    int count = 0;
+    const char *p = CONFIG_PIPELINE_BENCH_RATES;
+    while (*p && count < PIPELINE_BENCH_MAX_STEPS) {
+        char *end;
+        float r = strtof(p, &end);
+        if (end == p) break;
+        if (r > 0.0f) rates[count++] = r;
+        p = (*end == ',') ? end + 1 : end;
+    }
+
+    static pipeline_bench_step_t results[PIPELINE_BENCH_MAX_STEPS];
+    int steps = pipeline_bench_run(rates, count, CONFIG_PIPELINE_BENCH_STEP_S * 1000, results);
+    char line[512];
+    for (int i = 0; i < steps; i++) {
+        if (pipeline_bench_format_json(&results[i], line, sizeof(line)) > 0) {
+            printf("PIPELINE_BENCH %s\n", line);        // Una línea por escalón para capturar por serie
+        }
+    }
+    float best = 0.0f;
+    for (int i = 0; i < steps; i++) {
+        if (results[i].sustained_rate > best) best = results[i].sustained_rate;
+    }
+    if (steps > 0) {
+        ESP_LOGI(TAG, "Benchmark terminado: %d escalones, máximo sostenido %.1f muestras/s", steps, best);
+    }
+}
+
+#else
+
+void pipeline_bench_run_default(void)
+{
+}
+
+#endif
@@ -5,14 +5,35 @@
 #include "communication.h"
 #include "power_manager.h"
 #include "utils.h"
+#include "aggregation.h"
+#include "event_detector.h"
+#include "snow_metrics.h"
+#include "snow_filter.h"
+#include "energy_budget.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "diagnostics.h"
+#include "config.h"
+#include "commands.h"
+#define DLOG_LOCAL_LEVEL CONFIG_DLOG_LEVEL_TASKS
+#include "dlog.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
 
 static const char* TAG = "tasks";                       // Etiqueta de logs para este módulo
 static QueueHandle_t data_queue;                        // Cola para pasar datos del sensor a la tarea de publicación
+static TaskHandle_t sensor_task_handle;                 // Para despertarla cuando cambia la configuración
 
 // AGREGADO: Instancia global del nivómetro (debe ser inicializada desde main)
 extern nivometro_t g_nivometro;
@@ -21,15 +42,227 @@ extern nivometro_t g_nivometro;
 #define SENSOR_TASK_STACK    4096                       // AUMENTADO: Stack mayor para evitar overflow
 #define SENSOR_TASK_PRI      (tskIDLE_PRIORITY + 2)
 
-// ⚡ INTERVALOS CORREGIDOS - ESTOS SON LOS VALORES REALES QUE SE USAN
-#define SENSOR_PERIOD_USB_MS      5000                  // USB: 5 segundos (mediciones frecuentes)
-#define SENSOR_PERIOD_BATTERY_MS  60000                 // Batería: 60 segundos (máximo ahorro)
-#define SENSOR_PERIOD_DEFAULT_MS  30000                 // Default: 30 segundos
+// Los intervalos de muestreo (CFG_SENSOR_PERIOD_*) y la publicación en crudo (CFG_PUBLISH_RAW) se leen
+// de la configuración en cada ciclo; un cambio despierta a la tarea de sensores con este bit
+#define CFG_CHANGE_NOTIFY_BIT     (1UL << 1)            // POWER_EVENT_NOTIFY_BIT usa el bit 0
+#define COMMAND_NOTIFY_BIT        (1UL << 2)            // Ráfaga o tara pedidas por comando remoto
+
+// Muestras de ráfaga pedidas por el comando "burst"; la tarea de sensores las aplica al detector
+static volatile uint32_t burst_request = 0;
+
+// Tara pedida por el comando "tare". La hace la tarea de sensores, que es la única que lee el HX711.
+// En batería el tope se recorta a la espera a los comandos antes del deep sleep, menos un margen para la respuesta
+#define TARE_TIMEOUT_MS           30000
+#define TARE_REPLY_MARGIN_MS      1000
+#define TARE_POLL_MS              50
+static volatile bool tare_request = false;
+static volatile esp_err_t tare_result = ESP_OK;
+
+// Detector de eventos de nieve. En memoria RTC para conservar el CUSUM entre despertares
+RTC_DATA_ATTR static event_detector_t snow_detector;
+RTC_DATA_ATTR static bool snow_detector_ready = false;
+static event_detector_params_t snow_detector_params;
+
+// Filtro de Kalman de espesor y SWE. En memoria RTC para conservar la estimación entre despertares
+RTC_DATA_ATTR static snow_filter_t snow_filter;
+RTC_DATA_ATTR static bool snow_filter_ready = false;
+static snow_filter_params_t snow_filter_params;
+
+// Pasa la muestra por el filtro y copia la estimación y la estadística de innovación en la muestra
+static void filter_sample(sensor_data_t *d) {
+    snow_metrics_params_t geometry;
+    snow_metrics_t m;
+    snow_filter_output_t kf;
+    snow_metrics_load_params(&geometry);
+    snow_metrics_compute(&geometry, d->distance_cm, nivometro_is_sensor_working(d->sensor_status, NIVOMETRO_SENSOR_ULTRASONIC),
+                         d->weight_kg, nivometro_is_sensor_working(d->sensor_status, NIVOMETRO_SENSOR_SCALE), &m);
+    snow_filter_update(&snow_filter, &snow_filter_params, d->epoch_s,
+                       m.depth_cm, m.depth_valid, m.swe_mm, m.swe_valid, &kf);
+    d->depth_filt_cm = kf.depth_cm;
+    d->depth_rate_cm_h = kf.depth_rate_cm_h;
+    d->swe_filt_mm = kf.swe_mm;
+    d->swe_rate_mm_h = kf.swe_rate_mm_h;
+    d->depth_nis = kf.depth_nis;
+    d->swe_nis = kf.swe_nis;
+    d->filter_flags = kf.flags;
+}
 
 // Parámetros de la tarea de publicación
 #define PUBLISH_TASK_STACK   4096
 #define PUBLISH_TASK_PRI     (tskIDLE_PRIORITY + 1)
 
+// Ventanas de agregación (corta y larga). En memoria RTC para que sobrevivan al deep sleep del modo batería
+#define AGGREGATION_WINDOWS  2
+RTC_DATA_ATTR static aggregate_t aggregators[AGGREGATION_WINDOWS];
+
+// Inicializa las ventanas si es el primer arranque o si ha cambiado su duración en menuconfig
+static void aggregation_setup(void) {
+    const uint32_t windows_s[AGGREGATION_WINDOWS] = {
+        CONFIG_AGGREGATION_WINDOW_SHORT_S,
+        CONFIG_AGGREGATION_WINDOW_LONG_S
+    };
+    for (int i = 0; i < AGGREGATION_WINDOWS; i++) {
+        if (aggregators[i].window_s != windows_s[i]) {
+            aggregation_init(&aggregators[i], windows_s[i]);
+        }
+    }
+}
+
+// Acumula la muestra en cada ventana y publica las ventanas que se cierran
+static void aggregate_and_publish(const sensor_data_t* d) {
+    uint32_t now_s = (d->epoch_s != 0) ? d->epoch_s : (uint32_t)time(NULL);
+    bool distance_ok = nivometro_is_sensor_working(d->sensor_status, NIVOMETRO_SENSOR_ULTRASONIC);  // -1 cm si falló
+    bool weight_ok = nivometro_is_sensor_working(d->sensor_status, NIVOMETRO_SENSOR_SCALE);         // 0 kg si falló
+    aggregate_t closed;
+
+    for (int i = 0; i < AGGREGATION_WINDOWS; i++) {
+        if (aggregation_push(&aggregators[i], now_s, d->distance_cm, distance_ok, d->weight_kg, weight_ok, &closed)) {
+            communication_publish_aggregate(&closed);
+        }
+    }
+}
+
+// Publica en orden las muestras pendientes del almacén por lotes y las retira solo cuando el broker
+// las confirma: lo que siga en vuelo al dormir se reenvía en el próximo ciclo (QoS1 admite duplicados,
+// no pérdidas). Devuelve cuántas se confirmaron
+static uint32_t drain_backlog(void) {
+    sensor_data_t pending;
+    uint32_t sent = 0;
+
+    for (;;) {
+        // Un registro ilegible (error de nvs o de otra versión de sensor_data_t) se descarta: si se
+        // dejara, todas las subidas se pararían en él y el almacén acabaría lleno
+        esp_err_t err = storage_peek_oldest(&pending);
+        if (err == ESP_ERR_NOT_FOUND) break;
+        if (err != ESP_OK) {
+            storage_discard_oldest(err);
+            continue;
+        }
+
+        // El lote acaba en el primer registro ilegible, que será el más antiguo en la próxima vuelta
+        uint32_t batch = 0;
+        bool accepted = true;
+        while (batch < COMMUNICATION_ACK_BATCH && storage_peek(batch, &pending) == ESP_OK) {
+            if (!communication_publish_pending(&pending)) {
+                diagnostics_event(DIAG_EVT_PUBLISH_FAILED, (int32_t)storage_pending_count(), 0);
+                accepted = false;                   // El cliente no acepta más: se reintenta en el próximo ciclo
+                break;
+            }
+            batch++;
+        }
+
+        uint32_t acked = communication_wait_batch_acked(CONFIG_MQTT_BATCH_ACK_TIMEOUT_MS);
+        for (uint32_t i = 0; i < acked; i++) {
+            if (storage_peek_oldest(&pending) == ESP_OK) {
+                aggregate_and_publish(&pending);
+            }
+            storage_pop_oldest();
+            sent++;
+        }
+        if (!accepted || acked < batch) {
+            break;
+        }
+    }
+    return sent;
+}
+
+// Actualiza los indicadores de almacenamiento y memoria y publica una instantánea de métricas
+static void publish_metrics_snapshot(void) {
+    metrics_gauge_set(METRIC_BACKLOG, (int32_t)storage_pending_count());
+    metrics_gauge_set(METRIC_STORAGE_DROPPED, (int32_t)storage_dropped_count());
+    metrics_gauge_set(METRIC_FREE_HEAP, (int32_t)esp_get_free_heap_size());
+    communication_publish_metrics();
+}
+
+// Cambio de intervalos: se aplica ya, sin esperar a que venza la espera en curso
+static void on_period_changed(config_key_t key, void *ctx) {
+    (void)key;
+    (void)ctx;
+    if (sensor_task_handle) {
+        xTaskNotify(sensor_task_handle, CFG_CHANGE_NOTIFY_BIT, eSetBits);
+    }
+}
+
+// Comando {"cmd":"burst","samples":"12"}: muestreo en ráfaga como tras un evento de nieve
+static esp_err_t cmd_burst(const command_t *cmd, char *detail, size_t detail_len, void *ctx) {
+    (void)ctx;
+    char text[12];
+    uint32_t samples = CONFIG_EVENT_BURST_SAMPLES;
+    if (commands_get_arg(cmd, "samples", text, sizeof(text))) {
+        char *end;
+        unsigned long value = strtoul(text, &end, 10);
+        if (*end != '\0' || value == 0 || value > 1000) {
+            snprintf(detail, detail_len, "samples fuera de rango (1-1000)");
+            return ESP_ERR_INVALID_ARG;
+        }
+        samples = (uint32_t)value;
+    }
+    burst_request = samples;
+    if (sensor_task_handle) {
+        xTaskNotify(sensor_task_handle, COMMAND_NOTIFY_BIT, eSetBits);
+    }
+    snprintf(detail, detail_len, "ráfaga de %lu muestras", (unsigned long)samples);
+    return ESP_OK;
+}
+
+// Comando {"cmd":"tare"}: la balanza debe estar vacía. El nuevo offset se guarda con el resto de la calibración
+static esp_err_t cmd_tare(const command_t *cmd, char *detail, size_t detail_len, void *ctx) {
+    (void)cmd;
+    (void)ctx;
+    if (!sensor_task_handle) {
+        snprintf(detail, detail_len, "la tarea de sensores no está en marcha");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Si el deep sleep corta la espera, el id queda visto y la respuesta no sale nunca
+    uint32_t timeout_ms = TARE_TIMEOUT_MS;
+    if (power_manager_get_source() == POWER_SOURCE_BATTERY) {
+        timeout_ms = (CONFIG_COMMANDS_IDLE_WAIT_MS > TARE_REPLY_MARGIN_MS) ?
+                     CONFIG_COMMANDS_IDLE_WAIT_MS - TARE_REPLY_MARGIN_MS : 0;
+        if (timeout_ms > TARE_TIMEOUT_MS) timeout_ms = TARE_TIMEOUT_MS;
+    }
+
+    tare_request = true;
+    xTaskNotify(sensor_task_handle, COMMAND_NOTIFY_BIT, eSetBits);
+    TickType_t start = xTaskGetTickCount();
+    while (tare_request) {
+        if ((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeout_ms)) {
+            tare_request = false;                       // Si aún no ha empezado, ya no se hace
+            snprintf(detail, detail_len, "la tarea de sensores no respondió en %lu ms", (unsigned long)timeout_ms);
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(TARE_POLL_MS));
+    }
+    esp_err_t result = tare_result;
+    if (result == ESP_OK) {
+        snprintf(detail, detail_len, "offset=%ld", (long)g_nivometro.scale.offset);
+    } else if (result == ESP_ERR_INVALID_STATE) {
+        snprintf(detail, detail_len, "sin calibración guardada");
+    } else {
+        snprintf(detail, detail_len, "tara fallida: %s", esp_err_to_name(result));
+    }
+    return result;
+}
+
+// Tara en la tarea de sensores: se parte de la calibración guardada para no perder el factor de escala
+static esp_err_t remote_tare(void) {
+    calibration_data_t cal_data = {0};
+    esp_err_t err = calibration_load_from_nvs(&cal_data);
+    if (err != ESP_OK) {
+        DLOGW(TAG, "Tara remota rechazada: no hay calibración guardada");
+        return ESP_ERR_INVALID_STATE;
+    }
+    err = nivometro_tare_scale(&g_nivometro);
+    if (err != ESP_OK) {
+        DLOGE(TAG, "Error en tara remota: %s", esp_err_to_name(err));
+        return err;
+    }
+    cal_data.hx711_offset = g_nivometro.scale.offset;
+    err = calibration_save_to_nvs(&cal_data);
+    DLOGI(TAG, "Tara remota: offset %ld (%s)", (long)cal_data.hx711_offset, esp_err_to_name(err));
+    return err;
+}
+
 /**
  * Tarea de lectura de sensores con gestión inteligente de energía 
  */
@@ -38,6 +271,20 @@ static void sensor_task(void* _) {
     nivometro_data_t nivometro_data;
     uint32_t measurement_count = 0;
     
+    // Detector de eventos: parámetros de menuconfig y estado conservado si venimos de deep sleep
+    event_detector_default_params(&snow_detector_params);
+    if (!snow_detector_ready) {
+        event_detector_init(&snow_detector);
+        snow_detector_ready = true;
+    }
+    snow_filter_default_params(&snow_filter_params);
+    if (!snow_filter_ready) {
+        snow_filter_init(&snow_filter);
+        snow_filter_ready = true;
+    }
+    
+    // Recibir aviso inmediato cuando cambia la fuente de alimentación
+    power_manager_subscribe(xTaskGetCurrentTaskHandle());
         
     for (;;) {
         measurement_count++;
@@ -49,53 +296,126 @@ static void sensor_task(void* _) {
         
         // === DETERMINACIÓN DE INTERVALO SEGÚN FUENTE ===
         if (power_source == POWER_SOURCE_USB) {
-            // 🔌 MODO USB: Mediciones frecuentes cada 5 segundos
-            delay_ms = SENSOR_PERIOD_USB_MS;  // 5000 ms
+            // 🔌 MODO USB: Mediciones frecuentes (5 segundos por defecto)
+            delay_ms = config_get_u32(CFG_SENSOR_PERIOD_USB_MS);
             mode_str = "USB-FRECUENTE";
             
-            ESP_LOGI(TAG, "[%s] Medición #%lu - Intervalo: %lu ms (5 segundos)", 
+            DLOGI(TAG, "[%s] Medición #%lu - Intervalo: %lu ms", 
                     mode_str, measurement_count, delay_ms);
             
         } else if (power_source == POWER_SOURCE_BATTERY) {
-            // MODO BATERÍA: Mediciones espaciadas cada 60 segundos
-            delay_ms = SENSOR_PERIOD_BATTERY_MS;  // 60000 ms
+            // MODO BATERÍA: intervalo y promediado del HX711 según el plan de energía
             mode_str = "BATERÍA-ESPACIADO";
+            if (!power_manager_uses_deep_sleep() && measurement_count > 1) {
+                energy_budget_begin_cycle();            // En light sleep no hay reinicio: cada muestra es un ciclo
+            }
+            energy_plan_t plan;
+            energy_budget_update(power_manager_read_battery_voltage(), &plan);
             
-            ESP_LOGI(TAG, "[%s] Medición #%lu - Intervalo: %lu ms (60 segundos + sleep)", 
-                    mode_str, measurement_count, delay_ms);
+            if (plan.battery_voltage > 0.0f) {
+                delay_ms = plan.sample_period_s * 1000;
+                nivometro_set_hx711_samples(&g_nivometro, plan.hx711_samples);
+                DLOGI(TAG, "[%s] Medición #%lu - Batería %.2f V (%.0f%%)", 
+                        mode_str, measurement_count, plan.battery_voltage, plan.soc_percent);
+                DLOGI(TAG, "[%s] Intervalo %lu ms, autonomía prevista %.0f h", mode_str, delay_ms, plan.runtime_h);
+            } else {
+                // Sin medida de batería: intervalo fijo (60 segundos por defecto)
+                delay_ms = config_get_u32(CFG_SENSOR_PERIOD_BATTERY_MS);
+                DLOGI(TAG, "[%s] Medición #%lu - Intervalo: %lu ms (+ sleep)", 
+                        mode_str, measurement_count, delay_ms);
+            }
             
         } else {
             // MODO DESCONOCIDO: Usar configuración intermedia
-            delay_ms = SENSOR_PERIOD_DEFAULT_MS;  // 30000 ms
+            delay_ms = config_get_u32(CFG_SENSOR_PERIOD_DEFAULT_MS);
             mode_str = "DESCONOCIDO";
             
-            ESP_LOGW(TAG, "[%s] Medición #%lu - Intervalo: %lu ms (modo intermedio)", 
+            DLOGW(TAG, "[%s] Medición #%lu - Intervalo: %lu ms (modo intermedio)", 
                     mode_str, measurement_count, delay_ms);
         }
         
+        // === TARA REMOTA (antes de leer, con el HX711 libre) ===
+        if (tare_request) {
+            tare_result = remote_tare();
+            tare_request = false;
+        }
+        
         // === LECTURA DE SENSORES ===
+        int64_t read_start_us = esp_timer_get_time();
+        profiler_begin(PROFILE_SENSOR_READ);
         esp_err_t result = nivometro_read_all_sensors(&g_nivometro, &nivometro_data);
+        profiler_end(PROFILE_SENSOR_READ);
+        metrics_histogram_record(METRIC_SENSOR_READ_MS, (uint32_t)((esp_timer_get_time() - read_start_us) / 1000));
         
         if (result == ESP_OK) {
+            metrics_counter_inc(METRIC_SAMPLES_READ);
+            // Tensión real de batería y sello de tiempo UTC (se conserva en el almacén entre despertares)
+            nivometro_data.battery_voltage = power_manager_read_battery_voltage();
+            
             // Convertir nivometro_data_t a sensor_data_t
             nivometro_data_to_sensor_data(&nivometro_data, &d);
+            d.epoch_s = (uint32_t)time(NULL);
+            
+            // === FILTRO DE ESPESOR Y SWE ===
+            filter_sample(&d);
+            if (d.filter_flags & (SNOW_FILTER_DEPTH_GATED | SNOW_FILTER_SWE_GATED)) {
+                metrics_counter_inc(METRIC_FILTER_REJECTED);
+            }
+            
+            // === DETECCIÓN DE EVENTOS DE NIEVE ===
+            // Los canales con lectura fallida o rechazada por el filtro se pasan como NAN para no
+            // contaminar el CUSUM: un pico de nieve volando en el haz no dispara una ráfaga
+            bool distance_ok = nivometro_is_sensor_working(d.sensor_status, NIVOMETRO_SENSOR_ULTRASONIC) &&
+                               !(d.filter_flags & SNOW_FILTER_DEPTH_GATED);
+            bool weight_ok   = nivometro_is_sensor_working(d.sensor_status, NIVOMETRO_SENSOR_SCALE) &&
+                               !(d.filter_flags & SNOW_FILTER_SWE_GATED);
+            float det_distance = distance_ok ? d.distance_cm : NAN;
+            float det_weight   = weight_ok ? d.weight_kg : NAN;
+            if (burst_request > 0) {
+                event_detector_force_burst(&snow_detector, burst_request);
+                burst_request = 0;
+            }
+            bool new_event = event_detector_update(&snow_detector, &snow_detector_params, det_distance, det_weight);
+            d.snow_event = (snow_detector.activity == SNOW_ACTIVITY_EVENT);
+            if (new_event) {
+                diagnostics_event(DIAG_EVT_SNOW_EVENT, (int32_t)(d.distance_cm * 10.0f), (int32_t)(d.weight_kg * 1000.0f));
+                DLOGI(TAG, "[%s] Evento de nieve detectado - muestreo en ráfaga", mode_str);
+            }
             
             // Enviar datos a la cola para procesamiento
             if (xQueueSend(data_queue, &d, 0) != pdTRUE) {
-                ESP_LOGW(TAG, "[%s] Cola llena, descartando muestra", mode_str);
+                metrics_counter_inc(METRIC_SAMPLES_DROPPED);
+                DLOGW(TAG, "[%s] Cola llena, descartando muestra", mode_str);
             } else {
-                ESP_LOGI(TAG, "[%s] Datos enviados: %.2f cm, %.3f kg", 
+                DLOGI(TAG, "[%s] Datos enviados: %.2f cm, %.3f kg", 
                         mode_str, d.distance_cm, d.weight_kg);
             }
+            metrics_gauge_set(METRIC_QUEUE_DEPTH, (int32_t)uxQueueMessagesWaiting(data_queue));
         } else {
-            ESP_LOGE(TAG, "Error leyendo sensores: %s", esp_err_to_name(result));
+            metrics_counter_inc(METRIC_READ_ERRORS);
+            diagnostics_event(DIAG_EVT_SENSOR_ERROR, result, 0);
+            DLOGE(TAG, "Error leyendo sensores: %s", esp_err_to_name(result));
         }
         
+        // === AJUSTE DEL INTERVALO SEGÚN ACTIVIDAD ===
+        // Ráfaga durante eventos; en batería, intervalo largo si la señal está plana
+        uint32_t calm_ms = (power_source == POWER_SOURCE_USB) ? delay_ms : config_get_u32(CFG_EVENT_CALM_PERIOD_MS);
+        delay_ms = event_detector_period_ms(&snow_detector, delay_ms, config_get_u32(CFG_EVENT_BURST_PERIOD_MS), calm_ms);
+        power_manager_set_sleep_period_ms(delay_ms);
+        
         // === LOGGING DE CONFIRMACIÓN DEL INTERVALO ===
-        ESP_LOGI(TAG, "[%s] Esperando %lu ms antes de la siguiente medición", mode_str, delay_ms);
+        DLOGI(TAG, "[%s] Esperando %lu ms antes de la siguiente medición", mode_str, delay_ms);
         
-        // === ESPERAR EL TIEMPO DETERMINADO ===
-        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        // === ESPERAR EL TIEMPO DETERMINADO (o hasta un cambio de alimentación) ===
+        uint32_t events = 0;
+        xTaskNotifyWait(0, POWER_EVENT_NOTIFY_BIT | CFG_CHANGE_NOTIFY_BIT | COMMAND_NOTIFY_BIT, &events, pdMS_TO_TICKS(delay_ms));
+        if (events & POWER_EVENT_NOTIFY_BIT) {
+            DLOGI(TAG, "[%s] Cambio de alimentación - medición inmediata en el nuevo modo", mode_str);
+        } else if (events & CFG_CHANGE_NOTIFY_BIT) {
+            DLOGI(TAG, "[%s] Intervalos reconfigurados - medición inmediata", mode_str);
+        } else if (events & COMMAND_NOTIFY_BIT) {
+            DLOGI(TAG, "[%s] Comando remoto - medición inmediata", mode_str);
+        }
     }
 }
 
@@ -112,72 +432,134 @@ static void publish_task(void* _) {
             // DETECTAR FUENTE DE ALIMENTACIÓN 
             power_source_t power_source = power_manager_get_source();
             
-            // === ALMACENAMIENTO LOCAL (SIEMPRE) ===
-            storage_buffer_data(&d);
-            ESP_LOGI(TAG, "[Pub #%lu] Datos guardados localmente", publish_count);
-            
             if (power_source == POWER_SOURCE_USB) {
                 // ═══════════════════════════════════════
                 // MODO USB: COMUNICACIÓN COMPLETA
                 // ═══════════════════════════════════════
                 
-                ESP_LOGI(TAG, "[USB-Conectado] Publicación #%lu - Modo nominal", publish_count);
+                DLOGI(TAG, "[USB-Conectado] Publicación #%lu - Modo nominal", publish_count);
                 
-                // Asegurar conexión WiFi + MQTT
+                // Asegurar conexión WiFi + MQTT (puede no estar iniciada si arrancamos en batería)
+                if (!communication_is_initialized()) {
+                    DLOGI(TAG, "[USB-Conectado] USB recuperado - iniciando comunicaciones");
+                    communication_init();
+                }
                 communication_wait_for_connection();
                 
-                // Enviar datos al broker
-                communication_publish(&d);
-                ESP_LOGI(TAG, "[USB-Conectado] Datos enviados vía MQTT");
+                // Subir primero lo que quedara pendiente de los ciclos en batería
+                uint32_t drained = drain_backlog();
+                if (drained > 0) {
+                    DLOGI(TAG, "[USB-Conectado] %lu muestras pendientes enviadas", drained);
+                }
+                
+                // Enviar agregados al broker; la muestra en crudo si se ha pedido en menuconfig o hay evento
+                aggregate_and_publish(&d);
+                if (config_get_bool(CFG_PUBLISH_RAW) || d.snow_event) {
+                    communication_publish(&d);
+                }
+                DLOGI(TAG, "[USB-Conectado] Datos enviados vía MQTT");
+                
+                if (publish_count % CONFIG_METRICS_PUBLISH_EVERY == 0) {
+                    publish_metrics_snapshot();
+                }
+                
+                // Volcar el registro de eventos en reposo cuando el anillo va por la mitad
+                if (diagnostics_pending_flush() >= CONFIG_DIAG_RING_SIZE / 2) {
+                    diagnostics_flush();
+                }
                 
                 // Pausa breve y continuar (NO deep sleep)
                 vTaskDelay(pdMS_TO_TICKS(500));
-                ESP_LOGI(TAG, "[USB-Conectado] Continuando en modo nominal");
+                DLOGI(TAG, "[USB-Conectado] Continuando en modo nominal");
                 
             } else if (power_source == POWER_SOURCE_BATTERY) {
                 // ═══════════════════════════════════════
                 // MODO BATERÍA: AHORRO MÁXIMO CON VERIFICACIÓN
                 // ═══════════════════════════════════════
                 
-                ESP_LOGI(TAG, "[Batería] Publicación #%lu - Modo Batería", publish_count);
+                DLOGI(TAG, "[Batería] Publicación #%lu - Modo Batería", publish_count);
+                
+                // === ALMACENAMIENTO LOCAL: la muestra espera en nvs hasta el ciclo de subida ===
+                storage_buffer_data(&d);
+                DLOGI(TAG, "[Pub #%lu] Datos guardados localmente", publish_count);
                 
                 // Verificar peso válido
                 if (d.weight_kg == 0.0f) {
-                    ESP_LOGW(TAG, "[Batería] PESO CERO detectado - Verificar HX711");
+                    DLOGW(TAG, "[Batería] PESO CERO detectado - Verificar HX711");
                 }
                 
-                // Verificar conexión MQTT con timeout
-                ESP_LOGI(TAG, "[Batería] Verificando conexión MQTT...");
-                
-                uint32_t wait_start = xTaskGetTickCount();
-                uint32_t max_wait_ticks = pdMS_TO_TICKS(10000); // 10 segundos
-                
-                while (!communication_is_mqtt_connected() && 
-                       (xTaskGetTickCount() - wait_start) < max_wait_ticks) {
-                    ESP_LOGD(TAG, "[Batería] Esperando conexión MQTT...");
-                    vTaskDelay(pdMS_TO_TICKS(1000));
-                }
-                
-                if (communication_is_mqtt_connected()) {
-                    ESP_LOGI(TAG, "[Batería] MQTT conectado - Enviando datos");
-                    communication_publish(&d);
-                    ESP_LOGI(TAG, "[Batería] Datos enviados");
+                const energy_plan_t* plan = energy_budget_get_plan();
+                if (plan->upload_due || d.snow_event) {
+                    // Ciclo de subida (o evento de nieve): conectar si no se hizo al arrancar
+                    if (!communication_is_initialized()) {
+                        DLOGI(TAG, "[Batería] Evento de nieve - conectando fuera de ciclo");
+                        communication_init();
+                    }
+                    
+                    // Verificar conexión MQTT con timeout
+                    DLOGI(TAG, "[Batería] Verificando conexión MQTT...");
+                    
+                    uint32_t wait_start = xTaskGetTickCount();
+                    uint32_t max_wait_ticks = pdMS_TO_TICKS(10000); // 10 segundos
                     
-                    // Dar tiempo para confirmación
-                    vTaskDelay(pdMS_TO_TICKS(3000));
+                    while (!communication_is_mqtt_connected() && 
+                           (xTaskGetTickCount() - wait_start) < max_wait_ticks) {
+                        DLOGD(TAG, "[Batería] Esperando conexión MQTT...");
+                        vTaskDelay(pdMS_TO_TICKS(1000));
+                    }
+                    
+                    if (communication_is_mqtt_connected()) {
+                        DLOGI(TAG, "[Batería] MQTT conectado - Enviando lote");
+                        profiler_begin(PROFILE_PUBLISH);
+                        uint32_t sent = drain_backlog();
+                        communication_publish_status(plan, storage_pending_count());
+                        publish_metrics_snapshot();
+                        if (profiler_summary_ready() && communication_publish_profile()) {
+                            profiler_reset_summary();
+                        }
+                        profiler_end(PROFILE_PUBLISH);
+                        if (storage_pending_count() == 0) {
+                            energy_budget_mark_uploaded();
+                        }
+                        DLOGI(TAG, "[Batería] %lu muestras enviadas", sent);
+                        
+                        // Dar tiempo para confirmación
+                        profiler_begin(PROFILE_ACK_WAIT);
+                        vTaskDelay(pdMS_TO_TICKS(3000));
+                        // Los comandos que el broker guardaba llegan al conectar: terminarlos antes de dormir
+                        commands_wait_idle(CONFIG_COMMANDS_IDLE_WAIT_MS);
+                        profiler_end(PROFILE_ACK_WAIT);
+                    } else {
+                        DLOGW(TAG, "[Batería] MQTT no conectado - %lu muestras quedan para el próximo ciclo",
+                                 storage_pending_count());
+                    }
                 } else {
-                    ESP_LOGW(TAG, "[Batería] MQTT no conectado - Enviando de todas formas");
-                    communication_publish(&d);
-                    vTaskDelay(pdMS_TO_TICKS(5000));
+                    DLOGI(TAG, "[Batería] Sin subida en este ciclo (%lu pendientes, subida cada %lu)",
+                             storage_pending_count(), plan->upload_every);
                 }
                 
                 // Verificar si debe entrar en deep sleep
                 if (power_manager_should_sleep()) {
-                    ESP_LOGI(TAG, "[Batería] Condiciones para modo batería cumplidas");
-                    ESP_LOGI(TAG, "[Batería] Esperando 2 segundos antes de deep sleep...");
+                    DLOGI(TAG, "[Batería] Condiciones para modo batería cumplidas");
+                    DLOGI(TAG, "[Batería] Esperando 2 segundos antes de deep sleep...");
+                    profiler_begin(PROFILE_SLEEP_DELAY);
                     vTaskDelay(pdMS_TO_TICKS(2000));
+                    profiler_end(PROFILE_SLEEP_DELAY);
+                    
+                    // Lo que la tarea de sensores haya dejado en la cola mientras se esperaban las
+                    // confirmaciones se guarda: la RAM no sobrevive al deep sleep
+                    sensor_data_t queued;
+                    while (xQueueReceive(data_queue, &queued, 0) == pdTRUE) {
+                        storage_buffer_data(&queued);
+                    }
                     
-                    ESP_LOGI(TAG, "[Batería] Entrando en deep_sleep...");
+                    DLOGI(TAG, "[Batería] Entrando en deep_sleep...");
+                    profiler_cycle_end();
+                    if (diagnostics_pending_flush() >= CONFIG_DIAG_RING_SIZE / 2) {
+                        diagnostics_flush();                // El anillo RTC sobrevive al sueño: volcar solo por lotes
+                    }
+                    boot_button_enable_wakeup();
+                    led_stop_task();                    // Suelta RTC8M: en deep sleep el LEDC no funciona y solo sumaría consumo
                     power_manager_enter_deep_sleep();
                     
                     // EL SISTEMA SE REINICIA AQUÍ 
@@ -190,10 +572,11 @@ static void publish_task(void* _) {
                 // MODO DESCONOCIDO: COMPORTAMIENTO CONSERVATIVO
                 // ═══════════════════════════════════════
                 
-                ESP_LOGW(TAG, "[DESCONOCIDO] Publicación #%lu - modo conservativo", publish_count);
+                DLOGW(TAG, "[DESCONOCIDO] Publicación #%lu - modo conservativo", publish_count);
                 
                 communication_publish(&d);
-                ESP_LOGI(TAG, "[DESCONOCIDO] Datos enviados (modo conservativo)");
+                aggregate_and_publish(&d);
+                DLOGI(TAG, "[DESCONOCIDO] Datos enviados (modo conservativo)");
                 
                 vTaskDelay(pdMS_TO_TICKS(1000));
             }
@@ -204,17 +587,22 @@ static void publish_task(void* _) {
 void tasks_start_all(void) {
     ESP_LOGI(TAG, "Iniciando todas las tareas con gestión inteligente de energía");
     ESP_LOGI(TAG, "Intervalos configurados:");
-    ESP_LOGI(TAG, "Nominal: %d ms (%d segundos)", SENSOR_PERIOD_USB_MS, SENSOR_PERIOD_USB_MS/1000);
-    ESP_LOGI(TAG, "Batería: %d ms (%d segundos)", SENSOR_PERIOD_BATTERY_MS, SENSOR_PERIOD_BATTERY_MS/1000);
-    ESP_LOGI(TAG, "Default: %d ms (%d segundos)", SENSOR_PERIOD_DEFAULT_MS, SENSOR_PERIOD_DEFAULT_MS/1000);
+    ESP_LOGI(TAG, "Nominal: %lu ms", (unsigned long)config_get_u32(CFG_SENSOR_PERIOD_USB_MS));
+    ESP_LOGI(TAG, "Batería: %lu ms", (unsigned long)config_get_u32(CFG_SENSOR_PERIOD_BATTERY_MS));
+    ESP_LOGI(TAG, "Default: %lu ms", (unsigned long)config_get_u32(CFG_SENSOR_PERIOD_DEFAULT_MS));
     
-    // Crear la cola con capacidad para 10 muestras de sensor_data_t
-    data_queue = xQueueCreate(10, sizeof(sensor_data_t));
+    // Ventanas de agregación entre la lectura y la publicación
+    aggregation_setup();
+    ESP_LOGI(TAG, "Agregación: ventanas de %d s y %d s", CONFIG_AGGREGATION_WINDOW_SHORT_S, CONFIG_AGGREGATION_WINDOW_LONG_S);
+
+    // Crear la cola de sensor_data_t (10 muestras por defecto; el cambio se aplica al reiniciar)
+    uint32_t queue_length = config_get_u32(CFG_DATA_QUEUE_LENGTH);
+    data_queue = xQueueCreate(queue_length, sizeof(sensor_data_t));
     if (!data_queue) {
         ESP_LOGE(TAG, "Error: No se pudo crear la cola de datos");
         return;
     }
-    ESP_LOGI(TAG, "Cola de datos creada (capacidad: 10 muestras)");
+    ESP_LOGI(TAG, "Cola de datos creada (capacidad: %lu muestras)", (unsigned long)queue_length);
 
     // Lanzar la tarea de lectura de sensores con stack aumentado
     BaseType_t sensor_result = xTaskCreate(
@@ -223,11 +611,18 @@ void tasks_start_all(void) {
         SENSOR_TASK_STACK,  // 4096 bytes (aumentado)
         NULL, 
         SENSOR_TASK_PRI, 
-        NULL
+        &sensor_task_handle
     );
     
     if (sensor_result == pdPASS) {
         ESP_LOGI(TAG, "Tarea de sensores creada con stack de %d bytes", SENSOR_TASK_STACK);
+        config_subscribe(CFG_SENSOR_PERIOD_USB_MS, on_period_changed, NULL);
+        config_subscribe(CFG_SENSOR_PERIOD_BATTERY_MS, on_period_changed, NULL);
+        config_subscribe(CFG_SENSOR_PERIOD_DEFAULT_MS, on_period_changed, NULL);
+        config_subscribe(CFG_EVENT_BURST_PERIOD_MS, on_period_changed, NULL);
+        config_subscribe(CFG_EVENT_CALM_PERIOD_MS, on_period_changed, NULL);
+        commands_register("burst", cmd_burst, NULL);
+        commands_register("tare", cmd_tare, NULL);
     } else {
         ESP_LOGE(TAG, "Error creando tarea de sensores");
         return;
@@ -252,6 +647,6 @@ void tasks_start_all(void) {
 
     ESP_LOGI(TAG, "Todas las tareas iniciadas correctamente");
     ESP_LOGI(TAG, "Gestión automática de energía activa:");
-    ESP_LOGI(TAG, "USB conectado → Mediciones cada 5 segundos, modo nominal");
-    ESP_LOGI(TAG, "Solo batería → Mediciones cada 60 segundos + modo batería");
+    ESP_LOGI(TAG, "USB conectado → Mediciones frecuentes, modo nominal");
+    ESP_LOGI(TAG, "Solo batería → Intervalo según el plan de energía + modo batería");
 }
\ No newline at end of file
@@ -19,6 +19,8 @@ int data_formatter_format_json(const sensor_data_t *data, char *buf, size_t bufs
 // Definiciones fijas para NVS
 #define CALIBRATION_NVS_NAMESPACE   "calibration" // Namespace para datos de calibración
 #define CALIBRATION_MAGIC_NUMBER    0xCAFEBABE 
+#define CALIBRATION_RECORD_VERSION  2             // Formato del registro con secuencia y CRC32
+#define CALIBRATION_SLOT_COUNT      2             // Ranuras alternas (A/B) en NVS
 
 
 // Estados del LED (6 estados diferenciados)
@@ -31,18 +33,18 @@ typedef enum {
     LED_STATE_SOLID_ON          // ⚪ Proceso completo - encendido fijo
 } led_state_t;
 
-// Períodos fijos para cada estado (en milisegundos) - VALORES MÁS VISIBLES
+// Semiperiodos fijos para cada estado (en milisegundos, encendido = apagado) - VALORES MÁS VISIBLES
 #define LED_PERIOD_NORMAL_MS        2000    // 🟢 Lento
 #define LED_PERIOD_WARNING_MS       800     // 🟡 Medio 
 #define LED_PERIOD_CALIBRATION_MS   200     // 🔵 Rápido  
 #define LED_PERIOD_ERROR_MS         75      // 🔴 Muy rápido
 
 // Funciones de control LED
-void led_init(void);                        // Inicializa el GPIO del LED
-void led_start_task(void);                  // Inicia la tarea de control automático del LED
-void led_set_state(led_state_t state);      // Cambia el estado del LED
+void led_init(void);                        // Configura el LEDC (temporizador + canal) en el pin del LED
+void led_start_task(void);                  // Aplica el estado actual; el parpadeo lo genera el hardware, sin tarea
+void led_set_state(led_state_t state);      // Cambia el estado del LED (seguro desde cualquier tarea)
 led_state_t led_get_state(void);            // Obtiene el estado actual del LED
-void led_stop_task(void);                   // Detiene la tarea de control del LED
+void led_stop_task(void);                   // Detiene la salida PWM y deja el LED apagado
 
 // Definiciones para calibración
 #define BOOT_BUTTON_PIN         GPIO_NUM_0   // Botón BOOT de la ESP32
@@ -58,12 +60,16 @@ typedef struct {
     float known_weight_used;            // Peso conocido usado en calibración
     float known_distance_used;          // Distancia conocida usada en calibración
     uint32_t calibration_timestamp;     // Timestamp de cuándo se calibró
+    // Calibración multipunto (añadido al final: los registros antiguos acaban en calibration_timestamp)
+    uint8_t hx711_curve_order;          // 0: solo factor de escala; 1-2: polinomio ajustado
+    float hx711_curve[HX711_CURVE_MAX_ORDER + 1]; // Peso(g) = c0 + c1·x + c2·x², x = bruto - offset
+    int32_t hx711_curve_min;            // Rango de cuentas netas cubierto por los puntos de referencia
+    int32_t hx711_curve_max;
 } calibration_data_t;
 
 // Funciones de gestión NVS para calibración
 esp_err_t calibration_save_to_nvs(const calibration_data_t *cal_data);
 esp_err_t calibration_load_from_nvs(calibration_data_t *cal_data);
-esp_err_t calibration_all_nvs_partition(void);
 bool calibration_check_and_warn(void);
 esp_err_t calibration_apply_to_sensors(nivometro_t *nivometro, const calibration_data_t *cal_data);
 
@@ -71,6 +77,7 @@ esp_err_t calibration_apply_to_sensors(nivometro_t *nivometro, const calibration
 void boot_button_init(void);                    // Inicializa el botón BOOT
 bool boot_button_check_calibration_mode(void);  // Verifica si se debe entrar en modo calibración
 void boot_button_wait_for_press(void);          // Espera a que el usuario presione BOOT
+void boot_button_enable_wakeup(void);           // Habilita BOOT como fuente de despertar del deep sleep
 
 // Funciones de validación para calibración
 bool validate_calibration_data(const calibration_data_t *cal_data);
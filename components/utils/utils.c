@@ -4,6 +4,7 @@
 #include "sdkconfig.h"
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -13,6 +14,12 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "freertos/queue.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_rom_crc.h"
 
 static const char* TAG = "utils";
 
@@ -38,117 +45,303 @@ int data_formatter_format_json(const sensor_data_t *data, char *buf, size_t bufs
     );
 }
 
-// Variables globales para control del LED
-static TaskHandle_t led_task_handle = NULL;
+// Control del LED por hardware (LEDC): el parpadeo lo genera el temporizador PWM con un
+// ciclo de trabajo del 50 % y un periodo igual al del patrón, así que no hay tarea que
+// despierte a la CPU. El reloj RTC8M sigue activo en light sleep y el LED no se detiene.
+#define LED_LEDC_MODE           LEDC_LOW_SPEED_MODE
+#define LED_LEDC_TIMER          LEDC_TIMER_0
+#define LED_LEDC_CHANNEL        LEDC_CHANNEL_0
+#define LED_LEDC_RESOLUTION     LEDC_TIMER_16_BIT
+#define LED_LEDC_DUTY_MAX       (1UL << 16)          // Encendido fijo (100 %)
+#define LED_LEDC_CLK_HZ         8000000ULL           // RTC8M nominal (precisión suficiente para un parpadeo)
+#define LED_LEDC_DIV_MAX        ((1UL << 18) - 1)    // Divisor Q10.8 de 18 bits
+
+static portMUX_TYPE led_lock = portMUX_INITIALIZER_UNLOCKED;
 static led_state_t current_led_state = LED_STATE_OFF;
+static bool led_ledc_ready = false;
+static bool rtc8m_held = false;             // Referencia propia sobre el dominio RTC8M
 
-// Controla el LED según el estado actual
-static void led_control_task(void *pvParameters) {
-    bool led_physical_state = false;
-    uint32_t delay_ms;
-       
-    while (1) {
-        switch (current_led_state) {
-            case LED_STATE_NORMAL:
-                // 🟢 Normal calibrado - parpadeo muy lento
-                delay_ms = LED_PERIOD_NORMAL_MS;
-                led_physical_state = !led_physical_state;
-                gpio_set_level(LED_STATUS_PIN, led_physical_state);
-                break;
-                
-            case LED_STATE_WARNING:
-                // 🟡 Normal sin calibrar - parpadeo medio
-                delay_ms = LED_PERIOD_WARNING_MS;
-                led_physical_state = !led_physical_state;
-                gpio_set_level(LED_STATUS_PIN, led_physical_state);
-                break;
-                
-            case LED_STATE_CALIBRATION:
-                // 🔵 Modo calibración - parpadeo rápido
-                delay_ms = LED_PERIOD_CALIBRATION_MS;
-                led_physical_state = !led_physical_state;
-                gpio_set_level(LED_STATUS_PIN, led_physical_state);
-                break;
-                
-            case LED_STATE_ERROR:
-                // 🔴 Error/fallo - parpadeo muy rápido
-                delay_ms = LED_PERIOD_ERROR_MS;
-                led_physical_state = !led_physical_state;
-                gpio_set_level(LED_STATUS_PIN, led_physical_state);
-                break;
-                
-            case LED_STATE_SOLID_ON:
-                // ⚪ Proceso completo - encendido fijo
-                delay_ms = 100;  // Verificar cada 100ms pero mantener encendido
-                gpio_set_level(LED_STATUS_PIN, 1);
-                break;
-                
-            case LED_STATE_OFF:
-            default:
-                // ⚫ Sistema apagado
-                delay_ms = 100;  // Verificar cada 100ms pero mantener apagado
-                gpio_set_level(LED_STATUS_PIN, 0);
-                break;
-        }
-        
-        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+// Semiperiodo de cada patrón (tiempo encendido = tiempo apagado); 0 si no parpadea
+static uint32_t led_half_period_ms(led_state_t state) {
+    switch (state) {
+        case LED_STATE_NORMAL:      return LED_PERIOD_NORMAL_MS;       // 🟢 Normal calibrado - parpadeo muy lento
+        case LED_STATE_WARNING:     return LED_PERIOD_WARNING_MS;      // 🟡 Normal sin calibrar - parpadeo medio
+        case LED_STATE_CALIBRATION: return LED_PERIOD_CALIBRATION_MS;  // 🔵 Modo calibración - parpadeo rápido
+        case LED_STATE_ERROR:       return LED_PERIOD_ERROR_MS;        // 🔴 Error/fallo - parpadeo muy rápido
+        default:                    return 0;
+    }
+}
+
+// Programa el divisor del temporizador para un periodo de parpadeo completo de period_ms
+static esp_err_t led_ledc_set_period_ms(uint32_t period_ms) {
+    // f_timer = clk / (div * 2^res)  ->  div = clk * T / 2^res, en coma fija Q10.8
+    uint64_t div_q8 = (LED_LEDC_CLK_HZ * period_ms * 256ULL) / (1000ULL << LED_LEDC_RESOLUTION);
+    if (div_q8 < 256) div_q8 = 256;
+    if (div_q8 > LED_LEDC_DIV_MAX) div_q8 = LED_LEDC_DIV_MAX;
+    return ledc_timer_set(LED_LEDC_MODE, LED_LEDC_TIMER, (uint32_t)div_q8, LED_LEDC_RESOLUTION, LEDC_SCLK);
+}
+
+// RTC8M encendido en light sleep solo mientras hay parpadeo. esp_sleep_pd_config() cuenta referencias:
+// cada ON suma una, solo OFF la quita y AUTO no hace nada con referencias pendientes. Por eso se pide
+// una vez al entrar en un patrón de parpadeo y se suelta una vez al salir
+static void led_hold_rtc8m(bool hold) {
+    taskENTER_CRITICAL(&led_lock);
+    bool change = (hold != rtc8m_held);
+    rtc8m_held = hold;
+    taskEXIT_CRITICAL(&led_lock);
+    if (change) {
+        esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, hold ? ESP_PD_OPTION_ON : ESP_PD_OPTION_OFF);
     }
 }
 
+// Traduce el estado a periodo y ciclo de trabajo en el periférico
+static void led_apply_state(led_state_t state) {
+    uint32_t half_ms = led_half_period_ms(state);
+    uint32_t duty;
+
+    led_hold_rtc8m(half_ms > 0);                // Fijo o apagado no necesita reloj
+    if (half_ms > 0) {
+        led_ledc_set_period_ms(half_ms * 2);
+        ledc_timer_rst(LED_LEDC_MODE, LED_LEDC_TIMER);           // Empezar el patrón desde el principio
+        duty = LED_LEDC_DUTY_MAX / 2;
+    } else if (state == LED_STATE_SOLID_ON) {
+        duty = LED_LEDC_DUTY_MAX;                                  // ⚪ Proceso completo - encendido fijo
+    } else {
+        duty = 0;                                                  // ⚫ Sistema apagado
+    }
+    ledc_set_duty(LED_LEDC_MODE, LED_LEDC_CHANNEL, duty);
+    ledc_update_duty(LED_LEDC_MODE, LED_LEDC_CHANNEL);
+}
+
 void led_init(void) {
     // Resetear completamente el pin primero
     gpio_reset_pin(LED_STATUS_PIN);
     
-    // Configurar GPIO del LED
-    gpio_config_t led_config = {
-        .pin_bit_mask = (1ULL << LED_STATUS_PIN),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE
+    // Temporizador LEDC sobre el reloj RTC8M para que siga funcionando en light sleep.
+    // La frecuencia inicial es provisional: cada estado fija su propio divisor
+    ledc_timer_config_t timer_config = {
+        .speed_mode      = LED_LEDC_MODE,
+        .duty_resolution = LED_LEDC_RESOLUTION,
+        .timer_num       = LED_LEDC_TIMER,
+        .freq_hz         = 1,
+        .clk_cfg         = LEDC_USE_RTC8M_CLK
     };
+    esp_err_t result = ledc_timer_config(&timer_config);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Error configurando temporizador LEDC: %s", esp_err_to_name(result));
+        return;
+    }
     
-    esp_err_t result = gpio_config(&led_config);
+    // Canal en el pin del LED, inicialmente apagado
+    ledc_channel_config_t channel_config = {
+        .gpio_num   = LED_STATUS_PIN,
+        .speed_mode = LED_LEDC_MODE,
+        .channel    = LED_LEDC_CHANNEL,
+        .intr_type  = LEDC_INTR_DISABLE,
+        .timer_sel  = LED_LEDC_TIMER,
+        .duty       = 0,
+        .hpoint     = 0
+    };
+    result = ledc_channel_config(&channel_config);
     if (result != ESP_OK) {
-        ESP_LOGE(TAG, "Error configurando GPIO %d: %s", LED_STATUS_PIN, esp_err_to_name(result));
+        ESP_LOGE(TAG, "Error configurando canal LEDC en GPIO %d: %s", LED_STATUS_PIN, esp_err_to_name(result));
         return;
     }
     
-    // LED inicialmente apagado
-    gpio_set_level(LED_STATUS_PIN, 0);
+    taskENTER_CRITICAL(&led_lock);
     current_led_state = LED_STATE_OFF;
-    
+    led_ledc_ready = true;
+    taskEXIT_CRITICAL(&led_lock);
 }
 void led_start_task(void) {
-    if (led_task_handle == NULL) {
-        xTaskCreate(led_control_task, "led_control", 2048, NULL, 1, &led_task_handle);
-        ESP_LOGI(TAG, "Tarea de control LED iniciada");
+    // El patrón lo genera el LEDC: solo hay que aplicar el estado actual
+    if (led_ledc_ready) {
+        led_apply_state(led_get_state());
+        ESP_LOGI(TAG, "Control LED por hardware (LEDC) activo");
     }
 }
-// Cambia el estado del LED y actualiza la tarea de control
+// Cambia el estado del LED y reprograma el periférico
 void led_set_state(led_state_t state) {
+    taskENTER_CRITICAL(&led_lock);
+    bool changed = (state != current_led_state);
     current_led_state = state;
-    const char* state_names[] = {
-        "⚫ APAGADO", "🟢 NORMAL", "🟡 ADVERTENCIA", 
-        "🔵 CALIBRACIÓN", "🔴 ERROR", "⚪ ENCENDIDO"
-    };
-    ESP_LOGI(TAG, "LED estado cambiado: %s", state_names[state]);
+    bool ready = led_ledc_ready;
+    taskEXIT_CRITICAL(&led_lock);
+    
+    if (ready) {
+        led_apply_state(state);
+    }
+    if (changed) {
+        const char* state_names[] = {
+            "⚫ APAGADO", "🟢 NORMAL", "🟡 ADVERTENCIA", 
+            "🔵 CALIBRACIÓN", "🔴 ERROR", "⚪ ENCENDIDO"
+        };
+        ESP_LOGI(TAG, "LED estado cambiado: %s", state_names[state]);
+    }
 }
 led_state_t led_get_state(void) {
-    return current_led_state;
+    taskENTER_CRITICAL(&led_lock);
+    led_state_t state = current_led_state;
+    taskEXIT_CRITICAL(&led_lock);
+    return state;
 }
 void led_stop_task(void) {
-    if (led_task_handle != NULL) {
-        vTaskDelete(led_task_handle);
-        led_task_handle = NULL;
-        gpio_set_level(LED_STATUS_PIN, 0);
-        
+    if (led_ledc_ready) {
+        ledc_stop(LED_LEDC_MODE, LED_LEDC_CHANNEL, 0);      // Salida a nivel bajo
+        led_hold_rtc8m(false);
+    }
+}
+
+// Registro de calibración en NVS: dos ranuras alternas ("cal_a"/"cal_b") con número de
+// secuencia y CRC32. Se escribe siempre en la ranura que no contiene la calibración activa, así
+// que una escritura interrumpida deja intacta la anterior. Nunca se borra la partición.
+typedef struct {
+    uint16_t version;                   // CALIBRATION_RECORD_VERSION
+    uint16_t length;                    // sizeof(calibration_data_t) al escribir
+    uint32_t seq;                       // Crece en cada escritura; gana la mayor
+    calibration_data_t data;
+    uint32_t crc32;                     // CRC32 de todos los campos anteriores
+} calibration_record_t;
+
+static const char *const s_cal_slot_keys[CALIBRATION_SLOT_COUNT] = { "cal_a", "cal_b" };
+#define CALIBRATION_LEGACY_KEY  "cal_data"   // Formato anterior (solo lectura, para migrar)
+
+// Datos de antes de la calibración multipunto: acaban en calibration_timestamp. Es el tamaño de la
+// clave antigua y de los registros de la versión 1 de las ranuras
+#define CALIBRATION_V1_DATA_LEN     offsetof(calibration_data_t, hx711_curve_order)
+#define CALIBRATION_V1_RECORD_SIZE  (offsetof(calibration_record_t, data) + CALIBRATION_V1_DATA_LEN + sizeof(uint32_t))
+
+// Copia en RAM: la NVS se lee una única vez por arranque
+static bool s_cal_loaded = false;
+static esp_err_t s_cal_status = ESP_ERR_NOT_FOUND;
+static calibration_data_t s_cal_data;
+static int s_cal_active_slot = -1;       // Ranura con la calibración vigente (-1: ninguna)
+static uint32_t s_cal_last_seq = 0;      // Mayor secuencia vista en cualquiera de las ranuras
+
+static uint32_t calibration_record_crc(const calibration_record_t *rec) {
+    return esp_rom_crc32_le(0, (const uint8_t *)rec, offsetof(calibration_record_t, crc32));
+}
+
+// Registro de la versión 1 (se reconoce por el tamaño): se valida con su propio CRC, que va justo
+// detrás de los datos, y se completa como una calibración de solo factor de escala
+static esp_err_t calibration_upgrade_v1_slot(int slot, calibration_record_t *rec) {
+    size_t crc_offset = offsetof(calibration_record_t, data) + CALIBRATION_V1_DATA_LEN;
+    uint32_t stored_crc;
+    memcpy(&stored_crc, (const uint8_t *)rec + crc_offset, sizeof(stored_crc));
+    if (rec->length != CALIBRATION_V1_DATA_LEN || stored_crc != esp_rom_crc32_le(0, (const uint8_t *)rec, crc_offset)) {
+        ESP_LOGW(TAG, "Ranura de calibración %s (v1) no válida, se ignora", s_cal_slot_keys[slot]);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    memset((uint8_t *)&rec->data + CALIBRATION_V1_DATA_LEN, 0, sizeof(rec->data) - CALIBRATION_V1_DATA_LEN);
+    rec->data.hx711_curve_order = 0;
+    rec->version = CALIBRATION_RECORD_VERSION;
+    rec->length = sizeof(calibration_data_t);
+    rec->crc32 = calibration_record_crc(rec);
+    ESP_LOGI(TAG, "Ranura de calibración %s en formato v1: sin curva multipunto", s_cal_slot_keys[slot]);
+    return ESP_OK;
+}
+
+// Lee y valida una ranura. ESP_ERR_INVALID_CRC si existe pero está corrupta o es de otra versión
+static esp_err_t calibration_read_slot(nvs_handle_t handle, int slot, calibration_record_t *rec) {
+    size_t size = sizeof(*rec);
+    esp_err_t err = nvs_get_blob(handle, s_cal_slot_keys[slot], rec, &size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (size == CALIBRATION_V1_RECORD_SIZE && rec->version == 1) {
+        return calibration_upgrade_v1_slot(slot, rec);
+    }
+    if (size != sizeof(*rec) || rec->version != CALIBRATION_RECORD_VERSION ||
+        rec->length != sizeof(calibration_data_t) || rec->crc32 != calibration_record_crc(rec)) {
+        ESP_LOGW(TAG, "Ranura de calibración %s no válida, se ignora", s_cal_slot_keys[slot]);
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+static bool calibration_record_usable(const calibration_data_t *data) {
+    return data->magic_number == CALIBRATION_MAGIC_NUMBER && data->calibrated;
+}
+
+// Recorre las dos ranuras (y la clave antigua si no hay ninguna) y fija la calibración vigente
+static void calibration_load_cache(void) {
+    s_cal_loaded = true;
+    s_cal_status = ESP_ERR_NOT_FOUND;
+    s_cal_active_slot = -1;
+    s_cal_last_seq = 0;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CALIBRATION_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo abrir NVS para calibración: %s", esp_err_to_name(err));
+        s_cal_status = (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_ERR_NOT_FOUND : err;
+        return;
+    }
+
+    bool corrupt = false;
+    uint32_t best_seq = 0;
+    for (int slot = 0; slot < CALIBRATION_SLOT_COUNT; slot++) {
+        calibration_record_t rec;
+        err = calibration_read_slot(handle, slot, &rec);
+        if (err == ESP_ERR_INVALID_CRC) {
+            corrupt = true;
+        }
+        if (err != ESP_OK) {
+            continue;
+        }
+        if (rec.seq > s_cal_last_seq) {
+            s_cal_last_seq = rec.seq;
+        }
+        // Un registro sin completar (solo tara) no sustituye a una calibración completa
+        if (calibration_record_usable(&rec.data) && (s_cal_active_slot < 0 || rec.seq > best_seq)) {
+            s_cal_active_slot = slot;
+            best_seq = rec.seq;
+            s_cal_data = rec.data;
+        }
+    }
+
+    if (s_cal_active_slot < 0 && s_cal_last_seq == 0) {
+        // Equipos calibrados con el formato anterior: se acepta hasta la próxima calibración
+        size_t size = sizeof(calibration_data_t);
+        memset(&s_cal_data, 0, sizeof(s_cal_data));
+        err = nvs_get_blob(handle, CALIBRATION_LEGACY_KEY, &s_cal_data, &size);
+        if (err == ESP_OK && size == CALIBRATION_V1_DATA_LEN &&
+            calibration_record_usable(&s_cal_data)) {
+            ESP_LOGI(TAG, "Calibración en formato antiguo (%s)", CALIBRATION_LEGACY_KEY);
+            nvs_close(handle);
+            s_cal_status = ESP_OK;
+            return;
+        }
+    }
+    nvs_close(handle);
+
+    if (s_cal_active_slot >= 0) {
+        ESP_LOGI(TAG, "Calibración cargada de la ranura %s (secuencia %lu)",
+                 s_cal_slot_keys[s_cal_active_slot], (unsigned long)best_seq);
+        s_cal_status = ESP_OK;
+    } else {
+        s_cal_status = corrupt ? ESP_ERR_INVALID_CRC : ESP_ERR_NOT_FOUND;
     }
 }
 
 esp_err_t calibration_save_to_nvs(const calibration_data_t *cal_data) {
     nvs_handle_t nvs_handle;
     esp_err_t err;
+
+    if (!s_cal_loaded) {
+        calibration_load_cache();
+    }
+
+    // Escribir en la ranura que no guarda la calibración vigente
+    int slot = (s_cal_active_slot == 0) ? 1 : 0;
+    calibration_record_t rec = {
+        .version = CALIBRATION_RECORD_VERSION,
+        .length = sizeof(calibration_data_t),
+        .seq = s_cal_last_seq + 1,
+        .data = *cal_data,
+    };
+    rec.crc32 = calibration_record_crc(&rec);
     
     // Abrir NVS en modo escritura
     err = nvs_open(CALIBRATION_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
@@ -158,7 +351,7 @@ esp_err_t calibration_save_to_nvs(const calibration_data_t *cal_data) {
     }
     
     // Guardar datos
-    err = nvs_set_blob(nvs_handle, "cal_data", cal_data, sizeof(calibration_data_t));
+    err = nvs_set_blob(nvs_handle, s_cal_slot_keys[slot], &rec, sizeof(rec));
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error guardando calibración: %s", esp_err_to_name(err));
         nvs_close(nvs_handle);
@@ -170,7 +363,14 @@ esp_err_t calibration_save_to_nvs(const calibration_data_t *cal_data) {
     nvs_close(nvs_handle);
     
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Datos de calibración guardados en NVS");
+        s_cal_last_seq = rec.seq;
+        if (calibration_record_usable(cal_data)) {
+            s_cal_active_slot = slot;
+            s_cal_data = *cal_data;
+            s_cal_status = ESP_OK;
+        }
+        ESP_LOGI(TAG, "Datos de calibración guardados en NVS (ranura %s, secuencia %lu)",
+                 s_cal_slot_keys[slot], (unsigned long)rec.seq);
     } /*else {
         ESP_LOGE(TAG, "Error confirmando escritura: %s", esp_err_to_name(err));
     }*/
@@ -179,56 +379,23 @@ esp_err_t calibration_save_to_nvs(const calibration_data_t *cal_data) {
 }
 
 esp_err_t calibration_load_from_nvs(calibration_data_t *cal_data) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
-
-    err = nvs_open(CALIBRATION_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "No se pudo abrir NVS para calibración: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    // Leer datos de calibración
-    size_t required_size = sizeof(calibration_data_t);
-    err = nvs_get_blob(nvs_handle, "cal_data", cal_data, &required_size);
-    
-    nvs_close(nvs_handle);
-    
-    if (err == ESP_OK) {
-        // Validar datos
-        if (cal_data->magic_number == CALIBRATION_MAGIC_NUMBER && cal_data->calibrated) {
-            ESP_LOGI(TAG, "Datos de calibración cargados desde NVS");
-            ESP_LOGI(TAG, "HX711 - Escala: %.6f, Offset: %ld", 
-                     cal_data->hx711_scale_factor, cal_data->hx711_offset);
-            ESP_LOGI(TAG, "HC-SR04P - Factor: %.6f", cal_data->hcsr04p_cal_factor);
-            return ESP_OK;
-        } else {
+    if (!s_cal_loaded) {
+        calibration_load_cache();
+        if (s_cal_status == ESP_OK) {
+            ESP_LOGI(TAG, "HX711 - Escala: %.6f, Offset: %ld",
+                     s_cal_data.hx711_scale_factor, s_cal_data.hx711_offset);
+            ESP_LOGI(TAG, "HC-SR04P - Factor: %.6f", s_cal_data.hcsr04p_cal_factor);
+        } else if (s_cal_status == ESP_ERR_INVALID_CRC) {
             ESP_LOGW(TAG, "Datos de calibración corruptos en NVS");
-            return ESP_ERR_INVALID_CRC;
+        } else if (s_cal_status == ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(TAG, "No se encontraron datos de calibración en NVS");
         }
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "No se encontraron datos de calibración en NVS");
-        return ESP_ERR_NOT_FOUND;
-    } else {
-        ESP_LOGE(TAG, "Error leyendo calibración de NVS: %s", esp_err_to_name(err));
-        return err;
     }
-}
 
-esp_err_t calibration_all_nvs_partition(void) {
-    
-    // Borrar completamente toda la partición NVS
-    esp_err_t err = nvs_flash_erase();
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Toda la partición NVS borrada");
-        
-        // Reinicializar NVS completamente
-        err = nvs_flash_init();
-    } else {
-        ESP_LOGE(TAG, "Error borrando partición NVS: %s", esp_err_to_name(err));
+    if (s_cal_status == ESP_OK) {
+        *cal_data = s_cal_data;
     }
-    
-    return err;
+    return s_cal_status;
 }
 
 bool calibration_check_and_warn(void) {
@@ -269,9 +436,18 @@ bool calibration_check_and_warn(void) {
 }
 
 esp_err_t calibration_apply_to_sensors(nivometro_t *nivometro, const calibration_data_t *cal_data) {
-    // Aplicar calibración HX711
+    // Aplicar calibración HX711: factor de escala y tabla de conversión
     nivometro->scale.scale = cal_data->hx711_scale_factor;
     nivometro->scale.offset = cal_data->hx711_offset;
+    hx711_clear_curve(&nivometro->scale);
+    if (cal_data->hx711_curve_order > 0) {
+        hx711_set_curve(&nivometro->scale, cal_data->hx711_curve,
+                        cal_data->hx711_curve_min, cal_data->hx711_curve_max);
+        ESP_LOGI(TAG, "HX711: curva de orden %u", cal_data->hx711_curve_order);
+    } else if (cal_data->hx711_scale_factor != 0.0f) {
+        const float linear[HX711_CURVE_MAX_ORDER + 1] = { 0.0f, 1.0f / cal_data->hx711_scale_factor, 0.0f };
+        hx711_set_curve(&nivometro->scale, linear, HX711_RAW_MIN, HX711_RAW_MAX);
+    }
     
     // Aplicar calibración HC-SR04P
     hcsr04p_set_calibration(&nivometro->ultrasonic, cal_data->hcsr04p_cal_factor);
@@ -281,6 +457,53 @@ esp_err_t calibration_apply_to_sensors(nivometro_t *nivometro, const calibration
 }
 
 
+// Botón BOOT por interrupción: cada flanco se atiende en la ISR, una pulsación mantenida
+// CONFIG_CALIBRATION_BOOT_HOLD_TIME_MS la detecta un temporizador y las pulsaciones cortas
+// se entregan por cola a boot_button_wait_for_press(). El arranque normal no espera nada.
+#define CALIBRATION_REQUEST_MAGIC   0xCA11B0A7
+
+// Sobrevive a esp_restart() (no se inicializa en el arranque) pero no a un corte de alimentación
+RTC_NOINIT_ATTR static uint32_t calibration_request;
+
+static QueueHandle_t boot_button_queue = NULL;       // Pulsaciones completas (pulsar + soltar)
+static esp_timer_handle_t boot_hold_timer = NULL;
+static volatile int64_t boot_press_start_us = -1;
+static volatile bool calibration_in_progress = false;
+
+static void IRAM_ATTR boot_button_isr(void* arg) {
+    int64_t now = esp_timer_get_time();
+
+    if (gpio_get_level(BOOT_BUTTON_PIN) == 0) {
+        // Pulsado (activo bajo): arrancar la cuenta de pulsación larga
+        if (boot_press_start_us < 0) {
+            boot_press_start_us = now;
+            esp_timer_stop(boot_hold_timer);
+            esp_timer_start_once(boot_hold_timer, (uint64_t)CONFIG_CALIBRATION_BOOT_HOLD_TIME_MS * 1000ULL);
+        }
+    } else if (boot_press_start_us >= 0) {
+        // Soltado: las pulsaciones más cortas que el antirrebote se descartan
+        int64_t held_us = now - boot_press_start_us;
+        boot_press_start_us = -1;
+        esp_timer_stop(boot_hold_timer);
+        if (held_us >= (int64_t)CALIBRATION_DEBOUNCE_MS * 1000) {
+            BaseType_t woken = pdFALSE;
+            uint32_t held_ms = (uint32_t)(held_us / 1000);
+            xQueueSendFromISR(boot_button_queue, &held_ms, &woken);
+            portYIELD_FROM_ISR(woken);
+        }
+    }
+}
+
+// Pulsación larga confirmada: reiniciar directamente en modo calibración
+static void boot_hold_timer_cb(void* arg) {
+    if (calibration_in_progress || gpio_get_level(BOOT_BUTTON_PIN) != 0) {
+        return;                                   // Durante la calibración BOOT solo confirma pasos
+    }
+    ESP_LOGI(TAG, "Botón BOOT mantenido %d ms - reiniciando en modo calibración", CONFIG_CALIBRATION_BOOT_HOLD_TIME_MS);
+    calibration_request = CALIBRATION_REQUEST_MAGIC;
+    esp_restart();
+}
+
 void boot_button_init(void) {
     // Configurar botón BOOT
     gpio_config_t boot_btn_config = {
@@ -288,67 +511,72 @@ void boot_button_init(void) {
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE
+        .intr_type = GPIO_INTR_ANYEDGE
     };
     gpio_config(&boot_btn_config);
     
-    ESP_LOGI(TAG, "Botón BOOT inicializado en GPIO %d", BOOT_BUTTON_PIN);
-}
-
-bool boot_button_check_calibration_mode(void) {
-    ESP_LOGI(TAG, "INSTRUCCIONES: Mantén presionado el botón BOOT para calibrar");
+    boot_button_queue = xQueueCreate(4, sizeof(uint32_t));
+    const esp_timer_create_args_t hold_args = {
+        .callback = boot_hold_timer_cb,
+        .name     = "boot_hold",
+    };
+    esp_err_t result = esp_timer_create(&hold_args, &boot_hold_timer);
+    if (result == ESP_OK) {
+        // El servicio puede estar ya instalado por otro componente
+        result = gpio_install_isr_service(0);
+        if (result == ESP_ERR_INVALID_STATE) {
+            result = ESP_OK;
+        }
+    }
+    if (result == ESP_OK) {
+        result = gpio_isr_handler_add(BOOT_BUTTON_PIN, boot_button_isr, NULL);
+    }
+    if (result != ESP_OK || boot_button_queue == NULL) {
+        ESP_LOGE(TAG, "Error configurando interrupción del botón BOOT: %s", esp_err_to_name(result));
+        return;
+    }
     
-    uint32_t pressed_time = 0;
-    const uint32_t check_interval = 100; // Verificar cada 100ms
-    const uint32_t required_time = CONFIG_CALIBRATION_BOOT_HOLD_TIME_MS;
+    // Si ya está pulsado (p. ej. despertar por el propio botón) no habrá flanco: empezar la cuenta ya
+    if (gpio_get_level(BOOT_BUTTON_PIN) == 0) {
+        boot_press_start_us = esp_timer_get_time();
+        esp_timer_start_once(boot_hold_timer, (uint64_t)CONFIG_CALIBRATION_BOOT_HOLD_TIME_MS * 1000ULL);
+    }
     
-    // Verificar durante 5 segundos si el botón está presionado
-    for (int i = 0; i < 50; i++) {  // 50 * 100ms = 5 segundos
-        if (gpio_get_level(BOOT_BUTTON_PIN) == 0) {  // Botón presionado (activo bajo)
-            pressed_time += check_interval;
-            ESP_LOGI(TAG, "Botón BOOT presionado - Tiempo: %lu ms / %lu ms", 
-                    pressed_time, required_time);
-            
-            if (pressed_time >= required_time) {
-                ESP_LOGI(TAG, "Modo calibración activado!");
-                return true;
-            }
-        } else {
-            if (pressed_time > 0) {
-                ESP_LOGI(TAG, "Botón liberado - Tiempo insuficiente: %lu ms", pressed_time);
-            }
-            pressed_time = 0;
-        }
-        
-        vTaskDelay(pdMS_TO_TICKS(check_interval));
+    ESP_LOGI(TAG, "Botón BOOT inicializado en GPIO %d (mantener %d ms para calibrar)",
+             BOOT_BUTTON_PIN, CONFIG_CALIBRATION_BOOT_HOLD_TIME_MS);
+}
+bool boot_button_check_calibration_mode(void) {
+    // Sin ventana de espera: solo se consulta la petición dejada por la pulsación larga
+    if (calibration_request == CALIBRATION_REQUEST_MAGIC) {
+        calibration_request = 0;
+        calibration_in_progress = true;
+        ESP_LOGI(TAG, "Modo calibración activado!");
+        return true;
     }
     
-    ESP_LOGI(TAG, "Continuando con arranque normal");
+    ESP_LOGI(TAG, "INSTRUCCIONES: Mantén presionado el botón BOOT %d ms en cualquier momento para calibrar",
+             CONFIG_CALIBRATION_BOOT_HOLD_TIME_MS);
     return false;
 }
-
 void boot_button_wait_for_press(void) {
     ESP_LOGI(TAG, "Esperando confirmación (presiona BOOT)...");
     
-    // Esperar a que el botón se libere (si está presionado)
-    while (gpio_get_level(BOOT_BUTTON_PIN) == 0) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-    
-    // Esperar a que se presione
-    while (gpio_get_level(BOOT_BUTTON_PIN) == 1) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-    
-    // Anti-rebote
-    vTaskDelay(pdMS_TO_TICKS(CALIBRATION_DEBOUNCE_MS));
+    // Descartar pulsaciones anteriores y bloquear hasta la siguiente pulsación completa (pulsar + soltar)
+    xQueueReset(boot_button_queue);
+    uint32_t held_ms = 0;
+    xQueueReceive(boot_button_queue, &held_ms, portMAX_DELAY);
     
-    // Esperar a que se libere
-    while (gpio_get_level(BOOT_BUTTON_PIN) == 0) {
-        vTaskDelay(pdMS_TO_TICKS(100));
+    ESP_LOGI(TAG, "Confirmación recibida (%lu ms)", held_ms);
+}
+
+void boot_button_enable_wakeup(void) {
+#ifdef CONFIG_CALIBRATION_BOOT_WAKEUP
+    // BOOT (activo bajo) como fuente ext1: despertar y empezar la cuenta de pulsación larga
+    esp_err_t result = esp_sleep_enable_ext1_wakeup(1ULL << BOOT_BUTTON_PIN, ESP_EXT1_WAKEUP_ALL_LOW);
+    if (result != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo habilitar el despertar por BOOT: %s", esp_err_to_name(result));
     }
-    
-    ESP_LOGI(TAG, "Confirmación recibida");
+#endif
 }
 
 bool validate_calibration_data(const calibration_data_t *cal_data) {
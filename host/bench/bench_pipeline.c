@@ -0,0 +1,149 @@
+// File: host/bench/bench_pipeline.c
+//
+// Benchmark de la cadena cola -> almacén -> publicación (pipeline_bench.c) en el host: el mismo
+// código que en el equipo, con la NVS, la red y el broker simulados en tiempo virtual. Los costes
+// de flash y del enlace se pueden cambiar para ver dónde satura cada configuración.
+//
+// Uso: bench_pipeline [--rates 1,2,5,...] [--step-s s] [--nvs-entry-us us] [--nvs-commit-us us]
+//                     [--uplink-kbps kbps] [--rtt-ms ms] [--json resultados.json]
+
+#include "pipeline_bench.h"
+#include "communication.h"
+#include "storage.h"
+#include "diagnostics.h"
+#include "metrics.h"
+#include "nivometro_sensors.h"
+#include "sim_hal.h"
+#include "nvs_flash.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_LINE_MAX  512
+
+// tasks.c la declara extern; aquí no se lanza ninguna tarea de sensores
+nivometro_t g_nivometro;
+
+static float rates[PIPELINE_BENCH_MAX_STEPS] = { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+static int rate_count = 9;
+static uint32_t step_s = 10;
+static pipeline_bench_step_t results[PIPELINE_BENCH_MAX_STEPS];
+static int steps = -1;
+
+static void bench_task(void *arg)
+{
+    (void)arg;
+    diagnostics_init();
+    metrics_init();
+    nvs_flash_init();
+    storage_init();
+    communication_init();
+    communication_wait_for_connection();
+    steps = pipeline_bench_run(rates, rate_count, step_s * 1000, results);
+    sim_sched_stop();
+    vTaskDelete(NULL);
+}
+
+static void print_latency(const char *name, const pipeline_latency_t *l)
+{
+    printf("  %-8s p50 %8.2f ms  p95 %8.2f ms  p99 %8.2f ms  máx %8.2f ms\n", name,
+           l->p50_us / 1000.0, l->p95_us / 1000.0, l->p99_us / 1000.0, l->max_us / 1000.0);
+}
+
+static int write_json(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char line[BENCH_LINE_MAX];
+    fprintf(f, "{\n  \"step_s\": %u,\n  \"steps\": [", step_s);
+    for (int i = 0; i < steps; i++) {
+        if (pipeline_bench_format_json(&results[i], line, sizeof(line)) < 0) continue;
+        fprintf(f, "%s\n    %s", i ? "," : "", line);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return 0;
+}
+
+static int parse_rates(const char *text)
+{
+    int n = 0;
+    while (*text && n < PIPELINE_BENCH_MAX_STEPS) {
+        char *end;
+        float r = strtof(text, &end);
+        if (end == text || r <= 0.0f) return -1;
+        rates[n++] = r;
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    const char *json_path = NULL;
+    uint32_t nvs_entry_us = 600;                // Escritura de una entrada de 32 B en flash
+    uint32_t nvs_commit_us = 2000;
+    sim_net_params_t net;
+    sim_net_default_params(&net);
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(a, "--rates") == 0 && has_value) {
+            rate_count = parse_rates(argv[++i]);
+        } else if (strcmp(a, "--step-s") == 0 && has_value) {
+            step_s = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--nvs-entry-us") == 0 && has_value) {
+            nvs_entry_us = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--nvs-commit-us") == 0 && has_value) {
+            nvs_commit_us = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--uplink-kbps") == 0 && has_value) {
+            net.uplink_kbps = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--rtt-ms") == 0 && has_value) {
+            net.rtt_ms = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--json") == 0 && has_value) {
+            json_path = argv[++i];
+        } else {
+            fprintf(stderr, "Uso: %s [--rates 1,2,5,...] [--step-s s] [--nvs-entry-us us] [--nvs-commit-us us]\n"
+                            "       [--uplink-kbps kbps] [--rtt-ms ms] [--json fichero]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rate_count <= 0 || step_s == 0) {
+        fprintf(stderr, "Ritmos o duración de escalón no válidos\n");
+        return 2;
+    }
+
+    sim_log_set_level(ESP_LOG_ERROR);
+    sim_nvs_set_cost_us(nvs_entry_us, nvs_commit_us);
+    sim_net_configure(&net);
+    sim_wall_clock_set_epoch_at_zero(1704067200LL * 1000000);  // 2024-01-01
+    xTaskCreate(bench_task, "main", 4096, NULL, 1, NULL);
+    sim_sched_run_until((int64_t)(rate_count + 1) * step_s * 2 * 1000000 + 60 * 1000000);
+
+    if (steps <= 0) {
+        fprintf(stderr, "El benchmark no llegó a ejecutarse\n");
+        return 1;
+    }
+    printf("Pipeline cola -> almacén -> publicación (NVS %u us/entrada + %u us/commit, enlace %u kbps, RTT %u ms)\n",
+           nvs_entry_us, nvs_commit_us, net.uplink_kbps, net.rtt_ms);
+    for (int i = 0; i < steps; i++) {
+        const pipeline_bench_step_t *s = &results[i];
+        printf("%.1f muestras/s ofrecidas -> %.2f sostenidas | %u producidas, %u publicadas | "
+               "pérdidas: cola %u, almacén %u, publicación %u, pendientes %u | cola máx %u, media %.2f\n",
+               s->offered_rate, s->sustained_rate, s->produced, s->published, s->dropped_queue,
+               s->dropped_storage, s->publish_failed, s->pending_end, s->queue_max, s->queue_mean);
+        print_latency("cola", &s->queue);
+        print_latency("guardar", &s->store);
+        print_latency("publicar", &s->publish);
+        print_latency("total", &s->total);
+    }
+    if (json_path && write_json(json_path) != 0) return 2;
+    return 0;
+}
@@ -0,0 +1,465 @@
+// File: host/bench/bench_sensors.c
+//
+// Microbenchmarks de la pila de sensores sobre el HAL simulado. Para cada caso mide el coste
+// en CPU del host (ns por operación) y el tiempo virtual del dispositivo (us por operación,
+// esperas del HX711 y del eco incluidas), y comprueba que el resultado es el programado en
+// los modelos: un benchmark que devuelve lecturas erróneas no mide nada. Sale con código 1
+// si alguna comprobación falla.
+//
+// Uso: bench_sensors [--json fichero] [--quick] [-v]
+
+#include "sim_hal.h"
+#include "hx711.h"
+#include "hcsr04p.h"
+#include "nivometro_sensors.h"
+#include "storage.h"
+#include "aggregation.h"
+#include "event_detector.h"
+#include "metrics.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Los mismos pines que main.c
+#define HCSR04P_TRIGGER_PIN     12
+#define HCSR04P_ECHO_PIN        13
+#define HX711_DOUT_PIN          26
+#define HX711_SCK_PIN           27
+
+#define MAX_RESULTS             16
+
+typedef struct {
+    const char *name;
+    uint32_t iterations;
+    double host_ns_per_op;
+    double sim_us_per_op;
+    bool ok;
+} bench_result_t;
+
+static bench_result_t results[MAX_RESULTS];
+static int result_count = 0;
+static int scale_down = 1;              // --quick reduce las iteraciones para CI
+
+static double host_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef struct {
+    double host_start_ns;
+    int64_t sim_start_us;
+} bench_timer_t;
+
+static bench_timer_t bench_start(void)
+{
+    return (bench_timer_t){ host_now_ns(), sim_time_us() };
+}
+
+static void bench_stop(const bench_timer_t *t, const char *name, uint32_t iterations, bool ok)
+{
+    if (result_count == MAX_RESULTS) return;
+    bench_result_t *r = &results[result_count++];
+    r->name = name;
+    r->iterations = iterations;
+    r->host_ns_per_op = (host_now_ns() - t->host_start_ns) / iterations;
+    r->sim_us_per_op = (double)(sim_time_us() - t->sim_start_us) / iterations;
+    r->ok = ok;
+}
+
+// === HX711: bit-bang de 24 bits contra el modelo ===
+static void bench_hx711_read_raw(void)
+{
+    static const int32_t pattern[] = {
+        0, 1, -1, 0x123456, -0x123456, 8388607, -8388608, 0x00AA55, -0x00AA55, 4242
+    };
+    const int n_pattern = sizeof(pattern) / sizeof(pattern[0]);
+    const uint32_t rounds = 50 / scale_down;
+
+    sim_hx711_attach(HX711_DOUT_PIN, HX711_SCK_PIN);
+    hx711_t dev;
+    hx711_config_t cfg = { .dout_pin = HX711_DOUT_PIN, .sck_pin = HX711_SCK_PIN, .gain = HX711_GAIN_128 };
+    bool ok = hx711_init(&dev, &cfg) == ESP_OK;
+
+    bench_timer_t t = bench_start();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (int i = 0; i < n_pattern; i++) sim_hx711_push_raw(pattern[i]);
+        for (int i = 0; i < n_pattern; i++) {
+            int32_t raw = 0;
+            if (hx711_read_raw(&dev, &raw) != ESP_OK || raw != pattern[i]) {
+                fprintf(stderr, "hx711_read_raw: esperado %ld, leído %ld\n", (long)pattern[i], (long)raw);
+                ok = false;
+            }
+        }
+    }
+    ok = ok && sim_hx711_last_gain_pulses() == (int)HX711_GAIN_128;
+    bench_stop(&t, "hx711_read_raw", rounds * n_pattern, ok);
+
+    // Sensor desconectado: la lectura debe terminar por timeout, no colgarse
+    sim_hx711_set_connected(false);
+    int32_t raw;
+    t = bench_start();
+    ok = hx711_read_raw(&dev, &raw) == ESP_ERR_TIMEOUT && raw == INT32_MIN;
+    bench_stop(&t, "hx711_read_raw_timeout", 1, ok);
+    sim_hx711_set_connected(true);
+}
+
+// === HC-SR04P: cronometraje del eco ===
+static void bench_hcsr04p_read_distance(void)
+{
+    static const float distances_cm[] = { 5.0f, 50.0f, 150.0f, 300.0f, 400.0f };
+    const int n_dist = sizeof(distances_cm) / sizeof(distances_cm[0]);
+    const uint32_t reads = 200 / scale_down;
+
+    sim_hcsr04p_attach(HCSR04P_TRIGGER_PIN, HCSR04P_ECHO_PIN);
+    hcsr04p_sensor_t sensor;
+    bool ok = hcsr04p_init(&sensor, HCSR04P_TRIGGER_PIN, HCSR04P_ECHO_PIN);
+
+    bench_timer_t t = bench_start();
+    for (int d = 0; d < n_dist; d++) {
+        sim_hcsr04p_set_distance_cm(distances_cm[d]);
+        for (uint32_t i = 0; i < reads; i++) {
+            float measured = hcsr04p_read_distance(&sensor);
+            if (fabsf(measured - distances_cm[d]) > 0.5f) {
+                fprintf(stderr, "hcsr04p_read_distance: esperado %.2f cm, leído %.2f cm\n",
+                        distances_cm[d], measured);
+                ok = false;
+                break;
+            }
+        }
+    }
+    bench_stop(&t, "hcsr04p_read_distance", reads * n_dist, ok);
+
+    // Sin eco: timeout de 25 ms y -1
+    sim_hcsr04p_set_connected(false);
+    t = bench_start();
+    ok = hcsr04p_read_distance(&sensor) < 0.0f;
+    bench_stop(&t, "hcsr04p_read_timeout", 1, ok);
+    sim_hcsr04p_set_connected(true);
+}
+
+// === HX711: ajuste multipunto y conversión con la tabla en coma fija ===
+static void bench_hx711_curve(void)
+{
+    // Célula con un 4 % de pérdida de ganancia a fondo de escala (200 kg)
+    const double gain = 420.0, droop = 2e-7;
+    static const float ref_g[] = { 0.0f, 40000.0f, 80000.0f, 120000.0f, 160000.0f, 200000.0f };
+    const int n_ref = sizeof(ref_g) / sizeof(ref_g[0]);
+    int32_t ref_net[sizeof(ref_g) / sizeof(ref_g[0])];
+    for (int i = 0; i < n_ref; i++) ref_net[i] = (int32_t)lround(gain * ref_g[i] * (1.0 - droop * ref_g[i]));
+
+    hx711_t dev = { .scale = (float)gain };
+    float coef[HX711_CURVE_MAX_ORDER + 1];
+    float rms_g = 0.0f;
+    bool ok = hx711_fit_curve(ref_net, ref_g, n_ref, 2, coef, &rms_g) == ESP_OK &&
+              hx711_set_curve(&dev, coef, ref_net[0], ref_net[n_ref - 1]) == ESP_OK;
+
+    // Error frente al peso real en todo el rango: menos de 100 g (0,05 % del fondo de escala)
+    const uint32_t points = 2000000 / scale_down;
+    double max_err = 0.0, sink = 0.0;
+    bench_timer_t t = bench_start();
+    for (uint32_t i = 0; i < points; i++) {
+        double w = 200000.0 * i / points;
+        int32_t net = (int32_t)lround(gain * w * (1.0 - droop * w));
+        float units = hx711_net_to_units(&dev, net);
+        double err = fabs(units - w);
+        if (err > max_err) max_err = err;
+        sink += units;
+    }
+    ok = ok && max_err < 100.0 && sink > 0.0;
+    bench_stop(&t, "hx711_curve_lut", points, ok);
+    printf("  curva: rms del ajuste %.1f g, error máximo con la tabla %.1f g\n", rms_g, max_err);
+}
+
+// === Calibración con parada anticipada: converge con ruido normal y aborta con ruido excesivo ===
+static int32_t bench_noise(uint32_t *state, int32_t amplitude)
+{
+    // Suma de cuatro uniformes: aproximadamente normal, desviación ~amplitud/1,7
+    int32_t sum = 0;
+    for (int k = 0; k < 4; k++) {
+        *state = *state * 1664525u + 1013904223u;
+        sum += (int32_t)(*state >> 16) % (2 * amplitude + 1) - amplitude;
+    }
+    return sum / 2;
+}
+
+static void bench_calibrate_converged(void)
+{
+    const float scale = 420.0f, weight_g = 500.0f;
+    const int32_t offset = 81234;
+    const convergence_params_t params = {
+        .min_samples = 5, .max_samples = 200, .rel_tolerance = 0.005f, .abs_tolerance = 0.0,
+    };
+    uint32_t seed = 12345;
+
+    sim_hx711_attach(HX711_DOUT_PIN, HX711_SCK_PIN);
+    hx711_t dev;
+    hx711_config_t cfg = { .dout_pin = HX711_DOUT_PIN, .sck_pin = HX711_SCK_PIN, .gain = HX711_GAIN_128 };
+    bool ok = hx711_init(&dev, &cfg) == ESP_OK;
+    dev.offset = offset;
+
+    // Ruido de ~1 g (420 cuentas) sobre 500 g: ±0,5 % se alcanza con pocas lecturas
+    uint32_t before = sim_hx711_conversions_read();
+    sim_hx711_set_raw(offset);
+    for (int i = 0; i < 200; i++) sim_hx711_push_raw(offset + (int32_t)(weight_g * scale) + bench_noise(&seed, 700));
+    bench_timer_t t = bench_start();
+    ok = ok && hx711_calibrate_converged(&dev, weight_g, &params) == ESP_OK &&
+         fabsf(dev.scale - scale) / scale < 0.01f;
+    uint32_t used = sim_hx711_conversions_read() - before;
+    bench_stop(&t, "hx711_calibrate_converged", used ? used : 1, ok && used < (uint32_t)params.max_samples / 2);
+
+    // Carga oscilando un 20 %: debe abandonar mucho antes del máximo
+    before = sim_hx711_conversions_read();
+    sim_hx711_set_raw(offset);
+    for (int i = 0; i < 200; i++) sim_hx711_push_raw(offset + (int32_t)(weight_g * scale) + bench_noise(&seed, 40000));
+    t = bench_start();
+    ok = hx711_calibrate_converged(&dev, weight_g, &params) == ESP_ERR_INVALID_STATE;
+    uint32_t used_diverged = sim_hx711_conversions_read() - before;
+    bench_stop(&t, "hx711_calibrate_diverged", used_diverged ? used_diverged : 1,
+               ok && used_diverged < (uint32_t)params.max_samples / 4);
+    printf("  calibración: %u lecturas hasta converger, %u hasta abandonar (máximo %d)\n",
+           (unsigned)used, (unsigned)used_diverged, params.max_samples);
+}
+
+// === Ciclo completo de lectura del nivómetro ===
+static void bench_read_all_sensors(int hx711_samples, const char *name)
+{
+    const float scale = 420.0f;                 // Cuentas por gramo
+    const int32_t offset = 81234;
+    const float weight_g = 2500.0f;
+    const float distance_cm = 123.0f;
+    const uint32_t cycles = 20 / scale_down;
+
+    sim_hx711_attach(HX711_DOUT_PIN, HX711_SCK_PIN);
+    sim_hcsr04p_attach(HCSR04P_TRIGGER_PIN, HCSR04P_ECHO_PIN);
+    sim_hx711_set_raw(offset + (int32_t)(weight_g * scale));
+    sim_hcsr04p_set_distance_cm(distance_cm);
+
+    nivometro_t niv;
+    nivometro_config_t cfg = {
+        .hcsr04p_trigger_pin = HCSR04P_TRIGGER_PIN,
+        .hcsr04p_echo_pin = HCSR04P_ECHO_PIN,
+        .hcsr04p_cal_factor = 1.0f,
+        .hx711_dout_pin = HX711_DOUT_PIN,
+        .hx711_sck_pin = HX711_SCK_PIN,
+        .hx711_gain = HX711_GAIN_128,
+    };
+    bool ok = nivometro_init(&niv, &cfg) == ESP_OK;
+    nivometro_apply_calibration_factors(&niv, 1.0f, scale, offset);
+    nivometro_set_hx711_samples(&niv, hx711_samples);
+
+    bench_timer_t t = bench_start();
+    for (uint32_t i = 0; i < cycles; i++) {
+        nivometro_data_t data;
+        if (nivometro_read_all_sensors(&niv, &data) != ESP_OK || data.sensor_status != 0x03 ||
+            fabsf(data.weight_grams - weight_g) > 0.5f || fabsf(data.ultrasonic_distance_cm - distance_cm) > 0.5f) {
+            fprintf(stderr, "%s: estado 0x%02x, %.2f g, %.2f cm\n", name, data.sensor_status,
+                    data.weight_grams, data.ultrasonic_distance_cm);
+            ok = false;
+            break;
+        }
+    }
+    bench_stop(&t, name, cycles, ok);
+}
+
+// === Deriva de la balanza: seguimiento del cero y compensación térmica ===
+static float bench_temp_c;
+
+static float bench_temperature(void *ctx)
+{
+    (void)ctx;
+    return bench_temp_c;
+}
+
+static void bench_zero_tracking(void)
+{
+    // Cuatro días a una muestra cada 10 min con ciclo día-noche de ±8 °C. La célula deriva
+    // 2 g/°C y además repta 3 g en total; los tres primeros días la placa está vacía y el cuarto
+    // tiene 5 kg de nieve (el ultrasonido la ve: no se aprende de esas lecturas)
+    const float scale = 420.0f, k_g_per_c = 2.0f, creep_g = 3.0f, load_g = 5000.0f;
+    const int32_t offset = 81234;
+    const uint32_t per_day = 144, days = 4, samples = per_day * days;
+    uint32_t seed = 4242;
+
+    sim_hx711_attach(HX711_DOUT_PIN, HX711_SCK_PIN);
+    sim_hcsr04p_attach(HCSR04P_TRIGGER_PIN, HCSR04P_ECHO_PIN);
+    nivometro_t niv;
+    nivometro_config_t cfg = {
+        .hcsr04p_trigger_pin = HCSR04P_TRIGGER_PIN,
+        .hcsr04p_echo_pin = HCSR04P_ECHO_PIN,
+        .hcsr04p_cal_factor = 1.0f,
+        .hx711_dout_pin = HX711_DOUT_PIN,
+        .hx711_sck_pin = HX711_SCK_PIN,
+        .hx711_gain = HX711_GAIN_128,
+    };
+    bool ok = nivometro_init(&niv, &cfg) == ESP_OK;
+    nivometro_apply_calibration_factors(&niv, 1.0f, scale, offset);
+    nivometro_set_temperature_source(&niv, bench_temperature, NULL);
+    zero_tracker_t zt = { 0 };
+    nivometro_enable_zero_tracking(&niv, &zt);
+
+    double err_fixed = 0.0, err_tracked = 0.0;
+    bench_timer_t t = bench_start();
+    for (uint32_t i = 0; i < samples && ok; i++) {
+        bool loaded = i >= per_day * (days - 1);
+        bench_temp_c = -5.0f + 8.0f * sinf(2.0f * (float)M_PI * i / per_day);
+        float drift_g = k_g_per_c * (bench_temp_c + 5.0f) + creep_g * i / samples;
+        int32_t raw = offset + (int32_t)lroundf((drift_g + (loaded ? load_g : 0.0f)) * scale) + bench_noise(&seed, 200);
+        sim_hx711_set_raw(raw);
+        sim_hcsr04p_set_distance_cm(loaded ? 130.0f : 150.0f);
+
+        nivometro_data_t data;
+        ok = nivometro_read_all_sensors(&niv, &data) == ESP_OK && data.sensor_status == 0x03;
+        if (loaded) {
+            double fixed = fabs((raw - offset) / scale - load_g);
+            double tracked = fabs(data.weight_grams - load_g);
+            if (fixed > err_fixed) err_fixed = fixed;
+            if (tracked > err_tracked) err_tracked = tracked;
+        }
+    }
+    double k_est = zero_tracker_temp_coeff(&zt, &niv.zero_params) / scale;
+    ok = ok && err_tracked < 3.0 && err_tracked < err_fixed / 4 && fabs(k_est - k_g_per_c) < 0.1 * k_g_per_c;
+    bench_stop(&t, "hx711_zero_tracking", samples, ok);
+    printf("  deriva: error máximo con carga %.1f g con offset fijo, %.1f g con seguimiento "
+           "(pendiente %.2f g/°C, real %.2f)\n", err_fixed, err_tracked, k_est, k_g_per_c);
+}
+
+// === Filtros: detector de eventos y agregación ===
+static void bench_event_detector(void)
+{
+    const uint32_t samples = 1000000 / scale_down;
+    event_detector_params_t params;
+    event_detector_t det;
+    event_detector_default_params(&params);
+    event_detector_init(&det);
+
+    uint32_t events = 0;
+    bench_timer_t t = bench_start();
+    for (uint32_t i = 0; i < samples; i++) {
+        // Nivel plano con ruido y un escalón de nieve cada 10000 muestras
+        float step = (float)(i / 10000) * 5.0f;
+        float noise = (float)((i * 2654435761u) >> 28) * 0.01f;
+        if (event_detector_update(&det, &params, 200.0f - step + noise, 10.0f + step * 0.1f)) events++;
+    }
+    bench_stop(&t, "event_detector_update", samples, events >= samples / 10000 / 2);
+}
+
+static void bench_aggregation(void)
+{
+    const uint32_t samples = 1000000 / scale_down;
+    aggregate_t agg, closed;
+    aggregation_init(&agg, CONFIG_AGGREGATION_WINDOW_SHORT_S);
+
+    uint32_t windows = 0;
+    bench_timer_t t = bench_start();
+    for (uint32_t i = 0; i < samples; i++) {
+        if (aggregation_push(&agg, 1700000000u + i * 5, 150.0f + (float)(i % 7), true, 3.0f, true, &closed)) windows++;
+    }
+    // 5 s por muestra y ventanas de 60 s: una ventana cerrada cada 12 muestras
+    uint32_t expected = samples * 5 / CONFIG_AGGREGATION_WINDOW_SHORT_S;
+    bench_stop(&t, "aggregation_push", samples, windows + 1 >= expected && windows <= expected);
+}
+
+// === Almacén NVS: escritura y vaciado de la cola ===
+static void bench_storage(void)
+{
+    sim_nvs_reset();
+    storage_init();
+    const uint32_t capacity = storage_capacity();          // Lo que cabe en la partición simulada
+    const uint32_t samples = capacity * 4;
+
+    bench_timer_t t = bench_start();
+    for (uint32_t i = 0; i < samples; i++) {
+        sensor_data_t d = { .distance_cm = (float)i, .weight_kg = (float)i / 1000.0f, .epoch_s = i };
+        storage_buffer_data(&d);
+    }
+    bench_stop(&t, "storage_buffer_data", samples, storage_pending_count() == capacity &&
+               storage_dropped_count() == samples - capacity);
+    printf("  nvs: %.2f escrituras y %.1f bytes por muestra guardada\n",
+           (double)sim_nvs_write_count() / samples, (double)sim_nvs_bytes_written() / samples);
+
+    // Debe salir en orden la ventana de las últimas capacity muestras
+    bool ok = true;
+    uint32_t expected = samples - capacity;
+    uint32_t drained = 0;
+    t = bench_start();
+    sensor_data_t d;
+    while (storage_peek_oldest(&d) == ESP_OK) {
+        if (d.epoch_s != expected++) ok = false;
+        storage_pop_oldest();
+        drained++;
+    }
+    bench_stop(&t, "storage_peek_pop", drained ? drained : 1, ok && drained == capacity);
+}
+
+static void print_results(void)
+{
+    printf("\n%-26s %10s %14s %14s  %s\n", "caso", "iter", "host ns/op", "disp. us/op", "ok");
+    for (int i = 0; i < result_count; i++) {
+        const bench_result_t *r = &results[i];
+        printf("%-26s %10u %14.1f %14.1f  %s\n", r->name, (unsigned)r->iterations,
+               r->host_ns_per_op, r->sim_us_per_op, r->ok ? "sí" : "FALLO");
+    }
+}
+
+static int write_json(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "[\n");
+    for (int i = 0; i < result_count; i++) {
+        const bench_result_t *r = &results[i];
+        fprintf(f, "  {\"name\": \"%s\", \"iterations\": %u, \"host_ns_per_op\": %.1f, "
+                   "\"device_us_per_op\": %.1f, \"ok\": %s}%s\n",
+                r->name, (unsigned)r->iterations, r->host_ns_per_op, r->sim_us_per_op,
+                r->ok ? "true" : "false", i + 1 < result_count ? "," : "");
+    }
+    fprintf(f, "]\n");
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *json_path = NULL;
+    int log_level = ESP_LOG_ERROR;                      // Los avisos esperados (almacén lleno, timeouts) no ensucian la tabla
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            scale_down = 10;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            log_level = ESP_LOG_INFO;
+        } else {
+            fprintf(stderr, "Uso: %s [--json fichero] [--quick] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    sim_log_set_level(log_level);
+    metrics_init();
+    bench_hx711_read_raw();
+    bench_hcsr04p_read_distance();
+    bench_hx711_curve();
+    bench_calibrate_converged();
+    bench_read_all_sensors(1, "read_all_sensors_x1");
+    bench_read_all_sensors(8, "read_all_sensors_x8");
+    bench_zero_tracking();
+    bench_event_detector();
+    bench_aggregation();
+    bench_storage();
+
+    print_results();
+    if (json_path && write_json(json_path) != 0) return 2;
+
+    for (int i = 0; i < result_count; i++) {
+        if (!results[i].ok) return 1;
+    }
+    return 0;
+}
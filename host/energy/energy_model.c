@@ -0,0 +1,404 @@
+// File: host/energy/energy_model.c
+//
+// Modelo de energía del modo batería. Parte de los tiempos medidos por fase (resúmenes
+// nivometro/<id>/profile del perfilador, publicados por el equipo o por host/replay) y de la
+// corriente de cada componente (ESP32, radio en recepción y en transmisión, HX711, HC-SR04P,
+// deep sleep), y predice la corriente media y la autonomía para cada combinación de intervalo
+// de muestreo y de lote de subida. Con --baseline compara la carga despierta por muestra con
+// una referencia guardada y sale con código 1 si empeora más de la tolerancia.
+//
+// Uso: energy_model --profile capture.tsv [--profile ...] [--currents corrientes.conf]
+//                   [--period 30,60,600] [--upload-every 1,6,12] [--bytes-per-sample B]
+//                   [--uplink-kbps kbps] [--capacity-mah mAh] [--derate f]
+//                   [--json resultados.json] [--write-baseline fichero]
+//                   [--baseline fichero] [--tolerance %]
+
+#include "profiler.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SCENARIO_VALUES     16
+#define PROFILE_LINE_MAX        2048
+
+// Mismo orden y nombres que profiler.c
+static const char *const phase_names[PROFILE_PHASE_COUNT] = {
+    "boot", "hx711", "wifi", "sntp", "mqtt", "read", "publish", "ack_wait", "sleep_delay"
+};
+
+// Corrientes por componente (mA); se sobrescriben con --currents
+typedef struct {
+    double cpu_ma;              // ESP32 activo a 160 MHz, sin radio
+    double radio_rx_ma;         // Radio escuchando (sumado a la CPU)
+    double radio_tx_ma;         // Radio transmitiendo (sumado a la CPU, en lugar de rx)
+    double hx711_ma;            // HX711 más el puente de galgas alimentado
+    double hcsr04p_ma;          // HC-SR04P durante la medida
+    double sleep_ua;            // Equipo completo en deep sleep
+} currents_t;
+
+static currents_t currents = {
+    .cpu_ma = 40.0,
+    .radio_rx_ma = 60.0,
+    .radio_tx_ma = 140.0,
+    .hx711_ma = 5.0,
+    .hcsr04p_ma = 3.0,
+    .sleep_ua = 150.0,
+};
+
+// Qué está encendido en cada fase (fracción del tiempo) y si la fase solo ocurre en ciclos con subida
+typedef struct {
+    double cpu;
+    double rx;
+    double tx;
+    double hx711;
+    double hcsr04p;
+    bool upload_only;
+} phase_load_t;
+
+static const phase_load_t phase_load[PROFILE_PHASE_COUNT] = {
+    [PROFILE_BOOT]         = { 1.0, 0.0,  0.0,  0.0, 0.0, false },
+    [PROFILE_HX711_REINIT] = { 1.0, 0.0,  0.0,  1.0, 0.0, false },
+    [PROFILE_WIFI_ASSOC]   = { 1.0, 0.9,  0.1,  0.0, 0.0, true  },  // Sondeo, autenticación y DHCP
+    [PROFILE_SNTP]         = { 1.0, 0.98, 0.02, 0.0, 0.0, true  },
+    [PROFILE_MQTT_CONNECT] = { 1.0, 0.9,  0.1,  0.0, 0.0, true  },
+    [PROFILE_SENSOR_READ]  = { 1.0, 0.0,  0.0,  1.0, 1.0, false },
+    [PROFILE_PUBLISH]      = { 1.0, 0.7,  0.3,  0.0, 0.0, true  },  // El aire por muestra se suma aparte
+    [PROFILE_ACK_WAIT]     = { 1.0, 0.3,  0.0,  0.0, 0.0, true  },  // Modem sleep: escucha solo los beacons
+    [PROFILE_SLEEP_DELAY]  = { 1.0, 0.0,  0.0,  0.0, 0.0, false },
+};
+
+// Tiempos medidos: suma ponderada por ciclos de todos los resúmenes leídos
+typedef struct {
+    double cycles;
+    double uploads;
+    double total_ms[PROFILE_PHASE_COUNT];
+    int summaries;
+    bool uploads_known;
+} timings_t;
+
+typedef struct {
+    uint32_t period_s;
+    uint32_t upload_every;
+    double awake_ms;                            // Tiempo despierto medio por muestra
+    double phase_mas[PROFILE_PHASE_COUNT];      // Carga por muestra y fase
+    double tx_mas;                              // Aire de las muestras del lote
+    double awake_mas;                           // Carga despierta por muestra (depende del firmware)
+    double sleep_mas;                           // Carga dormida por muestra (depende del intervalo)
+    double avg_ma;
+    double life_days;
+} scenario_t;
+
+static double bytes_per_sample = 110.0;         // Informe de host/replay: bytes MQTT por muestra
+static double uplink_kbps = 1000.0;
+static double capacity_mah = 3000.0;
+static double derate = 0.85;                    // Fracción utilizable (frío, autodescarga, corte del regulador)
+
+// === ENTRADAS ===
+
+static bool json_number(const char *text, const char *key, double *value)
+{
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(text, pattern);
+    if (!p) return false;
+    *value = strtod(p + strlen(pattern), NULL);
+    return true;
+}
+
+// Lee cualquier texto (captura de replay, salida de mosquitto_sub -v) y suma cada resumen que encuentre
+static int load_profiles(const char *path, timings_t *t)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char line[PROFILE_LINE_MAX];
+    while (fgets(line, sizeof(line), f)) {
+        const char *obj = strstr(line, "{\"cycles\":");
+        double cycles, uploads;
+        if (!obj || !json_number(obj, "cycles", &cycles) || cycles <= 0) continue;
+
+        for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+            char key[32];
+            double mean_ms = 0;
+            snprintf(key, sizeof(key), "%s_ms", phase_names[i]);
+            json_number(obj, key, &mean_ms);
+            t->total_ms[i] += mean_ms * cycles;
+        }
+        if (json_number(obj, "uploads", &uploads)) {
+            t->uploads_known = true;
+        } else {
+            uploads = cycles;                   // Firmware anterior: se supone una subida por ciclo
+        }
+        t->cycles += cycles;
+        t->uploads += uploads;
+        t->summaries++;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int load_currents(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    static const struct { const char *key; double *value; } keys[] = {
+        { "cpu_ma", &currents.cpu_ma },
+        { "radio_rx_ma", &currents.radio_rx_ma },
+        { "radio_tx_ma", &currents.radio_tx_ma },
+        { "hx711_ma", &currents.hx711_ma },
+        { "hcsr04p_ma", &currents.hcsr04p_ma },
+        { "sleep_ua", &currents.sleep_ua },
+    };
+    char line[128];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char key[32];
+        double value;
+        if (line[0] == '#' || sscanf(line, " %31[a-z0-9_] = %lf", key, &value) != 2) continue;
+        bool found = false;
+        for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+            if (strcmp(key, keys[i].key) == 0) {
+                *keys[i].value = value;
+                found = true;
+            }
+        }
+        if (!found) fprintf(stderr, "%s:%d: clave desconocida '%s'\n", path, line_no, key);
+    }
+    fclose(f);
+    return 0;
+}
+
+static int parse_list(const char *text, uint32_t *values)
+{
+    int n = 0;
+    char *end;
+    while (*text && n < MAX_SCENARIO_VALUES) {
+        unsigned long v = strtoul(text, &end, 10);
+        if (end == text || v == 0) return -1;
+        values[n++] = (uint32_t)v;
+        text = (*end == ',') ? end + 1 : end;
+        if (*end && *end != ',') return -1;
+    }
+    return n;
+}
+
+// === MODELO ===
+
+static double phase_current_ma(int phase)
+{
+    const phase_load_t *l = &phase_load[phase];
+    return l->cpu * currents.cpu_ma + l->rx * currents.radio_rx_ma + l->tx * currents.radio_tx_ma
+         + l->hx711 * currents.hx711_ma + l->hcsr04p * currents.hcsr04p_ma;
+}
+
+static void model(const timings_t *t, uint32_t period_s, uint32_t upload_every, scenario_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->period_s = period_s;
+    s->upload_every = upload_every;
+
+    // El lote medido lleva cycles/uploads muestras; el aire de cada una (a la tasa de subida) se
+    // separa de la publicación para escalarlo con el lote del escenario
+    double measured_batch = t->uploads > 0 ? t->cycles / t->uploads : 1.0;
+    double tx_ms_per_sample = bytes_per_sample * 8.0 / uplink_kbps;
+    double tx_charge_ma = currents.cpu_ma + currents.radio_tx_ma;
+
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        double ms;
+        if (phase_load[i].upload_only) {
+            double per_upload_ms = t->uploads > 0 ? t->total_ms[i] / t->uploads : 0.0;
+            if (i == PROFILE_PUBLISH) {
+                per_upload_ms = fmax(0.0, per_upload_ms - measured_batch * tx_ms_per_sample);
+            }
+            ms = per_upload_ms / upload_every;
+        } else {
+            ms = t->total_ms[i] / t->cycles;
+        }
+        s->phase_mas[i] = ms / 1000.0 * phase_current_ma(i);
+        s->awake_ms += ms;
+        s->awake_mas += s->phase_mas[i];
+    }
+    s->tx_mas = tx_ms_per_sample / 1000.0 * tx_charge_ma;
+    s->awake_ms += tx_ms_per_sample;
+    s->awake_mas += s->tx_mas;
+
+    double asleep_s = fmax(0.0, period_s - s->awake_ms / 1000.0);
+    s->sleep_mas = asleep_s * currents.sleep_ua / 1000.0;
+    s->avg_ma = (s->awake_mas + s->sleep_mas) / fmax((double)period_s, s->awake_ms / 1000.0);
+    s->life_days = capacity_mah * derate / s->avg_ma / 24.0;
+}
+
+// === INFORME ===
+
+static void print_breakdown(const timings_t *t, const scenario_t *s)
+{
+    printf("Resúmenes: %d (%.0f ciclos, %.0f subidas%s)\n", t->summaries, t->cycles, t->uploads,
+           t->uploads_known ? "" : ", supuesta una por ciclo");
+    printf("Carga por muestra con %u s y subida cada %u:\n", s->period_s, s->upload_every);
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        printf("  %-12s %7.2f mA  %8.3f mA·s\n", phase_names[i], phase_current_ma(i), s->phase_mas[i]);
+    }
+    printf("  %-12s %7.2f mA  %8.3f mA·s\n", "aire lote", currents.cpu_ma + currents.radio_tx_ma, s->tx_mas);
+    printf("  %-12s %7.3f mA  %8.3f mA·s\n", "deep sleep", currents.sleep_ua / 1000.0, s->sleep_mas);
+}
+
+static void print_table(const scenario_t *s, int count)
+{
+    printf("%8s %7s %11s %13s %11s %10s\n", "periodo", "lote", "despierto", "mA·s/muestra", "I media", "autonomía");
+    for (int i = 0; i < count; i++) {
+        printf("%6u s %7u %8.0f ms %13.3f %8.3f mA %7.0f d%s\n", s[i].period_s, s[i].upload_every,
+               s[i].awake_ms, s[i].awake_mas, s[i].avg_ma, s[i].life_days,
+               s[i].awake_ms / 1000.0 > s[i].period_s ? "  (no cabe en el periodo)" : "");
+    }
+}
+
+static int write_json(const char *path, const scenario_t *s, int count)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "{\n  \"capacity_mah\": %.0f, \"derate\": %.2f, \"scenarios\": [", capacity_mah, derate);
+    for (int i = 0; i < count; i++) {
+        fprintf(f, "%s\n    {\"period_s\": %u, \"upload_every\": %u, \"awake_ms\": %.1f, \"awake_mas_per_sample\": %.4f, "
+                   "\"avg_ma\": %.4f, \"life_days\": %.1f}",
+                i ? "," : "", s[i].period_s, s[i].upload_every, s[i].awake_ms, s[i].awake_mas, s[i].avg_ma, s[i].life_days);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return 0;
+}
+
+static int write_baseline(const char *path, const scenario_t *s)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "{\"period_s\": %u, \"upload_every\": %u, \"awake_mas_per_sample\": %.4f, \"avg_ma\": %.4f}\n",
+            s->period_s, s->upload_every, s->awake_mas, s->avg_ma);
+    fclose(f);
+    return 0;
+}
+
+// Recalcula el escenario de la referencia con los tiempos actuales; 1 si la carga por muestra empeora
+static int check_baseline(const char *path, const timings_t *t, double tolerance_pct)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 2;
+    }
+    char text[512] = {0};
+    size_t n = fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    text[n] = '\0';
+
+    double period, every, reference;
+    if (!json_number(text, "period_s", &period) || !json_number(text, "upload_every", &every)
+        || !json_number(text, "awake_mas_per_sample", &reference) || period < 1 || every < 1) {
+        fprintf(stderr, "%s: referencia no válida\n", path);
+        return 2;
+    }
+    scenario_t s;
+    model(t, (uint32_t)period, (uint32_t)every, &s);
+    double change_pct = (s.awake_mas - reference) / reference * 100.0;
+    bool worse = change_pct > tolerance_pct;
+    printf("Referencia (%u s, subida cada %u): %.3f -> %.3f mA·s por muestra (%+.1f %%, tolerancia %.1f %%): %s\n",
+           s.period_s, s.upload_every, reference, s.awake_mas, change_pct, tolerance_pct, worse ? "EMPEORA" : "OK");
+    return worse ? 1 : 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Uso: %s --profile fichero [--profile ...] [--currents fichero] [--period s,s...]\n"
+                    "       [--upload-every n,n...] [--bytes-per-sample B] [--uplink-kbps kbps]\n"
+                    "       [--capacity-mah mAh] [--derate f] [--json fichero] [--write-baseline fichero]\n"
+                    "       [--baseline fichero] [--tolerance %%]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    timings_t timings = {0};
+    uint32_t periods[MAX_SCENARIO_VALUES] = { 30, 60, 300, 600, 1800 };
+    uint32_t batches[MAX_SCENARIO_VALUES] = { 1, 4, 12 };
+    int period_count = 5, batch_count = 3;
+    const char *json_path = NULL;
+    const char *baseline_out = NULL;
+    const char *baseline_in = NULL;
+    double tolerance_pct = 5.0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(a, "--profile") == 0 && has_value) {
+            if (load_profiles(argv[++i], &timings) != 0) return 2;
+        } else if (strcmp(a, "--currents") == 0 && has_value) {
+            if (load_currents(argv[++i]) != 0) return 2;
+        } else if (strcmp(a, "--period") == 0 && has_value) {
+            period_count = parse_list(argv[++i], periods);
+        } else if (strcmp(a, "--upload-every") == 0 && has_value) {
+            batch_count = parse_list(argv[++i], batches);
+        } else if (strcmp(a, "--bytes-per-sample") == 0 && has_value) {
+            bytes_per_sample = strtod(argv[++i], NULL);
+        } else if (strcmp(a, "--uplink-kbps") == 0 && has_value) {
+            uplink_kbps = strtod(argv[++i], NULL);
+        } else if (strcmp(a, "--capacity-mah") == 0 && has_value) {
+            capacity_mah = strtod(argv[++i], NULL);
+        } else if (strcmp(a, "--derate") == 0 && has_value) {
+            derate = strtod(argv[++i], NULL);
+        } else if (strcmp(a, "--json") == 0 && has_value) {
+            json_path = argv[++i];
+        } else if (strcmp(a, "--write-baseline") == 0 && has_value) {
+            baseline_out = argv[++i];
+        } else if (strcmp(a, "--baseline") == 0 && has_value) {
+            baseline_in = argv[++i];
+        } else if (strcmp(a, "--tolerance") == 0 && has_value) {
+            tolerance_pct = strtod(argv[++i], NULL);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (period_count <= 0 || batch_count <= 0 || uplink_kbps <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (timings.cycles <= 0) {
+        fprintf(stderr, "No hay resúmenes del perfilador ({\"cycles\":...}) en los ficheros indicados\n");
+        return 2;
+    }
+
+    int count = period_count * batch_count;
+    scenario_t *scenarios = calloc((size_t)count, sizeof(scenario_t));
+    if (!scenarios) return 2;
+    for (int p = 0; p < period_count; p++) {
+        for (int b = 0; b < batch_count; b++) {
+            model(&timings, periods[p], batches[b], &scenarios[p * batch_count + b]);
+        }
+    }
+
+    print_breakdown(&timings, &scenarios[0]);
+    printf("\n");
+    print_table(scenarios, count);
+
+    int result = 0;
+    if (json_path && write_json(json_path, scenarios, count) != 0) result = 2;
+    if (baseline_out && write_baseline(baseline_out, &scenarios[0]) != 0) result = 2;
+    if (baseline_in && result == 0) {
+        printf("\n");
+        result = check_baseline(baseline_in, &timings, tolerance_pct);
+    }
+    free(scenarios);
+    return result;
+}
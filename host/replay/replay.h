@@ -0,0 +1,16 @@
+// File: host/replay/replay.h
+
+#pragma once                   // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "event_detector.h"
+
+// Calibración fija del nivómetro simulado: la traza se convierte a cuentas del HX711 con ella
+// y el firmware la deshace al leer. 100 cuentas por gramo dejan ±83 kg en los 24 bits del HX711.
+#define REPLAY_HX711_SCALE      100.0f
+#define REPLAY_HX711_OFFSET     8000
+
+void replay_boot(void);                                                 // La parte de app_main que se simula
+void replay_record_read(int64_t read_us, uint32_t epoch_s, bool ok);    // Cada lectura de sensor_task
+void replay_record_detector(uint32_t epoch_s, bool new_event, snow_activity_t activity);  // Cada paso del detector
@@ -0,0 +1,133 @@
+// File: host/replay/replay_boot.c
+
+#include "replay.h"
+#include "sim_hal.h"
+#include "nivometro_sensors.h"
+#include "diagnostics.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "storage.h"
+#include "communication.h"
+#include "power_manager.h"
+#include "energy_budget.h"
+#include "tasks.h"
+#include "commands.h"
+#include "nvs_flash.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "replay";
+
+// Mismos pines que main.c
+#define HCSR04P_TRIGGER_PIN     12
+#define HCSR04P_ECHO_PIN        13
+#define HX711_DOUT_PIN          26
+#define HX711_SCK_PIN           27
+
+// Instancia global que usa tasks.c (en el firmware la define main.c)
+nivometro_t g_nivometro;
+
+void replay_boot(void)
+{
+    // Mismo orden que app_main, sin LED, botón BOOT ni modo calibración
+    profiler_init();
+    diagnostics_init();
+    metrics_init();
+    nvs_flash_init();
+
+    nivometro_config_t nivometro_config = {
+        .hcsr04p_trigger_pin = HCSR04P_TRIGGER_PIN,
+        .hcsr04p_echo_pin    = HCSR04P_ECHO_PIN,
+        .hcsr04p_cal_factor  = 1.0f,
+        .hx711_dout_pin      = HX711_DOUT_PIN,
+        .hx711_sck_pin       = HX711_SCK_PIN,
+        .hx711_gain          = HX711_GAIN_128,
+    };
+    sim_hx711_attach(HX711_DOUT_PIN, HX711_SCK_PIN);
+    sim_hcsr04p_attach(HCSR04P_TRIGGER_PIN, HCSR04P_ECHO_PIN);
+    profiler_begin(PROFILE_HX711_REINIT);               // En main.c, la reinicialización tras deep sleep
+    esp_err_t init_result = nivometro_init(&g_nivometro, &nivometro_config);
+    profiler_end(PROFILE_HX711_REINIT);
+    if (init_result != ESP_OK) {
+        ESP_LOGE(TAG, "Error inicializando el nivómetro simulado");
+        return;
+    }
+    nivometro_apply_calibration_factors(&g_nivometro, 1.0f, REPLAY_HX711_SCALE, REPLAY_HX711_OFFSET);
+
+    storage_init();
+    power_manager_init();
+
+    // En batería la red solo se levanta en los ciclos de subida
+    bool start_communication = true;
+    if (power_manager_get_source() != POWER_SOURCE_USB) {
+        energy_budget_begin_cycle();
+        energy_budget_update(power_manager_read_battery_voltage(), NULL);
+        start_communication = energy_budget_get_plan()->upload_due;
+    }
+    commands_init();
+    if (start_communication) {
+        communication_init();
+    }
+
+    tasks_start_all();
+}
+
+// === PUNTOS DE ENGANCHE (-Wl,--wrap) ===
+
+// En el equipo el deep sleep reinicia y communication_init() levanta la red desde cero. En el host
+// el módulo conserva su estado entre "reinicios": tras despertar se considera sin inicializar
+// mientras la radio esté apagada, e inicializar es reasociarse, esperar a la hora y rearrancar MQTT.
+bool __real_communication_is_initialized(void);
+void __real_communication_init(void);
+
+bool __wrap_communication_is_initialized(void)
+{
+    return __real_communication_is_initialized() && sim_net_radio_is_on();
+}
+
+void __wrap_communication_init(void)
+{
+    if (!__real_communication_is_initialized()) {
+        __real_communication_init();
+        return;
+    }
+    if (sim_net_radio_is_on()) {
+        return;
+    }
+    // Mismas fases del perfilador que communication_init(); MQTT_CONNECT lo cierra su manejador
+    profiler_begin(PROFILE_WIFI_ASSOC);
+    sim_net_radio_on();
+    while (!sim_net_wifi_connected()) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    profiler_end(PROFILE_WIFI_ASSOC);
+    profiler_begin(PROFILE_SNTP);
+    vTaskDelay(pdMS_TO_TICKS(1000));                    // init_sntp_and_wait() sondea cada segundo
+    profiler_end(PROFILE_SNTP);
+    profiler_begin(PROFILE_MQTT_CONNECT);
+    sim_net_mqtt_start();
+}
+
+// Instante de cada lectura para medir la latencia hasta el broker
+esp_err_t __real_nivometro_read_all_sensors(nivometro_t *nivometro, nivometro_data_t *data);
+
+esp_err_t __wrap_nivometro_read_all_sensors(nivometro_t *nivometro, nivometro_data_t *data)
+{
+    int64_t read_us = sim_time_us();
+    esp_err_t result = __real_nivometro_read_all_sensors(nivometro, data);
+    replay_record_read(read_us, (uint32_t)(sim_wall_clock_epoch_us() / 1000000), result == ESP_OK);
+    return result;
+}
+
+// Cada paso del detector de nieve, para comprobar cuándo dispara y cuándo vuelve a la calma
+bool __real_event_detector_update(event_detector_t *det, const event_detector_params_t *params,
+                                  float distance_cm, float weight_kg);
+
+bool __wrap_event_detector_update(event_detector_t *det, const event_detector_params_t *params,
+                                  float distance_cm, float weight_kg)
+{
+    bool new_event = __real_event_detector_update(det, params, distance_cm, weight_kg);
+    replay_record_detector((uint32_t)(sim_wall_clock_epoch_us() / 1000000), new_event, det->activity);
+    return new_event;
+}
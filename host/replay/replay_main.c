@@ -0,0 +1,756 @@
+// File: host/replay/replay_main.c
+//
+// Reproduce una traza registrada (instante, distancia, peso, alimentación) a través del firmware
+// real: sensor_task -> cola -> almacén -> publish_task -> cliente MQTT, con la red y el broker
+// simulados en tiempo virtual. Al terminar informa del rendimiento extremo a extremo, de los
+// percentiles de latencia hasta el broker, de las muestras perdidas en cada etapa y de los bytes
+// enviados por topic, para comparar cambios de lotes, agregación o planificación con datos reales.
+//
+// La traza es un CSV con una fila por instante (cabecera y líneas con # opcionales):
+//   timestamp,distance_cm,weight_kg,power[,battery_v]
+// timestamp en segundos epoch o ISO 8601 UTC (2024-01-05T10:00:00Z); power "usb" o "battery" (o 1/0).
+// Entre filas los sensores mantienen el último valor.
+//
+// Con --command s:json el servidor deja un comando en el topic cmd de la estación a los s segundos
+// de la traza (se puede repetir); si duerme, el broker lo guarda hasta la próxima conexión:
+//   --command '900:{"id":"c1","cmd":"set","key":"calm_ms","value":"300000"}'
+//
+// Las muestras en crudo llevan la estimación del filtro de espesor y SWE: se cuentan las medidas
+// rechazadas, el NIS medio de las aceptadas (~1 si el ruido configurado es el real; mucho menos, el
+// filtro desconfía de más) y el salto máximo entre muestras seguidas en crudo y filtrado. Con
+// --max-filter-step-cm sale con código 1 si el espesor filtrado salta más (comprobación con la
+// traza de ventisca, objetivo filter_check).
+//
+// Cada paso del detector de eventos (CUSUM) se registra en segundos desde la primera fila. Con
+// --expect-onset-s y --expect-calm-s se marca la nevada de la traza: un evento antes de ella (tramo
+// plano con ruido) es un falso disparo, el primero dentro debe llegar como mucho --max-onset-samples muestras después
+// del inicio y la actividad debe volver a CALM tras el fin; si no, sale con código 1 (objetivo
+// event_check con la traza de nevada).
+//
+// Uso: replay traza.csv [--json fichero] [--capture fichero] [--tail-s s] [--rtt-ms ms]
+//             [--uplink-kbps kbps] [--assoc-ms ms] [--mqtt-connect-ms ms] [--poll-us us]
+//             [--battery-v V] [--command s:json] [--max-filter-step-cm cm]
+//             [--expect-onset-s s] [--max-onset-samples n] [--expect-calm-s s] [-v]
+
+#define _GNU_SOURCE                         // strptime, timegm
+
+#include "replay.h"
+#include "sim_hal.h"
+#include "storage.h"
+#include "metrics.h"
+#include "config.h"
+#include "sdkconfig.h"
+#include "esp_mac.h"
+#include "esp_log.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define TRACE_LINE_MAX      256
+#define LATE_MATCH_S        1               // Tolerancia entre el sello de la muestra y el instante de lectura
+#define MAX_COMMANDS        16
+#define KF_DEPTH_VALID      0x01            // Bits de kf_flags (SNOW_FILTER_* en snow_filter.h)
+#define KF_SWE_VALID        0x02
+#define KF_DEPTH_GATED      0x04
+#define KF_SWE_GATED        0x08
+#define KF_RESETS           0x30
+
+typedef struct {
+    int64_t epoch_s;
+    float distance_cm;
+    float weight_kg;
+    bool usb;
+    float battery_v;                        // NAN si la traza no trae tensión
+} trace_row_t;
+
+typedef struct {
+    int64_t read_us;
+    uint32_t epoch_s;
+    bool delivered;
+} sample_t;
+
+typedef struct {
+    int64_t at_us;                          // Instante virtual en que el servidor lo publica
+    const char *json;
+} replay_command_t;
+
+typedef struct {
+    double *values;
+    size_t count;
+    size_t capacity;
+} series_t;
+
+// Un canal del filtro visto desde el broker (espesor o SWE)
+typedef struct {
+    uint32_t gated;
+    double nis_sum;                         // NIS de las medidas aceptadas
+    uint32_t nis_count;
+    bool has_prev;
+    double prev_raw, prev_filt;
+    double max_step_raw, max_step_filt;     // Mayor salto entre muestras seguidas
+} filter_channel_t;
+
+static trace_row_t *rows = NULL;
+static size_t row_count = 0;
+static size_t next_row = 0;
+static float default_battery_v = 3.90f;
+
+static sample_t *samples = NULL;
+static size_t sample_count = 0;
+static size_t sample_capacity = 0;
+static uint32_t read_errors = 0;
+
+static series_t raw_latency_s;              // Lectura -> llegada al broker (muestra en crudo)
+static series_t agg_latency_s;              // Cierre de la ventana -> llegada al broker (agregado)
+static uint32_t raw_received = 0;
+static uint32_t raw_unmatched = 0;          // Mensajes de datos sin lectura correspondiente (duplicados)
+static uint64_t agg_samples = 0;            // Muestras representadas en los agregados de la ventana corta
+static uint32_t agg_received = 0;
+static FILE *capture = NULL;
+
+static replay_command_t commands[MAX_COMMANDS];
+static int command_count = 0;
+static uint32_t command_acks = 0;
+static uint32_t filter_samples = 0;
+static uint32_t filter_resets = 0;
+static filter_channel_t filter_depth, filter_swe;
+
+// Detector de eventos, en segundos desde la primera fila (-1: sin nevada marcada o aún no ocurrido)
+static int64_t expect_onset_s = -1;
+static int64_t expect_calm_s = -1;
+static uint32_t det_updates = 0;
+static uint32_t det_events = 0;
+static uint32_t det_false_events = 0;       // Eventos antes del inicio de la nevada
+static uint32_t det_onset_samples = 0;      // Pasos del detector desde el inicio hasta el primer evento
+static int64_t det_first_event_s = -1;
+static int64_t det_calm_s = -1;             // Primera vuelta a CALM tras el fin
+
+// === SERIES Y PERCENTILES ===
+
+static void series_add(series_t *s, double v)
+{
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : 1024;
+        s->values = realloc(s->values, s->capacity * sizeof(double));
+        if (!s->values) {
+            fprintf(stderr, "Sin memoria para las latencias\n");
+            exit(2);
+        }
+    }
+    s->values[s->count++] = v;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const series_t *s, double p)
+{
+    if (s->count == 0) return NAN;
+    size_t i = (size_t)ceil(p / 100.0 * (double)s->count);
+    if (i > 0) i--;
+    if (i >= s->count) i = s->count - 1;
+    return s->values[i];
+}
+
+// === TRAZA ===
+
+static bool parse_timestamp(const char *text, int64_t *epoch_s)
+{
+    struct tm tm = {0};
+    char *end = NULL;
+    if (strptime(text, "%Y-%m-%dT%H:%M:%S", &tm) != NULL) {
+        *epoch_s = (int64_t)timegm(&tm);
+        return true;
+    }
+    double v = strtod(text, &end);
+    if (end == text) return false;
+    *epoch_s = (int64_t)v;
+    return true;
+}
+
+static bool parse_power(const char *text, bool *usb)
+{
+    while (*text == ' ') text++;
+    if (strncasecmp(text, "usb", 3) == 0 || text[0] == '1') {
+        *usb = true;
+    } else if (strncasecmp(text, "bat", 3) == 0 || text[0] == '0') {
+        *usb = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static int load_trace(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    size_t capacity = 0;
+    char line[TRACE_LINE_MAX];
+    int line_no = 0;
+    bool first = true;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+        bool header = first;
+        first = false;
+
+        char *fields[5] = {0};
+        int n = 0;
+        for (char *tok = strtok(line, ","); tok && n < 5; tok = strtok(NULL, ",")) {
+            fields[n++] = tok;
+        }
+        trace_row_t r = { .battery_v = NAN };
+        if (n < 4 || !parse_timestamp(fields[0], &r.epoch_s)) {
+            if (header) continue;                           // Cabecera
+            fprintf(stderr, "%s:%d: fila no válida\n", path, line_no);
+            fclose(f);
+            return -1;
+        }
+        r.distance_cm = strtof(fields[1], NULL);
+        r.weight_kg = strtof(fields[2], NULL);
+        if (!parse_power(fields[3], &r.usb)) {
+            fprintf(stderr, "%s:%d: alimentación desconocida '%s'\n", path, line_no, fields[3]);
+            fclose(f);
+            return -1;
+        }
+        if (n == 5 && fields[4][0] != '\0') r.battery_v = strtof(fields[4], NULL);
+        if (row_count > 0 && r.epoch_s < rows[row_count - 1].epoch_s) {
+            fprintf(stderr, "%s:%d: la traza no está ordenada por tiempo\n", path, line_no);
+            fclose(f);
+            return -1;
+        }
+
+        if (row_count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            rows = realloc(rows, capacity * sizeof(trace_row_t));
+            if (!rows) {
+                fclose(f);
+                return -1;
+            }
+        }
+        rows[row_count++] = r;
+    }
+    fclose(f);
+    if (row_count == 0) {
+        fprintf(stderr, "%s: traza vacía\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int64_t row_time_us(size_t i)
+{
+    return (rows[i].epoch_s - rows[0].epoch_s) * 1000000;
+}
+
+// Fija los modelos de los sensores y la alimentación con la fila y programa la siguiente
+static void apply_row_cb(void *arg)
+{
+    (void)arg;
+    const trace_row_t *r = &rows[next_row];
+
+    float raw = REPLAY_HX711_OFFSET + r->weight_kg * 1000.0f * REPLAY_HX711_SCALE;
+    if (raw > 8388607.0f) raw = 8388607.0f;             // Saturación del convertidor de 24 bits
+    if (raw < -8388608.0f) raw = -8388608.0f;
+    sim_hx711_set_raw((int32_t)raw);
+    sim_hcsr04p_set_distance_cm(r->distance_cm);
+    sim_power_set_battery_voltage(isnan(r->battery_v) ? default_battery_v : r->battery_v);
+    sim_power_set_usb(r->usb);
+
+    if (++next_row < row_count) {
+        sim_sched_call_at(row_time_us(next_row), apply_row_cb, NULL);
+    }
+}
+
+// === COMANDOS DEL SERVIDOR ===
+
+// Topic cmd de la estación, con el mismo id que calcula communication.c (menuconfig o MAC)
+static void command_topic(char *out, size_t out_len)
+{
+    char station[24];
+    if (strlen(CONFIG_NIVOMETRO_STATION_ID) > 0) {
+        snprintf(station, sizeof(station), "%s", CONFIG_NIVOMETRO_STATION_ID);
+    } else {
+        uint8_t mac[6] = {0};
+        esp_efuse_mac_get_default(mac);
+        snprintf(station, sizeof(station), "%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+    snprintf(out, out_len, "%s/%s/cmd", config_get_str(CFG_MQTT_TOPIC_PREFIX), station);
+}
+
+static void send_command_cb(void *arg)
+{
+    const replay_command_t *c = arg;
+    char topic[64];
+    command_topic(topic, sizeof(topic));
+    if (!sim_net_broker_publish(topic, c->json)) {
+        fprintf(stderr, "Buzón del broker lleno: comando descartado\n");
+    }
+}
+
+static bool parse_command(const char *text)
+{
+    char *end;
+    double at_s = strtod(text, &end);
+    if (end == text || *end != ':' || at_s < 0 || command_count == MAX_COMMANDS) return false;
+    commands[command_count].at_us = (int64_t)(at_s * 1e6);
+    commands[command_count].json = end + 1;
+    command_count++;
+    return true;
+}
+
+// === LECTURAS Y BROKER ===
+
+void replay_record_read(int64_t read_us, uint32_t epoch_s, bool ok)
+{
+    if (!ok) {
+        read_errors++;
+        return;
+    }
+    if (sample_count == sample_capacity) {
+        sample_capacity = sample_capacity ? sample_capacity * 2 : 4096;
+        samples = realloc(samples, sample_capacity * sizeof(sample_t));
+        if (!samples) {
+            fprintf(stderr, "Sin memoria para las lecturas\n");
+            exit(2);
+        }
+    }
+    samples[sample_count++] = (sample_t){ read_us, epoch_s, false };
+}
+
+void replay_record_detector(uint32_t epoch_s, bool new_event, snow_activity_t activity)
+{
+    int64_t t = (int64_t)epoch_s - rows[0].epoch_s;
+    bool before_onset = expect_onset_s >= 0 && t < expect_onset_s;
+    bool after_calm = expect_calm_s >= 0 && t >= expect_calm_s;
+    det_updates++;
+    if (expect_onset_s >= 0 && !before_onset && det_first_event_s < 0) det_onset_samples++;
+    if (new_event) {
+        det_events++;
+        if (before_onset) {
+            det_false_events++;
+        } else if (det_first_event_s < 0) {
+            det_first_event_s = t;
+        }
+    }
+    if (after_calm && det_calm_s < 0 && activity == SNOW_ACTIVITY_CALM) det_calm_s = t;
+}
+
+// Primera lectura aún sin entregar con ese sello (el reloj de pared nunca retrocede)
+static sample_t *match_sample(int64_t epoch_s)
+{
+    size_t lo = 0, hi = sample_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if ((int64_t)samples[mid].epoch_s < epoch_s - LATE_MATCH_S) lo = mid + 1;
+        else hi = mid;
+    }
+    for (size_t i = lo; i < sample_count && (int64_t)samples[i].epoch_s <= epoch_s + LATE_MATCH_S; i++) {
+        if (!samples[i].delivered) return &samples[i];
+    }
+    return NULL;
+}
+
+static bool json_number(const char *payload, const char *key, double *value)
+{
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(payload, pattern);
+    if (!p) return false;
+    *value = strtod(p + strlen(pattern), NULL);
+    return true;
+}
+
+static bool json_timestamp(const char *payload, int64_t *epoch_s)
+{
+    const char *p = strstr(payload, "\"timestamp\":");
+    if (!p) return false;
+    p = strchr(p + 12, '"');
+    return p && parse_timestamp(p + 1, epoch_s);
+}
+
+static bool ends_with(const char *s, const char *suffix)
+{
+    size_t ls = strlen(s), lx = strlen(suffix);
+    return ls >= lx && strcmp(s + ls - lx, suffix) == 0;
+}
+
+static void filter_channel_add(filter_channel_t *c, const char *payload, const char *raw_key,
+                               const char *filt_key, const char *nis_key, bool gated)
+{
+    double raw, filt, nis;
+    if (!json_number(payload, raw_key, &raw) || !json_number(payload, filt_key, &filt)) return;
+    if (gated) {
+        c->gated++;
+    } else if (json_number(payload, nis_key, &nis)) {
+        c->nis_sum += nis;
+        c->nis_count++;
+    }
+    if (c->has_prev) {
+        if (fabs(raw - c->prev_raw) > c->max_step_raw) c->max_step_raw = fabs(raw - c->prev_raw);
+        if (fabs(filt - c->prev_filt) > c->max_step_filt) c->max_step_filt = fabs(filt - c->prev_filt);
+    }
+    c->prev_raw = raw;
+    c->prev_filt = filt;
+    c->has_prev = true;
+}
+
+static void filter_record(const char *payload)
+{
+    double flags_value;
+    if (!json_number(payload, "kf_flags", &flags_value)) return;
+    uint32_t flags = (uint32_t)flags_value;
+    filter_samples++;
+    if (flags & KF_RESETS) filter_resets++;
+    if (flags & KF_DEPTH_VALID) {
+        filter_channel_add(&filter_depth, payload, "depth_cm", "depth_kf", "depth_nis", flags & KF_DEPTH_GATED);
+    }
+    if (flags & KF_SWE_VALID) {
+        filter_channel_add(&filter_swe, payload, "swe_mm", "swe_kf", "swe_nis", flags & KF_SWE_GATED);
+    }
+}
+
+static double filter_mean_nis(const filter_channel_t *c)
+{
+    return c->nis_count ? c->nis_sum / c->nis_count : 0.0;
+}
+
+// Virtual <-> pared: el reloj de pared sincronizado es el de la traza
+static int64_t epoch_to_virtual_us(int64_t epoch_s)
+{
+    return (epoch_s - rows[0].epoch_s) * 1000000;
+}
+
+static void broker_listener(const char *topic, const char *payload, int len, int64_t recv_us, void *ctx)
+{
+    (void)ctx;
+    if (capture) {
+        fprintf(capture, "%.3f\t%s\t%.*s\n", (double)(rows[0].epoch_s * 1000000 + recv_us) / 1e6, topic, len, payload);
+    }
+
+    int64_t ts;
+    if (ends_with(topic, "/ack")) {
+        command_acks++;
+    } else if (ends_with(topic, "/data") && json_timestamp(payload, &ts)) {
+        raw_received++;
+        filter_record(payload);
+        sample_t *s = match_sample(ts);
+        if (s) {
+            s->delivered = true;
+            series_add(&raw_latency_s, (double)(recv_us - s->read_us) / 1e6);
+        } else {
+            raw_unmatched++;
+        }
+    } else if (ends_with(topic, "/agg") && json_timestamp(payload, &ts)) {
+        double window_s = 0, count = 0;
+        json_number(payload, "window_s", &window_s);
+        json_number(payload, "count", &count);
+        if ((uint32_t)window_s == CONFIG_AGGREGATION_WINDOW_SHORT_S) {
+            agg_received++;
+            agg_samples += (uint64_t)count;
+            series_add(&agg_latency_s, (double)(recv_us - epoch_to_virtual_us(ts + (int64_t)window_s)) / 1e6);
+        }
+    }
+}
+
+// === INFORME ===
+
+typedef struct {
+    double virtual_h;
+    double host_s;
+    uint32_t read;
+    uint32_t raw_delivered;
+    uint32_t queue_dropped;
+    uint32_t storage_dropped;
+    uint32_t lost_at_sleep;
+    uint32_t lost_in_flight;
+    uint32_t publish_failed;
+    uint32_t pending;
+    uint64_t mqtt_bytes;
+    uint64_t ip_bytes;
+    uint32_t messages;
+} report_t;
+
+static void build_report(report_t *r, double host_s)
+{
+    memset(r, 0, sizeof(*r));
+    r->virtual_h = (double)sim_time_us() / 3.6e9;
+    r->host_s = host_s;
+    r->read = (uint32_t)sample_count;
+    for (size_t i = 0; i < sample_count; i++) {
+        if (samples[i].delivered) r->raw_delivered++;
+    }
+    r->queue_dropped = metrics_counter_get(METRIC_SAMPLES_DROPPED);
+    r->storage_dropped = storage_dropped_count();
+    r->lost_at_sleep = sim_sched_queue_items_lost();
+    r->lost_in_flight = sim_net_lost_in_flight();
+    r->publish_failed = metrics_counter_get(METRIC_PUBLISH_FAILED);
+    r->pending = storage_pending_count();
+    for (uint32_t i = 0; i < sim_net_topic_count(); i++) {
+        const sim_topic_stats_t *st = sim_net_topic_stats(i);
+        r->mqtt_bytes += st->mqtt_bytes;
+        r->messages += st->messages;
+    }
+    r->mqtt_bytes += sim_net_overhead_bytes();
+    r->ip_bytes = r->mqtt_bytes + sim_net_ip_packets() * 40;    // Cabeceras IPv4 + TCP sin opciones
+}
+
+static void print_latency(const char *name, series_t *s)
+{
+    qsort(s->values, s->count, sizeof(double), cmp_double);
+    if (s->count == 0) {
+        printf("  %-26s sin mensajes\n", name);
+        return;
+    }
+    printf("  %-26s n=%-7zu p50 %8.2f s  p95 %8.2f s  p99 %8.2f s  máx %8.2f s\n", name, s->count,
+           percentile(s, 50), percentile(s, 95), percentile(s, 99), s->values[s->count - 1]);
+}
+
+static void print_report(const report_t *r)
+{
+    double per_h = r->virtual_h > 0 ? 1.0 / r->virtual_h : 0;
+
+    printf("Traza: %zu filas, %.1f h simuladas en %.2f s de host (x%.0f)\n",
+           row_count, r->virtual_h, r->host_s, r->host_s > 0 ? r->virtual_h * 3600.0 / r->host_s : 0);
+    printf("Muestras: %u leídas (%u errores), %u en crudo en el broker, %" PRIu64 " en agregados de %d s, %u pendientes\n",
+           r->read, read_errors, r->raw_delivered, agg_samples, CONFIG_AGGREGATION_WINDOW_SHORT_S, r->pending);
+    printf("Perdidas: cola llena %u, almacén lleno %u, en RAM al dormir %u, en vuelo al dormir %u, rechazadas por el cliente %u\n",
+           r->queue_dropped, r->storage_dropped, r->lost_at_sleep, r->lost_in_flight, r->publish_failed);
+    printf("Rendimiento: %.1f lecturas/h, %.1f muestras en crudo/h, %.1f mensajes/h, cola máx %u\n",
+           r->read * per_h, r->raw_delivered * per_h, r->messages * per_h, sim_sched_queue_high_water());
+    printf("Latencia hasta el broker:\n");
+    print_latency("muestra en crudo", &raw_latency_s);
+    print_latency("cierre de ventana (agg)", &agg_latency_s);
+    if (raw_unmatched > 0) printf("  %u mensajes de datos sin lectura correspondiente\n", raw_unmatched);
+
+    printf("Bytes en la red:\n");
+    printf("  %-34s %8s %12s %12s\n", "topic", "mensajes", "carga (B)", "MQTT (B)");
+    for (uint32_t i = 0; i < sim_net_topic_count(); i++) {
+        const sim_topic_stats_t *st = sim_net_topic_stats(i);
+        printf("  %-34s %8u %12" PRIu64 " %12" PRIu64 "\n", sim_net_topic_name(i), st->messages,
+               st->payload_bytes, st->mqtt_bytes);
+    }
+    printf("  %-34s %8s %12s %12" PRIu64 "\n", "conexión, keepalive y SNTP", "", "", sim_net_overhead_bytes());
+    printf("  Total: %" PRIu64 " B MQTT, %" PRIu64 " B con TCP/IP", r->mqtt_bytes, r->ip_bytes);
+    if (r->read > 0) printf(" (%.1f B por muestra leída)", (double)r->ip_bytes / (double)r->read);
+    printf("\n");
+    printf("Energía: %u deep sleeps (%.1f h dormido), %u conexiones MQTT\n",
+           sim_power_deep_sleeps(), (double)sim_power_sleep_us() / 3.6e9, sim_net_connects());
+    if (command_count > 0) {
+        printf("Comandos: %d enviados, %u entregados a la estación, %u respuestas\n",
+               command_count, sim_net_broker_delivered(), command_acks);
+    }
+    if (filter_samples > 0) {
+        printf("Filtro: %u muestras, rechazadas %u de distancia y %u de peso, %u reinicios; NIS medio %.2f (espesor) y %.2f (SWE)\n",
+               filter_samples, filter_depth.gated, filter_swe.gated, filter_resets,
+               filter_mean_nis(&filter_depth), filter_mean_nis(&filter_swe));
+        printf("  salto máximo entre muestras: espesor %.1f cm en crudo, %.1f cm filtrado; SWE %.2f mm en crudo, %.2f mm filtrado\n",
+               filter_depth.max_step_raw, filter_depth.max_step_filt, filter_swe.max_step_raw, filter_swe.max_step_filt);
+    }
+    printf("Detector: %u muestras, %u eventos", det_updates, det_events);
+    if (det_first_event_s >= 0) {
+        printf(", primero a %" PRId64 " s", det_first_event_s);
+        if (expect_onset_s >= 0) printf(" (%u muestras tras el inicio de la nevada)", det_onset_samples);
+    }
+    if (expect_onset_s >= 0) printf(", %u antes de la nevada", det_false_events);
+    if (expect_calm_s >= 0) {
+        if (det_calm_s >= 0) {
+            printf(", calma de nuevo a %" PRId64 " s", det_calm_s);
+        } else {
+            printf(", sin volver a la calma");
+        }
+    }
+    printf("\n");
+}
+
+static int write_json(const char *path, const report_t *r)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "{\n");
+    fprintf(f, "  \"trace_rows\": %zu, \"virtual_h\": %.3f, \"host_s\": %.3f,\n", row_count, r->virtual_h, r->host_s);
+    fprintf(f, "  \"samples_read\": %u, \"read_errors\": %u, \"raw_delivered\": %u, \"agg_samples\": %" PRIu64 ", \"pending\": %u,\n",
+            r->read, read_errors, r->raw_delivered, agg_samples, r->pending);
+    fprintf(f, "  \"dropped\": {\"queue_full\": %u, \"storage_full\": %u, \"ram_at_sleep\": %u, "
+               "\"in_flight\": %u, \"publish_failed\": %u},\n",
+            r->queue_dropped, r->storage_dropped, r->lost_at_sleep, r->lost_in_flight, r->publish_failed);
+    fprintf(f, "  \"queue_high_water\": %u, \"messages\": %u, \"mqtt_bytes\": %" PRIu64 ", \"ip_bytes\": %" PRIu64 ",\n",
+            sim_sched_queue_high_water(), r->messages, r->mqtt_bytes, r->ip_bytes);
+    series_t *series[2] = { &raw_latency_s, &agg_latency_s };
+    const char *names[2] = { "raw_latency_s", "agg_latency_s" };
+    for (int i = 0; i < 2; i++) {
+        const series_t *s = series[i];
+        if (s->count == 0) {
+            fprintf(f, "  \"%s\": null,\n", names[i]);
+        } else {
+            fprintf(f, "  \"%s\": {\"n\": %zu, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+                    names[i], s->count, percentile(s, 50), percentile(s, 95), percentile(s, 99), s->values[s->count - 1]);
+        }
+    }
+    fprintf(f, "  \"topics\": [");
+    for (uint32_t i = 0; i < sim_net_topic_count(); i++) {
+        const sim_topic_stats_t *st = sim_net_topic_stats(i);
+        fprintf(f, "%s\n    {\"topic\": \"%s\", \"messages\": %u, \"payload_bytes\": %" PRIu64 ", \"mqtt_bytes\": %" PRIu64 "}",
+                i ? "," : "", sim_net_topic_name(i), st->messages, st->payload_bytes, st->mqtt_bytes);
+    }
+    fprintf(f, "\n  ],\n");
+    fprintf(f, "  \"commands\": {\"sent\": %d, \"delivered\": %u, \"acks\": %u},\n",
+            command_count, sim_net_broker_delivered(), command_acks);
+    fprintf(f, "  \"filter\": {\"samples\": %u, \"depth_gated\": %u, \"swe_gated\": %u, \"resets\": %u, "
+               "\"depth_nis_mean\": %.3f, \"swe_nis_mean\": %.3f, \"depth_max_step_raw\": %.2f, "
+               "\"depth_max_step_filt\": %.2f, \"swe_max_step_raw\": %.2f, \"swe_max_step_filt\": %.2f},\n",
+            filter_samples, filter_depth.gated, filter_swe.gated, filter_resets,
+            filter_mean_nis(&filter_depth), filter_mean_nis(&filter_swe), filter_depth.max_step_raw,
+            filter_depth.max_step_filt, filter_swe.max_step_raw, filter_swe.max_step_filt);
+    fprintf(f, "  \"detector\": {\"samples\": %u, \"events\": %u, \"false_events\": %u, "
+               "\"first_event_s\": %" PRId64 ", \"onset_samples\": %u, \"calm_s\": %" PRId64 "},\n",
+            det_updates, det_events, det_false_events, det_first_event_s, det_onset_samples, det_calm_s);
+    fprintf(f, "  \"deep_sleeps\": %u, \"sleep_h\": %.3f, \"mqtt_connects\": %u\n",
+            sim_power_deep_sleeps(), (double)sim_power_sleep_us() / 3.6e9, sim_net_connects());
+    fprintf(f, "}\n");
+    fclose(f);
+    return 0;
+}
+
+static double host_now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Uso: %s traza.csv [--json fichero] [--capture fichero] [--tail-s s] [--rtt-ms ms]\n"
+                    "       [--uplink-kbps kbps] [--assoc-ms ms] [--mqtt-connect-ms ms] [--poll-us us]\n"
+                    "       [--battery-v V] [--command s:json] [--max-filter-step-cm cm]\n"
+                    "       [--expect-onset-s s] [--max-onset-samples n] [--expect-calm-s s] [-v]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    const char *json_path = NULL;
+    const char *capture_path = NULL;
+    uint32_t tail_s = 600;                              // Margen tras la última fila para vaciar lo pendiente
+    uint32_t poll_us = 10;                              // Resolución del eco: 10 us ~ 1,7 mm, 10 veces menos CPU
+    int log_level = ESP_LOG_ERROR;
+    double max_filter_step_cm = 0.0;                    // 0: sin comprobación
+    uint32_t max_onset_samples = 0;                     // 0: sin límite
+    sim_net_params_t net;
+    sim_net_default_params(&net);
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(a, "--json") == 0 && has_value) {
+            json_path = argv[++i];
+        } else if (strcmp(a, "--capture") == 0 && has_value) {
+            capture_path = argv[++i];
+        } else if (strcmp(a, "--tail-s") == 0 && has_value) {
+            tail_s = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--rtt-ms") == 0 && has_value) {
+            net.rtt_ms = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--uplink-kbps") == 0 && has_value) {
+            net.uplink_kbps = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--assoc-ms") == 0 && has_value) {
+            net.wifi_assoc_ms = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--mqtt-connect-ms") == 0 && has_value) {
+            net.mqtt_connect_ms = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--poll-us") == 0 && has_value) {
+            poll_us = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--battery-v") == 0 && has_value) {
+            default_battery_v = strtof(argv[++i], NULL);
+        } else if (strcmp(a, "--command") == 0 && has_value) {
+            if (!parse_command(argv[++i])) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(a, "--max-filter-step-cm") == 0 && has_value) {
+            max_filter_step_cm = strtod(argv[++i], NULL);
+        } else if (strcmp(a, "--expect-onset-s") == 0 && has_value) {
+            expect_onset_s = atoll(argv[++i]);
+        } else if (strcmp(a, "--max-onset-samples") == 0 && has_value) {
+            max_onset_samples = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(a, "--expect-calm-s") == 0 && has_value) {
+            expect_calm_s = atoll(argv[++i]);
+        } else if (strcmp(a, "-v") == 0) {
+            log_level = ESP_LOG_INFO;
+        } else if (a[0] != '-' && !trace_path) {
+            trace_path = a;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!trace_path) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (load_trace(trace_path) != 0) return 2;
+    if (capture_path) {
+        capture = fopen(capture_path, "w");
+        if (!capture) {
+            perror(capture_path);
+            return 2;
+        }
+    }
+
+    sim_log_set_level(log_level);
+    sim_set_poll_cost_us(poll_us ? poll_us : 1);
+    sim_net_configure(&net);
+    sim_net_set_broker_listener(broker_listener, NULL);
+    sim_wall_clock_set_epoch_at_zero(rows[0].epoch_s * 1000000);
+
+    // La primera fila fija el estado al encender; después, una fila por instante de la traza
+    apply_row_cb(NULL);
+    sim_power_set_boot(replay_boot);
+    for (int i = 0; i < command_count; i++) {
+        sim_sched_call_at(commands[i].at_us, send_command_cb, &commands[i]);
+    }
+
+    double host_start = host_now_s();
+    sim_sched_run_until(row_time_us(row_count - 1) + (int64_t)tail_s * 1000000);
+
+    report_t report;
+    build_report(&report, host_now_s() - host_start);
+    print_report(&report);
+    if (capture) fclose(capture);
+    if (json_path && write_json(json_path, &report) != 0) return 2;
+    if (max_filter_step_cm > 0.0 && (filter_samples == 0 || filter_depth.max_step_filt > max_filter_step_cm)) {
+        fprintf(stderr, "Filtro: salto de espesor filtrado %.2f cm (máximo %.2f)\n",
+                filter_depth.max_step_filt, max_filter_step_cm);
+        return 1;
+    }
+    int status = 0;
+    if (det_false_events > 0) {
+        fprintf(stderr, "Detector: %u eventos antes de la nevada\n", det_false_events);
+        status = 1;
+    }
+    if (expect_onset_s >= 0 && (det_first_event_s < 0 ||
+                                (max_onset_samples > 0 && det_onset_samples > max_onset_samples))) {
+        fprintf(stderr, "Detector: primer evento %u muestras tras el inicio de la nevada (máximo %u)\n",
+                det_onset_samples, max_onset_samples);
+        status = 1;
+    }
+    if (expect_calm_s >= 0 && det_calm_s < 0) {
+        fprintf(stderr, "Detector: no vuelve a la calma tras el fin de la nevada\n");
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,101 @@
+// File: host/sdkconfig.h
+//
+// Configuración de la compilación en host: los valores por defecto de los Kconfig.projbuild
+// de los componentes que se compilan aquí. Sin CONFIG_PM_ENABLE (no hay gestión de energía).
+
+#pragma once
+
+#define CONFIG_FREERTOS_HZ                      100
+
+// main/Kconfig.projbuild
+#define CONFIG_CALIBRATION_HX711_KNOWN_WEIGHT   500
+#define CONFIG_CALIBRATION_HX711_SAMPLES        40
+#define CONFIG_CALIBRATION_HX711_TOLERANCE_PERCENT 3
+#define CONFIG_CALIBRATION_HCSR04P_KNOWN_DISTANCE 30
+#define CONFIG_CALIBRATION_HCSR04P_SAMPLES      40
+#define CONFIG_CALIBRATION_HCSR04P_TOLERANCE_PERCENT 3
+#define CONFIG_CALIBRATION_HX711_TARE_CI_COUNTS 200
+#define CONFIG_CALIBRATION_MIN_SAMPLES          5
+#define CONFIG_CALIBRATION_CONVERGENCE_PERMILLE 5
+
+// components/communication
+#define CONFIG_WIFI_SSID                        ""
+#define CONFIG_WIFI_PASSWORD                    ""
+#define CONFIG_NIVOMETRO_STATION_ID             ""
+#define CONFIG_MQTT_TOPIC_PREFIX                "nivometro"
+#define CONFIG_MQTT_BATCH_ACK_TIMEOUT_MS        10000
+#define CONFIG_MQTT_BROKER_URI                  "mqtts://broker.sim:8883"  // El broker simulado acepta comandos
+#define CONFIG_MQTT_USERNAME                    "nivometro"
+#define CONFIG_MQTT_PASSWORD                    "sim"
+#define CONFIG_MQTT_COMMANDS                    1
+
+// components/power_manager (deep sleep en batería, despertar por USB)
+#define CONFIG_POWER_DEBOUNCE_MS                100
+#define CONFIG_POWER_BATTERY_DEEP_SLEEP         1
+#define CONFIG_POWER_USB_WAKEUP                 1
+#define CONFIG_BATTERY_CAPACITY_MAH             3000
+#define CONFIG_BATTERY_FULL_MV                  4200
+#define CONFIG_BATTERY_EMPTY_MV                 3300
+#define CONFIG_ENERGY_TARGET_RUNTIME_DAYS       180
+#define CONFIG_ENERGY_SLEEP_CURRENT_UA          150
+#define CONFIG_ENERGY_SAMPLE_CHARGE_MAS         60
+#define CONFIG_ENERGY_UPLOAD_CHARGE_MAS         700
+#define CONFIG_ENERGY_MIN_SAMPLE_PERIOD_S       60
+#define CONFIG_ENERGY_MAX_SAMPLE_PERIOD_S       3600
+#define CONFIG_ENERGY_MAX_UPLOAD_EVERY          12
+
+// components/aggregation
+#define CONFIG_AGGREGATION_WINDOW_SHORT_S       60
+#define CONFIG_AGGREGATION_WINDOW_LONG_S        600
+
+// components/event_detector
+#define CONFIG_EVENT_BURST_PERIOD_MS            10000
+#define CONFIG_EVENT_BURST_SAMPLES              12
+#define CONFIG_EVENT_CALM_PERIOD_MS             600000
+#define CONFIG_EVENT_CALM_SAMPLES               10
+#define CONFIG_EVENT_DISTANCE_DRIFT_MM          5
+#define CONFIG_EVENT_DISTANCE_THRESHOLD_MM      30
+#define CONFIG_EVENT_DISTANCE_STEP_MM           20
+#define CONFIG_EVENT_WEIGHT_DRIFT_G             50
+#define CONFIG_EVENT_WEIGHT_THRESHOLD_G         300
+#define CONFIG_EVENT_WEIGHT_STEP_G              200
+
+// components/diagnostics
+#define CONFIG_DIAG_RING_SIZE                   64
+#define CONFIG_DIAG_FLASH_BLOCKS                8
+#define CONFIG_METRICS_PUBLISH_EVERY            60
+#define CONFIG_PROFILER_SUMMARY_CYCLES          24
+#define CONFIG_DLOG_DEFAULT_LEVEL               3
+#define CONFIG_DLOG_LEVEL_TASKS                 3
+#define CONFIG_DLOG_LEVEL_COMM                  3
+#define CONFIG_DLOG_LEVEL_SENSORS               3
+#define CONFIG_DLOG_RING_ENTRIES                64
+#define CONFIG_DLOG_OUTPUT_TEXT                 1
+
+// components/commands
+#define CONFIG_COMMANDS_QUEUE_LENGTH            4
+#define CONFIG_COMMANDS_DEDUP_SLOTS             16
+#define CONFIG_COMMANDS_IDLE_WAIT_MS            10000
+
+// components/nivometro_sensors
+#define CONFIG_HX711_ZERO_TRACKING              1
+#define CONFIG_HX711_ZERO_BAND_G                50
+#define CONFIG_HX711_ZERO_STABLE_G              10
+#define CONFIG_HX711_ZERO_STABLE_SAMPLES        3
+#define CONFIG_HX711_ZERO_WINDOW                288
+#define CONFIG_HX711_ZERO_MAX_DRIFT_G           500
+#define CONFIG_HX711_TEMPCO_MIN_SPAN_DC         20
+#define CONFIG_HX711_ZERO_DISTANCE_BAND_MM      20
+
+// components/snow_metrics
+#define CONFIG_SNOW_MOUNT_HEIGHT_MM             2000
+#define CONFIG_SNOW_PILLOW_AREA_CM2             2500
+#define CONFIG_SNOW_DENSITY_MIN_DEPTH_MM        20
+#define CONFIG_SNOW_FILTER_DEPTH_SIGMA_MM       10
+#define CONFIG_SNOW_FILTER_SWE_SIGMA_DMM        5
+#define CONFIG_SNOW_FILTER_FALL_ACCEL_MM_H2     50
+#define CONFIG_SNOW_FILTER_DEPTH_ACCEL_MM_H2    20
+#define CONFIG_SNOW_FILTER_SWE_ACCEL_DMM_H2     10
+#define CONFIG_SNOW_FILTER_NEW_SNOW_DENSITY     100
+#define CONFIG_SNOW_FILTER_GATE_SIGMA           3
+#define CONFIG_SNOW_FILTER_MAX_REJECTIONS       5
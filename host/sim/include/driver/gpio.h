@@ -0,0 +1,50 @@
+// File: host/sim/include/driver/gpio.h
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_rom_sys.h"
+
+typedef int gpio_num_t;
+
+#define GPIO_NUM_0  0
+#define GPIO_NUM_4  4
+#define GPIO_NUM_26 26
+#define GPIO_NUM_27 27
+
+// Pines del ESP32: no existen 20, 24 y 28-31; 34-39 solo son de entrada
+#define SIM_GPIO_VALID_MASK         (0xFFFFFFFFFFULL & ~((1ULL << 20) | (1ULL << 24) | (0xFULL << 28)))
+#define GPIO_IS_VALID_GPIO(n)       ((n) >= 0 && (n) < 40 && ((SIM_GPIO_VALID_MASK >> (n)) & 1))
+#define GPIO_IS_VALID_OUTPUT_GPIO(n) (GPIO_IS_VALID_GPIO(n) && (n) < 34)
+
+typedef enum {
+    GPIO_MODE_DISABLE = 0,
+    GPIO_MODE_INPUT,
+    GPIO_MODE_OUTPUT,
+    GPIO_MODE_INPUT_OUTPUT
+} gpio_mode_t;
+
+typedef enum { GPIO_PULLUP_DISABLE = 0, GPIO_PULLUP_ENABLE } gpio_pullup_t;
+typedef enum { GPIO_PULLDOWN_DISABLE = 0, GPIO_PULLDOWN_ENABLE } gpio_pulldown_t;
+typedef enum {
+    GPIO_INTR_DISABLE = 0,
+    GPIO_INTR_POSEDGE,
+    GPIO_INTR_NEGEDGE,
+    GPIO_INTR_ANYEDGE,
+    GPIO_INTR_LOW_LEVEL,
+    GPIO_INTR_HIGH_LEVEL
+} gpio_int_type_t;
+
+typedef struct {
+    uint64_t pin_bit_mask;
+    gpio_mode_t mode;
+    gpio_pullup_t pull_up_en;
+    gpio_pulldown_t pull_down_en;
+    gpio_int_type_t intr_type;
+} gpio_config_t;
+
+esp_err_t gpio_config(const gpio_config_t *config);
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num);
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+int gpio_get_level(gpio_num_t gpio_num);
@@ -0,0 +1,8 @@
+// File: host/sim/include/esp_attr.h
+
+#pragma once
+
+// En host no hay memoria RTC ni IRAM: las variables viven en la RAM normal del proceso
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
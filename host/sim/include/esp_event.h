@@ -0,0 +1,19 @@
+// File: host/sim/include/esp_event.h
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_bit_defs.h"
+#include "freertos/FreeRTOS.h"
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t base, int32_t event_id, void *event_data);
+typedef void *esp_event_handler_instance_t;
+
+#define ESP_EVENT_ANY_ID    -1
+
+// Bucle de eventos por defecto: los eventos simulados (sim_net.c) se entregan desde el planificador
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t event_id, esp_event_handler_t handler,
+                                              void *arg, esp_event_handler_instance_t *instance);
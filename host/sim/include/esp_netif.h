@@ -0,0 +1,18 @@
+// File: host/sim/include/esp_netif.h
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_event.h"
+
+typedef struct sim_netif esp_netif_t;
+
+extern const esp_event_base_t IP_EVENT;
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP = 0,
+    IP_EVENT_STA_LOST_IP
+} ip_event_t;
+
+esp_err_t esp_netif_init(void);
+esp_netif_t *esp_netif_create_default_wifi_sta(void);
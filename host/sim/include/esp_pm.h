@@ -0,0 +1,6 @@
+// File: host/sim/include/esp_pm.h
+
+#pragma once
+
+// Sin CONFIG_PM_ENABLE en host: los drivers no usan los bloqueos de energía
+#include "esp_err.h"
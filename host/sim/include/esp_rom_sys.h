@@ -0,0 +1,8 @@
+// File: host/sim/include/esp_rom_sys.h
+
+#pragma once
+
+#include <stdint.h>
+
+void esp_rom_delay_us(uint32_t us);                     // Avanza el reloj virtual
+int esp_rom_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
@@ -0,0 +1,13 @@
+// File: host/sim/include/esp_sntp.h
+
+#pragma once
+
+#include <stdint.h>
+
+typedef enum { SNTP_OPMODE_POLL = 0, SNTP_OPMODE_LISTENONLY } esp_sntp_operatingmode_t;
+typedef enum { SNTP_SYNC_STATUS_RESET = 0, SNTP_SYNC_STATUS_COMPLETED, SNTP_SYNC_STATUS_IN_PROGRESS } sntp_sync_status_t;
+
+void esp_sntp_setoperatingmode(esp_sntp_operatingmode_t mode);
+void esp_sntp_setservername(uint8_t idx, const char *server);
+void esp_sntp_init(void);
+sntp_sync_status_t sntp_get_sync_status(void);
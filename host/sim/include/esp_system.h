@@ -0,0 +1,9 @@
+// File: host/sim/include/esp_system.h
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+uint32_t esp_get_free_heap_size(void);
+void esp_restart(void);
@@ -0,0 +1,8 @@
+// File: host/sim/include/esp_timer.h
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+int64_t esp_timer_get_time(void);                       // Reloj virtual del simulador (ver sim_hal.h)
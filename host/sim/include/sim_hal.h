@@ -0,0 +1,144 @@
+// File: host/sim/include/sim_hal.h
+
+#pragma once                   // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// HAL simulado para la compilación en host. El tiempo es virtual: solo avanza con
+// esp_rom_delay_us(), vTaskDelay() y un coste fijo por cada consulta a esp_timer_get_time(),
+// así los bucles de espera activa de los drivers terminan y las medidas son deterministas.
+// Los modelos de periférico se enganchan a los pines y responden a escrituras y lecturas.
+
+// === RELOJ VIRTUAL ===
+int64_t sim_time_us(void);                              // Instante virtual actual
+void sim_advance_us(int64_t us);                        // Avanza el reloj
+void sim_set_poll_cost_us(uint32_t us);                 // Coste de cada esp_timer_get_time() (1 us por defecto)
+void sim_reset_boot_time(void);                         // esp_timer y los ticks vuelven a 0 (arranque tras deep sleep)
+
+// === GPIO ===
+#define SIM_GPIO_COUNT  40
+
+typedef struct {
+    void (*on_write)(void *ctx, int pin, int level);    // El firmware escribe en un pin del modelo
+    int (*read)(void *ctx, int pin);                    // El firmware lee un pin del modelo
+    void *ctx;
+} sim_gpio_model_t;
+
+void sim_gpio_attach(int pin, const sim_gpio_model_t *model);   // NULL para soltar el pin
+int sim_gpio_output_level(int pin);                     // Último nivel escrito por el firmware
+uint32_t sim_gpio_write_count(void);                    // Escrituras GPIO desde el arranque
+
+// === MODELO HX711 ===
+// Convertidor de 24 bits: DOUT baja cuando hay conversión lista, cada flanco de subida de SCK
+// saca un bit (MSB primero) y los pulsos 25-27 eligen la ganancia de la siguiente conversión.
+// SCK alto más de 60 us lo apaga.
+void sim_hx711_attach(int dout_pin, int sck_pin);
+void sim_hx711_push_raw(int32_t raw);                   // Encola un valor (se repite el último si la cola se vacía)
+void sim_hx711_set_raw(int32_t raw);                    // Vacía la cola y fija un valor constante
+void sim_hx711_set_conversion_us(uint32_t us);          // Tiempo entre conversiones (100 ms = 10 SPS)
+void sim_hx711_set_connected(bool connected);           // Desconectado: DOUT siempre alto
+int sim_hx711_last_gain_pulses(void);                   // Pulsos extra de la última lectura (1, 2 o 3)
+uint32_t sim_hx711_conversions_read(void);
+
+// === MODELO HC-SR04P ===
+// Tras un pulso de trigger de al menos 10 us, el eco sube al cabo de echo_delay_us y
+// permanece alto el tiempo de vuelo de la distancia programada.
+void sim_hcsr04p_attach(int trigger_pin, int echo_pin);
+void sim_hcsr04p_set_distance_cm(float distance_cm);
+void sim_hcsr04p_set_echo_delay_us(uint32_t us);        // Latencia del sensor antes del eco (~450 us)
+void sim_hcsr04p_set_echo(uint32_t delay_us, uint32_t width_us);   // Retardo y anchura del eco en crudo
+void sim_hcsr04p_set_connected(bool connected);         // Desconectado: sin eco (timeout)
+uint32_t sim_hcsr04p_triggers(void);
+
+// === NVS EN MEMORIA ===
+void sim_nvs_reset(void);                               // Borra todo el contenido simulado
+uint32_t sim_nvs_write_count(void);                     // Escrituras (set_*) desde el último reset
+void sim_nvs_set_cost_us(uint32_t per_entry_us, uint32_t per_commit_us);   // Tiempo de flash por entrada de 32 B y por commit
+size_t sim_nvs_bytes_written(void);
+uint32_t sim_nvs_commit_count(void);
+
+// === REGISTRO ===
+void sim_log_set_level(int level);                      // Nivel esp_log para el host (ESP_LOG_WARN por defecto)
+
+// === PLANIFICADOR ===
+// Tareas FreeRTOS como hilos que se ceden el turno: solo una ejecuta a la vez y cambia de tarea
+// únicamente al bloquearse (vTaskDelay, colas, notificaciones, grupos de eventos). Sin expropiación:
+// una tarea de más prioridad que se despierta espera a que la actual se bloquee. Cuando ninguna
+// tarea está lista el reloj salta al siguiente despertar o temporizador, así una traza de meses
+// se reproduce en segundos. Los temporizadores se ejecutan en el hilo del planificador.
+typedef void (*sim_timer_fn_t)(void *arg);
+
+uint32_t sim_sched_call_at(int64_t when_us, sim_timer_fn_t fn, void *arg);   // Devuelve un id (nunca 0)
+void sim_sched_cancel(uint32_t timer_id);
+void sim_sched_sleep_us(int64_t us);                    // Bloqueo inferior a un tick (p. ej. transmisión por el enlace)
+void sim_sched_run_until(int64_t end_us);               // Ejecuta tareas y temporizadores hasta ese instante virtual
+void sim_sched_stop(void);                              // Hace volver a sim_sched_run_until() (desde tarea o temporizador)
+void sim_sched_kill_all(void);                          // Reinicio: termina todas las tareas (la que llama no vuelve)
+uint32_t sim_sched_queue_high_water(void);              // Máxima ocupación observada en cualquier cola
+uint32_t sim_sched_queue_items_lost(void);              // Elementos que quedaban en colas al reiniciar
+
+// === RED Y BROKER MQTT EN PROCESO ===
+// Wi-Fi, SNTP y cliente MQTT simulados: los eventos llegan al firmware con los retardos del
+// modelo y cada publicación QoS1 ocupa el enlace de subida según su tamaño en la red (cabeceras
+// MQTT incluidas); el broker la recibe medio RTT después y el PUBACK vuelve otro medio RTT más tarde.
+// En sentido contrario, sim_net_broker_publish() deja un mensaje QoS1 en el broker para el topic
+// y se entrega (MQTT_EVENT_DATA medio RTT después) en cuanto el cliente está conectado y suscrito.
+// Con clean session desactivado la suscripción se conserva entre conexiones (session_present),
+// y lo que el broker no ha podido entregar espera a la próxima (también lo publicado antes de la
+// primera suscripción, como si la sesión ya existiera).
+typedef struct {
+    uint32_t wifi_assoc_ms;                             // Desde esp_wifi_connect() hasta obtener IP
+    uint32_t sntp_ms;                                   // Desde esp_sntp_init() hasta sincronizar
+    uint32_t mqtt_connect_ms;                           // Desde tener red hasta MQTT_EVENT_CONNECTED
+    uint32_t rtt_ms;                                    // Ida y vuelta hasta el broker
+    uint32_t uplink_kbps;                               // Capacidad del enlace de subida
+    uint32_t keepalive_s;                               // Intervalo de PINGREQ con la conexión en reposo
+} sim_net_params_t;
+
+typedef struct {
+    uint32_t messages;
+    uint64_t payload_bytes;
+    uint64_t mqtt_bytes;                                // PUBLISH + PUBACK
+} sim_topic_stats_t;
+
+// Recepción en el broker: instante virtual de llegada del mensaje completo
+typedef void (*sim_broker_listener_t)(const char *topic, const char *payload, int len, int64_t recv_us, void *ctx);
+
+void sim_net_default_params(sim_net_params_t *params);
+void sim_net_configure(const sim_net_params_t *params);
+void sim_net_set_broker_listener(sim_broker_listener_t listener, void *ctx);
+void sim_net_radio_off(void);                           // Deep sleep: se corta la conexión y se pierde lo que estaba en vuelo
+void sim_net_radio_on(void);                            // Vuelve a asociarse a la red tras el deep sleep
+void sim_net_mqtt_start(void);                          // Arranca otra vez el cliente MQTT que creó el firmware
+bool sim_net_radio_is_on(void);
+bool sim_net_wifi_connected(void);
+uint32_t sim_net_topic_count(void);
+const char *sim_net_topic_name(uint32_t index);
+const sim_topic_stats_t *sim_net_topic_stats(uint32_t index);
+uint64_t sim_net_overhead_bytes(void);                  // CONNECT/CONNACK, PINGREQ/PINGRESP y SNTP
+uint64_t sim_net_ip_packets(void);                      // Paquetes IP (para sumar 40 bytes TCP/IP por paquete)
+uint32_t sim_net_lost_in_flight(void);                  // Mensajes aceptados que no llegaron al broker
+uint32_t sim_net_connects(void);                        // Conexiones MQTT establecidas
+bool sim_net_broker_publish(const char *topic, const char *payload);   // false si el buzón del broker está lleno
+uint32_t sim_net_broker_delivered(void);                // Mensajes entregados por el broker al cliente
+
+// === RELOJ DE PARED ===
+// time() y gettimeofday() se redirigen aquí (-Wl,--wrap): antes de la primera sincronización SNTP
+// cuentan desde el encendido; después, epoch_at_zero + tiempo virtual. Sobrevive al deep sleep, como el RTC.
+void sim_wall_clock_set_epoch_at_zero(int64_t epoch_us);
+int64_t sim_wall_clock_epoch_us(void);
+bool sim_wall_clock_synced(void);
+
+// === ALIMENTACIÓN (sustituye a power_manager.c) ===
+// La fuente sigue al pin de detección con el mismo doble antirrebote. El deep sleep termina todas
+// las tareas, apaga la radio y vuelve a ejecutar la función de arranque al despertar; la memoria
+// "RTC" es toda la del proceso, así que el estado que el firmware no guarda en RTC también sobrevive.
+typedef void (*sim_boot_fn_t)(void);
+
+void sim_power_set_boot(sim_boot_fn_t boot);            // Función de arranque (la parte de app_main que se simula)
+void sim_power_set_usb(bool usb);                       // Nivel del pin de detección de USB
+void sim_power_set_battery_voltage(float volts);
+uint32_t sim_power_deep_sleeps(void);
+int64_t sim_power_sleep_us(void);                       // Tiempo total en deep sleep
@@ -0,0 +1,10 @@
+// File: host/sim/include/string.h
+// La newlib de ESP-IDF declara strlcpy; glibc no la trae hasta la 2.38
+#pragma once
+
+#include_next <string.h>
+
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+#define SIM_NEED_STRLCPY 1
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
@@ -0,0 +1,192 @@
+// File: host/sim/sim_hal.c
+
+#include "sim_hal.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "esp_system.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// === RELOJ VIRTUAL ===
+
+static int64_t now_us = 0;
+static int64_t boot_us = 0;                             // Instante del último arranque (esp_timer cuenta desde ahí)
+static uint32_t poll_cost_us = 1;
+
+int64_t sim_time_us(void)
+{
+    return now_us;
+}
+
+void sim_advance_us(int64_t us)
+{
+    if (us > 0) now_us += us;
+}
+
+void sim_set_poll_cost_us(uint32_t us)
+{
+    poll_cost_us = us;
+}
+
+void sim_reset_boot_time(void)
+{
+    boot_us = now_us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    // Cada consulta cuesta tiempo de CPU: así terminan los bucles de espera activa
+    now_us += poll_cost_us;
+    return now_us - boot_us;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    now_us += us;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)((now_us - boot_us) / (1000000 / configTICK_RATE_HZ));
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 200 * 1024;
+}
+
+void esp_restart(void)
+{
+    fprintf(stderr, "esp_restart() en host: fin del proceso\n");
+    exit(2);
+}
+
+// === GPIO ===
+
+static const sim_gpio_model_t *models[SIM_GPIO_COUNT];
+static int output_level[SIM_GPIO_COUNT];
+static uint32_t gpio_writes = 0;
+
+void sim_gpio_attach(int pin, const sim_gpio_model_t *model)
+{
+    if (pin >= 0 && pin < SIM_GPIO_COUNT) models[pin] = model;
+}
+
+int sim_gpio_output_level(int pin)
+{
+    return (pin >= 0 && pin < SIM_GPIO_COUNT) ? output_level[pin] : 0;
+}
+
+uint32_t sim_gpio_write_count(void)
+{
+    return gpio_writes;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    if (!config || (config->pin_bit_mask >> SIM_GPIO_COUNT) != 0) return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT) return ESP_ERR_INVALID_ARG;
+    output_level[gpio_num] = 0;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT) return ESP_ERR_INVALID_ARG;
+    gpio_writes++;
+    int changed = output_level[gpio_num] != (int)(level != 0);
+    output_level[gpio_num] = (level != 0);
+    const sim_gpio_model_t *m = models[gpio_num];
+    if (changed && m && m->on_write) m->on_write(m->ctx, gpio_num, output_level[gpio_num]);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT) return 0;
+    const sim_gpio_model_t *m = models[gpio_num];
+    if (m && m->read) return m->read(m->ctx, gpio_num);
+    return output_level[gpio_num];
+}
+
+// === REGISTRO ===
+
+static esp_log_level_t log_level = ESP_LOG_WARN;
+
+void sim_log_set_level(int level)
+{
+    log_level = (esp_log_level_t)level;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    log_level = level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)((now_us - boot_us) / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    (void)tag;
+    if (level > log_level) return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+int esp_rom_printf(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = vfprintf(stderr, fmt, args);
+    va_end(args);
+    return n;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                    return "ESP_OK";
+        case ESP_FAIL:                  return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:  return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC:       return "ESP_ERR_INVALID_CRC";
+        default:                        return "ESP_ERR_UNKNOWN";
+    }
+}
+
+#ifdef SIM_NEED_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
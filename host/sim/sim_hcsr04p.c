@@ -0,0 +1,90 @@
+// File: host/sim/sim_hcsr04p.c
+
+#include "sim_hal.h"
+
+#define SOUND_SPEED_CM_US   0.0343      // La misma constante que el driver
+#define MIN_TRIGGER_US      10
+
+static struct {
+    int trigger_pin;
+    int echo_pin;
+    bool connected;
+    uint32_t echo_delay_us;
+    uint32_t echo_width_us;
+    int64_t trigger_rise_us;
+    int64_t echo_rise_us;
+    int64_t echo_fall_us;
+    uint32_t triggers;
+} us_sensor = {
+    .echo_delay_us = 450,
+    .echo_rise_us = -1,
+    .echo_fall_us = -1,
+};
+
+static void hcsr04p_write(void *ctx, int pin, int level)
+{
+    (void)ctx;
+    if (pin != us_sensor.trigger_pin) return;
+    int64_t now = sim_time_us();
+
+    if (level) {
+        us_sensor.trigger_rise_us = now;
+    } else if (now - us_sensor.trigger_rise_us >= MIN_TRIGGER_US) {
+        // Pulso de disparo válido: programar el eco
+        us_sensor.triggers++;
+        if (us_sensor.connected) {
+            us_sensor.echo_rise_us = now + us_sensor.echo_delay_us;
+            us_sensor.echo_fall_us = us_sensor.echo_rise_us + us_sensor.echo_width_us;
+        }
+    }
+}
+
+static int hcsr04p_read(void *ctx, int pin)
+{
+    (void)ctx;
+    if (pin != us_sensor.echo_pin) return 0;
+    int64_t now = sim_time_us();
+    return (now >= us_sensor.echo_rise_us && now < us_sensor.echo_fall_us) ? 1 : 0;
+}
+
+static const sim_gpio_model_t hcsr04p_model = {
+    .on_write = hcsr04p_write,
+    .read = hcsr04p_read,
+    .ctx = NULL,
+};
+
+void sim_hcsr04p_attach(int trigger_pin, int echo_pin)
+{
+    us_sensor.trigger_pin = trigger_pin;
+    us_sensor.echo_pin = echo_pin;
+    us_sensor.connected = true;
+    sim_gpio_attach(trigger_pin, &hcsr04p_model);
+    sim_gpio_attach(echo_pin, &hcsr04p_model);
+}
+
+void sim_hcsr04p_set_distance_cm(float distance_cm)
+{
+    // Ida y vuelta del sonido
+    us_sensor.echo_width_us = (uint32_t)(2.0 * distance_cm / SOUND_SPEED_CM_US + 0.5);
+}
+
+void sim_hcsr04p_set_echo_delay_us(uint32_t us)
+{
+    us_sensor.echo_delay_us = us;
+}
+
+void sim_hcsr04p_set_echo(uint32_t delay_us, uint32_t width_us)
+{
+    us_sensor.echo_delay_us = delay_us;
+    us_sensor.echo_width_us = width_us;
+}
+
+void sim_hcsr04p_set_connected(bool connected)
+{
+    us_sensor.connected = connected;
+}
+
+uint32_t sim_hcsr04p_triggers(void)
+{
+    return us_sensor.triggers;
+}
@@ -0,0 +1,155 @@
+// File: host/sim/sim_hx711.c
+
+#include "sim_hal.h"
+#include <stdio.h>
+
+#define QUEUE_SIZE          256
+#define POWER_DOWN_US       60          // SCK alto más de 60 us apaga el convertidor
+#define SETTLE_CONVERSIONS  4           // Conversiones hasta el primer dato tras encender (400 ms a 10 SPS)
+
+static struct {
+    int dout_pin;
+    int sck_pin;
+    bool connected;
+    bool powered_down;
+    uint32_t conversion_us;
+    int64_t ready_at_us;                // Instante en que termina la conversión en curso
+    int64_t sck_high_since_us;
+    bool shifting;                      // Lectura en curso (desde el primer flanco de SCK)
+    int bit_index;                      // Flancos de SCK en esta lectura
+    uint32_t shift_value;
+    int last_gain_pulses;
+    uint32_t conversions_read;
+    int32_t queue[QUEUE_SIZE];
+    uint32_t q_head;
+    uint32_t q_tail;
+    int32_t current_raw;
+} hx;
+
+static int32_t next_value(void)
+{
+    // Sin valores encolados se repite el último (señal constante)
+    if (hx.q_head != hx.q_tail) {
+        hx.current_raw = hx.queue[hx.q_head % QUEUE_SIZE];
+        hx.q_head++;
+    }
+    return hx.current_raw;
+}
+
+static void finish_read_if_done(int64_t now)
+{
+    if (hx.shifting && hx.bit_index > 24 && now >= hx.ready_at_us) {
+        hx.shifting = false;
+        hx.last_gain_pulses = hx.bit_index - 24;
+    }
+}
+
+static bool sck_powered_down(int64_t now)
+{
+    return hx.powered_down ||
+           (sim_gpio_output_level(hx.sck_pin) && now - hx.sck_high_since_us > POWER_DOWN_US);
+}
+
+static int hx711_read(void *ctx, int pin)
+{
+    (void)ctx; (void)pin;
+    int64_t now = sim_time_us();
+    if (!hx.connected || sck_powered_down(now)) return 1;
+
+    finish_read_if_done(now);
+    if (hx.shifting) {
+        if (hx.bit_index == 0) return 0;
+        if (hx.bit_index <= 24) return (hx.shift_value >> (24 - hx.bit_index)) & 1;
+        return 1;                        // Bits de ganancia: DOUT alto hasta la siguiente conversión
+    }
+    return now >= hx.ready_at_us ? 0 : 1;
+}
+
+static void hx711_write(void *ctx, int pin, int level)
+{
+    (void)ctx;
+    if (pin != hx.sck_pin) return;
+    int64_t now = sim_time_us();
+
+    if (level) {
+        hx.sck_high_since_us = now;
+        finish_read_if_done(now);
+        if (!hx.shifting && !hx.powered_down && hx.connected && now >= hx.ready_at_us) {
+            hx.shifting = true;
+            hx.bit_index = 0;
+            hx.shift_value = (uint32_t)next_value() & 0xFFFFFF;
+        }
+        if (hx.shifting) {
+            hx.bit_index++;
+            if (hx.bit_index == 25) {
+                // El pulso 25 cierra la lectura y arranca la siguiente conversión
+                hx.ready_at_us = now + hx.conversion_us;
+                hx.conversions_read++;
+            }
+        }
+        return;
+    }
+
+    // Flanco de bajada: un SCK alto demasiado largo apagó el convertidor y ahora vuelve a arrancar
+    if (now - hx.sck_high_since_us > POWER_DOWN_US) {
+        hx.powered_down = false;
+        hx.shifting = false;
+        hx.ready_at_us = now + (int64_t)hx.conversion_us * SETTLE_CONVERSIONS;
+    }
+}
+
+static const sim_gpio_model_t hx711_model = {
+    .on_write = hx711_write,
+    .read = hx711_read,
+    .ctx = NULL,
+};
+
+void sim_hx711_attach(int dout_pin, int sck_pin)
+{
+    hx.dout_pin = dout_pin;
+    hx.sck_pin = sck_pin;
+    hx.connected = true;
+    hx.powered_down = false;
+    if (hx.conversion_us == 0) hx.conversion_us = 100000;
+    hx.ready_at_us = sim_time_us() + hx.conversion_us;
+    hx.shifting = false;
+    sim_gpio_attach(dout_pin, &hx711_model);
+    sim_gpio_attach(sck_pin, &hx711_model);
+}
+
+void sim_hx711_push_raw(int32_t raw)
+{
+    if (hx.q_tail - hx.q_head >= QUEUE_SIZE) {
+        fprintf(stderr, "sim_hx711: cola llena, se descarta el valor\n");
+        return;
+    }
+    hx.queue[hx.q_tail % QUEUE_SIZE] = raw;
+    hx.q_tail++;
+}
+
+void sim_hx711_set_raw(int32_t raw)
+{
+    hx.q_head = hx.q_tail = 0;
+    hx.current_raw = raw;
+}
+
+void sim_hx711_set_conversion_us(uint32_t us)
+{
+    hx.conversion_us = us ? us : 1;
+}
+
+void sim_hx711_set_connected(bool connected)
+{
+    hx.connected = connected;
+}
+
+int sim_hx711_last_gain_pulses(void)
+{
+    finish_read_if_done(sim_time_us());
+    return hx.last_gain_pulses;
+}
+
+uint32_t sim_hx711_conversions_read(void)
+{
+    return hx.conversions_read;
+}
@@ -0,0 +1,682 @@
+// File: host/sim/sim_net.c
+
+#include "sim_hal.h"
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_mac.h"
+#include "esp_sntp.h"
+#include "mqtt_client.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+// Red simulada para la compilación en host: Wi-Fi, SNTP, cliente MQTT y un broker en proceso
+// que hace de Mosquitto. Todo ocurre en tiempo virtual mediante temporizadores del planificador.
+
+const esp_event_base_t WIFI_EVENT = "WIFI_EVENT";
+const esp_event_base_t IP_EVENT = "IP_EVENT";
+
+#define MAX_HANDLERS        8
+#define MAX_TOPICS          16
+#define MAX_PENDING         64              // Mensajes en vuelo (enviados y aún no recibidos por el broker)
+#define MQTT_CONNECT_BYTES  64              // CONNECT con id de cliente + CONNACK
+#define MQTT_PING_BYTES     4               // PINGREQ + PINGRESP
+#define MQTT_PUBACK_BYTES   4
+#define MQTT_SUBACK_BYTES   5
+#define MAX_SUBSCRIPTIONS   4
+#define MAX_DOWNLINK        16              // Mensajes del broker hacia el cliente aún sin entregar
+#define SNTP_BYTES          96              // Petición y respuesta NTP de 48 bytes
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} handler_entry_t;
+
+struct sim_mqtt_client {
+    esp_event_handler_t handler;
+    void *handler_arg;
+    bool started;
+    bool connected;
+    bool clean_session;
+    int next_msg_id;
+};
+
+// Mensaje del broker al cliente (QoS1): se retira al entregarlo
+typedef struct {
+    char *topic;
+    char *payload;
+    int len;
+    uint32_t timer_id;                      // Entrega en curso
+} downlink_msg_t;
+
+typedef struct {
+    uint32_t timer_id;                      // Llegada al broker
+    int64_t recv_us;
+    int msg_id;
+    int topic_index;
+    char *payload;
+    int len;
+} pending_msg_t;
+
+// Valores por defecto: red doméstica o 4G con buena cobertura
+#define SIM_NET_DEFAULT_PARAMS { \
+    .wifi_assoc_ms = 1500, \
+    .sntp_ms = 400, \
+    .mqtt_connect_ms = 300, \
+    .rtt_ms = 80, \
+    .uplink_kbps = 1000, \
+    .keepalive_s = 120, \
+}
+
+static sim_net_params_t params = SIM_NET_DEFAULT_PARAMS;
+
+static handler_entry_t handlers[MAX_HANDLERS];
+static int handler_count = 0;
+static struct sim_mqtt_client client;
+
+static bool radio_on = false;
+static bool wifi_started = false;
+static bool wifi_connected = false;
+static bool sntp_started = false;
+static bool sntp_synced = false;
+static uint32_t net_timer = 0;              // Asociación o conexión MQTT en curso
+static uint32_t ping_timer = 0;
+static int64_t link_free_us = 0;            // El enlace de subida transmite un mensaje detrás de otro
+
+static char topic_names[MAX_TOPICS][64];
+static sim_topic_stats_t topic_stats[MAX_TOPICS];
+static uint32_t topic_count = 0;
+static pending_msg_t pending[MAX_PENDING];
+static uint64_t overhead_bytes = 0;
+static uint64_t ip_packets = 0;
+static uint32_t lost_in_flight = 0;
+static uint32_t connects = 0;
+
+// Sesión del cliente en el broker: sobrevive a las desconexiones si no es clean session
+static bool session_exists = false;
+static char subscriptions[MAX_SUBSCRIPTIONS][64];
+static uint32_t subscription_count = 0;
+static downlink_msg_t downlink[MAX_DOWNLINK];
+static uint32_t downlink_delivered = 0;
+
+static sim_broker_listener_t listener = NULL;
+static void *listener_ctx = NULL;
+
+static int64_t epoch_at_zero_us = 0;
+
+static int64_t ms_to_us(uint32_t ms)
+{
+    return (int64_t)ms * 1000;
+}
+
+// === CONFIGURACIÓN ===
+
+void sim_net_default_params(sim_net_params_t *out)
+{
+    *out = (sim_net_params_t)SIM_NET_DEFAULT_PARAMS;
+}
+
+void sim_net_configure(const sim_net_params_t *p)
+{
+    params = *p;
+    if (params.uplink_kbps == 0) params.uplink_kbps = 1;
+}
+
+void sim_net_set_broker_listener(sim_broker_listener_t fn, void *ctx)
+{
+    listener = fn;
+    listener_ctx = ctx;
+}
+
+// === EVENTOS ===
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t event_id, esp_event_handler_t handler,
+                                              void *arg, esp_event_handler_instance_t *instance)
+{
+    if (handler_count == MAX_HANDLERS) return ESP_ERR_NO_MEM;
+    handlers[handler_count] = (handler_entry_t){ base, event_id, handler, arg };
+    if (instance) *instance = &handlers[handler_count];
+    handler_count++;
+    return ESP_OK;
+}
+
+static void post_event(esp_event_base_t base, int32_t id, void *data)
+{
+    for (int i = 0; i < handler_count; i++) {
+        if (handlers[i].base == base && (handlers[i].id == ESP_EVENT_ANY_ID || handlers[i].id == id)) {
+            handlers[i].handler(handlers[i].arg, base, id, data);
+        }
+    }
+}
+
+static void post_mqtt_event_full(esp_mqtt_event_t *event)
+{
+    if (!client.handler) return;
+    event->client = &client;
+    client.handler(client.handler_arg, "MQTT_EVENTS", event->event_id, event);
+}
+
+static void post_mqtt_event(esp_mqtt_event_id_t id, int msg_id)
+{
+    esp_mqtt_event_t event = { .event_id = id, .msg_id = msg_id };
+    post_mqtt_event_full(&event);
+}
+
+// === MQTT ===
+
+static void ping_cb(void *arg)
+{
+    (void)arg;
+    ping_timer = 0;
+    if (!client.connected) return;
+    overhead_bytes += MQTT_PING_BYTES;
+    ip_packets += 2;
+    ping_timer = sim_sched_call_at(sim_time_us() + (int64_t)params.keepalive_s * 1000000, ping_cb, NULL);
+}
+
+static void flush_downlink(void);
+
+static void mqtt_connected_cb(void *arg)
+{
+    (void)arg;
+    net_timer = 0;
+    if (!wifi_connected || !client.started || client.connected) return;
+    client.connected = true;
+    connects++;
+    overhead_bytes += MQTT_CONNECT_BYTES;
+    ip_packets += 2 + 3;                                // CONNECT/CONNACK y el saludo TCP
+    if (params.keepalive_s > 0) {
+        ping_timer = sim_sched_call_at(sim_time_us() + (int64_t)params.keepalive_s * 1000000, ping_cb, NULL);
+    }
+
+    // Clean session: el broker descarta la sesión anterior y con ella las suscripciones
+    bool resumed = session_exists && !client.clean_session;
+    if (!resumed) subscription_count = 0;
+    session_exists = true;
+    esp_mqtt_event_t event = { .event_id = MQTT_EVENT_CONNECTED, .session_present = resumed };
+    post_mqtt_event_full(&event);
+    flush_downlink();
+}
+
+static void schedule_mqtt_connect(void)
+{
+    if (client.started && !client.connected && wifi_connected && net_timer == 0) {
+        net_timer = sim_sched_call_at(sim_time_us() + ms_to_us(params.mqtt_connect_ms), mqtt_connected_cb, NULL);
+    }
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    memset(&client, 0, sizeof(client));
+    client.clean_session = !(config && config->session.disable_clean_session);
+    client.next_msg_id = 1;
+    return &client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t c, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void *arg)
+{
+    (void)event;
+    if (!c) return ESP_ERR_INVALID_ARG;
+    c->handler = handler;
+    c->handler_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t c)
+{
+    if (!c) return ESP_ERR_INVALID_ARG;
+    c->started = true;
+    schedule_mqtt_connect();
+    return ESP_OK;
+}
+
+static int topic_index(const char *topic)
+{
+    for (uint32_t i = 0; i < topic_count; i++) {
+        if (strcmp(topic_names[i], topic) == 0) return (int)i;
+    }
+    if (topic_count == MAX_TOPICS) return -1;
+    strncpy(topic_names[topic_count], topic, sizeof(topic_names[0]) - 1);
+    return (int)topic_count++;
+}
+
+static uint32_t varint_len(uint32_t value)
+{
+    uint32_t n = 1;
+    while (value >= 128) {
+        value /= 128;
+        n++;
+    }
+    return n;
+}
+
+static void puback_cb(void *arg)
+{
+    int msg_id = (int)(intptr_t)arg;
+    if (client.connected) post_mqtt_event(MQTT_EVENT_PUBLISHED, msg_id);
+}
+
+static void broker_receive_cb(void *arg)
+{
+    pending_msg_t *m = arg;
+    if (listener) listener(topic_names[m->topic_index], m->payload, m->len, m->recv_us, listener_ctx);
+    sim_sched_call_at(m->recv_us + ms_to_us(params.rtt_ms) / 2, puback_cb, (void *)(intptr_t)m->msg_id);
+    free(m->payload);
+    m->payload = NULL;
+    m->timer_id = 0;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t c, const char *topic, const char *data,
+                            int len, int qos, int retain)
+{
+    (void)qos;
+    (void)retain;
+    if (!c || !c->connected || !topic) return -1;       // Sin conexión el cliente no acepta el mensaje
+    if (len <= 0) len = data ? (int)strlen(data) : 0;
+
+    pending_msg_t *m = NULL;
+    for (int i = 0; i < MAX_PENDING && !m; i++) {
+        if (pending[i].timer_id == 0) m = &pending[i];
+    }
+    int index = topic_index(topic);
+    if (!m || index < 0) return -1;                     // Buzón de salida lleno
+
+    // PUBLISH QoS1: cabecera fija + longitud restante (topic, id de paquete y carga útil)
+    uint32_t remaining = 2 + (uint32_t)strlen(topic) + 2 + (uint32_t)len;
+    uint32_t wire = 1 + varint_len(remaining) + remaining;
+    int64_t now = sim_time_us();
+    int64_t tx_us = (int64_t)wire * 8 * 1000 / params.uplink_kbps;
+    if (link_free_us < now) link_free_us = now;
+    link_free_us += tx_us;
+
+    int msg_id = c->next_msg_id++;
+    if (c->next_msg_id > 65535) c->next_msg_id = 1;
+
+    sim_topic_stats_t *st = &topic_stats[index];
+    st->messages++;
+    st->payload_bytes += (uint64_t)len;
+    st->mqtt_bytes += wire + MQTT_PUBACK_BYTES;
+    ip_packets += 2;
+
+    m->recv_us = link_free_us + ms_to_us(params.rtt_ms) / 2;
+    m->msg_id = msg_id;
+    m->topic_index = index;
+    m->len = len;
+    m->payload = malloc((size_t)len + 1);
+    if (m->payload) {
+        memcpy(m->payload, data, (size_t)len);
+        m->payload[len] = '\0';
+    }
+    m->timer_id = sim_sched_call_at(m->recv_us, broker_receive_cb, m);
+
+    // El cliente escribe en el socket: la tarea queda ocupada lo que tarda en salir su mensaje
+    sim_sched_sleep_us(link_free_us - now);
+    return msg_id;
+}
+
+// === BROKER -> CLIENTE ===
+
+static bool subscribed(const char *topic)
+{
+    for (uint32_t i = 0; i < subscription_count; i++) {
+        if (strcmp(subscriptions[i], topic) == 0) return true;
+    }
+    return false;
+}
+
+static void downlink_free(downlink_msg_t *m)
+{
+    free(m->topic);
+    free(m->payload);
+    memset(m, 0, sizeof(*m));
+}
+
+static void deliver_cb(void *arg)
+{
+    downlink_msg_t *m = arg;
+    m->timer_id = 0;
+    if (!client.connected) return;                      // Se corta antes de llegar: se reintenta al reconectar
+
+    int index = topic_index(m->topic);
+    uint32_t remaining = 2 + (uint32_t)strlen(m->topic) + 2 + (uint32_t)m->len;
+    if (index >= 0) {
+        sim_topic_stats_t *st = &topic_stats[index];
+        st->messages++;
+        st->payload_bytes += (uint64_t)m->len;
+        st->mqtt_bytes += 1 + varint_len(remaining) + remaining + MQTT_PUBACK_BYTES;
+    }
+    ip_packets += 2;
+    downlink_delivered++;
+
+    esp_mqtt_event_t event = {
+        .event_id = MQTT_EVENT_DATA,
+        .data = m->payload,
+        .data_len = m->len,
+        .total_data_len = m->len,
+        .topic = m->topic,
+        .topic_len = (int)strlen(m->topic),
+        .qos = 1,
+    };
+    post_mqtt_event_full(&event);
+    downlink_free(m);
+}
+
+// Entrega lo que espera en el broker para los topics a los que el cliente está suscrito
+static void flush_downlink(void)
+{
+    if (!client.connected) return;
+    for (int i = 0; i < MAX_DOWNLINK; i++) {
+        downlink_msg_t *m = &downlink[i];
+        if (m->topic && m->timer_id == 0 && subscribed(m->topic)) {
+            m->timer_id = sim_sched_call_at(sim_time_us() + ms_to_us(params.rtt_ms) / 2, deliver_cb, m);
+        }
+    }
+}
+
+static void flush_downlink_cb(void *arg)
+{
+    (void)arg;
+    flush_downlink();
+}
+
+static void suback_cb(void *arg)
+{
+    if (client.connected) post_mqtt_event(MQTT_EVENT_SUBSCRIBED, (int)(intptr_t)arg);
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t c, const char *topic, int qos)
+{
+    (void)qos;
+    if (!c || !c->connected || !topic) return -1;
+    if (!subscribed(topic)) {
+        if (subscription_count == MAX_SUBSCRIPTIONS) return -1;
+        strncpy(subscriptions[subscription_count], topic, sizeof(subscriptions[0]) - 1);
+        subscription_count++;
+    }
+
+    // SUBSCRIBE: cabecera fija + id de paquete + topic + opciones; SUBACK de vuelta
+    uint32_t remaining = 2 + 2 + (uint32_t)strlen(topic) + 1;
+    overhead_bytes += 1 + varint_len(remaining) + remaining + MQTT_SUBACK_BYTES;
+    ip_packets += 2;
+
+    int msg_id = c->next_msg_id++;
+    if (c->next_msg_id > 65535) c->next_msg_id = 1;
+    int64_t now = sim_time_us();
+    sim_sched_call_at(now + ms_to_us(params.rtt_ms) / 2, flush_downlink_cb, NULL);
+    sim_sched_call_at(now + ms_to_us(params.rtt_ms), suback_cb, (void *)(intptr_t)msg_id);
+    return msg_id;
+}
+
+bool sim_net_broker_publish(const char *topic, const char *payload)
+{
+    for (int i = 0; i < MAX_DOWNLINK; i++) {
+        downlink_msg_t *m = &downlink[i];
+        if (m->topic) continue;
+        m->topic = strdup(topic);
+        m->payload = strdup(payload);
+        m->len = (int)strlen(payload);
+        if (!m->topic || !m->payload) {
+            downlink_free(m);
+            return false;
+        }
+        flush_downlink();
+        return true;
+    }
+    return false;
+}
+
+uint32_t sim_net_broker_delivered(void)
+{
+    return downlink_delivered;
+}
+
+// === WI-FI ===
+
+static void got_ip_cb(void *arg)
+{
+    (void)arg;
+    net_timer = 0;
+    if (!radio_on) return;
+    wifi_connected = true;
+    post_event(IP_EVENT, IP_EVENT_STA_GOT_IP, NULL);
+    schedule_mqtt_connect();
+}
+
+static void sta_start_cb(void *arg)
+{
+    (void)arg;
+    post_event(WIFI_EVENT, WIFI_EVENT_STA_START, NULL);
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    static int netif;
+    return (esp_netif_t *)&netif;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    (void)mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *config)
+{
+    (void)interface;
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    (void)type;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    wifi_started = true;
+    radio_on = true;
+    sim_sched_call_at(sim_time_us(), sta_start_cb, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    if (!radio_on) return ESP_ERR_INVALID_STATE;        // Reintento durante el deep sleep: se repite al despertar
+    if (!wifi_connected && net_timer == 0) {
+        net_timer = sim_sched_call_at(sim_time_us() + ms_to_us(params.wifi_assoc_ms), got_ip_cb, NULL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac)
+{
+    static const uint8_t sim_mac[6] = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+    memcpy(mac, sim_mac, sizeof(sim_mac));
+    return ESP_OK;
+}
+
+void sim_net_radio_off(void)
+{
+    if (!radio_on) return;
+    radio_on = false;
+    wifi_connected = false;
+    if (net_timer) sim_sched_cancel(net_timer);
+    if (ping_timer) sim_sched_cancel(ping_timer);
+    net_timer = 0;
+    ping_timer = 0;
+
+    // Lo que seguía en el enlace no llega al broker
+    for (int i = 0; i < MAX_PENDING; i++) {
+        if (pending[i].timer_id != 0) {
+            sim_sched_cancel(pending[i].timer_id);
+            free(pending[i].payload);
+            pending[i].payload = NULL;
+            pending[i].timer_id = 0;
+            lost_in_flight++;
+        }
+    }
+    link_free_us = sim_time_us();
+
+    // Lo que bajaba del broker sigue allí para la próxima conexión
+    for (int i = 0; i < MAX_DOWNLINK; i++) {
+        if (downlink[i].timer_id != 0) {
+            sim_sched_cancel(downlink[i].timer_id);
+            downlink[i].timer_id = 0;
+        }
+    }
+
+    // El cliente MQTT vive en RAM: tras el reinicio hay que volver a arrancarlo
+    client.started = false;
+    if (client.connected) {
+        client.connected = false;
+        post_mqtt_event(MQTT_EVENT_DISCONNECTED, 0);
+    }
+}
+
+void sim_net_radio_on(void)
+{
+    if (radio_on || !wifi_started) return;
+    radio_on = true;
+    esp_wifi_connect();
+}
+
+void sim_net_mqtt_start(void)
+{
+    if (client.handler) esp_mqtt_client_start(&client);
+}
+
+bool sim_net_radio_is_on(void)
+{
+    return radio_on;
+}
+
+bool sim_net_wifi_connected(void)
+{
+    return wifi_connected;
+}
+
+// === ESTADÍSTICAS ===
+
+uint32_t sim_net_topic_count(void)
+{
+    return topic_count;
+}
+
+const char *sim_net_topic_name(uint32_t index)
+{
+    return index < topic_count ? topic_names[index] : NULL;
+}
+
+const sim_topic_stats_t *sim_net_topic_stats(uint32_t index)
+{
+    return index < topic_count ? &topic_stats[index] : NULL;
+}
+
+uint64_t sim_net_overhead_bytes(void)
+{
+    return overhead_bytes;
+}
+
+uint64_t sim_net_ip_packets(void)
+{
+    return ip_packets;
+}
+
+uint32_t sim_net_lost_in_flight(void)
+{
+    return lost_in_flight;
+}
+
+uint32_t sim_net_connects(void)
+{
+    return connects;
+}
+
+// === SNTP Y RELOJ DE PARED ===
+
+static void sntp_done_cb(void *arg)
+{
+    (void)arg;
+    if (radio_on) sntp_synced = true;
+}
+
+void esp_sntp_setoperatingmode(esp_sntp_operatingmode_t mode)
+{
+    (void)mode;
+}
+
+void esp_sntp_setservername(uint8_t idx, const char *server)
+{
+    (void)idx;
+    (void)server;
+}
+
+void esp_sntp_init(void)
+{
+    if (sntp_started) return;
+    sntp_started = true;
+    overhead_bytes += SNTP_BYTES;
+    ip_packets += 2;
+    sim_sched_call_at(sim_time_us() + ms_to_us(params.sntp_ms), sntp_done_cb, NULL);
+}
+
+sntp_sync_status_t sntp_get_sync_status(void)
+{
+    return sntp_synced ? SNTP_SYNC_STATUS_COMPLETED : SNTP_SYNC_STATUS_RESET;
+}
+
+void sim_wall_clock_set_epoch_at_zero(int64_t epoch_us)
+{
+    epoch_at_zero_us = epoch_us;
+}
+
+int64_t sim_wall_clock_epoch_us(void)
+{
+    return sntp_synced ? epoch_at_zero_us + sim_time_us() : sim_time_us();
+}
+
+bool sim_wall_clock_synced(void)
+{
+    return sntp_synced;
+}
+
+// Enlazado con -Wl,--wrap=time,--wrap=gettimeofday
+time_t __wrap_time(time_t *out)
+{
+    time_t t = (time_t)(sim_wall_clock_epoch_us() / 1000000);
+    if (out) *out = t;
+    return t;
+}
+
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tz;
+    int64_t us = sim_wall_clock_epoch_us();
+    tv->tv_sec = (time_t)(us / 1000000);
+    tv->tv_usec = (suseconds_t)(us % 1000000);
+    return 0;
+}
@@ -0,0 +1,278 @@
+// File: host/sim/sim_nvs.c
+
+#include "sim_hal.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <stdlib.h>
+#include <string.h>
+
+// NVS en memoria: pares (espacio de nombres, clave) -> bytes. Cuenta escrituras y bytes
+// para que los benchmarks puedan comparar el desgaste de flash de cada estrategia, y la ocupación
+// en entradas de 32 bytes como la partición real: una escritura que no cabe falla igual que allí.
+
+#define MAX_NAMESPACES  16
+#define MAX_ENTRIES     1024
+#define KEY_MAX         16              // 15 caracteres + terminador, como en ESP-IDF
+#define PAGE_ENTRIES    126             // Entradas por página de 4 KB
+#define PARTITION_PAGES 6               // Partición nvs por defecto de 24 KB
+#define TOTAL_ENTRIES   (PAGE_ENTRIES * PARTITION_PAGES)
+#define USABLE_ENTRIES  (TOTAL_ENTRIES - PAGE_ENTRIES)      // Una página queda libre para compactar
+
+typedef enum { TYPE_U32, TYPE_I32, TYPE_STR, TYPE_BLOB } entry_type_t;
+
+typedef struct {
+    bool used;
+    nvs_handle_t ns;
+    char key[KEY_MAX];
+    entry_type_t type;
+    size_t length;
+    uint8_t *data;
+} entry_t;
+
+static char namespaces[MAX_NAMESPACES][KEY_MAX];
+static int namespace_count = 0;
+static entry_t entries[MAX_ENTRIES];
+static uint32_t writes = 0;
+static size_t bytes_written = 0;
+static uint32_t commits = 0;
+static uint32_t entry_write_us = 0;     // Coste por entrada de 32 bytes escrita (0: instantáneo)
+static uint32_t commit_us = 0;
+static size_t used_entries = 0;
+
+// Entradas que ocupa un valor: una para números; cabecera y datos para textos; en los blobs además
+// el índice (formato de blob por fragmentos de ESP-IDF 4+)
+static size_t entry_span(entry_type_t type, size_t length)
+{
+    switch (type) {
+        case TYPE_STR:  return 1 + (length + 31) / 32;
+        case TYPE_BLOB: return 2 + (length + 31) / 32;
+        default:        return 1;
+    }
+}
+
+static entry_t *find(nvs_handle_t ns, const char *key)
+{
+    for (int i = 0; i < MAX_ENTRIES; i++) {
+        if (entries[i].used && entries[i].ns == ns && strcmp(entries[i].key, key) == 0) return &entries[i];
+    }
+    return NULL;
+}
+
+static bool valid_handle(nvs_handle_t handle)
+{
+    return handle >= 1 && handle <= (nvs_handle_t)namespace_count;
+}
+
+static esp_err_t store(nvs_handle_t handle, const char *key, entry_type_t type, const void *value, size_t length)
+{
+    if (!valid_handle(handle)) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!key || strlen(key) >= KEY_MAX) return ESP_ERR_INVALID_ARG;
+
+    entry_t *e = find(handle, key);
+    size_t old_span = e ? entry_span(e->type, e->length) : 0;
+    size_t new_span = entry_span(type, length);
+    if (used_entries - old_span + new_span > USABLE_ENTRIES) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    if (!e) {
+        for (int i = 0; i < MAX_ENTRIES && !e; i++) {
+            if (!entries[i].used) e = &entries[i];
+        }
+        if (!e) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        e->used = true;
+        e->ns = handle;
+        strcpy(e->key, key);
+        e->data = NULL;
+    }
+    uint8_t *data = malloc(length ? length : 1);
+    if (!data) return ESP_ERR_NO_MEM;
+    memcpy(data, value, length);
+    free(e->data);
+    e->data = data;
+    e->length = length;
+    e->type = type;
+    used_entries = used_entries - old_span + new_span;
+    writes++;
+    bytes_written += length;
+    if (entry_write_us) {
+        sim_advance_us((int64_t)entry_write_us * (1 + (length + 31) / 32));   // Cabecera + datos
+    }
+    return ESP_OK;
+}
+
+static esp_err_t load(nvs_handle_t handle, const char *key, entry_type_t type, void *out, size_t *length)
+{
+    if (!valid_handle(handle)) return ESP_ERR_NVS_INVALID_HANDLE;
+    entry_t *e = find(handle, key);
+    if (!e || e->type != type) return ESP_ERR_NVS_NOT_FOUND;
+    if (!out) {
+        *length = e->length;
+        return ESP_OK;
+    }
+    if (*length < e->length) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out, e->data, e->length);
+    *length = e->length;
+    return ESP_OK;
+}
+
+void sim_nvs_reset(void)
+{
+    for (int i = 0; i < MAX_ENTRIES; i++) {
+        free(entries[i].data);
+        entries[i] = (entry_t){0};
+    }
+    namespace_count = 0;
+    used_entries = 0;
+    writes = 0;
+    bytes_written = 0;
+    commits = 0;
+}
+
+void sim_nvs_set_cost_us(uint32_t per_entry_us, uint32_t per_commit_us)
+{
+    entry_write_us = per_entry_us;
+    commit_us = per_commit_us;
+}
+
+uint32_t sim_nvs_write_count(void)
+{
+    return writes;
+}
+
+size_t sim_nvs_bytes_written(void)
+{
+    return bytes_written;
+}
+
+uint32_t sim_nvs_commit_count(void)
+{
+    return commits;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    sim_nvs_reset();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    (void)open_mode;
+    if (!namespace_name || !out_handle || strlen(namespace_name) >= KEY_MAX) return ESP_ERR_INVALID_ARG;
+    for (int i = 0; i < namespace_count; i++) {
+        if (strcmp(namespaces[i], namespace_name) == 0) {
+            *out_handle = (nvs_handle_t)(i + 1);
+            return ESP_OK;
+        }
+    }
+    if (namespace_count == MAX_NAMESPACES) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    strcpy(namespaces[namespace_count], namespace_name);
+    *out_handle = (nvs_handle_t)++namespace_count;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    if (!valid_handle(handle)) return ESP_ERR_NVS_INVALID_HANDLE;
+    commits++;
+    if (commit_us) sim_advance_us(commit_us);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (!valid_handle(handle)) return ESP_ERR_NVS_INVALID_HANDLE;
+    entry_t *e = find(handle, key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    used_entries -= entry_span(e->type, e->length);
+    free(e->data);
+    *e = (entry_t){0};
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    if (!valid_handle(handle)) return ESP_ERR_NVS_INVALID_HANDLE;
+    for (int i = 0; i < MAX_ENTRIES; i++) {
+        if (entries[i].used && entries[i].ns == handle) {
+            used_entries -= entry_span(entries[i].type, entries[i].length);
+            free(entries[i].data);
+            entries[i] = (entry_t){0};
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return store(handle, key, TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    if (!length) return ESP_ERR_INVALID_ARG;
+    return load(handle, key, TYPE_BLOB, out_value, length);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return store(handle, key, TYPE_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return load(handle, key, TYPE_U32, out_value, &length);
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value)
+{
+    return store(handle, key, TYPE_I32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return load(handle, key, TYPE_I32, out_value, &length);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return store(handle, key, TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    if (!length) return ESP_ERR_INVALID_ARG;
+    return load(handle, key, TYPE_STR, out_value, length);
+}
+
+esp_err_t nvs_get_stats(const char *part_name, nvs_stats_t *nvs_stats)
+{
+    (void)part_name;
+    if (!nvs_stats) return ESP_ERR_INVALID_ARG;
+    nvs_stats->used_entries = used_entries;
+    nvs_stats->free_entries = TOTAL_ENTRIES - used_entries;
+    nvs_stats->total_entries = TOTAL_ENTRIES;
+    nvs_stats->namespace_count = (size_t)namespace_count;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_used_entry_count(nvs_handle_t handle, size_t *used)
+{
+    if (!valid_handle(handle)) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!used) return ESP_ERR_INVALID_ARG;
+    *used = 0;
+    for (int i = 0; i < MAX_ENTRIES; i++) {
+        if (entries[i].used && entries[i].ns == handle) *used += entry_span(entries[i].type, entries[i].length);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,207 @@
+// File: host/sim/sim_power.c
+
+#include "sim_hal.h"
+#include "power_manager.h"
+#include "sleep_planner.h"
+#include "diagnostics.h"
+#include "dlog.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+
+// Sustituto de power_manager.c para el host: la fuente la fija la traza en lugar del GPIO 4,
+// la batería en lugar del ADC, y el deep sleep reinicia las tareas en tiempo virtual.
+
+static const char *TAG = "power_manager";
+
+#define POWER_MAX_SUBSCRIBERS   4
+#define SLEEP_PERIOD_DEFAULT_MS 60000
+
+static bool pin_usb = true;
+static float battery_v = 0.0f;
+static power_source_t last_detected_source = POWER_SOURCE_UNKNOWN;
+static uint32_t debounce_timer = 0;
+static TaskHandle_t subscribers[POWER_MAX_SUBSCRIBERS];
+static int subscriber_count = 0;
+static uint32_t sleep_period_ms = SLEEP_PERIOD_DEFAULT_MS;
+static uint32_t state_change_count = 0;
+
+static sim_boot_fn_t boot_fn = NULL;
+static bool sleeping = false;
+static uint32_t wake_timer = 0;
+static int64_t sleep_start_us = 0;
+static int64_t total_sleep_us = 0;
+static uint32_t deep_sleeps = 0;
+
+static power_source_t pin_source(void)
+{
+    return pin_usb ? POWER_SOURCE_USB : POWER_SOURCE_BATTERY;
+}
+
+// === ARRANQUE Y DEEP SLEEP ===
+
+static void boot_task(void *arg)
+{
+    (void)arg;
+    if (boot_fn) boot_fn();
+    vTaskDelete(NULL);                                  // Como app_main: termina tras lanzar las tareas
+}
+
+static void wake_cb(void *arg)
+{
+    (void)arg;
+    wake_timer = 0;
+    if (sleeping) {
+        sleeping = false;
+        total_sleep_us += sim_time_us() - sleep_start_us;
+    }
+    sim_reset_boot_time();
+    subscriber_count = 0;                               // Estado en RAM normal: se pierde con el reinicio
+    xTaskCreate(boot_task, "main", 4096, NULL, 1, NULL);
+}
+
+void sim_power_set_boot(sim_boot_fn_t boot)
+{
+    boot_fn = boot;
+    sim_sched_call_at(sim_time_us(), wake_cb, NULL);   // Primer encendido
+}
+
+uint32_t sim_power_deep_sleeps(void)
+{
+    return deep_sleeps;
+}
+
+int64_t sim_power_sleep_us(void)
+{
+    return total_sleep_us;
+}
+
+// === DETECCIÓN DE LA FUENTE ===
+
+static void debounce_cb(void *arg)
+{
+    // Misma regla que power_manager.c: dos lecturas iguales separadas por el antirrebote
+    bool confirming = (arg != NULL);
+    debounce_timer = 0;
+    if (pin_source() == last_detected_source) return;
+    if (!confirming) {
+        debounce_timer = sim_sched_call_at(sim_time_us() + (int64_t)CONFIG_POWER_DEBOUNCE_MS * 1000, debounce_cb, (void *)1);
+        return;
+    }
+
+    last_detected_source = pin_source();
+    state_change_count++;
+    diagnostics_event(DIAG_EVT_POWER_SOURCE, last_detected_source, (int32_t)state_change_count);
+    if (last_detected_source == POWER_SOURCE_USB) {
+        sleep_planner_reset();
+    }
+    ESP_LOGI(TAG, "CAMBIO DETECTADO #%" PRIu32 ": %s", state_change_count,
+             last_detected_source == POWER_SOURCE_USB ? "USB" : "Batería");
+    for (int i = 0; i < subscriber_count; i++) {
+        xTaskNotify(subscribers[i], POWER_EVENT_NOTIFY_BIT, eSetBits);
+    }
+}
+
+void sim_power_set_usb(bool usb)
+{
+    if (usb == pin_usb) return;
+    pin_usb = usb;
+
+#ifdef CONFIG_POWER_USB_WAKEUP
+    if (sleeping && usb && wake_timer) {
+        // ext0: el USB despierta al equipo antes del temporizador
+        sim_sched_cancel(wake_timer);
+        wake_timer = sim_sched_call_at(sim_time_us(), wake_cb, NULL);
+        return;
+    }
+#endif
+    if (!sleeping) {
+        if (debounce_timer) sim_sched_cancel(debounce_timer);
+        debounce_timer = sim_sched_call_at(sim_time_us() + (int64_t)CONFIG_POWER_DEBOUNCE_MS * 1000, debounce_cb, NULL);
+    }
+}
+
+void sim_power_set_battery_voltage(float volts)
+{
+    battery_v = volts;
+}
+
+// === API DE power_manager.h ===
+
+void power_manager_init(void)
+{
+    last_detected_source = pin_source();
+    ESP_LOGI(TAG, "Fuente inicial (simulada): %s", pin_usb ? "USB" : "Batería");
+}
+
+power_source_t power_manager_get_source(void)
+{
+    return last_detected_source;
+}
+
+bool power_manager_is_usb_connected(void)
+{
+    return last_detected_source == POWER_SOURCE_USB;
+}
+
+esp_err_t power_manager_subscribe(TaskHandle_t task)
+{
+    if (task == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (subscriber_count >= POWER_MAX_SUBSCRIBERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    subscribers[subscriber_count++] = task;
+    return ESP_OK;
+}
+
+bool power_manager_uses_deep_sleep(void)
+{
+#ifdef CONFIG_POWER_BATTERY_LIGHT_SLEEP
+    return false;
+#else
+    return true;
+#endif
+}
+
+bool power_manager_should_sleep(void)
+{
+    return power_manager_get_source() != POWER_SOURCE_USB && power_manager_uses_deep_sleep();
+}
+
+void power_manager_set_sleep_period_ms(uint32_t period_ms)
+{
+    sleep_period_ms = period_ms;
+}
+
+float power_manager_read_battery_voltage(void)
+{
+    return battery_v;
+}
+
+void power_manager_debug_gpio_state(void)
+{
+    ESP_LOGI(TAG, "Pin de detección (simulado): %d", pin_usb ? 1 : 0);
+}
+
+void power_manager_enter_deep_sleep(void)
+{
+    if (power_manager_get_source() == POWER_SOURCE_USB) {
+        ESP_LOGW(TAG, "CANCELANDO Deep Sleep: USB conectado");
+        return;
+    }
+
+    const uint64_t sleep_us = sleep_planner_next_sleep_us(sleep_period_ms);
+    dlog_flush();
+    deep_sleeps++;
+    sleeping = true;
+    sleep_start_us = sim_time_us();
+    if (debounce_timer) {
+        sim_sched_cancel(debounce_timer);
+        debounce_timer = 0;
+    }
+    sim_net_radio_off();
+    wake_timer = sim_sched_call_at(sim_time_us() + (int64_t)sleep_us, wake_cb, NULL);
+    sim_sched_kill_all();                               // No vuelve: el equipo "se reinicia" al despertar
+}
@@ -0,0 +1,525 @@
+// File: host/sim/sim_sched.c
+
+#include "sim_hal.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Planificador cooperativo en tiempo virtual. Cada tarea es un hilo, pero solo avanza el que
+// tiene el turno (current); los demás esperan en su variable de condición. Una tarea bloqueada
+// guarda el objeto que espera y su plazo: las señales sobre ese objeto adelantan su despertar
+// al instante actual y la tarea vuelve a comprobar su condición al recibir el turno.
+
+#define NO_DEADLINE     INT64_MAX
+
+struct sim_task {
+    pthread_t thread;
+    pthread_cond_t cond;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    UBaseType_t priority;
+    uint64_t last_run;              // Orden de turno entre tareas de igual prioridad
+    int64_t wake_us;                // Próximo despertar (NO_DEADLINE: solo por señal)
+    const void *waiting_on;
+    uint32_t notify_value;
+    bool notify_pending;
+    bool killed;
+    bool dead;
+    bool joined;
+    struct sim_task *next;
+};
+
+struct sim_queue {
+    uint32_t length;
+    uint32_t item_size;
+    uint32_t count;
+    uint32_t head;
+    uint8_t *storage;
+    struct sim_queue *next;
+};
+
+struct sim_event_group {
+    EventBits_t bits;
+};
+
+typedef struct sim_timer {
+    uint32_t id;
+    int64_t when_us;
+    sim_timer_fn_t fn;
+    void *arg;
+    struct sim_timer *next;
+} sim_timer_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sched_cond = PTHREAD_COND_INITIALIZER;
+static struct sim_task *tasks = NULL;
+static struct sim_task *current = NULL;
+static __thread struct sim_task *self = NULL;           // Tarea que ejecuta este hilo (NULL en el hilo principal)
+static sim_timer_t *timers = NULL;                      // Ordenados por instante y, a igualdad, por creación
+static uint32_t next_timer_id = 1;
+static uint64_t run_counter = 0;
+static bool stop_requested = false;
+static struct sim_queue *queues = NULL;
+static uint32_t queue_high_water = 0;
+static uint32_t queue_items_lost = 0;
+
+// === TURNOS ===
+
+static void task_exit(struct sim_task *t) __attribute__((noreturn));
+
+static void task_exit(struct sim_task *t)
+{
+    pthread_mutex_lock(&lock);
+    t->dead = true;
+    current = NULL;
+    pthread_cond_signal(&sched_cond);
+    pthread_mutex_unlock(&lock);
+    pthread_exit(NULL);
+}
+
+// Devuelve el turno al planificador y espera a recuperarlo
+static void task_yield(struct sim_task *t)
+{
+    pthread_mutex_lock(&lock);
+    current = NULL;
+    pthread_cond_signal(&sched_cond);
+    while (current != t) {
+        pthread_cond_wait(&t->cond, &lock);
+    }
+    bool killed = t->killed;
+    pthread_mutex_unlock(&lock);
+    if (killed) task_exit(t);
+}
+
+static void *task_entry(void *p)
+{
+    struct sim_task *t = p;
+    self = t;
+    pthread_mutex_lock(&lock);
+    while (current != t) {
+        pthread_cond_wait(&t->cond, &lock);
+    }
+    bool killed = t->killed;
+    pthread_mutex_unlock(&lock);
+    if (!killed) {
+        t->fn(t->arg);
+    }
+    task_exit(t);                                       // Una tarea que retorna equivale a vTaskDelete(NULL)
+}
+
+// Da el turno a la tarea y espera (en el hilo del planificador) a que lo devuelva
+static void dispatch(struct sim_task *t)
+{
+    t->last_run = ++run_counter;
+    pthread_mutex_lock(&lock);
+    current = t;
+    pthread_cond_signal(&t->cond);
+    while (current != NULL) {
+        pthread_cond_wait(&sched_cond, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+// Bloquea la tarea actual hasta una señal sobre obj o hasta el plazo; false si venció el plazo
+static bool wait_on(const void *obj, int64_t deadline_us)
+{
+    if (!self) {
+        // Sin tarea (microbenchmarks): nadie puede señalar, solo pasa el tiempo
+        if (deadline_us != NO_DEADLINE) sim_advance_us(deadline_us - sim_time_us());
+        return false;
+    }
+    self->waiting_on = obj;
+    self->wake_us = deadline_us;
+    task_yield(self);
+    self->waiting_on = NULL;
+    return sim_time_us() < deadline_us;
+}
+
+static void signal_waiters(const void *obj)
+{
+    int64_t now = sim_time_us();
+    for (struct sim_task *t = tasks; t; t = t->next) {
+        if (!t->dead && t->waiting_on == obj && t->wake_us > now) {
+            t->wake_us = now;
+        }
+    }
+}
+
+static int64_t deadline_from_ticks(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) return NO_DEADLINE;
+    return sim_time_us() + (int64_t)ticks * (1000000 / configTICK_RATE_HZ);
+}
+
+// === TAREAS ===
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void)stack;
+    struct sim_task *t = calloc(1, sizeof(*t));
+    if (!t) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "");
+    t->priority = priority;
+    t->wake_us = sim_time_us();                         // Lista para ejecutar
+    pthread_cond_init(&t->cond, NULL);
+    if (pthread_create(&t->thread, NULL, task_entry, t) != 0) {
+        free(t);
+        return pdFAIL;
+    }
+    t->next = tasks;
+    tasks = t;
+    if (handle) *handle = t;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+    if (!handle || handle == self) {
+        if (self) task_exit(self);
+        return;
+    }
+    handle->killed = true;
+    handle->wake_us = sim_time_us();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return self;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    int64_t deadline = deadline_from_ticks(ticks);
+    if (!self) {
+        sim_advance_us(deadline - sim_time_us());
+        return;
+    }
+    while (wait_on(NULL, deadline)) {
+    }
+}
+
+void sim_sched_sleep_us(int64_t us)
+{
+    int64_t deadline = sim_time_us() + us;
+    if (!self) {
+        sim_advance_us(us);
+        return;
+    }
+    while (wait_on(NULL, deadline)) {
+    }
+}
+
+// === NOTIFICACIONES ===
+
+BaseType_t xTaskNotify(TaskHandle_t handle, uint32_t value, eNotifyAction action)
+{
+    if (!handle || handle->dead) return pdFAIL;
+    switch (action) {
+        case eSetBits:                  handle->notify_value |= value; break;
+        case eIncrement:                handle->notify_value++; break;
+        case eSetValueWithOverwrite:    handle->notify_value = value; break;
+        case eSetValueWithoutOverwrite:
+            if (handle->notify_pending) return pdFAIL;
+            handle->notify_value = value;
+            break;
+        case eNoAction:                 break;
+    }
+    handle->notify_pending = true;
+    signal_waiters(handle);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle)
+{
+    return xTaskNotify(handle, 0, eIncrement);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks)
+{
+    struct sim_task *t = self;
+    if (!t) {
+        vTaskDelay(ticks == portMAX_DELAY ? 0 : ticks);
+        if (value) *value = 0;
+        return pdFALSE;
+    }
+    if (!t->notify_pending) {
+        t->notify_value &= ~clear_on_entry;
+        int64_t deadline = deadline_from_ticks(ticks);
+        while (!t->notify_pending && ticks != 0 && wait_on(t, deadline)) {
+        }
+    }
+    if (value) *value = t->notify_value;
+    if (!t->notify_pending) return pdFALSE;
+    t->notify_value &= ~clear_on_exit;
+    t->notify_pending = false;
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct sim_task *t = self;
+    if (!t) {
+        vTaskDelay(ticks == portMAX_DELAY ? 0 : ticks);
+        return 0;
+    }
+    int64_t deadline = deadline_from_ticks(ticks);
+    while (t->notify_value == 0 && ticks != 0 && wait_on(t, deadline)) {
+    }
+    uint32_t value = t->notify_value;
+    if (value != 0) {
+        t->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    t->notify_pending = false;
+    return value;
+}
+
+// === COLAS ===
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct sim_queue *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->storage = malloc((size_t)length * item_size);
+    if (!q->storage) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    q->next = queues;
+    queues = q;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    for (struct sim_queue **p = &queues; *p; p = &(*p)->next) {
+        if (*p == queue) {
+            *p = queue->next;
+            free(queue->storage);
+            free(queue);
+            return;
+        }
+    }
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    int64_t deadline = deadline_from_ticks(ticks);
+    while (queue->count == queue->length) {
+        if (ticks == 0 || !wait_on(queue, deadline)) {
+            if (queue->count == queue->length) return pdFAIL;
+        }
+    }
+    uint32_t slot = (queue->head + queue->count) % queue->length;
+    memcpy(queue->storage + (size_t)slot * queue->item_size, item, queue->item_size);
+    queue->count++;
+    if (queue->count > queue_high_water) queue_high_water = queue->count;
+    signal_waiters(queue);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks)
+{
+    int64_t deadline = deadline_from_ticks(ticks);
+    while (queue->count == 0) {
+        if (ticks == 0 || !wait_on(queue, deadline)) {
+            if (queue->count == 0) return pdFAIL;
+        }
+    }
+    memcpy(buffer, queue->storage + (size_t)queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    signal_waiters(queue);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+uint32_t sim_sched_queue_high_water(void)
+{
+    return queue_high_water;
+}
+
+uint32_t sim_sched_queue_items_lost(void)
+{
+    return queue_items_lost;
+}
+
+// === GRUPOS DE EVENTOS ===
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return calloc(1, sizeof(struct sim_event_group));
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    group->bits |= bits;
+    signal_waiters(group);
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    return group->bits;
+}
+
+static bool bits_satisfied(EventBits_t value, EventBits_t bits, BaseType_t wait_for_all)
+{
+    return wait_for_all ? (value & bits) == bits : (value & bits) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    int64_t deadline = deadline_from_ticks(ticks);
+    while (!bits_satisfied(group->bits, bits, wait_for_all)) {
+        if (ticks == 0 || !wait_on(group, deadline)) {
+            if (!bits_satisfied(group->bits, bits, wait_for_all)) return group->bits;
+        }
+    }
+    EventBits_t value = group->bits;
+    if (clear_on_exit) group->bits &= ~bits;
+    return value;
+}
+
+// === TEMPORIZADORES ===
+
+uint32_t sim_sched_call_at(int64_t when_us, sim_timer_fn_t fn, void *arg)
+{
+    sim_timer_t *tm = malloc(sizeof(*tm));
+    if (!tm) return 0;
+    tm->id = next_timer_id++;
+    tm->when_us = when_us;
+    tm->fn = fn;
+    tm->arg = arg;
+
+    sim_timer_t **p = &timers;
+    while (*p && (*p)->when_us <= when_us) {
+        p = &(*p)->next;
+    }
+    tm->next = *p;
+    *p = tm;
+    return tm->id;
+}
+
+void sim_sched_cancel(uint32_t timer_id)
+{
+    for (sim_timer_t **p = &timers; *p; p = &(*p)->next) {
+        if ((*p)->id == timer_id) {
+            sim_timer_t *tm = *p;
+            *p = tm->next;
+            free(tm);
+            return;
+        }
+    }
+}
+
+// === BUCLE DEL PLANIFICADOR ===
+
+void sim_sched_stop(void)
+{
+    stop_requested = true;
+}
+
+void sim_sched_kill_all(void)
+{
+    // Lo que quedaba en las colas se pierde con la RAM
+    for (struct sim_queue *q = queues; q; q = q->next) {
+        queue_items_lost += q->count;
+        q->count = 0;
+    }
+    for (struct sim_task *t = tasks; t; t = t->next) {
+        if (!t->dead) {
+            t->killed = true;
+            t->wake_us = sim_time_us();
+        }
+    }
+    if (self) task_exit(self);
+}
+
+// Recoge los hilos terminados. La estructura se conserva: alguien puede guardar aún el handle
+static void reap_tasks(void)
+{
+    for (struct sim_task *t = tasks; t; t = t->next) {
+        if (t->dead && !t->joined) {
+            pthread_join(t->thread, NULL);
+            t->joined = true;
+        }
+    }
+}
+
+// La tarea lista de más prioridad; a igualdad, la que lleva más tiempo sin turno
+static struct sim_task *pick_ready(int64_t now)
+{
+    struct sim_task *best = NULL;
+    for (struct sim_task *t = tasks; t; t = t->next) {
+        if (t->dead || t->wake_us > now) continue;
+        if (t->killed) return t;                        // Terminar cuanto antes las tareas de un reinicio
+        if (!best || t->priority > best->priority ||
+            (t->priority == best->priority && t->last_run < best->last_run)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+static int64_t next_wake(void)
+{
+    int64_t next = timers ? timers->when_us : NO_DEADLINE;
+    for (struct sim_task *t = tasks; t; t = t->next) {
+        if (!t->dead && t->wake_us < next) next = t->wake_us;
+    }
+    return next;
+}
+
+void sim_sched_run_until(int64_t end_us)
+{
+    stop_requested = false;
+    while (!stop_requested) {
+        int64_t now = sim_time_us();
+
+        // Los temporizadores vencidos van antes que las tareas (equivalen a interrupciones y eventos del sistema)
+        if (timers && timers->when_us <= now) {
+            sim_timer_t *tm = timers;
+            timers = tm->next;
+            tm->fn(tm->arg);
+            free(tm);
+            continue;
+        }
+
+        struct sim_task *t = pick_ready(now);
+        if (t) {
+            dispatch(t);
+            if (t->dead) reap_tasks();
+            continue;
+        }
+
+        int64_t next = next_wake();
+        if (next > end_us) {
+            if (end_us > now) sim_advance_us(end_us - now);
+            return;
+        }
+        sim_advance_us(next - now);
+    }
+}
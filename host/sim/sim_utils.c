@@ -0,0 +1,39 @@
+// File: host/sim/sim_utils.c
+
+#include "utils.h"
+#include "nvs.h"
+
+// Funciones de utils.c que usan las tareas. En host no hay botón BOOT ni LED: no hacen nada.
+// La calibración (tara remota) se guarda en RAM; al empezar no hay ninguna guardada
+
+static calibration_data_t saved_calibration;
+static bool calibration_saved = false;
+
+void boot_button_enable_wakeup(void)
+{
+}
+
+void led_set_state(led_state_t state)
+{
+    (void)state;
+}
+
+void led_stop_task(void)
+{
+}
+
+esp_err_t calibration_save_to_nvs(const calibration_data_t *cal_data)
+{
+    if (!cal_data) return ESP_ERR_INVALID_ARG;
+    saved_calibration = *cal_data;
+    calibration_saved = true;
+    return ESP_OK;
+}
+
+esp_err_t calibration_load_from_nvs(calibration_data_t *cal_data)
+{
+    if (!cal_data) return ESP_ERR_INVALID_ARG;
+    if (!calibration_saved) return ESP_ERR_NVS_NOT_FOUND;
+    *cal_data = saved_calibration;
+    return ESP_OK;
+}
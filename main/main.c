@@ -1,7 +1,9 @@
 //File: main/main.c
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
@@ -9,36 +11,79 @@
 #include "esp_sleep.h"
 #include "nvs_flash.h"
 #include "esp_timer.h"
+#include "esp_attr.h"
 #include "sdkconfig.h"
+#include "soc/soc_caps.h"
+#if SOC_TEMP_SENSOR_SUPPORTED
+#include "driver/temperature_sensor.h"
+#endif
 
 #include "nivometro_sensors.h"
 #include "diagnostics.h"
+#include "dlog.h"
+#include "metrics.h"
+#include "profiler.h"
 #include "config.h"
 #include "storage.h"
 #include "communication.h"
 #include "power_manager.h"
+#include "energy_budget.h"
 #include "utils.h"
 #include "tasks.h"
+#include "commands.h"
+#include "pipeline_bench.h"
 
 static const char *TAG = "NIVOMETRO_MAIN";
 
-// --- Configuración sensores ---
-#define HCSR04P_TRIGGER_PIN         12
-#define HCSR04P_ECHO_PIN            13
+// --- Configuración sensores (los pines están en la configuración: CFG_HCSR04P_*_PIN, CFG_HX711_*_PIN) ---
 #define HCSR04P_CAL_FACTOR          1.02f
-
-#define HX711_DOUT_PIN              GPIO_NUM_26
-#define HX711_SCK_PIN               GPIO_NUM_27
 #define HX711_KNOWN_WEIGHT_G        500.0f
 
 // Instancia global del nivómetro
 nivometro_t g_nivometro;
 
+#if CONFIG_HX711_ZERO_TRACKING
+// Cero de la balanza y su pendiente térmica aprendidos desde la última tara (sobreviven al deep sleep)
+RTC_DATA_ATTR static zero_tracker_t zero_tracker;
+#endif
+
+#if SOC_TEMP_SENSOR_SUPPORTED
+// Sensor de temperatura interno del chip. Mide el encapsulado, no el aire, pero dentro de la caja
+// sigue a la electrónica de la balanza, que es lo que deriva. Se activa solo durante la lectura
+static temperature_sensor_handle_t chip_temp_sensor = NULL;
+
+static float read_chip_temperature(void *ctx) {
+    (void)ctx;
+    float celsius = NAN;
+    if (temperature_sensor_enable(chip_temp_sensor) == ESP_OK) {
+        if (temperature_sensor_get_celsius(chip_temp_sensor, &celsius) != ESP_OK) {
+            celsius = NAN;
+        }
+        temperature_sensor_disable(chip_temp_sensor);
+    }
+    return celsius;
+}
+
+static void install_temperature_source(void) {
+    temperature_sensor_config_t temp_config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-30, 50);
+    if (temperature_sensor_install(&temp_config, &chip_temp_sensor) == ESP_OK) {
+        nivometro_set_temperature_source(&g_nivometro, read_chip_temperature, NULL);
+    } else {
+        ESP_LOGW(TAG, "Sensor de temperatura interno no disponible: sin compensación térmica");
+    }
+}
+#else
+static void install_temperature_source(void) {
+    ESP_LOGW(TAG, "El chip no tiene sensor de temperatura: solo seguimiento del cero");
+}
+#endif
+
 // Función para reinicializar HX711 después de deep sleep
 static esp_err_t reinitialize_hx711_after_deep_sleep(void) {
     esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
     
-    if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER) {
+    if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER || wakeup_reason == ESP_SLEEP_WAKEUP_EXT0 ||
+        wakeup_reason == ESP_SLEEP_WAKEUP_EXT1) {
         ESP_LOGI(TAG, "🔧 Reinicializando HX711 tras deep sleep");
         
         // Power cycle completo del HX711
@@ -90,6 +135,65 @@ static esp_err_t reinitialize_hx711_after_deep_sleep(void) {
     return ESP_OK; // No era deep sleep wakeup
 }
 
+// Calibración multipunto de la balanza: la tara más los pesos de CONFIG_CALIBRATION_HX711_MULTIPOINT_WEIGHTS,
+// ajustados por mínimos cuadrados. Deja el polinomio en cal_data y la tabla de conversión activa.
+static esp_err_t run_multipoint_scale_calibration(calibration_data_t *cal_data) {
+    int32_t net[HX711_CURVE_MAX_POINTS];
+    float weights[HX711_CURVE_MAX_POINTS];
+    int count = 0;
+
+    // La tara es el punto de 0 g
+    net[count] = 0;
+    weights[count++] = 0.0f;
+
+    const char *text = CONFIG_CALIBRATION_HX711_MULTIPOINT_WEIGHTS;
+    while (*text && count < HX711_CURVE_MAX_POINTS) {
+        char *end;
+        float w = strtof(text, &end);
+        if (end == text || w <= 0.0f) {
+            ESP_LOGE(TAG, "Lista de pesos de referencia no válida: %s", CONFIG_CALIBRATION_HX711_MULTIPOINT_WEIGHTS);
+            return ESP_ERR_INVALID_ARG;
+        }
+        ESP_LOGI(TAG, "Punto %d: coloca %.0f g y presiona BOOT", count, w);
+        boot_button_wait_for_press();
+
+        esp_err_t err = nivometro_read_scale_converged(&g_nivometro, &net[count]);
+        if (err != ESP_OK) {
+            return err;
+        }
+        weights[count++] = w;
+        ESP_LOGI(TAG, "Punto %d: %.0f g -> %ld cuentas netas", count - 1, w, (long)net[count - 1]);
+        text = (*end == ',') ? end + 1 : end;
+    }
+
+    int order = CONFIG_CALIBRATION_HX711_FIT_ORDER;
+    if (count <= order) {
+        ESP_LOGE(TAG, "Se necesitan al menos %d puntos para un ajuste de orden %d", order + 1, order);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    float rms_g = 0.0f;
+    esp_err_t err = hx711_fit_curve(net, weights, count, order, cal_data->hx711_curve, &rms_g);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int32_t net_min = net[0], net_max = net[0];
+    for (int i = 1; i < count; i++) {
+        if (net[i] < net_min) net_min = net[i];
+        if (net[i] > net_max) net_max = net[i];
+    }
+    err = hx711_set_curve(&g_nivometro.scale, cal_data->hx711_curve, net_min, net_max);
+    if (err != ESP_OK) {
+        return err;
+    }
+    cal_data->hx711_curve_order = (uint8_t)order;
+    cal_data->hx711_curve_min = net_min;
+    cal_data->hx711_curve_max = net_max;
+    ESP_LOGI(TAG, "Ajuste multipunto: %d puntos, error cuadrático medio %.2f g", count, rms_g);
+    return ESP_OK;
+}
+
 // Modo calibración
 static void run_calibration_mode(void) {
     ESP_LOGI(TAG, "===============ENTRANDO EN MODO CALIBRACIÓN===============");
@@ -97,21 +201,15 @@ static void run_calibration_mode(void) {
     // Cambiar LED a modo calibración (parpadeo rápido)
     led_set_state(LED_STATE_CALIBRATION);
     
-    // Limpiar la partición NVS para máximo espacio disponible
-    esp_err_t clear_result = calibration_all_nvs_partition();
-    if (clear_result == ESP_OK) {
-        ESP_LOGI(TAG, "Partición NVS limpiada para calibración");
-    } else {
-        ESP_LOGW(TAG, "Error limpiando NVS: %s", esp_err_to_name(clear_result));
-    }
+    // La calibración nueva se escribe en la ranura libre: diagnósticos y muestras pendientes se conservan
         
     // Mostrar parámetros configurados
     ESP_LOGI(TAG, "Parámetros de calibración (desde menuconfig):");
     ESP_LOGI(TAG, "Peso conocido HX711: %d gramos", CONFIG_CALIBRATION_HX711_KNOWN_WEIGHT);
-    ESP_LOGI(TAG, "Muestras HX711: %d", CONFIG_CALIBRATION_HX711_SAMPLES);
+    ESP_LOGI(TAG, "Máximo de muestras HX711: %d", CONFIG_CALIBRATION_HX711_SAMPLES);
     ESP_LOGI(TAG, "Tolerancia HX711: ±%d%%", CONFIG_CALIBRATION_HX711_TOLERANCE_PERCENT);
     ESP_LOGI(TAG, "Distancia conocida HC-SR04P: %d cm", CONFIG_CALIBRATION_HCSR04P_KNOWN_DISTANCE);
-    ESP_LOGI(TAG, "Muestras HC-SR04P: %d", CONFIG_CALIBRATION_HCSR04P_SAMPLES);
+    ESP_LOGI(TAG, "Máximo de muestras HC-SR04P: %d", CONFIG_CALIBRATION_HCSR04P_SAMPLES);
     ESP_LOGI(TAG, "Tolerancia HC-SR04P: ±%d%%", CONFIG_CALIBRATION_HCSR04P_TOLERANCE_PERCENT);
     
     calibration_data_t cal_data = {0};
@@ -124,7 +222,7 @@ static void run_calibration_mode(void) {
     
     // === PASO 1: TARA HX711 ===
     ESP_LOGI(TAG, "PASO 1: Calibración HX711 - TARA");
-    ESP_LOGI(TAG, "El sistema tomará %d mediciones", CONFIG_CALIBRATION_HX711_SAMPLES);
+    ESP_LOGI(TAG, "El sistema tomará hasta %d mediciones", CONFIG_CALIBRATION_HX711_SAMPLES);
     ESP_LOGI(TAG, "INSTRUCCIONES:");
     ESP_LOGI(TAG, "1. Asegúrate de que la balanza esté VACÍA");
     ESP_LOGI(TAG, "2. Presiona BOOT para continuar");
@@ -151,7 +249,7 @@ static void run_calibration_mode(void) {
     
     // === PASO 2: CALIBRACIÓN PESO HX711 ===
     ESP_LOGI(TAG, "PASO 2: Calibración HX711 - PESO CONOCIDO");
-    ESP_LOGI(TAG, "El sistema tomará %d mediciones", CONFIG_CALIBRATION_HX711_SAMPLES);
+    ESP_LOGI(TAG, "El sistema tomará hasta %d mediciones", CONFIG_CALIBRATION_HX711_SAMPLES);
     ESP_LOGI(TAG, "INSTRUCCIONES:");
     ESP_LOGI(TAG, "1. Coloca un peso conocido de %d gramos", CONFIG_CALIBRATION_HX711_KNOWN_WEIGHT);
     ESP_LOGI(TAG, "2. Presiona BOOT para continuar");
@@ -174,12 +272,23 @@ static void run_calibration_mode(void) {
         esp_restart();
     }
     
+    // === PASO 2b: CALIBRACIÓN MULTIPUNTO HX711 (opcional) ===
+    if (strlen(CONFIG_CALIBRATION_HX711_MULTIPOINT_WEIGHTS) > 0) {
+        ESP_LOGI(TAG, "PASO 2b: Calibración HX711 multipunto (orden %d)", CONFIG_CALIBRATION_HX711_FIT_ORDER);
+        esp_err_t multi_result = run_multipoint_scale_calibration(&cal_data);
+        if (multi_result != ESP_OK) {
+            ESP_LOGW(TAG, "Calibración multipunto fallida (%s), se mantiene el factor de escala",
+                     esp_err_to_name(multi_result));
+            cal_data.hx711_curve_order = 0;
+        }
+    }
+    
     // === PASO 3: CALIBRACIÓN DISTANCIA HC-SR04P ===
     ESP_LOGI(TAG, "PASO 3: Calibración HC-SR04P");
     ESP_LOGI(TAG, "INSTRUCCIONES:");
     ESP_LOGI(TAG, "1. Coloca un objeto a exactamente %d cm del sensor", CONFIG_CALIBRATION_HCSR04P_KNOWN_DISTANCE);
     ESP_LOGI(TAG, "2. Asegúrate de que el objeto esté perpendicular al sensor");
-    ESP_LOGI(TAG, "3. El sistema tomará %d mediciones", CONFIG_CALIBRATION_HCSR04P_SAMPLES);
+    ESP_LOGI(TAG, "3. El sistema tomará hasta %d mediciones", CONFIG_CALIBRATION_HCSR04P_SAMPLES);
     ESP_LOGI(TAG, "4. Presiona BOOT para continuar");
     
     boot_button_wait_for_press();
@@ -229,14 +338,23 @@ static void run_calibration_mode(void) {
 void app_main(void) {
     esp_err_t ret;
 
+    // 0) Perfilador de fases: lo primero, para medir el arranque
+    profiler_init();
+
     // 1) Inicializar GPIO para LED y botón BOOT 
     led_init();
     boot_button_init();
     led_start_task();
     led_set_state(LED_STATE_OFF);
 
-    // 2) Logs y diagnóstico
+    // 2) Logs, diagnóstico y registro de métricas (conservado en RTC entre despertares)
     diagnostics_init();
+    metrics_init();
+    dlog_init();                                        // Registro diferido de los caminos calientes
+    diagnostics_event(DIAG_EVT_BOOT, esp_reset_reason(), esp_sleep_get_wakeup_cause());
+#if CONFIG_DLOG_BENCHMARK
+    dlog_run_benchmark();
+#endif
 
     // 3) Mensajes de arranque del nivómetro
     ESP_LOGI(TAG, "Iniciando TFG Nivómetro Antártida");
@@ -249,6 +367,10 @@ void app_main(void) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         ret = nvs_flash_init();
     }
+
+    // 4b) Configuración: caché en RAM de los parámetros guardados (pines, intervalos...)
+    config_init();
+
     // 5) Modo calibración
     if (boot_button_check_calibration_mode()) {
         ESP_LOGI(TAG, "Botón BOOT detectado - Entrando en modo calibración");
@@ -258,11 +380,11 @@ void app_main(void) {
         
         // Inicializar nivómetro para calibración
         nivometro_config_t nivometro_config = {
-            .hcsr04p_trigger_pin = HCSR04P_TRIGGER_PIN,
-            .hcsr04p_echo_pin    = HCSR04P_ECHO_PIN,
+            .hcsr04p_trigger_pin = (int)config_get_u32(CFG_HCSR04P_TRIGGER_PIN),
+            .hcsr04p_echo_pin    = (int)config_get_u32(CFG_HCSR04P_ECHO_PIN),
             .hcsr04p_cal_factor  = HCSR04P_CAL_FACTOR,
-            .hx711_dout_pin      = HX711_DOUT_PIN,
-            .hx711_sck_pin       = HX711_SCK_PIN,
+            .hx711_dout_pin      = (gpio_num_t)config_get_u32(CFG_HX711_DOUT_PIN),
+            .hx711_sck_pin       = (gpio_num_t)config_get_u32(CFG_HX711_SCK_PIN),
             .hx711_gain          = HX711_GAIN_128,
             .hx711_known_weight  = HX711_KNOWN_WEIGHT_G
         };
@@ -277,9 +399,6 @@ void app_main(void) {
     //Continua con el arranque normal
     ESP_LOGI(TAG, "Arranque normal");
 
-    // 6) Configuración global
-    config_init();
-
     // 7) Validación de calibración
     bool calibration_valid = calibration_check_and_warn();
     
@@ -294,11 +413,11 @@ void app_main(void) {
     
     // 9) Inicializar el nivómetro 
     nivometro_config_t nivometro_config = {
-        .hcsr04p_trigger_pin = HCSR04P_TRIGGER_PIN,
-        .hcsr04p_echo_pin    = HCSR04P_ECHO_PIN,
+        .hcsr04p_trigger_pin = (int)config_get_u32(CFG_HCSR04P_TRIGGER_PIN),
+        .hcsr04p_echo_pin    = (int)config_get_u32(CFG_HCSR04P_ECHO_PIN),
         .hcsr04p_cal_factor  = HCSR04P_CAL_FACTOR,
-        .hx711_dout_pin      = HX711_DOUT_PIN,
-        .hx711_sck_pin       = HX711_SCK_PIN,
+        .hx711_dout_pin      = (gpio_num_t)config_get_u32(CFG_HX711_DOUT_PIN),
+        .hx711_sck_pin       = (gpio_num_t)config_get_u32(CFG_HX711_SCK_PIN),
         .hx711_gain          = HX711_GAIN_128,
         .hx711_known_weight  = HX711_KNOWN_WEIGHT_G 
     };
@@ -323,31 +442,58 @@ void app_main(void) {
     }
     
     // 11) Fix específico para HX711 tras deep sleep
+    profiler_begin(PROFILE_HX711_REINIT);
     esp_err_t hx711_init_result = reinitialize_hx711_after_deep_sleep();
+    profiler_end(PROFILE_HX711_REINIT);
     if (hx711_init_result != ESP_OK) {
         ESP_LOGW(TAG, "⚠️ Problema reinicializando HX711, pero continuando...");
     }
     
+    // 11b) Deriva de la balanza: temperatura y seguimiento del cero desde la tara
+    install_temperature_source();
+#if CONFIG_HX711_ZERO_TRACKING
+    nivometro_enable_zero_tracking(&g_nivometro, &zero_tracker);
+#endif
+    
     ESP_LOGI(TAG, "Nivómetro inicializado correctamente");
 
     // 12) Almacenamiento local
     storage_init();
 
-    // 13) Comunicaciones (Wi-Fi, MQTT, sincronización de hora)
-    communication_init();
-    ESP_LOGI(TAG, "Comunicaciones inicializadas");
-
-    // 14) GESTIÓN DE ENERGÍA CON DETECCIÓN REAL POR GPIO
+    // 13) GESTIÓN DE ENERGÍA CON DETECCIÓN REAL POR GPIO
     power_manager_init();
     
     // Mostrar estado inicial de alimentación
     power_source_t initial_power = power_manager_get_source();
+    bool start_communication = true;
     if (initial_power == POWER_SOURCE_USB) {
         ESP_LOGI(TAG, "USB DETECTADO (GPIO 4 = 1) - Iniciando en modo nominal");
         ESP_LOGI(TAG, "Comportamiento: Mediciones cada 5 segundos, sin deep sleep");
     } else {
         ESP_LOGI(TAG, "SOLO BATERÍA DETECTADA (GPIO 4 = 0) - Iniciando en modo batería");
-        ESP_LOGI(TAG, "Comportamiento: Mediciones cada 60 segundos + deep sleep automático");
+        
+        // Planificar el ciclo según la batería restante; el WiFi solo se levanta en ciclos de subida
+        energy_budget_begin_cycle();
+        energy_budget_update(power_manager_read_battery_voltage(), NULL);
+        const energy_plan_t* plan = energy_budget_get_plan();
+        start_communication = plan->upload_due;
+        ESP_LOGI(TAG, "Comportamiento: Mediciones cada %lu s, subida cada %lu ciclos + deep sleep automático",
+                 plan->sample_period_s, plan->upload_every);
+    }
+
+    // 13b) Comandos remotos: antes de conectar, para suscribirse a <prefijo>/<id>/cmd al llegar al broker
+    commands_init();
+
+    // 14) Comunicaciones (Wi-Fi, MQTT, sincronización de hora)
+    if (start_communication) {
+        communication_init();
+        ESP_LOGI(TAG, "Comunicaciones inicializadas");
+#if CONFIG_PIPELINE_BENCHMARK
+        communication_wait_for_connection();
+        pipeline_bench_run_default();
+#endif
+    } else {
+        ESP_LOGI(TAG, "Ciclo sin subida - WiFi apagado (%lu muestras pendientes)", storage_pending_count());
     }
 
     // 15) Temporizador interno
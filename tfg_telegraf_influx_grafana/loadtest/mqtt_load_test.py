@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+# File: tfg_telegraf_influx_grafana/loadtest/mqtt_load_test.py
+#
+# Prueba de carga del broker: simula N estaciones que publican lotes de
+# muestras en su topic nivometro/<id>/data, igual que el firmware, y un
+# suscriptor que mide mensajes recibidos, muestras/s y latencia extremo a extremo.
+# La latencia se mide con el campo sent_at de cada muestra, que Telegraf descarta
+# (fielddrop) para no guardarlo en InfluxDB.
+#
+# Uso (con el broker local levantado: docker-compose --profile loadtest up -d):
+#   pip install paho-mqtt
+#   python3 loadtest/mqtt_load_test.py --stations 50 --batch 12 --rate 1 --duration 60
+
+import argparse
+import json
+import random
+import threading
+import time
+from datetime import datetime, timezone
+
+import paho.mqtt.client as mqtt
+
+
+def make_client(client_id):
+    # Compatible con paho-mqtt 1.x y 2.x
+    try:
+        return mqtt.Client(mqtt.CallbackAPIVersion.VERSION1, client_id=client_id)
+    except AttributeError:
+        return mqtt.Client(client_id=client_id)
+
+
+def iso_utc(ts):
+    return datetime.fromtimestamp(ts, timezone.utc).strftime("%Y-%m-%dT%H:%M:%SZ")
+
+
+def station_worker(args, index, stop, stats):
+    station_id = "load%03d" % index
+    topic = "%s/%s/data" % (args.prefix, station_id)
+    client = make_client("nivometro-" + station_id)
+    client.connect(args.host, args.port, keepalive=60)
+    client.loop_start()
+
+    distance = random.uniform(50.0, 300.0)
+    weight = random.uniform(0.0, 50.0)
+    period = 1.0 / args.rate
+    next_deadline = time.monotonic() + random.uniform(0.0, period)
+
+    while not stop.is_set():
+        now = time.time()
+        batch = []
+        for i in range(args.batch):
+            # Paseo aleatorio suave, como una acumulación de nieve lenta
+            distance = max(0.0, distance - random.uniform(-0.2, 0.5))
+            weight = max(0.0, weight + random.uniform(-0.05, 0.2))
+            batch.append({
+                "distance_cm": round(distance, 2),
+                "weight_kg": round(weight, 3),
+                "timestamp": iso_utc(now - (args.batch - 1 - i) * args.sample_period),
+                "sent_at": now,
+            })
+        payload = json.dumps(batch, separators=(",", ":"))
+        client.publish(topic, payload, qos=args.qos)
+        with stats["lock"]:
+            stats["published_msgs"] += 1
+            stats["published_samples"] += len(batch)
+            stats["published_bytes"] += len(payload)
+
+        next_deadline += period
+        delay = next_deadline - time.monotonic()
+        if delay > 0:
+            stop.wait(delay)
+
+    client.loop_stop()
+    client.disconnect()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Prueba de carga MQTT para la flota de nivómetros")
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--prefix", default="nivometro", help="Prefijo de topic (CONFIG_MQTT_TOPIC_PREFIX)")
+    parser.add_argument("--stations", type=int, default=50, help="Número de estaciones simuladas")
+    parser.add_argument("--batch", type=int, default=12, help="Muestras por mensaje")
+    parser.add_argument("--sample-period", type=float, default=5.0, help="Separación entre muestras del lote (s)")
+    parser.add_argument("--rate", type=float, default=1.0, help="Mensajes por segundo y estación")
+    parser.add_argument("--qos", type=int, default=1, choices=[0, 1])
+    parser.add_argument("--duration", type=float, default=60.0, help="Duración de la prueba (s)")
+    args = parser.parse_args()
+
+    stats = {"lock": threading.Lock(), "published_msgs": 0, "published_samples": 0,
+             "published_bytes": 0, "received_msgs": 0, "received_samples": 0, "latencies": []}
+
+    def on_message(client, userdata, msg):
+        received = time.time()
+        batch = json.loads(msg.payload)
+        with stats["lock"]:
+            stats["received_msgs"] += 1
+            stats["received_samples"] += len(batch)
+            stats["latencies"].append(received - batch[-1]["sent_at"])
+
+    sub = make_client("nivometro-loadtest-sub")
+    sub.on_message = on_message
+    sub.connect(args.host, args.port, keepalive=60)
+    sub.subscribe("%s/+/data" % args.prefix, qos=args.qos)
+    sub.loop_start()
+    time.sleep(0.5)
+
+    stop = threading.Event()
+    workers = [threading.Thread(target=station_worker, args=(args, i, stop, stats), daemon=True)
+               for i in range(args.stations)]
+    start = time.monotonic()
+    for w in workers:
+        w.start()
+    time.sleep(args.duration)
+    stop.set()
+    for w in workers:
+        w.join()
+    time.sleep(1.0)  # Margen para que lleguen los últimos mensajes
+    elapsed = time.monotonic() - start
+    sub.loop_stop()
+    sub.disconnect()
+
+    lat = sorted(stats["latencies"])
+
+    def pct(p):
+        return lat[min(len(lat) - 1, int(p / 100.0 * len(lat)))] * 1000.0 if lat else float("nan")
+
+    print("Estaciones: %d  lote: %d muestras  qos: %d  duración: %.1f s"
+          % (args.stations, args.batch, args.qos, elapsed))
+    print("Publicados: %d mensajes, %d muestras, %d bytes"
+          % (stats["published_msgs"], stats["published_samples"], stats["published_bytes"]))
+    print("Recibidos:  %d mensajes, %d muestras (%.1f muestras/s)"
+          % (stats["received_msgs"], stats["received_samples"], stats["received_samples"] / elapsed))
+    print("Perdidos:   %d mensajes" % (stats["published_msgs"] - stats["received_msgs"]))
+    print("Latencia (ms): p50=%.1f p95=%.1f p99=%.1f max=%.1f"
+          % (pct(50), pct(95), pct(99), lat[-1] * 1000.0 if lat else float("nan")))
+
+
+if __name__ == "__main__":
+    main()
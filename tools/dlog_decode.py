@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+# File: tools/dlog_decode.py
+#
+# Decodificador del registro diferido (CONFIG_DLOG_OUTPUT_BINARY). El firmware imprime
+# líneas "DL <ts> <nivel> <tag> <fmt> <n> <a0> <a1> <a2> <a3>" en hexadecimal; las
+# direcciones de tag y formato (y de los argumentos %s) se leen del ELF del firmware
+# y los argumentos se reinterpretan según cada conversión del formato.
+#
+# Uso:
+#   pip install pyelftools
+#   idf.py monitor | python3 tools/dlog_decode.py build/nivometro.elf
+#   python3 tools/dlog_decode.py build/nivometro.elf captura.log
+
+import argparse
+import re
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+
+LEVELS = "NEWID"
+SPEC_RE = re.compile(r"%(%|[-+ #0]*\d*(?:\.\d+)?(hh|h|ll|l|z|j|t)?([diuxXcsfFeEgGaAp]))")
+
+
+class ElfStrings:
+    # Lee cadenas terminadas en cero a partir de su dirección en las secciones cargables
+    def __init__(self, path):
+        self.sections = []
+        with open(path, "rb") as f:
+            elf = ELFFile(f)
+            for sec in elf.iter_sections():
+                if sec["sh_addr"] and sec["sh_type"] == "SHT_PROGBITS":
+                    self.sections.append((sec["sh_addr"], sec.data()))
+        self.cache = {}
+
+    def string(self, addr):
+        if addr in self.cache:
+            return self.cache[addr]
+        for base, data in self.sections:
+            if base <= addr < base + len(data):
+                end = data.index(b"\0", addr - base)
+                text = data[addr - base:end].decode("utf-8", "replace")
+                self.cache[addr] = text
+                return text
+        return "<0x%08x?>" % addr
+
+
+def format_message(strings, fmt, args):
+    out = []
+    pos = 0
+    index = 0
+    for m in SPEC_RE.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        if m.group(1) == "%":
+            out.append("%")
+            continue
+        spec = "%" + m.group(1)
+        if m.group(2):
+            spec = spec.replace(m.group(2), "", 1)   # Python no usa modificadores de longitud
+        conv = m.group(3)
+        raw = args[index] if index < len(args) else 0
+        index += 1
+        if conv in "fFeEgGaA":
+            value = struct.unpack("<f", struct.pack("<I", raw))[0]
+            out.append(spec.replace(conv, "f" if conv in "aA" else conv) % value)
+        elif conv == "s":
+            out.append(spec % strings.string(raw))
+        elif conv == "p":
+            out.append("0x%08x" % raw)
+        elif conv in "di":
+            out.append(spec % struct.unpack("<i", struct.pack("<I", raw))[0])
+        elif conv == "c":
+            out.append(chr(raw & 0xFF))
+        else:
+            out.append(spec.replace("u", "d") % raw)
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decodifica las líneas DL del registro diferido")
+    parser.add_argument("elf", help="ELF del firmware que generó el registro")
+    parser.add_argument("log", nargs="?", help="Captura de la consola (por defecto, entrada estándar)")
+    args = parser.parse_args()
+
+    strings = ElfStrings(args.elf)
+    source = open(args.log, encoding="utf-8", errors="replace") if args.log else sys.stdin
+    for line in source:
+        fields = line.split()
+        if len(fields) != 10 or fields[0] != "DL":
+            sys.stdout.write(line)                      # Resto de la consola sin tocar
+            continue
+        ts, level, tag, fmt, nargs = (int(x, 16) for x in fields[1:6])
+        raw_args = [int(x, 16) for x in fields[6:6 + nargs]]
+        text = format_message(strings, strings.string(fmt), raw_args)
+        print("%s (%d) %s: %s" % (LEVELS[min(level, 4)], ts, strings.string(tag), text))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+# File: tools/influx_export_trace.py
+#
+# Exporta de InfluxDB las muestras de una estación (medida Nivometro) a una traza CSV para
+# host/replay: timestamp,distance_cm,weight_kg,power,battery_v. La fuente de alimentación no
+# se guarda en InfluxDB; se deduce del ritmo de publicación (en USB se publica cada pocos
+# segundos, en batería una muestra por despertar) con el umbral --usb-gap-s.
+#
+# Uso:
+#   INFLUX_TOKEN=... python3 tools/influx_export_trace.py --station 240ac4000001 \
+#       --start 2024-01-01T00:00:00Z --stop 2024-03-01T00:00:00Z > traza.csv
+#   ./build-host/replay traza.csv --json informe.json
+
+import argparse
+import csv
+import io
+import os
+import sys
+import urllib.request
+from datetime import datetime
+
+QUERY = """
+from(bucket: "{bucket}")
+  |> range(start: {start}, stop: {stop})
+  |> filter(fn: (r) => r._measurement == "Nivometro" and r.station == "{station}")
+  |> filter(fn: (r) => r._field == "distance_cm" or r._field == "weight_kg" or r._field == "battery_v")
+  |> pivot(rowKey: ["_time"], columnKey: ["_field"], valueColumn: "_value")
+  |> keep(columns: ["_time", "distance_cm", "weight_kg", "battery_v"])
+  |> sort(columns: ["_time"])
+"""
+
+
+def query_influx(args):
+    body = QUERY.format(bucket=args.bucket, start=args.start, stop=args.stop, station=args.station)
+    req = urllib.request.Request(
+        f"{args.url.rstrip('/')}/api/v2/query?org={args.org}",
+        data=body.encode(),
+        headers={
+            "Authorization": f"Token {args.token}",
+            "Content-Type": "application/vnd.flux",
+            "Accept": "application/csv",
+        },
+    )
+    with urllib.request.urlopen(req) as resp:
+        return resp.read().decode()
+
+
+def parse_rows(text):
+    # CSV anotado de Flux: una tabla por bloque, cabecera propia en cada una
+    rows = []
+    header = None
+    for line in csv.reader(io.StringIO(text)):
+        if not line or line[0].startswith("#"):
+            header = None
+            continue
+        if header is None:
+            header = line
+            continue
+        rec = dict(zip(header, line))
+        if not rec.get("distance_cm") or not rec.get("weight_kg"):
+            continue
+        ts = datetime.fromisoformat(rec["_time"].replace("Z", "+00:00"))
+        rows.append((int(ts.timestamp()), float(rec["distance_cm"]), float(rec["weight_kg"]),
+                     rec.get("battery_v") or ""))
+    return rows
+
+
+def main():
+    p = argparse.ArgumentParser(description="Exporta una traza de InfluxDB para host/replay")
+    p.add_argument("--url", default=os.environ.get("INFLUX_URL", "http://localhost:8086"))
+    p.add_argument("--org", default=os.environ.get("INFLUX_ORG", "my-tfg"))
+    p.add_argument("--bucket", default=os.environ.get("INFLUX_BUCKET", "Simulacion_tfg"))
+    p.add_argument("--token", default=os.environ.get("INFLUX_TOKEN"))
+    p.add_argument("--station", required=True, help="Id de la estación (etiqueta station)")
+    p.add_argument("--start", required=True, help="Inicio, RFC 3339 o relativo (-30d)")
+    p.add_argument("--stop", default="now()", help="Fin, RFC 3339 (por defecto ahora)")
+    p.add_argument("--usb-gap-s", type=float, default=30.0,
+                   help="Separación máxima entre muestras para considerar la estación en USB")
+    args = p.parse_args()
+    if not args.token:
+        p.error("falta el token (--token o INFLUX_TOKEN)")
+    rows = parse_rows(query_influx(args))
+    if not rows:
+        print("Sin muestras en el intervalo", file=sys.stderr)
+        return 1
+
+    out = csv.writer(sys.stdout, lineterminator="\n")
+    out.writerow(["timestamp", "distance_cm", "weight_kg", "power", "battery_v"])
+    for i, (ts, dist, kg, volts) in enumerate(rows):
+        gaps = [abs(ts - rows[j][0]) for j in (i - 1, i + 1) if 0 <= j < len(rows)]
+        power = "usb" if gaps and min(gaps) <= args.usb_gap_s else "battery"
+        out.writerow([ts, f"{dist:.2f}", f"{kg:.3f}", power, volts])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())